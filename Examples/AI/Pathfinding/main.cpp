@@ -0,0 +1,117 @@
+#include <echlib.h> // include echlib
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Agents walking to random goals on a grid. Their paths are requested all at once and searched
+// on the job workers; each frame's Update() hands back the batch started the frame before.
+
+struct Agent
+{
+	float x, y;
+	int request = -1;
+	std::vector<ech::PathPoint> path;
+	size_t next = 0;
+	ech::Color color;
+};
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+	const int TileSize = 12;
+	const int Columns = WindowWidth / TileSize, Rows = WindowHeight / TileSize;
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Pathfinding example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	ech::PathGrid grid(Columns, Rows);
+	for (int i = 0; i < 120; i++) // random walls
+	{
+		int x = rand() % Columns, y = rand() % Rows, length = 5 + rand() % 20;
+		bool horizontal = rand() % 2 == 0;
+		for (int k = 0; k < length; k++) grid.SetWalkable(horizontal ? x + k : x, horizontal ? y : y + k, false);
+	}
+
+	auto randomTile = [&](int& x, int& y)
+	{
+		do { x = rand() % Columns; y = rand() % Rows; } while (!grid.IsWalkable(x, y));
+	};
+
+	std::vector<Agent> agents(300);
+	for (Agent& a : agents)
+	{
+		int x, y;
+		randomTile(x, y);
+		a.x = (float)x;
+		a.y = (float)y;
+		a.color = { 0.3f + (rand() % 70) / 100.0f, 0.3f + (rand() % 70) / 100.0f, 1.0f, 1.0f };
+	}
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+
+		// Left click toggles a wall; the hierarchical cache only redoes the clusters around it
+		if (ech::IsMouseButtonPressed(ech::MOUSE_LEFT_BUTTON))
+		{
+			int x = (int)(ech::GetMouseX() / TileSize), y = (int)(ech::GetMouseY() / TileSize);
+			grid.SetWalkable(x, y, !grid.IsWalkable(x, y));
+		}
+
+		grid.Update(); // completes last frame's requests and starts this frame's
+
+		for (Agent& a : agents)
+		{
+			if (a.request >= 0 && grid.GetPathStatus(a.request) != ech::PATH_PENDING)
+			{
+				grid.GetPath(a.request, a.path);
+				grid.ReleasePath(a.request);
+				a.request = -1;
+				a.next = 0;
+			}
+			if (a.request < 0 && a.next >= a.path.size())
+			{
+				int gx, gy;
+				randomTile(gx, gy);
+				a.path.clear();
+				a.request = grid.RequestPath((int)(a.x + 0.5f), (int)(a.y + 0.5f), gx, gy, ech::PATH_HIERARCHICAL);
+			}
+
+			// Walk toward the next tile of the path
+			if (a.next < a.path.size())
+			{
+				float dx = a.path[a.next].x - a.x, dy = a.path[a.next].y - a.y;
+				float step = 8.0f * dt;
+				if (dx * dx + dy * dy <= step * step)
+				{
+					a.x = (float)a.path[a.next].x;
+					a.y = (float)a.path[a.next].y;
+					a.next++;
+				}
+				else
+				{
+					float length = sqrtf(dx * dx + dy * dy);
+					a.x += dx / length * step;
+					a.y += dy / length * step;
+				}
+			}
+		}
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		for (int y = 0; y < Rows; y++)
+			for (int x = 0; x < Columns; x++)
+				if (!grid.IsWalkable(x, y)) ech::DrawRectangle((float)(x * TileSize), (float)(y * TileSize), TileSize, TileSize, ech::GRAY);
+
+		for (const Agent& a : agents)
+			ech::DrawRectangle(a.x * TileSize + 2, a.y * TileSize + 2, TileSize - 4, TileSize - 4, a.color);
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include <echlib.h> // include echlib
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks CheckCollisionBatch against CheckCollision for every instruction set this CPU supports,
+// then times one box against 1M boxes. No window needed.
+
+static const char* SimdName(ech::SimdLevel level)
+{
+	switch (level)
+	{
+	case ech::SIMD_AVX2: return "AVX2";
+	case ech::SIMD_SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
+
+int main()
+{
+	const int BoxCount = 1000000;
+
+	// Boxes in structure-of-arrays layout: one array per field
+	std::vector<float> x(BoxCount), y(BoxCount), w(BoxCount), h(BoxCount);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-5000.0f, 5000.0f);
+	std::uniform_real_distribution<float> size(1.0f, 64.0f);
+	for (int i = 0; i < BoxCount; i++)
+	{
+		x[i] = position(rng);
+		y[i] = position(rng);
+		w[i] = size(rng);
+		h[i] = size(rng);
+	}
+	// A few boxes that only touch the query edge, which must not count as overlapping
+	x[0] = 100.0f; y[0] = 0.0f; w[0] = 10.0f; h[0] = 10.0f;
+	x[1] = -10.0f; y[1] = 0.0f; w[1] = 10.0f; h[1] = 10.0f;
+
+	ech::BoxArray boxes;
+	boxes.x = x.data();
+	boxes.y = y.data();
+	boxes.w = w.data();
+	boxes.h = h.data();
+	boxes.count = BoxCount;
+
+	const float qx = 0.0f, qy = 0.0f, qw = 100.0f, qh = 100.0f;
+
+	// Reference result from the scalar CheckCollision
+	std::vector<int> expected;
+	for (int i = 0; i < BoxCount; i++)
+	{
+		if (ech::CheckCollision(qx, qy, qw, qh, x[i], y[i], w[i], h[i])) expected.push_back(i);
+	}
+
+	std::vector<uint64_t> mask((BoxCount + 63) / 64);
+	std::vector<int> indices(BoxCount);
+	bool allPassed = true;
+
+	for (int level = ech::SIMD_SCALAR; level <= ech::GetSupportedSimdLevel(); level++)
+	{
+		ech::SetSimdLevel((ech::SimdLevel)level);
+
+		// Bitmask and index list must both agree with CheckCollision
+		ech::CheckCollisionBatch(qx, qy, qw, qh, boxes, mask.data());
+		int found = ech::CheckCollisionBatch(qx, qy, qw, qh, boxes, indices.data(), BoxCount);
+		bool passed = found == (int)expected.size();
+		for (int i = 0; passed && i < found; i++) passed = indices[i] == expected[i];
+		for (int i = 0; passed && i < BoxCount; i++)
+		{
+			bool bit = (mask[i / 64] >> (i % 64)) & 1;
+			passed = bit == ech::CheckCollision(qx, qy, qw, qh, x[i], y[i], w[i], h[i]);
+		}
+		allPassed = allPassed && passed;
+
+		// Time the bitmask version, best of a few runs
+		double bestMs = 1e9;
+		for (int run = 0; run < 20; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			ech::CheckCollisionBatch(qx, qy, qw, qh, boxes, mask.data());
+			auto end = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if (ms < bestMs) bestMs = ms;
+		}
+
+		std::printf("%-6s %s  %d overlaps  %.3f ms for %d boxes (%.2f ns/box)\n",
+			SimdName((ech::SimdLevel)level), passed ? "OK  " : "FAIL", found, bestMs, BoxCount, bestMs * 1e6 / BoxCount);
+	}
+
+	// Scalar CheckCollision loop for comparison
+	double scalarMs = 1e9;
+	for (int run = 0; run < 20; run++)
+	{
+		int hits = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < BoxCount; i++) hits += ech::CheckCollision(qx, qy, qw, qh, x[i], y[i], w[i], h[i]);
+		auto end = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (ms < scalarMs && hits >= 0) scalarMs = ms;
+	}
+	std::printf("CheckCollision loop  %.3f ms\n", scalarMs);
+
+	return allPassed ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <echlib.h> // include echlib
+
+#include <chrono>
+#include <cstdio>
+
+// Builds a pyramid of boxes on a static floor and steps it at 60 Hz until it settles,
+// printing the step cost, island count and how much the top box moved. No window needed.
+
+int main()
+{
+	const int Base = 40;
+	const float Size = 20.0f;
+
+	ech::Physics world;
+
+	ech::BodyDef floorBody;
+	floorBody.type = ech::BODY_STATIC;
+	floorBody.y = 20.0f;
+	ech::ShapeDef floorShape;
+	floorShape.width = 4000.0f;
+	floorShape.height = 40.0f;
+	world.CreateBody(floorBody, floorShape);
+
+	ech::ShapeDef box;
+	box.width = Size;
+	box.height = Size;
+
+	int top = -1;
+	for (int row = 0; row < Base; row++)
+	{
+		for (int i = 0; i < Base - row; i++)
+		{
+			ech::BodyDef body;
+			body.x = (i - (Base - row - 1) * 0.5f) * Size;
+			body.y = -(row + 0.5f) * Size;
+			top = world.CreateBody(body, box);
+		}
+	}
+	const float topX = world.GetX(top), topY = world.GetY(top);
+
+	printf("%d bodies, %d solver workers\n", world.GetBodyCount(), world.GetWorkerCount());
+
+	double totalMs = 0.0;
+	int steps = 0;
+	for (; steps < 600 && world.GetAwakeBodyCount() > 0; steps++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		world.Step(1.0f / 60.0f);
+		totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (steps % 30 == 0)
+		{
+			printf("step %3d: %d awake, %d contacts, %d islands\n", steps, world.GetAwakeBodyCount(),
+				world.GetContactCount(), world.GetIslandCount());
+		}
+	}
+
+	printf("settled after %d steps, %.3f ms per step\n", steps, totalMs / steps);
+	printf("top box moved (%.2f, %.2f)\n", world.GetX(top) - topX, world.GetY(top) - topY);
+	return 0;
+}
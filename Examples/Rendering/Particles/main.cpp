@@ -0,0 +1,72 @@
+#include <echlib.h> // include echlib
+
+#include <cstdio>
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Particle example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	ech::ParticleSystem particles;
+
+	// A fountain that keeps about 600,000 particles alive, all drawn with a single draw call
+	ech::EmitterDef fountain;
+	fountain.x = WindowWidth / 2.0f;
+	fountain.y = WindowHeight - 40.0f;
+	fountain.width = 40.0f;
+	fountain.rate = 300000.0f;
+	fountain.maxParticles = 700000;
+	fountain.lifeMin = 1.5f;
+	fountain.lifeMax = 2.5f;
+	fountain.speedMin = 300.0f;
+	fountain.speedMax = 600.0f;
+	fountain.spread = 0.5f;
+	fountain.gravityY = 400.0f;
+	fountain.startSize = 3.0f;
+	fountain.endSize = 1.0f;
+	fountain.startColor[0] = 0.3f; fountain.startColor[1] = 0.6f; fountain.startColor[2] = 1.0f;
+	int water = particles.CreateEmitter(fountain);
+
+	// Sparks for mouse clicks: additive, so overlapping sparks glow
+	ech::EmitterDef burst;
+	burst.maxParticles = 100000;
+	burst.lifeMin = 0.3f;
+	burst.lifeMax = 0.8f;
+	burst.speedMin = 50.0f;
+	burst.speedMax = 400.0f;
+	burst.drag = 3.0f;
+	burst.startSize = 4.0f;
+	burst.endSize = 0.0f;
+	burst.startColor[2] = 0.4f;
+	burst.endColor[1] = 0.3f; burst.endColor[2] = 0.0f;
+	burst.additive = true;
+	int sparks = particles.CreateEmitter(burst);
+
+	while (!ech::WindowShouldClose())
+	{
+		// Click to throw 5000 sparks at the mouse
+		if (ech::IsMouseButtonPressed(ech::MOUSE_LEFT_BUTTON))
+		{
+			particles.SetEmitterPosition(sparks, ech::GetMouseX(), ech::GetMouseY());
+			particles.Burst(sparks, 5000);
+		}
+
+		particles.Update(ech::GetDeltaTime());
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		particles.Draw(); // One instanced draw call per emitter
+
+		// Press I to print the particle counts
+		if (ech::IsKeyPressed(ech::KEY_I)) printf("%d water, %d sparks\n", particles.GetParticleCount(water), particles.GetParticleCount(sparks));
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
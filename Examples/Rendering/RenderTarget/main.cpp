@@ -0,0 +1,54 @@
+#include <echlib.h> // include echlib
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Render target example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	// The static part of the world is drawn ONCE into this texture instead of every frame
+	ech::RenderTarget worldLayer(2000, 2000);
+
+	float playerX = 600.0f;
+	float playerY = 360.0f;
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+		if (ech::IsKeyHeld(ech::KEY_D)) playerX += 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_A)) playerX -= 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_S)) playerY += 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_W)) playerY -= 300.0f * dt;
+
+		// Press R to rebuild the cached layer (for example after the level changed)
+		if (ech::IsKeyPressed(ech::KEY_R)) worldLayer.MarkDirty();
+
+		ech::UpdateCamera(playerX, playerY, 0.1f, (float)WindowWidth, (float)WindowHeight);
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::GRAY); // Clear the Background With a color
+
+		// Only re-render the layer when it is dirty. End() clears the flag again.
+		if (worldLayer.IsDirty())
+		{
+			worldLayer.Begin();
+			ech::DrawRectangle(0, 0, 2000, 2000, ech::BLACK); // A giant floor
+			for (int i = 0; i < 40; i++)
+			{
+				ech::DrawRectangle(100.0f + i * 45.0f, 300.0f + (i % 7) * 150.0f, 30, 30, ech::LIGHT_BLUE); // Static obstacles
+			}
+			worldLayer.End();
+		}
+
+		ech::DrawRenderTarget(worldLayer, 0, 0); // One textured quad for the whole layer
+		ech::DrawRectangle(playerX, playerY, 40, 40, ech::LIGHT_GREEN); // Dynamic objects are drawn on top as usual
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	worldLayer.Destroy(); // Release its textures while the window's context still exists
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
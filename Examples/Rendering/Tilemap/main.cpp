@@ -0,0 +1,62 @@
+#include <echlib.h> // include echlib
+
+#include <cstdio>
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Tilemap example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	// Any tileset image works: 16x16 pixel tiles packed in a grid
+	unsigned int tileset = ech::LoadTexture("tileset.png");
+
+	// A 256x256 level. Its geometry is built per 32x32 chunk on the first draw and only
+	// rebuilt when a chunk's tiles change.
+	ech::Tilemap ground(256, 256, 32.0f, 32.0f);
+	ground.SetTileset(tileset, 16, 16);
+	for (int y = 0; y < ground.Height(); y++)
+	{
+		for (int x = 0; x < ground.Width(); x++)
+		{
+			ground.SetTile(x, y, (x * 7 + y * 13) % 4); // First four tiles of the tileset
+		}
+	}
+
+	float playerX = 4096.0f;
+	float playerY = 4096.0f;
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+		if (ech::IsKeyHeld(ech::KEY_D)) playerX += 600.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_A)) playerX -= 600.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_S)) playerY += 600.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_W)) playerY -= 600.0f * dt;
+
+		// Press SPACE to dig a hole under the player: only that chunk is rebuilt
+		if (ech::IsKeyPressed(ech::KEY_SPACE))
+		{
+			ground.SetTile((int)(playerX / 32.0f), (int)(playerY / 32.0f), ech::Tilemap::EmptyTile);
+		}
+
+		ech::UpdateCamera(playerX, playerY, 0.1f, (float)WindowWidth, (float)WindowHeight);
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		ground.Draw(); // One draw call per visible chunk
+		ech::DrawRectangle(playerX, playerY, 32, 32, ech::LIGHT_GREEN);
+
+		// Press I to see how many chunks the last draw touched
+		if (ech::IsKeyPressed(ech::KEY_I)) printf("%d of %d chunks drawn\n", ground.GetDrawnChunkCount(), ground.GetChunkCount());
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ground.Destroy(); // Release its GPU buffers while the window's context still exists
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <echlib.h> // include echlib
+
+#include <cstdio>
+#include <cstdlib>
+
+// Components are plain structs
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+struct Lifetime { float seconds; };
+struct Tint { ech::Color color; };
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Entity component system example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	ech::World world;
+
+	// 20,000 boxes bouncing around the window forever
+	for (int i = 0; i < 20000; i++)
+	{
+		world.CreateEntity(
+			Position{ (float)(rand() % WindowWidth), (float)(rand() % WindowHeight) },
+			Velocity{ (float)(rand() % 400 - 200), (float)(rand() % 400 - 200) },
+			Tint{ ech::LIGHT_GREEN });
+	}
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+
+		// Press SPACE for a burst of short-lived red boxes at the mouse
+		if (ech::IsKeyPressed(ech::KEY_SPACE))
+		{
+			for (int i = 0; i < 500; i++)
+			{
+				world.CreateEntity(
+					Position{ ech::GetMouseX(), ech::GetMouseY() },
+					Velocity{ (float)(rand() % 600 - 300), (float)(rand() % 600 - 300) },
+					Lifetime{ 1.0f + (rand() % 100) / 100.0f },
+					Tint{ ech::RED });
+			}
+		}
+
+		// Movement touches every entity, so it runs on all cores
+		world.ParallelEach<Position, Velocity>([&](Position& p, Velocity& v)
+		{
+			p.x += v.x * dt;
+			p.y += v.y * dt;
+			if (p.x < 0.0f || p.x > WindowWidth) v.x = -v.x;
+			if (p.y < 0.0f || p.y > WindowHeight) v.y = -v.y;
+		});
+
+		// Destroying inside a query is safe: it happens once the query is done
+		world.Each<Lifetime>([&](ech::Entity entity, Lifetime& life)
+		{
+			life.seconds -= dt;
+			if (life.seconds <= 0.0f) world.DestroyEntity(entity);
+		});
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		world.Each<const Position, const Tint>([](const Position& p, const Tint& tint)
+		{
+			ech::DrawRectangle(p.x, p.y, 4, 4, tint.color);
+		});
+
+		// Press I to print the entity count
+		if (ech::IsKeyPressed(ech::KEY_I)) printf("%d entities in %d archetypes\n", world.GetEntityCount(), world.GetArchetypeCount());
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
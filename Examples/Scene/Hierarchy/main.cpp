@@ -0,0 +1,80 @@
+#include <echlib.h> // include echlib
+
+#include <cmath>
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Scene hierarchy example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	ech::Scene scene;
+
+	// A player with an arm, and a sword held by the arm: moving or turning a node carries
+	// its children along
+	int player = scene.CreateNode();
+	scene.SetRectangle(player, 48, 48, ech::LIGHT_GREEN);
+	scene.SetPosition(player, 600, 360);
+
+	int arm = scene.CreateNode(player);
+	scene.SetRectangle(arm, 40, 10, ech::WHITE);
+	scene.SetOrigin(arm, 0.0f, 0.5f); // rotate around the shoulder
+	scene.SetPosition(arm, 20, 0);
+
+	int sword = scene.CreateNode(arm);
+	scene.SetRectangle(sword, 60, 6, ech::RED);
+	scene.SetOrigin(sword, 0.0f, 0.5f);
+	scene.SetPosition(sword, 40, 0);
+	scene.SetLayer(sword, 1); // drawn on top of the player
+
+	// Eight moons circling the player, each with a smaller moon of its own
+	int moons[8];
+	for (int i = 0; i < 8; i++)
+	{
+		moons[i] = scene.CreateNode(player);
+		scene.SetCircle(moons[i], 8, ech::LIGHT_BLUE);
+
+		int small = scene.CreateNode(moons[i]);
+		scene.SetCircle(small, 3, ech::WHITE);
+		scene.SetPosition(small, 16, 0);
+	}
+
+	float time = 0.0f;
+	float playerX = 600.0f;
+	float playerY = 360.0f;
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+		time += dt;
+
+		if (ech::IsKeyHeld(ech::KEY_D)) playerX += 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_A)) playerX -= 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_S)) playerY += 300.0f * dt;
+		if (ech::IsKeyHeld(ech::KEY_W)) playerY -= 300.0f * dt;
+		scene.SetPosition(player, playerX, playerY);
+
+		// Only local transforms are set; world transforms follow on the next Draw()
+		scene.SetRotation(arm, std::sin(time * 4.0f) * 1.2f);
+		for (int i = 0; i < 8; i++)
+		{
+			float angle = time + i * 0.785f;
+			scene.SetTransform(moons[i], std::cos(angle) * 120.0f, std::sin(angle) * 120.0f, time * 3.0f, 1.0f, 1.0f);
+		}
+
+		// Press H to hide the sword (and anything attached to it)
+		if (ech::IsKeyPressed(ech::KEY_H)) scene.SetVisible(sword, !scene.IsVisible(sword));
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		scene.Draw(); // Shapes of the same color are drawn together
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
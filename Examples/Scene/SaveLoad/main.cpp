@@ -0,0 +1,115 @@
+#include <echlib.h> // include echlib
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+
+// What gets saved for each entity. The schema lets later versions of the game add, remove or
+// retype fields and still load old saves.
+struct BodyRecord { float x, y, vx, vy; };
+
+const ech::Schema BodySchema = { 1, sizeof(BodyRecord), {
+	ECH_SCHEMA_FIELD(BodyRecord, x),
+	ECH_SCHEMA_FIELD(BodyRecord, y),
+	ECH_SCHEMA_FIELD(BodyRecord, vx),
+	ECH_SCHEMA_FIELD(BodyRecord, vy)
+} };
+
+int main()
+{
+	int WindowWidth = 1200; // Define a width for the window
+	int WindowHeight = 720; // Define a height for the window
+
+	ech::CreateWindow(WindowWidth, WindowHeight, "Saving and loading example with echlib"); // Create the window
+	ech::SetFpsLimit(60);
+
+	ech::World world;
+	for (int i = 0; i < 5000; i++)
+	{
+		world.CreateEntity(
+			Position{ (float)(rand() % WindowWidth), (float)(rand() % WindowHeight) },
+			Velocity{ (float)(rand() % 400 - 200), (float)(rand() % 400 - 200) });
+	}
+
+	// A small scene: a spinning arm with a box at each end
+	ech::Scene scene;
+	int arm = scene.CreateNode();
+	scene.SetPosition(arm, WindowWidth / 2.0f, WindowHeight / 2.0f);
+	scene.SetRectangle(arm, 300, 10, ech::WHITE);
+	for (int side = -1; side <= 1; side += 2)
+	{
+		int box = scene.CreateNode(arm);
+		scene.SetPosition(box, side * 150.0f, 0);
+		scene.SetRectangle(box, 40, 40, ech::ORANGE);
+	}
+
+	while (!ech::WindowShouldClose())
+	{
+		float dt = ech::GetDeltaTime();
+
+		world.Each<Position, Velocity>([&](Position& p, Velocity& v)
+		{
+			p.x += v.x * dt;
+			p.y += v.y * dt;
+			if (p.x < 0.0f || p.x > WindowWidth) v.x = -v.x;
+			if (p.y < 0.0f || p.y > WindowHeight) v.y = -v.y;
+		});
+		scene.SetRotation(arm, scene.GetRotation(arm) + dt);
+
+		// Press S to save everything
+		if (ech::IsKeyPressed(ech::KEY_S))
+		{
+			std::vector<BodyRecord> bodies;
+			world.EachChunk<const Position, const Velocity>([&](int count, const ech::Entity*, const Position* p, const Velocity* v)
+			{
+				for (int i = 0; i < count; i++) bodies.push_back({ p[i].x, p[i].y, v[i].x, v[i].y });
+			});
+
+			ech::BinaryWriter writer;
+			writer.AddTable("Bodies", BodySchema, bodies);
+			if (writer.Save("bodies.bin") && scene.Save("scene.bin")) printf("Saved %d bodies\n", (int)bodies.size());
+		}
+
+		// Press L to load them back
+		if (ech::IsKeyPressed(ech::KEY_L))
+		{
+			ech::BinaryFile file;
+			if (file.Open("bodies.bin"))
+			{
+				// Read straight out of the mapped file when the layout hasn't changed, converted otherwise
+				std::vector<BodyRecord> converted;
+				size_t count = 0;
+				const BodyRecord* bodies = file.GetRecords<BodyRecord>("Bodies", BodySchema, count);
+				if (!bodies && file.ReadTable("Bodies", BodySchema, converted))
+				{
+					bodies = converted.data();
+					count = converted.size();
+				}
+
+				world.Clear();
+				for (size_t i = 0; i < count; i++)
+					world.CreateEntity(Position{ bodies[i].x, bodies[i].y }, Velocity{ bodies[i].vx, bodies[i].vy });
+				printf("Loaded %d bodies\n", (int)count);
+			}
+			if (scene.Load("scene.bin")) arm = 0; // handles are renumbered breadth first, so the root is 0
+		}
+
+		ech::StartDrawing();  // Start Drawing the window
+		ech::ClearBackground(ech::BLACK); // Clear the Background With a color
+
+		world.Each<const Position>([](const Position& p)
+		{
+			ech::DrawRectangle(p.x, p.y, 4, 4, ech::LIGHT_GREEN);
+		});
+		scene.Draw();
+
+		ech::EndDrawing(); // End Drawing The window
+	}
+
+	ech::CloseWindow(); // Close Window
+	return 0;
+}
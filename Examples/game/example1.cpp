@@ -8,9 +8,11 @@ int main() {
     const int SCREEN_W = 800;
     const int SCREEN_H = 600;
     ech::CreateWindow(SCREEN_W, SCREEN_H, "Echlib - Movement + Spikes Demo");
-    ech::InitGraphics();
     ech::SetFpsLimit(60);
 
+    // Physics runs at a fixed 120 Hz no matter what the frame rate is
+    ech::FixedStep physics(120.0);
+
     // Player
     float px = 100.0f;
     float py = 100.0f;
@@ -24,6 +26,19 @@ int main() {
     const float gw = 2400.0f;
     const float gh = 60.0f;
 
+    // Everything the player can stand on, as structure-of-arrays boxes: the ground and a thin
+    // floating platform (fast falls would tunnel through it with a plain overlap test)
+    float solidX[] = { gx, 700.0f };
+    float solidY[] = { gy, gy - 140.0f };
+    float solidW[] = { gw, 220.0f };
+    float solidH[] = { gh, 6.0f };
+    ech::BoxArray solids;
+    solids.x = solidX;
+    solids.y = solidY;
+    solids.w = solidW;
+    solids.h = solidH;
+    solids.count = 2;
+
     // Camera smoothing / settings
     const float camLerp = 0.12f;
 
@@ -46,64 +61,80 @@ int main() {
         {1500, gy - 32, 32}
     };
 
+    // Player position at the previous tick, used to interpolate the rendered position
+    float prevPx = px;
+    float prevPy = py;
+    bool jumpRequested = false;
+
     // Main loop
     while (!ech::WindowShouldClose()) {
-        float dt = ech::GetDeltaTime();
-        if (dt <= 0.0f) dt = 1.0f / 60.0f;
-
-        // --- Input & movement ---
+        // --- Input (once per frame) ---
         float vx = 0.0f;
-        if (ech::IsKeyHeld(ech::KEY_D) || ech::IsKeyHeld(ech::KEY_D)) vx += speed;
-        if (ech::IsKeyHeld(ech::KEY_A) || ech::IsKeyHeld(ech::KEY_A)) vx -= speed;
+        if (ech::IsKeyHeld(ech::KEY_D)) vx += speed;
+        if (ech::IsKeyHeld(ech::KEY_A)) vx -= speed;
 
-        // Jump (space)
-        if ((ech::IsKeyPressed(ech::KEY_SPACE) || ech::IsKeyPressed(ech::KEY_W)) && onGround) {
-            vy = jumpVelocity;
-            onGround = false;
+        // Jump (space) - remembered until the next physics tick picks it up
+        if (ech::IsKeyPressed(ech::KEY_SPACE) || ech::IsKeyPressed(ech::KEY_W)) {
+            jumpRequested = true;
         }
 
-        // Apply velocities
-        px += vx * dt;
-        vy += gravity * dt;
-        py += vy * dt;
+        // --- Physics (0..N fixed ticks per frame) ---
+        physics.Run([&](float dt) {
+            prevPx = px;
+            prevPy = py;
 
-        // --- Collision with ground ---
-        if (ech::CheckCollision(px, py, pw, ph, gx, gy, gw, gh)) {
-            py = gy - ph;
-            vy = 0.0f;
-            onGround = true;
-        }
-        else {
-            onGround = false;
-        }
+            if (jumpRequested && onGround) {
+                vy = jumpVelocity;
+                onGround = false;
+            }
+            jumpRequested = false;
+
+            // Move with swept collision: stops at the first surface along the way and slides
+            vy += gravity * dt;
+            ech::SlideResult move = ech::MoveAndSlide(px, py, pw, ph, vx * dt, vy * dt, solids);
+            px = move.x;
+            py = move.y;
+
+            onGround = move.hitY && vy > 0.0f;
+            if (move.hitY) vy = 0.0f;
+
+            // --- Spike collisions ---
+            bool hitSpike = false;
+            for (auto& s : spikes) {
+                // Approximate spike as a small square hitbox for simplicity
+                if (ech::CheckCollision(px, py, pw, ph, s.x, s.y, s.size, s.size)) {
+                    hitSpike = true;
+                    break;
+                }
+            }
 
-        // --- Spike collisions ---
-        bool hitSpike = false;
-        for (auto& s : spikes) {
-            // Approximate spike as a small square hitbox for simplicity
-            if (ech::CheckCollision(px, py, pw, ph, s.x, s.y, s.size, s.size)) {
-                hitSpike = true;
-                break;
+            if (hitSpike) {
+                // Reset player to start
+                px = 100.0f;
+                py = 100.0f;
+                prevPx = px;
+                prevPy = py;
+                vy = 0.0f;
+                std::cout << "Ouch! Hit a spike!\n";
             }
-        }
+        });
 
-        if (hitSpike) {
-            // Reset player to start
-            px = 100.0f;
-            py = 100.0f;
-            vy = 0.0f;
-            std::cout << "Ouch! Hit a spike!\n";
-        }
+        // Render between the last two physics states
+        float alpha = physics.Alpha();
+        float drawX = ech::Lerp(prevPx, px, alpha);
+        float drawY = ech::Lerp(prevPy, py, alpha);
 
         // --- Update camera ---
-        ech::UpdateCamera(px + pw * 0.5f, py + ph * 0.5f, camLerp, (float)SCREEN_W, (float)SCREEN_H);
+        ech::UpdateCamera(drawX + pw * 0.5f, drawY + ph * 0.5f, camLerp, (float)SCREEN_W, (float)SCREEN_H);
 
         // --- Rendering ---
         ech::StartDrawing();
         ech::ClearBackground(ech::BEIGE);
 
-        // Ground
-        ech::DrawRectangle(gx, gy, gw, gh, ech::LIGHT_BLUE);
+        // Ground and platform
+        for (int i = 0; i < solids.count; i++) {
+            ech::DrawRectangle(solidX[i], solidY[i], solidW[i], solidH[i], ech::LIGHT_BLUE);
+        }
 
         // Spikes (red triangles)
         for (auto& s : spikes) {
@@ -111,10 +142,10 @@ int main() {
         }
 
         // Player
-        ech::DrawRectangle(px, py, pw, ph, ech::LIGHT_GREEN);
+        ech::DrawRectangle(drawX, drawY, pw, ph, ech::LIGHT_GREEN);
 
         // Shadow under player
-        ech::DrawRectangle(px + 6.0f, gy - 6.0f, pw, 6.0f, { 0, 0, 0, 0.15f });
+        ech::DrawRectangle(drawX + 6.0f, gy - 6.0f, pw, 6.0f, { 0, 0, 0, 0.15f });
 
         ech::EndDrawing();
     }
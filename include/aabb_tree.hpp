@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+
+#include "collision.hpp"
+
+namespace ech {
+
+    struct RaycastHit {
+        int proxy = -1;
+        float t = 0.0f;             // 0..1 along the segment
+        float x = 0.0f, y = 0.0f;   // hit point
+        float normalX = 0.0f, normalY = 0.0f;
+    };
+
+    // Dynamic bounding volume tree over (x, y, w, h) boxes, for worlds where object sizes vary too
+    // much for a uniform grid (large static walls next to small bullets).
+    //
+    // Each leaf stores a "fat" box grown by a margin, so a box that moves a little stays inside
+    // it and Move() costs nothing; only boxes that leave their fat box are reinserted. Inserts
+    // pick the sibling with the lowest perimeter cost and the path back up is rebalanced with
+    // rotations, keeping the tree shallow. Nodes live in one contiguous pool and are addressed
+    // by integer handles.
+    class AABBTree {
+    public:
+        explicit AABBTree(float fatMargin = 4.0f);
+
+        int Insert(float x, float y, float w, float h, int userData = 0);
+        // Returns true if the proxy had to be reinserted. The displacement (e.g. velocity * dt)
+        // stretches the fat box in the direction of motion so fast movers reinsert less often.
+        bool Move(int proxy, float x, float y, float w, float h, float dx = 0.0f, float dy = 0.0f);
+        void Remove(int proxy);
+        void Clear();
+
+        int GetUserData(int proxy) const;
+        void SetUserData(int proxy, int userData);
+        int Count() const { return m_LeafCount; }
+        int GetHeight() const;
+
+        // Proxies whose box overlaps the given box. Writes at most maxProxies, returns the total.
+        int Query(float x, float y, float w, float h, int* proxies, int maxProxies);
+
+        // Every overlapping pair of proxies, each once. Writes at most maxPairs, returns the total.
+        int FindOverlappingPairs(CollisionPair* pairs, int maxPairs);
+
+        // Closest box hit by the segment (x1, y1) -> (x2, y2), tested like RaycastAABB. Boxes
+        // containing the start point are hit at t = 0 with a zero normal.
+        bool Raycast(float x1, float y1, float x2, float y2, RaycastHit& hit);
+        // All boxes hit by the segment, in no particular order
+        int RaycastAll(float x1, float y1, float x2, float y2, RaycastHit* hits, int maxHits);
+
+    private:
+        static constexpr int Null = -1;
+
+        struct Bounds {
+            float minX, minY, maxX, maxY;
+        };
+
+        struct Node {
+            Bounds fat;         // enlarged box for leaves, union of the children otherwise
+            Bounds tight;       // leaves only: the box as last given to Insert/Move
+            int parent;         // also the free list link for unused nodes
+            int child1, child2; // Null for leaves
+            int height;         // 0 for leaves, -1 for free nodes
+            int userData;
+
+            bool IsLeaf() const { return child1 == Null; }
+        };
+
+        int AllocateNode();
+        void FreeNode(int node);
+        void InsertLeaf(int leaf);
+        void RemoveLeaf(int leaf);
+        int Balance(int a);
+        bool RaycastLeaf(int leaf, float x1, float y1, float x2, float y2, float maxT, RaycastHit& hit) const;
+
+        std::vector<Node> m_Nodes;
+        int m_Root = Null;
+        int m_FreeList = Null;
+        int m_LeafCount = 0;
+        float m_Margin;
+
+        std::vector<int> m_Stack;   // traversal stack, reused between queries
+    };
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+
+namespace ech {
+
+    enum CaptureFormat {
+        CAPTURE_PNG_SEQUENCE,   // path is a prefix: prefix_000000.png, prefix_000001.png, ...
+        CAPTURE_RAW_RGBA        // every frame appended to one file as raw RGBA8 (top row first)
+    };
+
+    struct CaptureStats {
+        int framesRequested = 0;
+        int framesWritten = 0;
+        int framesDropped = 0;  // readback ring or writer queue was full
+        int width = 0;
+        int height = 0;
+    };
+
+    // Screen capture never stalls the frame: EndDrawing copies the back buffer into a ring of
+    // pixel buffer objects, the copy is mapped a few frames later once its fence has signaled,
+    // and files are written on background threads.
+
+    // Save the next presented frame as a PNG
+    void TakeScreenshot(const std::string& path);
+
+    // Record every frame until StopRecording. Raw output can be turned into a video with e.g.
+    // ffmpeg -f rawvideo -pixel_format rgba -video_size WxH -framerate 60 -i capture.raw out.mp4
+    bool StartRecording(const std::string& path, CaptureFormat format = CAPTURE_RAW_RGBA);
+    // Flushes frames still in flight and waits for the writers to finish
+    void StopRecording();
+    bool IsRecording();
+
+    CaptureStats GetCaptureStats();
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+
+namespace ech {
+
+    struct CollisionPair {
+        int a, b;
+    };
+
+    // Structure-of-arrays view over `count` boxes in the (x, y, w, h) convention of CheckCollision.
+    // The arrays are only read and need no particular alignment.
+    struct BoxArray {
+        const float* x = nullptr;
+        const float* y = nullptr;
+        const float* w = nullptr;
+        const float* h = nullptr;
+        int count = 0;
+    };
+
+    enum SimdLevel {
+        SIMD_SCALAR,
+        SIMD_SSE2,
+        SIMD_AVX2
+    };
+
+    // Best instruction set the batch kernels can use on this CPU, picked once at startup
+    SimdLevel GetSupportedSimdLevel();
+    SimdLevel GetSimdLevel();
+    // Force a lower level (benchmarks, comparisons); requests above the supported level are clamped
+    void SetSimdLevel(SimdLevel level);
+
+    // Batch versions of CheckCollision, returning exactly what it would for every box.
+    //
+    // Bitmask: bit i of mask[i / 64] is set when box i overlaps. `mask` needs (count + 63) / 64 words.
+    void CheckCollisionBatch(float x, float y, float w, float h, const BoxArray& boxes, uint64_t* mask);
+    // Index list: writes at most maxIndices indices of overlapping boxes, returns the total count
+    int CheckCollisionBatch(float x, float y, float w, float h, const BoxArray& boxes, int* indices, int maxIndices);
+    // N boxes against the array: pairs are (query index, box index). Writes at most maxPairs,
+    // returns the total count.
+    int CheckCollisionBatch(const BoxArray& queries, const BoxArray& boxes, CollisionPair* pairs, int maxPairs);
+
+    // --- Continuous collision (collision_sweep.cpp) ---
+
+    struct SweepHit {
+        float time = 1.0f;          // fraction of the movement (0..1) at first contact
+        float normalX = 0.0f;       // surface normal of the box that was hit
+        float normalY = 0.0f;
+        float penetration = 0.0f;   // > 0 when the boxes already overlapped at the start
+    };
+
+    // Box A moving by (dx, dy) against a static box B. Reports the first contact along the move.
+    // Touching edges only count when moving into them, so a box can slide along a wall it rests
+    // against. If the boxes already overlap, the hit is at time 0 with the normal and depth of
+    // the shallowest way out.
+    bool SweepAABB(float ax, float ay, float aw, float ah, float dx, float dy,
+        float bx, float by, float bw, float bh, SweepHit& hit);
+
+    // Segment (x1, y1) -> (x2, y2) against a box. A segment starting inside hits at time 0 with
+    // a zero normal.
+    bool RaycastAABB(float x1, float y1, float x2, float y2,
+        float bx, float by, float bw, float bh, SweepHit& hit);
+
+    // Earliest contact of box A moving by (dx, dy) against every box in `solids`. Returns the
+    // index of the box hit, or -1.
+    int SweepAABBFirst(float ax, float ay, float aw, float ah, float dx, float dy,
+        const BoxArray& solids, SweepHit& hit);
+
+    // SweepAABBFirst for many movers at once: mover i moves by (dx[i], dy[i]). hits[i] and
+    // hitIndex[i] receive its first contact (-1 when nothing is hit). Returns how many movers hit.
+    int SweepAABBBatch(const BoxArray& movers, const float* dx, const float* dy,
+        const BoxArray& solids, SweepHit* hits, int* hitIndex);
+
+    struct SlideResult {
+        float x = 0.0f, y = 0.0f;   // final position
+        bool hitX = false;          // blocked by a wall to the left/right
+        bool hitY = false;          // blocked by a floor/ceiling
+        float normalX = 0.0f;       // normal of the last surface hit
+        float normalY = 0.0f;
+    };
+
+    // Move a box by (dx, dy) through `solids`, stopping at each contact and sliding along it
+    // with the rest of the movement. Boxes that start overlapping are pushed out first. Zero the
+    // matching velocity component when hitX / hitY is set.
+    SlideResult MoveAndSlide(float x, float y, float w, float h, float dx, float dy,
+        const BoxArray& solids, int maxIterations = 4);
+
+}
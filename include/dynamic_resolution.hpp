@@ -0,0 +1,41 @@
+#pragma once
+
+namespace ech {
+
+    enum UpscaleFilter {
+        UPSCALE_BILINEAR,
+        UPSCALE_SHARPEN     // bilinear + a light unsharp mask to win back some detail
+    };
+
+    struct DynamicResolutionSettings {
+        float targetGpuMs = 12.0f;   // GPU time budget for the world pass
+        float minScale = 0.5f;       // per-axis render scale limits
+        float maxScale = 1.0f;
+        UpscaleFilter filter = UPSCALE_BILINEAR;
+        float sharpness = 0.5f;      // 0..1, only used by UPSCALE_SHARPEN
+        bool automatic = true;       // false = keep whatever SetResolutionScale chose
+    };
+
+    // Optional mode for fill-heavy scenes: the world is rendered into an offscreen target at
+    // a fraction of the window resolution and upscaled, and the fraction follows the measured
+    // GPU time of the world pass. Usage per frame:
+    //
+    //   StartDrawing();
+    //   BeginWorldDrawing();   ... world draws ...   EndWorldDrawing();
+    //   ... UI / text draws (native resolution) ...
+    //   EndDrawing();
+    //
+    // While disabled, Begin/EndWorldDrawing do nothing and the world renders at native resolution.
+    void EnableDynamicResolution(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+    void DisableDynamicResolution();
+    bool IsDynamicResolutionEnabled();
+
+    void BeginWorldDrawing();
+    void EndWorldDrawing();
+
+    float GetResolutionScale();
+    void SetResolutionScale(float scale);
+    // Smoothed GPU time of the world pass in milliseconds (a few frames old)
+    float GetWorldGpuTime();
+
+}
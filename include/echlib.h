@@ -6,6 +6,29 @@
 
 #include <stb_truetype.h>
 #include "window.hpp"
+#include "render_target.hpp"
+#include "tilemap.hpp"
+#include "level.hpp"
+#include "tile_collision.hpp"
+#include "particles.hpp"
+#include "headless.hpp"
+#include "capture.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_pacer.hpp"
+#include "fixed_step.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include "input.hpp"
+#include "replay.hpp"
+#include "collision.hpp"
+#include "spatial_hash.hpp"
+#include "aabb_tree.hpp"
+#include "jobs.hpp"
+#include "physics.hpp"
+#include "ecs.hpp"
+#include "scene.hpp"
+#include "serialize.hpp"
+#include "pathfinding.hpp"
 #include <internal.hpp>
 
 namespace ech {
@@ -80,12 +103,33 @@ namespace ech {
         KEY_SPACE,
         KEY_ESCAPE,
         KEY_ENTER,
+        KEY_0, KEY_1, KEY_2, KEY_3, KEY_4,
+        KEY_5, KEY_6, KEY_7, KEY_8, KEY_9,
+        KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT,
+        KEY_TAB, KEY_BACKSPACE, KEY_INSERT, KEY_DELETE,
+        KEY_HOME, KEY_END, KEY_PAGE_UP, KEY_PAGE_DOWN,
+        KEY_LEFT_SHIFT, KEY_RIGHT_SHIFT,
+        KEY_LEFT_CONTROL, KEY_RIGHT_CONTROL,
+        KEY_LEFT_ALT, KEY_RIGHT_ALT,
+        KEY_LEFT_SUPER, KEY_RIGHT_SUPER, KEY_MENU,
+        KEY_CAPS_LOCK, KEY_SCROLL_LOCK, KEY_NUM_LOCK,
+        KEY_PRINT_SCREEN, KEY_PAUSE,
+        KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6,
+        KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+        KEY_APOSTROPHE, KEY_COMMA, KEY_MINUS, KEY_PERIOD, KEY_SLASH,
+        KEY_SEMICOLON, KEY_EQUAL, KEY_LEFT_BRACKET, KEY_BACKSLASH,
+        KEY_RIGHT_BRACKET, KEY_GRAVE_ACCENT,
+        KEY_KP_0, KEY_KP_1, KEY_KP_2, KEY_KP_3, KEY_KP_4,
+        KEY_KP_5, KEY_KP_6, KEY_KP_7, KEY_KP_8, KEY_KP_9,
+        KEY_KP_DECIMAL, KEY_KP_DIVIDE, KEY_KP_MULTIPLY,
+        KEY_KP_SUBTRACT, KEY_KP_ADD, KEY_KP_ENTER, KEY_KP_EQUAL,
         KEY_COUNT
     };
 
     enum MouseKeys {
         MOUSE_LEFT_BUTTON, MOUSE_RIGHT_BUTTON,
-        MOUSE_MIDDLE_BUTTON
+        MOUSE_MIDDLE_BUTTON,
+        MOUSE_BUTTON_4, MOUSE_BUTTON_5
     };
 
     // Window / GL
@@ -94,8 +138,11 @@ namespace ech {
     int WindowShouldClose();
 
     void StartDrawingAdv(Window& window);
+    // Only ending the default window's drawing polls events and paces the frame, so draw it
+    // last when drawing several windows per loop
     void EndDrawingAdv(Window& window);
 
+    // Manual frame control (EndDrawing already does PollEvents + EndFrame)
     void BeginFrame();
     void PollEvents();
     void EndFrame();
@@ -120,11 +167,13 @@ namespace ech {
     // Texture
     unsigned int LoadTexture(const char* path);
 
-    // Input
+    // Input (read from the snapshot taken at the last PollEvents / EndDrawing, no side effects)
     int IsKeyPressed(int key);
     int IsKeyHeld(int key);
+    int IsKeyReleased(int key);
     int IsMouseButtonPressed(int button);
     int IsMouseButtonHeld(int button);
+    int IsMouseButtonReleased(int button);
 
     // Camera
     void UpdateCamera(float targetX, float targetY, float lerpFactor, float screenWidth, float screenHeight);
@@ -152,7 +201,8 @@ namespace ech {
 
     
     void SetFpsLimit(int fps);
-    void ApplyFpsLimit();   // no params
+    int GetFpsLimit();      // 0 = unlimited
+    void ApplyFpsLimit();   // no params, waits for the next frame deadline
     
 
 
@@ -0,0 +1,320 @@
+#pragma once
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ech {
+
+    // Entity handle: a slot index plus a generation that changes whenever the slot is reused,
+    // so handles of destroyed entities stay invalid
+    struct Entity {
+        uint32_t index = 0xffffffffu;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const Entity& other) const { return !(*this == other); }
+    };
+
+    constexpr int MaxComponentTypes = 256;
+    using ComponentId = int;
+
+    // How to handle a component type without knowing it. move() move-constructs dst from src
+    // and destroys src.
+    struct ComponentInfo {
+        size_t size = 0, align = 0;
+        void (*move)(void* dst, void* src) = nullptr;
+        void (*destroy)(void* p) = nullptr;
+    };
+
+    // Ids are shared by every World; -1 once MaxComponentTypes types are registered
+    ComponentId RegisterComponent(const ComponentInfo& info);
+    const ComponentInfo& GetComponentInfo(ComponentId id);
+
+    template <typename T>
+    ComponentId GetComponentId() {
+        static_assert(std::is_same<T, std::decay_t<T>>::value, "components are plain value types");
+        static_assert(alignof(T) <= 64, "components are aligned to at most 64 bytes");
+        static const ComponentId id = [] {
+            ComponentInfo info;
+            info.size = sizeof(T);
+            info.align = alignof(T);
+            info.move = [](void* dst, void* src) {
+                new (dst) T(std::move(*static_cast<T*>(src)));
+                static_cast<T*>(src)->~T();
+            };
+            info.destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            return RegisterComponent(info);
+        }();
+        return id;
+    }
+
+    // Entity-component store with archetype chunks. Entities with the same set of component
+    // types share an archetype, whose entities live in 16 KB chunks holding one packed array
+    // per component type, so a query walks plain arrays in memory order.
+    //
+    // Structural changes (creating and destroying entities, adding and removing components)
+    // made while a query runs are deferred until the outermost query returns; entities created
+    // meanwhile aren't alive until then. Component values can be changed at any time.
+    //
+    // Adding or removing a component moves the entity to another archetype, and destroying
+    // one moves the last entity of its archetype into the hole: component pointers are only
+    // valid until the next structural change.
+    class World {
+    public:
+        explicit World(int workerCount = -1);  // job workers ParallelEach may use; -1 for all of them
+        ~World();
+
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        Entity CreateEntity();
+        // Creates the entity directly in the archetype of its components. Types must be distinct.
+        template <typename... Ts>
+        Entity CreateEntity(Ts... components);
+        void DestroyEntity(Entity entity);
+        bool IsAlive(Entity entity) const;
+        // Destroys every entity
+        void Clear();
+
+        // Replaces the value if the entity already has the component
+        template <typename T>
+        void Add(Entity entity, T component = T());
+        template <typename T>
+        void Remove(Entity entity);
+        template <typename T>
+        bool Has(Entity entity) const;
+        // nullptr if the entity is dead or doesn't have the component
+        template <typename T>
+        T* Get(Entity entity);
+
+        // fn(Ts&...) or fn(Entity, Ts&...) for every entity that has all of Ts (and maybe more).
+        // Const types give read-only access.
+        template <typename... Ts, typename F>
+        void Each(F&& fn);
+        // fn(int count, const Entity* entities, Ts*... arrays) once per chunk, for loops the
+        // compiler can vectorize
+        template <typename... Ts, typename F>
+        void EachChunk(F&& fn);
+        // Each() with the chunks split across the job system's workers. fn runs concurrently and may
+        // only touch the components it is given; structural changes are fine (they're deferred).
+        template <typename... Ts, typename F>
+        void ParallelEach(F&& fn);
+
+        int GetEntityCount() const { return m_EntityCount; }
+        int GetArchetypeCount() const { return (int)m_Archetypes.size(); }
+        int GetWorkerCount() const;
+
+    private:
+        using ComponentMask = std::bitset<MaxComponentTypes>;
+
+        struct Chunk {
+            unsigned char* data = nullptr;
+            int count = 0;
+        };
+
+        struct Archetype {
+            std::vector<ComponentId> types;     // sorted
+            ComponentMask mask;
+            std::vector<size_t> offsets;        // of each type's array in a chunk; entities are at 0
+            size_t chunkBytes = 0;
+            int capacity = 0;                   // entities per chunk
+            std::vector<Chunk> chunks;          // all full except the last
+            int count = 0;
+            std::unordered_map<ComponentId, int> addEdges, removeEdges;
+
+            int Column(ComponentId id) const;
+            Entity* Entities(const Chunk& chunk) const { return reinterpret_cast<Entity*>(chunk.data); }
+            void* At(const Chunk& chunk, int column, int row) const {
+                return chunk.data + offsets[column] + (size_t)row * GetComponentInfo(types[column]).size;
+            }
+        };
+
+        struct Record {
+            int archetype = -1;                 // -1: free slot
+            int chunk = 0, row = 0;
+            uint32_t generation = 0;
+        };
+
+        enum CommandType { COMMAND_CREATE, COMMAND_DESTROY, COMMAND_ADD, COMMAND_REMOVE };
+
+        struct Command {
+            CommandType type;
+            Entity entity;
+            ComponentId component;
+            void* value;                        // COMMAND_ADD: the component, moved in on flush
+        };
+
+        // Keeps structural changes deferred while a query runs
+        struct IterationScope {
+            explicit IterationScope(World& world) : m_World(world) { ++m_World.m_Iterating; }
+            ~IterationScope() {
+                if (--m_World.m_Iterating == 0) m_World.Flush();
+            }
+            World& m_World;
+        };
+
+        template <typename... Ts>
+        static ComponentMask MaskOf() {
+            ComponentMask mask;
+            const ComponentId ids[] = { GetComponentId<std::remove_const_t<Ts>>()... };
+            for (ComponentId id : ids) mask.set((size_t)id);
+            return mask;
+        }
+
+        template <typename... Ts, typename F, size_t... I>
+        static void VisitChunk(const Archetype& a, const Chunk& chunk, const size_t* offsets, F& fn, std::index_sequence<I...>) {
+            fn(chunk.count, (const Entity*)a.Entities(chunk), reinterpret_cast<Ts*>(chunk.data + offsets[I])...);
+        }
+
+        // Turns a per-entity callback into a per-chunk one
+        template <typename F, typename... Ts>
+        struct EntityVisitor {
+            F& fn;
+            void operator()(int count, const Entity* entities, Ts*... arrays) const {
+                for (int i = 0; i < count; ++i) {
+                    if constexpr (std::is_invocable<F&, Entity, Ts&...>::value) fn(entities[i], arrays[i]...);
+                    else fn(arrays[i]...);
+                }
+            }
+        };
+
+        bool Deferring() const { return m_Iterating > 0; }
+        const Record* Find(Entity entity) const;
+        void* GetRaw(Entity entity, ComponentId id) const;
+
+        int FindArchetype(std::vector<ComponentId> types);
+        int ArchetypeWith(int from, ComponentId id);
+        int ArchetypeWithout(int from, ComponentId id);
+        Entity Allocate();
+        void Place(Entity entity, int archetype);
+        // Moves the entity to `archetype`, destroying the components it doesn't have. The slots
+        // of components new to the entity are left uninitialized.
+        void MoveEntity(Entity entity, int archetype);
+        void RemoveRow(int archetype, int chunk, int row);
+        void* AddRaw(Entity entity, ComponentId id);
+        void RemoveRaw(Entity entity, ComponentId id);
+        void DestroyNow(Entity entity);
+
+        Entity DeferCreate();
+        void Defer(CommandType type, Entity entity, ComponentId component);
+        void* DeferAdd(Entity entity, ComponentId component);
+        void Flush();
+
+        void RunParallel(int count, int grain, const std::function<void(int, int)>& fn);
+
+        std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+        std::vector<Record> m_Records;
+        std::vector<uint32_t> m_FreeSlots;
+        int m_EntityCount = 0;
+        int m_Iterating = 0;
+
+        std::mutex m_CommandMutex;
+        std::vector<Command> m_Commands;
+        uint32_t m_PendingSlots = 0;           // new slots handed out by DeferCreate
+
+        int m_WorkerCount;
+    };
+
+    template <typename... Ts>
+    Entity World::CreateEntity(Ts... components) {
+        if (Deferring()) {
+            const Entity entity = DeferCreate();
+            int expand[] = { 0, (Add<Ts>(entity, std::move(components)), 0)... };
+            (void)expand;
+            return entity;
+        }
+
+        const Entity entity = Allocate();
+        Place(entity, FindArchetype({ GetComponentId<Ts>()... }));
+        int expand[] = { 0, (new (GetRaw(entity, GetComponentId<Ts>())) Ts(std::move(components)), 0)... };
+        (void)expand;
+        return entity;
+    }
+
+    template <typename T>
+    void World::Add(Entity entity, T component) {
+        const ComponentId id = GetComponentId<T>();
+        if (Deferring()) {
+            if (void* slot = DeferAdd(entity, id)) new (slot) T(std::move(component));
+            return;
+        }
+        if (T* existing = static_cast<T*>(GetRaw(entity, id))) {
+            *existing = std::move(component);
+            return;
+        }
+        if (void* slot = AddRaw(entity, id)) new (slot) T(std::move(component));
+    }
+
+    template <typename T>
+    void World::Remove(Entity entity) {
+        const ComponentId id = GetComponentId<T>();
+        if (Deferring()) Defer(COMMAND_REMOVE, entity, id);
+        else RemoveRaw(entity, id);
+    }
+
+    template <typename T>
+    bool World::Has(Entity entity) const {
+        return GetRaw(entity, GetComponentId<T>()) != nullptr;
+    }
+
+    template <typename T>
+    T* World::Get(Entity entity) {
+        return static_cast<T*>(GetRaw(entity, GetComponentId<std::remove_const_t<T>>()));
+    }
+
+    template <typename... Ts, typename F>
+    void World::EachChunk(F&& fn) {
+        static_assert(sizeof...(Ts) > 0, "queries need at least one component type");
+        IterationScope scope(*this);
+        const ComponentMask required = MaskOf<Ts...>();
+
+        for (const std::unique_ptr<Archetype>& archetype : m_Archetypes) {
+            const Archetype& a = *archetype;
+            if (a.count == 0 || (a.mask & required) != required) continue;
+            const size_t offsets[] = { a.offsets[a.Column(GetComponentId<std::remove_const_t<Ts>>())]... };
+            for (const Chunk& chunk : a.chunks)
+                VisitChunk<Ts...>(a, chunk, offsets, fn, std::index_sequence_for<Ts...>());
+        }
+    }
+
+    template <typename... Ts, typename F>
+    void World::Each(F&& fn) {
+        EachChunk<Ts...>(EntityVisitor<F, Ts...>{ fn });
+    }
+
+    template <typename... Ts, typename F>
+    void World::ParallelEach(F&& fn) {
+        static_assert(sizeof...(Ts) > 0, "queries need at least one component type");
+        IterationScope scope(*this);
+        const ComponentMask required = MaskOf<Ts...>();
+
+        struct Span {
+            const Archetype* archetype;
+            const Chunk* chunk;
+        };
+        std::vector<Span> spans;
+        for (const std::unique_ptr<Archetype>& archetype : m_Archetypes) {
+            const Archetype& a = *archetype;
+            if (a.count == 0 || (a.mask & required) != required) continue;
+            for (const Chunk& chunk : a.chunks) spans.push_back({ &a, &chunk });
+        }
+
+        const EntityVisitor<F, Ts...> visitor{ fn };
+        RunParallel((int)spans.size(), 4, [&](int begin, int end) {
+            for (int s = begin; s < end; ++s) {
+                const Archetype& a = *spans[s].archetype;
+                const size_t offsets[] = { a.offsets[a.Column(GetComponentId<std::remove_const_t<Ts>>())]... };
+                VisitChunk<Ts...>(a, *spans[s].chunk, offsets, visitor, std::index_sequence_for<Ts...>());
+            }
+        });
+    }
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+namespace ech {
+
+    // Fixed-timestep driver: simulation runs in constant ticks no matter how long a frame took,
+    // and rendering blends the two most recent states with Alpha(). Typical loop:
+    //
+    //   ech::FixedStep physics(120.0);
+    //   while (!ech::WindowShouldClose()) {
+    //       physics.Run([&](float dt) { prev = curr; Simulate(curr, dt); });
+    //       Draw(Lerp(prev, curr, physics.Alpha()));
+    //   }
+    class FixedStep {
+    public:
+        // maxStepsPerFrame is the spiral-of-death clamp: if a frame owes more ticks than that,
+        // the excess time is dropped and the simulation runs slow for a frame instead of freezing.
+        explicit FixedStep(double hz = 60.0, int maxStepsPerFrame = 8);
+
+        void SetRate(double hz);
+        double Rate() const { return 1.0 / m_Step; }
+        double StepSize() const { return m_Step; }
+        void SetMaxStepsPerFrame(int steps);
+
+        // Feed a frame's delta time; returns how many ticks to simulate now
+        int Advance(double frameDelta);
+
+        // Advance by GetDeltaTime() and call tick(dt) for each owed tick
+        template <typename TickFn>
+        int Run(TickFn&& tick) {
+            int steps = Advance(FrameDelta());
+            for (int i = 0; i < steps; ++i) {
+                m_CurrentTick = i;
+                tick(static_cast<float>(m_Step));
+                m_TickCount++;
+            }
+            m_CurrentTick = -1;
+            return steps;
+        }
+
+        // 0..1 position of the rendered frame between the previous and the latest tick
+        float Alpha() const { return static_cast<float>(m_Accumulator / m_Step); }
+
+        // GetTime() timestamp at the end of the tick currently being run by Run(), or of the
+        // latest tick when called outside of it. Lets a tick consume exactly its own input events.
+        double TickEndTime() const;
+
+        long long TickCount() const { return m_TickCount; }
+        long long DroppedTicks() const { return m_DroppedTicks; }
+        void Reset();
+
+    private:
+        static double FrameDelta();
+
+        double m_Step = 1.0 / 60.0;
+        double m_Accumulator = 0.0;
+        int m_MaxSteps = 8;
+        int m_PendingSteps = 0;     // ticks handed out by the last Advance
+        int m_CurrentTick = -1;
+        double m_FrameTime = 0.0;   // GetTime() at the last Advance
+        long long m_TickCount = 0;
+        long long m_DroppedTicks = 0;
+    };
+
+    // Blend between the previous and current tick's value for rendering
+    inline float Lerp(float previous, float current, float alpha) {
+        return previous + (current - previous) * alpha;
+    }
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace ech {
+
+    enum FramePacingMode {
+        PACING_UNCAPPED,    // no limiter, no vsync
+        PACING_FIXED,       // software limiter at the fps given to SetFpsLimit / SetFramePacing
+        PACING_VSYNC        // let the swap wait for the display (a software limit may still apply on top)
+    };
+
+    struct FrameTimeStats {
+        int samples = 0;        // frames in the history window
+        double minMs = 0;
+        double maxMs = 0;
+        double avgMs = 0;
+        double p50Ms = 0;
+        double p99Ms = 0;
+        double jitterMs = 0;    // standard deviation of the frame time
+        double avgSleepMs = 0;  // time the limiter spent waiting per frame
+    };
+
+    // Convenience for SetVSync + SetFpsLimit in one call. fps is only used by PACING_FIXED.
+    void SetFramePacing(FramePacingMode mode, int fps = 0);
+    FramePacingMode GetFramePacing();
+
+    // Statistics over the last few hundred frames (measured end-of-frame to end-of-frame)
+    FrameTimeStats GetFrameTimeStats();
+    void ResetFrameTimeStats();
+
+    // Seconds since the library was loaded, from the same monotonic clock the pacer uses
+    double GetTime();
+
+}
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "render_stats.hpp"
+
 // shader sources (declarations only)
 extern const char* shapeVertexShaderSource;
 extern const char* shapeFragmentShaderSource;
@@ -25,6 +27,47 @@ namespace ech {
     unsigned int CreateShaderProgram(const char* vertexSrc, const char* fragmentSrc);
     void InitGraphics(GLFWwindow* window);
 
-    // Called each frame by StartDrawing
+    // Called each frame by StartDrawing, and whenever projection/view change mid-frame
     void UploadShapeUniforms();
+
+    // Screen capture (capture.cpp): queue PBO readbacks before the swap, flush on shutdown
+    void UpdateFrameCapture();
+    void ShutdownFrameCapture();
+
+    // Dynamic resolution (dynamic_resolution.cpp): release GL objects before the context goes away
+    void ShutdownDynamicResolution();
+
+    // Tilemaps (tilemap.cpp): release the shared quad index buffer
+    void ShutdownTilemaps();
+
+    // Particles (particles.cpp): release the shared instancing program and quad
+    void ShutdownParticles();
+
+    // Profiler (profiler.cpp): drain per-thread zones at the end of each frame
+    void ProfilerEndFrame();
+    void ShutdownProfiler();
+
+    // Render stats (render_stats.cpp): counters for the frame in progress
+    extern RenderStats g_RenderStatsFrame;
+    void TrackTextureBind(unsigned int texture);
+    void TrackShaderSwitch(unsigned int program);
+    void RenderStatsEndFrame(double limiterSleepSeconds);
+
+    // Textured quad with explicit UVs (shared by DrawTexturedRectangle and render targets)
+    void DrawTexturedQuad(float x, float y, float w, float h, unsigned int textureID,
+        float u0, float v0, float u1, float v1);
 }
+
+#if ECH_RENDER_STATS
+#define ECH_STATS_DRAW(vertexCount) (::ech::g_RenderStatsFrame.drawCalls++, ::ech::g_RenderStatsFrame.vertices += (vertexCount))
+#define ECH_STATS_UPLOAD(bytes) (::ech::g_RenderStatsFrame.bufferUploads++, ::ech::g_RenderStatsFrame.bytesUploaded += (bytes))
+#define ECH_STATS_TEXTURE_BIND(texture) ::ech::TrackTextureBind(texture)
+#define ECH_STATS_SHADER(program) ::ech::TrackShaderSwitch(program)
+#define ECH_STATS_TEXTURE_LOADED() (::ech::g_RenderStatsFrame.texturesLoaded++)
+#else
+#define ECH_STATS_DRAW(vertexCount) ((void)0)
+#define ECH_STATS_UPLOAD(bytes) ((void)0)
+#define ECH_STATS_TEXTURE_BIND(texture) ((void)0)
+#define ECH_STATS_SHADER(program) ((void)0)
+#define ECH_STATS_TEXTURE_LOADED() ((void)0)
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ech {
+
+    // CPU-side RGBA8 image, top row first (same orientation as PNG files)
+    struct Image {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct ImageDiff {
+        bool matches = false;
+        int differentPixels = 0;    // pixels with any channel off by more than the tolerance
+        int maxDifference = 0;      // largest per-channel difference seen (0..255)
+        double meanDifference = 0;  // average per-channel difference over the whole image
+    };
+
+    struct FrameTimings {
+        int frames = 0;
+        double totalMs = 0;
+        double minMs = 0;
+        double maxMs = 0;
+        double avgMs = 0;
+        double p50Ms = 0;
+        double p99Ms = 0;
+    };
+
+    // Creates the default window without a visible surface. Rendering goes into an offscreen
+    // framebuffer, so this works on CI machines with no display (e.g. Mesa llvmpipe).
+    void CreateHeadlessWindow(int width, int height, const char* title = "Echlib headless");
+
+    // Read back what has been drawn so far this frame (call before EndDrawing on a visible window)
+    bool CaptureFrame(Image& out);
+    bool SaveFrame(const std::string& path);
+
+    bool LoadImageFile(const std::string& path, Image& out);
+    bool SaveImageFile(const Image& image, const std::string& path);
+
+    // A pixel differs when any channel is off by more than `tolerance`. The images match when
+    // at most `maxDifferentRatio` (0..1) of the pixels differ.
+    ImageDiff CompareImages(const Image& a, const Image& b, int tolerance, double maxDifferentRatio = 0.0);
+
+    // Compare the current frame against a golden PNG. With writeIfMissing the golden image is
+    // created from this frame when the file does not exist yet.
+    ImageDiff CompareFrameToGolden(const std::string& goldenPath, int tolerance,
+        double maxDifferentRatio = 0.0, bool writeIfMissing = false);
+
+    // Run `frames` frames back to back with the fps limit disabled and report how long they took.
+    // `drawFrame` is called between StartDrawing and EndDrawing with the frame index.
+    // syncEachFrame waits for the GPU every frame so the timings include rendering, not just submission.
+    FrameTimings RunFrames(int frames, const std::function<void(int)>& drawFrame, bool syncEachFrame = true);
+
+}
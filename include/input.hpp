@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+namespace ech {
+
+    // Sizes cover the whole GLFW key / mouse button range (GLFW_KEY_LAST = 348, GLFW_MOUSE_BUTTON_LAST = 7)
+    constexpr int InputKeyCount = 349;
+    constexpr int InputButtonCount = 8;
+    constexpr int InputKeyWords = (InputKeyCount + 63) / 64;
+
+    // Input state for one frame, filled from GLFW callbacks during PollEvents. Indices are GLFW
+    // key / button codes. "pressed" and "released" are edges seen since the previous poll, so a
+    // tap that starts and ends within one frame still reports pressed. Events come from every
+    // window, so with several open the mouse position is relative to the last one it moved over.
+    struct InputSnapshot {
+        uint64_t keysDown[InputKeyWords] = {};
+        uint64_t keysPressed[InputKeyWords] = {};
+        uint64_t keysReleased[InputKeyWords] = {};
+        uint8_t buttonsDown = 0;
+        uint8_t buttonsPressed = 0;
+        uint8_t buttonsReleased = 0;
+        double mouseX = 0.0;
+        double mouseY = 0.0;
+        double scrollX = 0.0;   // wheel movement since the previous poll
+        double scrollY = 0.0;
+
+        static bool Test(const uint64_t* bits, int index) {
+            return index >= 0 && index < InputKeyCount && ((bits[index >> 6] >> (index & 63)) & 1u);
+        }
+        static bool Test(uint8_t bits, int index) {
+            return index >= 0 && index < InputButtonCount && ((bits >> index) & 1u);
+        }
+    };
+
+    // The snapshot the Is*Pressed/Held/Released queries read from
+    const InputSnapshot& GetInputSnapshot();
+
+    float GetMouseX();
+    float GetMouseY();
+    float GetMouseWheel();
+
+    enum InputEventType {
+        INPUT_KEY_DOWN, INPUT_KEY_UP, INPUT_KEY_REPEAT,
+        INPUT_MOUSE_DOWN, INPUT_MOUSE_UP,
+        INPUT_MOUSE_MOVE, INPUT_MOUSE_SCROLL
+    };
+
+    struct InputEvent {
+        InputEventType type;
+        int code;       // Key or MouseKeys value, -1 for keys without one
+        double time;    // GetTime() when the event was received
+        float x, y;     // cursor position, or wheel offsets for INPUT_MOUSE_SCROLL
+    };
+
+    // Buffered, timestamped event queue alongside the snapshot, for input whose order and timing
+    // within a frame matters. Events are kept in a fixed ring (the oldest are dropped when it is
+    // full) until drained. While enabled the frame limiter waits on the event loop instead of
+    // sleeping, so events are stamped when they arrive rather than all at the next poll. With
+    // vsync the wait happens inside the buffer swap and events are stamped at the poll.
+    void EnableInputEvents(bool enabled);
+    bool IsInputEventsEnabled();
+
+    // Pop the oldest event; false when the queue is empty
+    bool PollInputEvent(InputEvent& event);
+    // Pop the oldest event only if it happened at or before `time`, e.g. FixedStep::TickEndTime()
+    bool PollInputEventUntil(double time, InputEvent& event);
+    int GetInputEventCount();
+    long long GetDroppedInputEvents();
+    void ClearInputEvents();
+
+}
@@ -2,5 +2,24 @@
 #include "window.hpp"
 
 namespace ech {
+    struct InputSnapshot;
+
     Window*& GetDefaultWindow();
+
+    // Frame pacer (frame_pacer.cpp)
+    void SetPacerPeriod(double seconds);    // 0 = no software limit
+    double GetPacerPeriod();
+    void SetPacerVSync(bool enabled);
+    void StartPacer();                      // anchor the first deadline (done lazily otherwise)
+    double PaceFrame();                     // wait for the next deadline, returns seconds since the last call
+    double GetLastPacerSleep();             // seconds the last PaceFrame spent waiting
+
+    // Input (input.cpp)
+    void InstallInputCallbacks(GLFWwindow* window);
+    void RemoveInputCallbacks(GLFWwindow* window);
+    void PumpEvents();                      // glfwPollEvents + publish this frame's input snapshot
+
+    // Input recording / replay (replay.cpp)
+    bool ReplayInputFrame(InputSnapshot& snapshot);     // true when the snapshot was replaced by a replay
+    double ReplayEndFrame(double measuredDelta);        // records the frame, or returns the recorded delta
 }
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ech {
+
+    struct JobNode;
+
+    // Number of unfinished jobs in a group. Jobs can be held back until a counter reaches
+    // zero, and WaitForJobs() runs other jobs meanwhile. A counter must outlive its jobs, and
+    // shouldn't get new jobs once something waits for it to reach zero.
+    class JobCounter {
+    public:
+        JobCounter() = default;
+        ~JobCounter();
+
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend struct JobScheduler;
+
+        std::atomic<int> m_Pending{ 0 };
+        std::mutex m_Mutex;                     // guards m_Waiters and the drop to zero
+        std::vector<JobNode*> m_Waiters;        // jobs queued once the count reaches zero
+    };
+
+    // Work-stealing job system shared by the whole library: one worker thread per core,
+    // besides the thread that first uses it, each with its own deque. Jobs submitted from a
+    // worker (or that first thread) go on its own deque and run newest first; idle workers
+    // steal the oldest job from another deque. The workers start with the first job.
+
+    // Queues fn. counter, if given, counts it until it returns. With a dependency, fn is
+    // only queued once that counter reaches zero.
+    void RunJob(std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    // Runs queued jobs on the calling thread until the counter reaches zero
+    void WaitForJobs(JobCounter& counter);
+
+    // fn(begin, end) over chunks of [0, count) on the workers and the calling thread, and
+    // returns once every chunk is done. grain is the chunk size, or 0 to split the range in a
+    // few chunks per thread. maxWorkers caps the workers that help (-1: all of them), and
+    // nested calls from inside a job are fine.
+    void ParallelFor(int count, int grain, const std::function<void(int, int)>& fn, int maxWorkers = -1);
+
+    // Worker threads, not counting the threads that wait and help
+    int GetJobWorkerCount();
+    // Restarts the workers with `count` threads (-1: one per core, less one); 0 runs every job
+    // on the thread that waits for it. Only call it while no job is queued or running.
+    void SetJobWorkerCount(int count);
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "collision.hpp"
+#include "mapped_file.hpp"
+
+namespace ech {
+
+    class Tilemap;
+
+    // Tile gids follow Tiled: 0 is empty, tileset n starts at its firstGid, and the top bits
+    // flag flipped tiles
+    constexpr uint32_t TileFlipHorizontal = 0x80000000u;
+    constexpr uint32_t TileFlipVertical = 0x40000000u;
+    constexpr uint32_t TileFlipDiagonal = 0x20000000u;
+    constexpr uint32_t TileGidMask = 0x0fffffffu;
+
+    enum LevelObjectShape : uint32_t {
+        OBJECT_RECTANGLE,
+        OBJECT_ELLIPSE,     // inscribed in the object's box
+        OBJECT_POINT,
+        OBJECT_POLYGON,     // outline in the level's point array
+        OBJECT_POLYLINE,
+        OBJECT_TILE         // tile object, drawn with its gid
+    };
+
+    // These records are stored as-is in the compiled file. Names are offsets into its string
+    // table, read with Level::GetString.
+    struct LevelTileset {
+        uint32_t name, image;       // image path is relative to the map
+        int32_t firstGid;
+        int32_t tileWidth, tileHeight;
+        int32_t margin, spacing;
+        int32_t columns, tileCount;
+        int32_t imageWidth, imageHeight;
+    };
+
+    struct LevelTileLayer {
+        uint32_t name;
+        int32_t width, height;
+        uint32_t firstTile;         // into the level's tile array, row by row
+        float offsetX, offsetY;     // pixel offset, including that of enclosing groups
+        float opacity;
+        uint32_t visible;
+    };
+
+    struct LevelObjectLayer {
+        uint32_t name;
+        uint32_t firstObject, objectCount;
+        uint32_t visible;
+    };
+
+    // Level imported from a Tiled map (.tmx, or .tmj/.json) and compiled into a flat binary
+    // file that is memory mapped and used in place, with no parsing. Objects of every object
+    // layer sit in structure-of-arrays form, positions in world pixels with layer offsets
+    // applied and the box's top-left corner as the anchor (rotation, in degrees, turns about
+    // that corner), so a layer's boxes feed straight into CheckCollisionBatch or
+    // SweepAABBFirst.
+    //
+    // Supported: orthogonal finite maps; tile layers in CSV, uncompressed base64 or XML tiles;
+    // embedded or external (.tsx / .tsj) single-image tilesets; object and group layers.
+    class Level {
+    public:
+        Level();
+        ~Level();
+
+        Level(const Level&) = delete;
+        Level& operator=(const Level&) = delete;
+
+        // Loads a Tiled map through the compiled cache: the cache file in cacheDir is named
+        // after hashes of the map's path and contents, and is rebuilt when missing, stale or
+        // when an external tileset changed. An empty cacheDir puts it next to the map.
+        bool Load(const std::string& path, const std::string& cacheDir = "");
+        // Loads a file written by Compile or by the cache
+        bool LoadCompiled(const std::string& path);
+        // Imports a Tiled map and writes the compiled level
+        static bool Compile(const std::string& sourcePath, const std::string& outputPath);
+        void Unload();
+
+        bool IsLoaded() const { return m_Data != nullptr; }
+        // True when the last Load() was served from the cache without importing
+        bool WasCached() const { return m_Cached; }
+
+        int Width() const;          // in tiles
+        int Height() const;
+        int TileWidth() const;      // in pixels
+        int TileHeight() const;
+
+        const char* GetString(uint32_t offset) const;
+
+        int GetTilesetCount() const;
+        const LevelTileset& GetTileset(int index) const;
+        // Index of the tileset a gid belongs to, or -1 for empty tiles
+        int FindTileset(uint32_t gid) const;
+
+        int GetTileLayerCount() const;
+        const LevelTileLayer& GetTileLayer(int index) const;
+        const uint32_t* GetTiles(int layer) const;
+        int FindTileLayer(const char* name) const;
+
+        int GetObjectLayerCount() const;
+        const LevelObjectLayer& GetObjectLayer(int index) const;
+        int FindObjectLayer(const char* name) const;
+
+        // Objects of all layers; layer i covers [firstObject, firstObject + objectCount)
+        int GetObjectCount() const;
+        const float* GetObjectX() const;
+        const float* GetObjectY() const;
+        const float* GetObjectWidth() const;
+        const float* GetObjectHeight() const;
+        const float* GetObjectRotation() const;
+        const uint32_t* GetObjectId() const;
+        const uint32_t* GetObjectGid() const;
+        const uint32_t* GetObjectName() const;      // string offsets
+        const uint32_t* GetObjectType() const;      // string offsets ("class" in newer Tiled)
+        const uint32_t* GetObjectShape() const;     // LevelObjectShape
+        const uint32_t* GetObjectFirstPoint() const;
+        const uint32_t* GetObjectPointCount() const;
+        // Polygon and polyline vertices as x, y pairs relative to the object position
+        const float* GetPoints() const;
+
+        // Boxes of one object layer, or of all objects for layer -1
+        BoxArray GetObjectBoxes(int layer = -1) const;
+
+        // Sizes the tilemap to a tile layer and fills it with the tiles of one tileset,
+        // converted to tileset indices. Tiles of other tilesets are left empty and flip flags
+        // are dropped. The tilemap's own tileset texture is left for the caller to set.
+        bool BuildTilemap(int layer, Tilemap& map, int tileset = 0) const;
+
+    private:
+        bool Adopt(std::vector<uint64_t>&& data, size_t size, const std::string& source);
+        const void* Section(int section, size_t& count, size_t recordSize) const;
+        template<typename T> const T* Array(int section) const;
+
+        // The compiled file, either mapped from disk or just imported into m_Imported, whose
+        // 8-byte words keep every section aligned like the page-aligned mapping does
+        MappedFile m_File;
+        std::vector<uint64_t> m_Imported;
+        const unsigned char* m_Data = nullptr;
+        size_t m_Size = 0;
+        bool m_Cached = false;
+    };
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "level.hpp"
+
+namespace ech {
+
+    // Compiled level file: a LevelFileHeader, then every section at the 8-byte aligned offset
+    // recorded in the header. Values are in the writing machine's byte order; it is a cache,
+    // not an interchange format.
+    constexpr char LevelMagic[4] = { 'E', 'C', 'H', 'L' };
+    constexpr uint32_t LevelVersion = 1;
+
+    enum LevelSection {
+        LEVEL_TILESETS,         // LevelTileset
+        LEVEL_TILE_LAYERS,      // LevelTileLayer
+        LEVEL_TILES,            // uint32_t gids
+        LEVEL_OBJECT_LAYERS,    // LevelObjectLayer
+        LEVEL_OBJECT_X,         // float per object
+        LEVEL_OBJECT_Y,
+        LEVEL_OBJECT_WIDTH,
+        LEVEL_OBJECT_HEIGHT,
+        LEVEL_OBJECT_ROTATION,
+        LEVEL_OBJECT_ID,        // uint32_t per object
+        LEVEL_OBJECT_GID,
+        LEVEL_OBJECT_NAME,
+        LEVEL_OBJECT_TYPE,
+        LEVEL_OBJECT_SHAPE,
+        LEVEL_OBJECT_FIRST_POINT,
+        LEVEL_OBJECT_POINT_COUNT,
+        LEVEL_POINTS,           // float x, y pairs
+        LEVEL_STRINGS,          // zero-terminated strings, starting with the empty string
+        LEVEL_DEPENDENCIES,     // LevelDependency
+        LEVEL_SECTION_COUNT
+    };
+
+    // External file the level was built from besides the map itself
+    struct LevelDependency {
+        uint32_t path;          // as opened by the importer
+        uint32_t reserved;
+        uint64_t hash;
+    };
+
+    struct LevelFileSection {
+        uint64_t offset, size;  // in bytes
+    };
+
+    struct LevelFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        int32_t width, height;
+        int32_t tileWidth, tileHeight;
+        LevelFileSection sections[LEVEL_SECTION_COUNT];
+    };
+
+    // FNV-1a, 64-bit
+    uint64_t HashBytes(const void* data, size_t size);
+    bool ReadFileBytes(const std::string& path, std::string& bytes);
+
+    // Parses the Tiled map whose contents are `source` and lays out the compiled file in
+    // `compiled` (size in bytes returned in `size`). Errors go to std::cerr.
+    bool ImportTiledMap(const std::string& path, const std::string& source,
+        std::vector<uint64_t>& compiled, size_t& size);
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace ech {
+
+    // Read-only view of a whole file mapped into memory. Pages are read in by the OS as they
+    // are first touched, so opening costs the same whatever the file's size. The data starts
+    // page aligned.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Fails for missing and empty files
+        bool Open(const std::string& path);
+        void Close();
+
+        bool IsOpen() const { return m_Data != nullptr; }
+        const unsigned char* Data() const { return m_Data; }
+        size_t Size() const { return m_Size; }
+
+    private:
+        const unsigned char* m_Data = nullptr;
+        size_t m_Size = 0;
+#ifdef _WIN32
+        void* m_File = nullptr;
+        void* m_Mapping = nullptr;
+#endif
+    };
+
+}
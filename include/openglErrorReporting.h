@@ -1,5 +1,6 @@
 #pragma once
 #include <glad/glad.h>
+#include "profiler.hpp"
 
 //https://learnopengl.com/In-Practice/Debugging
 void GLAPIENTRY glDebugOutput(GLenum source,
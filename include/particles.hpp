@@ -0,0 +1,77 @@
+#pragma once
+#include <memory>
+
+namespace ech {
+
+    // How an emitter spawns and draws its particles. Directions are in radians with y down,
+    // so the default direction is straight up. Colors are RGBA in 0..1, like Color.
+    struct EmitterDef {
+        float x = 0.0f, y = 0.0f;           // spawn point
+        float width = 0.0f, height = 0.0f;  // spawn area centered on the point
+        float rate = 0.0f;                  // particles per second spawned by Update()
+        int maxParticles = 10000;           // spawns past this are dropped
+        float lifeMin = 1.0f, lifeMax = 1.0f;       // seconds
+        float speedMin = 50.0f, speedMax = 100.0f;
+        float direction = -1.5707963f;
+        float spread = 6.2831853f;          // full angle of the spawn cone
+        float gravityX = 0.0f, gravityY = 0.0f;
+        float drag = 0.0f;                  // velocity lost per second, as a damping rate
+        float startSize = 8.0f, endSize = 8.0f;
+        float startColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        float endColor[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+        unsigned int texture = 0;           // 0 draws solid squares
+        bool additive = false;              // additive blending, for fire and sparks
+    };
+
+    // Particle pools stored as structure-of-arrays (x, y, vx, vy, age), one per emitter.
+    // Size and color aren't stored: they are interpolated from the particle's age on the GPU.
+    // Update() integrates with the SIMD level picked by SetSimdLevel and splits big pools
+    // across worker threads; Draw() is one instanced draw call per emitter, uploading only
+    // positions and ages.
+    class ParticleSystem {
+    public:
+        explicit ParticleSystem(int workerCount = -1);  // job workers updates may use; -1 for all of them
+        ~ParticleSystem();
+
+        ParticleSystem(const ParticleSystem&) = delete;
+        ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+        // Returns an emitter handle, or -1 if the definition is invalid. Handles are reused.
+        int CreateEmitter(const EmitterDef& def);
+        void DestroyEmitter(int emitter);
+        bool IsValid(int emitter) const;
+
+        // Changes apply to particles spawned from now on, except colors, sizes, gravity and
+        // drag, which apply to the whole pool
+        const EmitterDef& GetEmitterDef(int emitter) const;
+        void SetEmitterDef(int emitter, const EmitterDef& def);
+        void SetEmitterPosition(int emitter, float x, float y);
+        void SetEmitterRate(int emitter, float rate);
+
+        // Spawns count particles at once
+        void Burst(int emitter, int count);
+        // Removes the emitter's live particles
+        void Clear(int emitter);
+
+        void Update(float dt);
+        // Draws every emitter, in handle order, with the current camera
+        void Draw();
+        void Draw(int emitter);
+
+        int GetParticleCount() const;
+        int GetParticleCount(int emitter) const;
+
+        // Live particles of an emitter, valid until the next Update(). Age runs from 0 at spawn
+        // to 1 at death.
+        const float* GetParticleX(int emitter) const;
+        const float* GetParticleY(int emitter) const;
+        const float* GetParticleAge(int emitter) const;
+
+        int GetWorkerCount() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_Impl;
+    };
+
+}
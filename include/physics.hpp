@@ -0,0 +1,146 @@
+#pragma once
+#include <memory>
+
+#include "aabb_tree.hpp"
+
+namespace ech {
+
+    enum BodyType {
+        BODY_STATIC,    // never moves, infinite mass
+        BODY_KINEMATIC, // moved by its velocity only, pushes dynamic bodies
+        BODY_DYNAMIC
+    };
+
+    enum ShapeType {
+        SHAPE_BOX,
+        SHAPE_CIRCLE,
+        SHAPE_POLYGON
+    };
+
+    // Largest vertex count of a SHAPE_POLYGON
+    constexpr int MaxPolygonVertices = 8;
+
+    // Bodies are positioned by their center of mass. Units are whatever the game uses (pixels
+    // by default, y down); angles are in radians and, with y down, positive is clockwise.
+    struct BodyDef {
+        BodyType type = BODY_DYNAMIC;
+        float x = 0.0f, y = 0.0f;
+        float angle = 0.0f;
+        float velocityX = 0.0f, velocityY = 0.0f;
+        float angularVelocity = 0.0f;
+        float linearDamping = 0.0f;
+        float angularDamping = 0.0f;
+        float gravityScale = 1.0f;
+        bool fixedRotation = false;
+        bool allowSleep = true;
+        int userData = 0;
+    };
+
+    // One shape per body. Boxes and circles are centered on the body; polygon vertices are
+    // interleaved x, y pairs of a convex outline in either winding, and are re-centered on
+    // their centroid.
+    struct ShapeDef {
+        ShapeType type = SHAPE_BOX;
+        float width = 0.0f, height = 0.0f;  // SHAPE_BOX
+        float radius = 0.0f;                // SHAPE_CIRCLE
+        const float* vertices = nullptr;    // SHAPE_POLYGON
+        int vertexCount = 0;
+        float density = 1.0f;
+        float friction = 0.6f;
+        float restitution = 0.0f;
+    };
+
+    struct PhysicsSettings {
+        float gravityX = 0.0f, gravityY = 980.0f;
+        // Solver substeps per Step(). Contacts stay stable up to a contactHertz of about an eighth
+        // of the substep rate (60 Hz for 8 substeps of a 60 Hz step); stiffer contacts squash
+        // less under tall stacks. The defaults suit pixel units, with strong gravity relative
+        // to body size.
+        int subSteps = 8;
+        float contactHertz = 60.0f;
+        float linearSlop = 0.5f;            // sets the speculative contact distance (4x)
+        float contactDampingRatio = 10.0f;
+        float maxPushoutSpeed = 300.0f;     // cap on the speed used to resolve overlap
+        float restitutionThreshold = 50.0f; // slower impacts don't bounce
+        float maxLinearSpeed = 40000.0f;
+        float sleepLinearSpeed = 5.0f;
+        float sleepAngularSpeed = 0.035f;
+        float timeToSleep = 0.5f;
+        int workerCount = -1;               // job workers the solver may use; -1 for all of them
+    };
+
+    // Rigid-body world. Bodies live in structure-of-arrays pools addressed by integer handles;
+    // the broadphase is an AABBTree. Each Step() builds contact manifolds (in parallel), groups
+    // awake bodies touching each other into islands, and solves the islands in parallel with
+    // soft sequential impulses over a few substeps. Islands that stay still for timeToSleep
+    // go to sleep and cost nothing but their broadphase proxies until something touches them.
+    //
+    // Step with a fixed dt, e.g. from a FixedStep loop, for stable and repeatable results.
+    class Physics {
+    public:
+        explicit Physics(const PhysicsSettings& settings = PhysicsSettings());
+        ~Physics();
+
+        Physics(const Physics&) = delete;
+        Physics& operator=(const Physics&) = delete;
+
+        // Returns a body handle, or -1 if the shape is invalid. Handles of destroyed bodies are reused.
+        int CreateBody(const BodyDef& body, const ShapeDef& shape);
+        void DestroyBody(int body);
+        void Clear();
+        bool IsValid(int body) const;
+
+        void Step(float dt);
+
+        const PhysicsSettings& GetSettings() const { return m_Settings; }
+        void SetGravity(float x, float y);
+
+        float GetX(int body) const;
+        float GetY(int body) const;
+        float GetAngle(int body) const;
+        float GetVelocityX(int body) const;
+        float GetVelocityY(int body) const;
+        float GetAngularVelocity(int body) const;
+        float GetMass(int body) const;
+        BodyType GetType(int body) const;
+        int GetUserData(int body) const;
+        void SetUserData(int body, int userData);
+
+        // Teleports the body and wakes it
+        void SetTransform(int body, float x, float y, float angle);
+        void SetVelocity(int body, float vx, float vy);
+        void SetAngularVelocity(int body, float w);
+        // Forces are cleared after every Step(); impulses change velocity immediately.
+        // The point versions take a world-space point.
+        void ApplyForce(int body, float fx, float fy);
+        void ApplyForce(int body, float fx, float fy, float px, float py);
+        void ApplyTorque(int body, float torque);
+        void ApplyImpulse(int body, float ix, float iy);
+        void ApplyImpulse(int body, float ix, float iy, float px, float py);
+
+        bool IsAwake(int body) const;
+        void WakeUp(int body);
+
+        // World-space outline for drawing: polygon/box corners, or the center and a point on
+        // the rim for circles. Returns the vertex count (at most MaxPolygonVertices).
+        int GetShapeVertices(int body, float* xy) const;
+        // Axis-aligned bounds as (x, y, w, h)
+        void GetBounds(int body, float& x, float& y, float& w, float& h) const;
+
+        // Bodies whose bounds overlap the box. Same return convention as AABBTree::Query.
+        int QueryBounds(float x, float y, float w, float h, int* bodies, int maxBodies);
+
+        int GetBodyCount() const { return m_BodyCount; }
+        int GetAwakeBodyCount() const;
+        int GetContactCount() const;    // touching contacts in the last step
+        int GetIslandCount() const;     // awake islands solved in the last step
+        int GetWorkerCount() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_Impl;
+        PhysicsSettings m_Settings;
+        int m_BodyCount = 0;
+    };
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+
+#include "physics.hpp"
+
+namespace ech {
+
+    // Shapes in body space, centered on the center of mass. Boxes are stored as 4-gons.
+    struct PhysicsShape {
+        ShapeType type;
+        float radius;   // circles only
+        int count;      // polygon vertex count, counter-clockwise in y-up terms
+        float x[MaxPolygonVertices], y[MaxPolygonVertices];
+        float nx[MaxPolygonVertices], ny[MaxPolygonVertices]; // outward edge normals
+    };
+
+    struct PhysicsTransform {
+        float x, y;
+        float c, s;     // cos/sin of the angle
+    };
+
+    struct ManifoldPoint {
+        float anchorAX, anchorAY;   // contact point relative to each body's center
+        float anchorBX, anchorBY;
+        float separation;           // negative when overlapping
+        uint32_t id;                // identifies the features, for matching across steps
+    };
+
+    // Contact between shapes A and B; the normal points from A to B. Points farther apart than
+    // the speculative distance are left out.
+    struct Manifold {
+        float normalX, normalY;
+        int pointCount;
+        ManifoldPoint points[2];
+    };
+
+    // Validates the definition and fills the shape. Polygons are re-centered on their centroid,
+    // which is returned in body space.
+    bool MakePhysicsShape(const ShapeDef& def, PhysicsShape& shape, float& centroidX, float& centroidY);
+    void ComputeShapeMass(const PhysicsShape& shape, float density, float& mass, float& inertia);
+    void ComputeShapeBounds(const PhysicsShape& shape, const PhysicsTransform& xf,
+        float& minX, float& minY, float& maxX, float& maxY);
+
+    void CollideShapes(const PhysicsShape& a, const PhysicsTransform& xfA,
+        const PhysicsShape& b, const PhysicsTransform& xfB, float speculativeDistance, Manifold& manifold);
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Set ECH_PROFILING to 0 to compile every ECH_PROFILE_* zone out of the build
+#ifndef ECH_PROFILING
+#define ECH_PROFILING 1
+#endif
+
+namespace ech {
+
+    class Font;
+
+    struct ProfileZoneStats {
+        std::string name;
+        bool gpu = false;
+        double avgMs = 0;   // smoothed inclusive time per frame
+        double maxMs = 0;   // worst frame in the recent history
+        double calls = 0;   // smoothed calls per frame
+    };
+
+    // Recording starts disabled; a disabled zone costs one relaxed atomic load.
+    void EnableProfiler(bool enabled);
+    bool IsProfilerEnabled();
+
+    // Per-zone timings, slowest first
+    std::vector<ProfileZoneStats> GetProfilerZones();
+
+    // Screen-space overlay with frame time and the slowest zones (ignores the camera)
+    void DrawProfilerOverlay(Font& font, float x = 10.0f, float y = 10.0f, float lineHeight = 22.0f);
+
+    // Write the recorded history (CPU threads + GPU track) as Chrome trace_event JSON.
+    // Open it in chrome://tracing or https://ui.perfetto.dev
+    bool ExportChromeTrace(const std::string& path);
+    // CPU zones lost because a thread recorded more than its ring holds between two frame
+    // ends. Also in the trace: per thread, and as otherData.droppedEvents.
+    uint64_t GetProfilerDroppedEvents();
+
+    // Zone names must outlive the profiler (string literals are ideal)
+    void BeginCpuZone(const char* name);
+    void EndCpuZone();
+    // GPU zones use GL timestamp queries, read back a few frames later so they never stall
+    void BeginGpuZone(const char* name);
+    void EndGpuZone();
+    // Instant event on the current thread's track (text is copied)
+    void ProfilerMarker(const std::string& text);
+
+    class ProfileScope {
+    public:
+        explicit ProfileScope(const char* name) { BeginCpuZone(name); }
+        ~ProfileScope() { EndCpuZone(); }
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+    };
+
+    class GpuProfileScope {
+    public:
+        explicit GpuProfileScope(const char* name) { BeginGpuZone(name); }
+        ~GpuProfileScope() { EndGpuZone(); }
+        GpuProfileScope(const GpuProfileScope&) = delete;
+        GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+    };
+
+}
+
+#define ECH_PROFILE_CONCAT_INNER(a, b) a##b
+#define ECH_PROFILE_CONCAT(a, b) ECH_PROFILE_CONCAT_INNER(a, b)
+
+#if ECH_PROFILING
+#define ECH_PROFILE_SCOPE(name) ::ech::ProfileScope ECH_PROFILE_CONCAT(echProfileScope, __LINE__)(name)
+#define ECH_PROFILE_GPU_SCOPE(name) ::ech::GpuProfileScope ECH_PROFILE_CONCAT(echGpuProfileScope, __LINE__)(name)
+#define ECH_PROFILE_FUNCTION() ECH_PROFILE_SCOPE(__func__)
+#else
+#define ECH_PROFILE_SCOPE(name) ((void)0)
+#define ECH_PROFILE_GPU_SCOPE(name) ((void)0)
+#define ECH_PROFILE_FUNCTION() ((void)0)
+#endif
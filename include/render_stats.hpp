@@ -0,0 +1,36 @@
+#pragma once
+
+// Renderer counters are compiled out of release (NDEBUG) builds unless ECH_RENDER_STATS=1
+#ifndef ECH_RENDER_STATS
+#ifdef NDEBUG
+#define ECH_RENDER_STATS 0
+#else
+#define ECH_RENDER_STATS 1
+#endif
+#endif
+
+namespace ech {
+
+    struct RenderStats {
+        unsigned int drawCalls = 0;
+        unsigned long long vertices = 0;        // vertices submitted (indexed draws count indices)
+        unsigned int bufferUploads = 0;         // glBufferData / glTexImage2D style uploads
+        unsigned long long bytesUploaded = 0;
+        unsigned int textureBinds = 0;          // binds that changed the bound texture
+        unsigned int shaderSwitches = 0;        // glUseProgram calls that changed the program
+        unsigned int texturesLoaded = 0;
+        double limiterSleepMs = 0.0;            // time the frame limiter waited at the end of the frame
+    };
+
+    // Number of completed frames kept by GetRenderStatsHistory
+    constexpr int RenderStatsHistorySize = 120;
+
+    // Counters of the last completed frame (all zero when ECH_RENDER_STATS is 0)
+    const RenderStats& GetRenderStats();
+    // framesAgo = 0 is the last completed frame; returns zeros past the recorded history
+    const RenderStats& GetRenderStatsHistory(int framesAgo);
+    int GetRenderStatsHistoryCount();
+    // Average over the recorded history
+    RenderStats GetAverageRenderStats();
+
+}
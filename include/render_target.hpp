@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ech {
+
+    // Offscreen framebuffer (FBO) with one or more color textures.
+    // Everything drawn between Begin() and End() lands in the target instead of the window,
+    // so static layers can be rendered once and then blitted every frame with DrawRenderTarget.
+    class RenderTarget {
+    public:
+        static constexpr int MaxColorAttachments = 4;
+
+        RenderTarget();
+        RenderTarget(int width, int height, int colorAttachments = 1);
+        ~RenderTarget();
+
+        RenderTarget(const RenderTarget&) = delete;
+        RenderTarget& operator=(const RenderTarget&) = delete;
+
+        bool Create(int width, int height, int colorAttachments = 1);
+        void Destroy();
+
+        // Bind the target, clear it to transparent and set up a pixel projection of its size.
+        // The camera is NOT applied, so draw in the target's own coordinates.
+        void Begin();
+        // Restore the previous framebuffer, viewport and matrices. Clears the dirty flag.
+        void End();
+
+        unsigned int GetTexture(int attachment = 0) const;
+        unsigned int GetFramebuffer() const { return m_Framebuffer; }
+        int Width() const { return m_Width; }
+        int Height() const { return m_Height; }
+        bool IsValid() const { return m_Framebuffer != 0; }
+
+        // Cache invalidation is up to the user: mark the target dirty when its content changed,
+        // and only re-render it while IsDirty() is true. A freshly created target starts dirty.
+        void MarkDirty() { m_Dirty = true; }
+        bool IsDirty() const { return m_Dirty; }
+
+    private:
+        unsigned int m_Framebuffer = 0;
+        unsigned int m_ColorTextures[MaxColorAttachments] = {};
+        int m_ColorCount = 0;
+        int m_Width = 0;
+        int m_Height = 0;
+        bool m_Dirty = true;
+
+        // State saved by Begin() so End() can put everything back (targets can be nested)
+        int m_PrevFramebuffer = 0;
+        int m_PrevViewport[4] = {};
+        float m_PrevClearColor[4] = {};
+        glm::mat4 m_PrevProjection{};
+        glm::mat4 m_PrevView{};
+        bool m_Active = false;
+    };
+
+    // Draw the target's color texture as a textured rectangle (goes through the camera like any other draw)
+    void DrawRenderTarget(const RenderTarget& target, float x, float y);
+    void DrawRenderTarget(const RenderTarget& target, float x, float y, float w, float h, int attachment = 0);
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+namespace ech {
+
+    // Input recording and deterministic replay. A recording stores, for every frame, the input
+    // snapshot seen after the poll and the delta time GetDeltaTime() returned, plus the seed of
+    // the library RNG. Replaying feeds those back through IsKey*/IsMouseButton*/GetMouse*/
+    // GetDeltaTime instead of GLFW, so a game that only reads input and time through echlib
+    // runs the exact same simulation again.
+    //
+    // Not recorded: the timestamped event queue and GetTime(). Live input is ignored during replay.
+
+    // Starts a new recording and reseeds the RNG with `seed`
+    bool StartInputRecording(const char* path, uint32_t seed);
+    bool StopInputRecording();
+    bool IsInputRecording();
+
+    // With fastForward the frame limiter and vsync are turned off for the replay (and restored
+    // afterwards); combine with CreateHeadlessWindow for benchmark runs. GetDeltaTime() still
+    // returns the recorded values, so the simulation is unchanged.
+    bool StartInputReplay(const char* path, bool fastForward = false);
+    void StopInputReplay();
+    bool IsInputReplaying();
+    // True once a replay has fed its last frame (stays set until the next StartInputReplay)
+    bool IsInputReplayFinished();
+    int GetReplayFrame();
+    int GetReplayFrameCount();
+
+    // Library RNG (PCG32). Seeded from the recording during replay, so gameplay randomness
+    // drawn from here repeats too.
+    void SetRandomSeed(uint32_t seed);
+    int GetRandomValue(int min, int max);   // inclusive range
+    float GetRandomFloat();                 // [0, 1)
+
+}
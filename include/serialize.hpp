@@ -0,0 +1,207 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+namespace ech {
+
+    // Pointer stored as the distance from the field itself to its target, so a structure
+    // built from them reads the same wherever its bytes sit in memory: a blob holding one can
+    // be used straight out of a mapped file. An offset of 0 is null.
+    template <typename T>
+    struct RelPtr {
+        int64_t offset = 0;
+
+        const T* Get() const {
+            return offset ? reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset) : nullptr;
+        }
+        // Target and pointer must be in the same buffer
+        void Set(const T* target) {
+            offset = target ? reinterpret_cast<const char*>(target) - reinterpret_cast<const char*>(this) : 0;
+        }
+    };
+
+    template <typename T>
+    struct RelArray {
+        int64_t offset = 0;
+        uint64_t count = 0;
+
+        const T* Data() const {
+            return offset ? reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset) : nullptr;
+        }
+        void Set(const T* data, size_t size) {
+            offset = data ? reinterpret_cast<const char*>(data) - reinterpret_cast<const char*>(this) : 0;
+            count = size;
+        }
+        size_t Size() const { return (size_t)count; }
+        const T& operator[](size_t i) const { return Data()[i]; }
+        const T* begin() const { return Data(); }
+        const T* end() const { return Data() + count; }
+    };
+
+    enum FieldType : uint32_t {
+        FIELD_INT8,
+        FIELD_UINT8,
+        FIELD_INT16,
+        FIELD_UINT16,
+        FIELD_INT32,
+        FIELD_UINT32,
+        FIELD_INT64,
+        FIELD_UINT64,
+        FIELD_FLOAT32,
+        FIELD_FLOAT64,
+        FIELD_TYPE_COUNT
+    };
+
+    // `count` values of `type` starting `offset` bytes into the record
+    struct SchemaField {
+        std::string name;
+        FieldType type = FIELD_UINT8;
+        uint32_t offset = 0;
+        uint32_t count = 1;
+    };
+
+    // Layout of a plain record type. Files keep the schema of every table they hold, so
+    // records saved under an older layout can still be read: fields are matched by name.
+    struct Schema {
+        uint32_t version = 1;           // stored with the table; not used for matching
+        uint32_t size = 0;              // sizeof the record
+        std::vector<SchemaField> fields;
+    };
+
+    template <typename T>
+    constexpr FieldType FieldTypeOf() {
+        using V = std::remove_cv_t<std::remove_all_extents_t<T>>;
+        using U = typename std::conditional_t<std::is_enum<V>::value, std::underlying_type<V>, std::remove_cv<V>>::type;
+        static_assert(std::is_arithmetic<U>::value && !std::is_same<U, bool>::value && !std::is_same<U, long double>::value,
+            "schema fields are integers, floats or fixed arrays of them");
+        if (std::is_floating_point<U>::value) return sizeof(U) == 4 ? FIELD_FLOAT32 : FIELD_FLOAT64;
+        switch (sizeof(U)) {
+        case 1: return std::is_signed<U>::value ? FIELD_INT8 : FIELD_UINT8;
+        case 2: return std::is_signed<U>::value ? FIELD_INT16 : FIELD_UINT16;
+        case 4: return std::is_signed<U>::value ? FIELD_INT32 : FIELD_UINT32;
+        default: return std::is_signed<U>::value ? FIELD_INT64 : FIELD_UINT64;
+        }
+    }
+
+    template <typename T>
+    SchemaField MakeSchemaField(const char* name, size_t offset) {
+        using V = std::remove_all_extents_t<T>;
+        return { name, FieldTypeOf<T>(), (uint32_t)offset, (uint32_t)(sizeof(T) / sizeof(V)) };
+    }
+
+    // Schema field for a member, arrays included: ECH_SCHEMA_FIELD(Enemy, health)
+#define ECH_SCHEMA_FIELD(Record, member) ::ech::MakeSchemaField<decltype(Record::member)>(#member, offsetof(Record, member))
+
+    // XXH64 with seed 0
+    uint64_t ComputeChecksum(const void* data, size_t size);
+
+    // Collects named tables of records and blobs, and writes them as one binary file:
+    // a versioned header with a checksum, then the tables, each 64-byte aligned and stored
+    // byte for byte. Everything inside the file refers to the rest through relative offsets,
+    // so BinaryFile reads it in place. Values are in the writing machine's byte order.
+    class BinaryWriter {
+    public:
+        BinaryWriter();
+
+        BinaryWriter(const BinaryWriter&) = delete;
+        BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+        // `records` holds count records laid out as described by the schema
+        void AddTable(const std::string& name, const Schema& schema, const void* records, size_t count);
+        template <typename T>
+        void AddTable(const std::string& name, const Schema& schema, const std::vector<T>& records);
+        // Raw bytes, read back with BinaryFile::GetBlob. RelPtr and RelArray pointing inside
+        // the blob stay valid.
+        void AddBlob(const std::string& name, const void* data, size_t size);
+
+        // version is the caller's, returned by BinaryFile::GetVersion
+        bool Save(const std::string& path, uint32_t version = 0);
+        void Clear();
+
+    private:
+        struct Table {
+            std::string name;
+            Schema schema;
+            bool blob;
+            uint64_t offset, count;
+        };
+
+        std::vector<unsigned char> m_Data;      // header space, then the table data
+        std::vector<Table> m_Tables;
+    };
+
+    // File written by BinaryWriter, memory mapped. Opening checks the header, that every
+    // offset in the file stays inside it and, unless told not to, the checksum; nothing is
+    // parsed or copied, so tables whose layout is unchanged are used where they lie.
+    class BinaryFile {
+    public:
+        BinaryFile() = default;
+
+        BinaryFile(const BinaryFile&) = delete;
+        BinaryFile& operator=(const BinaryFile&) = delete;
+
+        // Skipping the checksum saves a pass over the file, and leaves pages not yet needed
+        // on disk
+        bool Open(const std::string& path, bool verifyChecksum = true);
+        void Close();
+        bool IsOpen() const { return m_File.IsOpen(); }
+
+        uint32_t GetVersion() const;
+
+        int GetTableCount() const;
+        int FindTable(const std::string& name) const;      // -1 if missing
+        const char* GetTableName(int table) const;
+        uint32_t GetSchemaVersion(int table) const;
+        size_t GetRecordCount(int table) const;
+
+        // The records where they lie in the file, or nullptr when the table was saved with
+        // a different layout than `schema` (or is missing). Valid until Close().
+        const void* GetRecords(int table, const Schema& schema) const;
+        template <typename T>
+        const T* GetRecords(const std::string& name, const Schema& schema, size_t& count) const;
+
+        // Copies the records into `out` (GetRecordCount() records of schema.size bytes),
+        // converting them when the layout changed: fields are matched by name and their
+        // values converted to the new type; fields missing from the file keep their value in
+        // `defaults` (zero if null). Fails when the table is missing or is a blob.
+        bool ReadRecords(int table, const Schema& schema, void* out, const void* defaults = nullptr) const;
+        template <typename T>
+        bool ReadTable(const std::string& name, const Schema& schema, std::vector<T>& out, const T& defaults = T()) const;
+
+        // nullptr if missing or not a blob
+        const void* GetBlob(const std::string& name, size_t& size) const;
+
+    private:
+        MappedFile m_File;
+    };
+
+    template <typename T>
+    void BinaryWriter::AddTable(const std::string& name, const Schema& schema, const std::vector<T>& records) {
+        static_assert(std::is_trivially_copyable<T>::value, "records are stored byte for byte");
+        AddTable(name, schema, records.data(), records.size());
+    }
+
+    template <typename T>
+    const T* BinaryFile::GetRecords(const std::string& name, const Schema& schema, size_t& count) const {
+        static_assert(std::is_trivially_copyable<T>::value, "records are read in place");
+        const int table = FindTable(name);
+        const T* records = sizeof(T) == schema.size ? static_cast<const T*>(GetRecords(table, schema)) : nullptr;
+        count = records ? GetRecordCount(table) : 0;
+        return records;
+    }
+
+    template <typename T>
+    bool BinaryFile::ReadTable(const std::string& name, const Schema& schema, std::vector<T>& out, const T& defaults) const {
+        static_assert(std::is_trivially_copyable<T>::value, "records are copied byte for byte");
+        const int table = FindTable(name);
+        if (table < 0 || sizeof(T) != schema.size) return false;
+        out.resize(GetRecordCount(table));
+        return ReadRecords(table, schema, out.data(), &defaults);
+    }
+
+}
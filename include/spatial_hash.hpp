@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "collision.hpp"
+
+namespace ech {
+
+    // Uniform grid broadphase over the same (x, y, w, h) boxes CheckCollision uses. Boxes are
+    // bucketed by the grid cells they touch, so finding every overlapping pair costs roughly
+    // O(n) for scenes where objects are about the cell size, instead of O(n^2) pairwise checks.
+    //
+    // Insert/Move/Remove are cheap; the cell table is rebuilt lazily by the next query, and only
+    // when some box changed cells. Queries write into caller-provided buffers and reuse internal
+    // storage, so they don't allocate once warmed up.
+    //
+    // Pick a cell size close to the typical object size: much smaller and large objects land in
+    // many cells, much larger and each cell holds too many objects.
+    class SpatialHash {
+    public:
+        explicit SpatialHash(float cellSize = 64.0f);
+
+        void SetCellSize(float cellSize);
+        float GetCellSize() const { return m_CellSize; }
+
+        // Returns a handle for the box. Handles of removed boxes are reused.
+        int Insert(float x, float y, float w, float h);
+        void Move(int handle, float x, float y, float w, float h);
+        void Remove(int handle);
+        void Clear();
+
+        int Count() const { return m_Count; }
+        bool IsValid(int handle) const;
+
+        // Every pair of overlapping boxes, each reported once with a < b. Writes at most maxPairs
+        // and returns the total number found, so a caller can grow its buffer and ask again.
+        int FindOverlappingPairs(CollisionPair* pairs, int maxPairs);
+
+        // Handles of the boxes overlapping the given box. Same return convention as above.
+        int Query(float x, float y, float w, float h, int* handles, int maxHandles);
+
+    private:
+        struct Box {
+            float x, y, w, h;
+            int minCx, minCy, maxCx, maxCy;
+            bool alive;
+        };
+
+        struct CellEntry {
+            uint64_t cell;
+            int handle;
+        };
+
+        void CellRange(float x, float y, float w, float h, int& minCx, int& minCy, int& maxCx, int& maxCy) const;
+        void Rebuild();
+        uint32_t Bucket(uint64_t cell) const;
+
+        float m_CellSize;
+        float m_InvCellSize;
+        std::vector<Box> m_Boxes;
+        std::vector<int> m_FreeHandles;
+        int m_Count = 0;
+        bool m_Dirty = true;
+
+        // Cell entries counting-sorted by hash bucket; bucket i is [m_BucketStart[i], m_BucketStart[i + 1])
+        std::vector<CellEntry> m_Entries;
+        std::vector<CellEntry> m_Scratch;
+        std::vector<uint32_t> m_BucketStart;
+        uint32_t m_BucketMask = 0;
+
+        // Per-box stamp so a region query reports a box spanning several cells only once
+        std::vector<uint32_t> m_QueryStamp;
+        uint32_t m_QueryCounter = 0;
+    };
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ech {
+
+    class Tilemap;
+
+    enum TileShape : uint8_t {
+        TILE_EMPTY,
+        TILE_SOLID,
+        TILE_ONE_WAY,               // only stops boxes landing on it from above
+        // Floor slopes, named by the direction the floor rises. LOW/HIGH are the two tiles of a
+        // gentle slope that climbs one tile over two.
+        TILE_SLOPE_UP_RIGHT,
+        TILE_SLOPE_UP_LEFT,
+        TILE_SLOPE_UP_RIGHT_LOW,
+        TILE_SLOPE_UP_RIGHT_HIGH,
+        TILE_SLOPE_UP_LEFT_HIGH,
+        TILE_SLOPE_UP_LEFT_LOW
+    };
+
+    struct TileMoveResult {
+        float x = 0.0f, y = 0.0f;   // final position
+        bool hitX = false;          // blocked by a wall
+        bool hitY = false;          // blocked by a floor or ceiling
+        bool onGround = false;      // standing on a floor, platform or slope
+    };
+
+    // Collision layer for a tile grid. Solid and one-way tiles are kept as packed bitsets,
+    // both per row and per column, so a box query tests 64 tiles per word and a sweep finds
+    // the first blocking tile with a bit scan: the cost depends on the box and the distance,
+    // never on the size of the map.
+    //
+    // Boxes follow CheckCollision: (x, y, w, h) with y down, and touching edges don't count.
+    // Tiles outside the grid are empty.
+    class TileCollision {
+    public:
+        TileCollision();
+        TileCollision(int width, int height, float tileWidth, float tileHeight);
+
+        // Size in tiles and the world size of one tile. All tiles start empty.
+        bool Create(int width, int height, float tileWidth, float tileHeight);
+        // Sized and positioned like the tilemap; shapes[i] is the shape of tileset index i
+        bool Build(const Tilemap& map, const TileShape* shapes, int shapeCount);
+
+        // World position of the grid's top-left corner
+        void SetPosition(float x, float y);
+
+        void SetTile(int x, int y, TileShape shape);
+        TileShape GetTile(int x, int y) const;
+
+        // Whether any TILE_SOLID tile overlaps the box. One-way and slope tiles don't count.
+        bool OverlapsSolid(float x, float y, float w, float h) const;
+
+        // How far the box can move along one axis (between 0 and dx / dy) before touching a
+        // solid tile. Tiles the box already overlaps are ignored, so it can always get out.
+        float SweepX(float x, float y, float w, float h, float dx) const;
+        // Moving down, one-way tiles the box starts above block as well, unless dropThrough
+        float SweepY(float x, float y, float w, float h, float dy, bool dropThrough = false) const;
+
+        // Floor height of the slope tile containing the world point, if it is a slope
+        bool GetSlopeSurface(float x, float y, float& surfaceY) const;
+
+        // Platformer movement: x first, then y, then the bottom center of the box is settled
+        // on any slope under it. Walking down a slope keeps the box on it.
+        TileMoveResult Move(float x, float y, float w, float h, float dx, float dy, bool dropThrough = false) const;
+
+        int Width() const { return m_Width; }
+        int Height() const { return m_Height; }
+
+    private:
+        void SetBit(std::vector<uint64_t>& rows, std::vector<uint64_t>& columns, int x, int y, bool set);
+        bool SlopeSurface(int tx, int ty, float localX, float& surfaceY) const;
+        bool StandsOnSlope(float footX, float bottom) const;
+
+        std::vector<uint8_t> m_Shapes;
+        std::vector<uint64_t> m_SolidRows, m_SolidColumns;
+        std::vector<uint64_t> m_OneWayRows, m_OneWayColumns;
+        int m_RowWords = 0, m_ColumnWords = 0;
+        int m_Width = 0, m_Height = 0;
+        float m_TileWidth = 0.0f, m_TileHeight = 0.0f;
+        float m_X = 0.0f, m_Y = 0.0f;
+    };
+
+}
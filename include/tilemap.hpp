@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+
+namespace ech {
+
+    // Grid of tiles drawn from one tileset texture. The geometry of each ChunkSize x ChunkSize
+    // block of tiles is built once into its own static vertex buffer and rebuilt only after
+    // one of its tiles changes; Draw() skips chunks outside the current view, so a screen full
+    // of tiles costs one draw call per visible chunk.
+    //
+    // Tiles are indices into the tileset, counted left to right, top to bottom; EmptyTile
+    // draws nothing. Several maps over the same area make layers.
+    class Tilemap {
+    public:
+        static constexpr int ChunkSize = 32;
+        static constexpr int EmptyTile = -1;
+
+        Tilemap();
+        Tilemap(int width, int height, float tileWidth, float tileHeight);
+        ~Tilemap();
+
+        Tilemap(const Tilemap&) = delete;
+        Tilemap& operator=(const Tilemap&) = delete;
+
+        // Size in tiles and the world size of one tile. All tiles start empty.
+        bool Create(int width, int height, float tileWidth, float tileHeight);
+        void Destroy();
+
+        // Tile images are tileWidth x tileHeight pixels, `margin` pixels in from the texture
+        // edge and `spacing` pixels apart. The texture size is read back from GL.
+        bool SetTileset(unsigned int texture, int tileWidth, int tileHeight, int margin = 0, int spacing = 0);
+        unsigned int GetTileset() const { return m_Texture; }
+        int GetTilesetColumns() const { return m_Columns; }
+
+        void SetTile(int x, int y, int tile);
+        int GetTile(int x, int y) const;
+        // Copies width * height tiles, row by row, into the map starting at (x, y)
+        void SetTiles(int x, int y, int width, int height, const int* tiles);
+        void Fill(int tile);
+
+        // World position of the map's top-left corner
+        void SetPosition(float x, float y);
+        float GetX() const { return m_X; }
+        float GetY() const { return m_Y; }
+
+        int Width() const { return m_Width; }
+        int Height() const { return m_Height; }
+        float TileWidth() const { return m_TileWidth; }
+        float TileHeight() const { return m_TileHeight; }
+        bool IsValid() const { return m_Width > 0; }
+
+        // Draws the chunks that intersect the view of the current projection and camera,
+        // rebuilding dirty ones first
+        void Draw();
+        // Draws the chunks that intersect a world-space rectangle
+        void Draw(float viewX, float viewY, float viewW, float viewH);
+
+        int GetChunkCount() const { return (int)m_Chunks.size(); }
+        int GetDrawnChunkCount() const { return m_DrawnChunks; }   // in the last Draw()
+
+    private:
+        struct Chunk {
+            unsigned int vao = 0, vbo = 0;
+            int quadCount = 0;
+            bool dirty = true;
+        };
+
+        void MarkDirty(int x, int y);
+        void BuildChunk(int cx, int cy);
+        void DestroyChunks();
+
+        std::vector<int> m_Tiles;
+        std::vector<Chunk> m_Chunks;
+        std::vector<float> m_Scratch;   // vertex data of the chunk being built
+        int m_Width = 0, m_Height = 0;
+        int m_ChunksX = 0, m_ChunksY = 0;
+        float m_TileWidth = 0.0f, m_TileHeight = 0.0f;
+        float m_X = 0.0f, m_Y = 0.0f;
+
+        unsigned int m_Texture = 0;
+        int m_TextureWidth = 0, m_TextureHeight = 0;
+        int m_SourceWidth = 0, m_SourceHeight = 0;
+        int m_Margin = 0, m_Spacing = 0;
+        int m_Columns = 0, m_TileCount = 0;
+
+        int m_DrawnChunks = 0;
+    };
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <memory>
 #include <glm/glm.hpp>
 
 
@@ -7,12 +8,24 @@ struct GLFWwindow;
 
 namespace ech {
 
+    class RenderTarget;
+
     class Window {
     public:
-        Window(int width, int height, const char* title);
+        // headless = true creates an invisible window (or a surfaceless EGL/OSMesa context when
+        // GLFW supports the null platform) and renders into an offscreen framebuffer instead.
+        Window(int width, int height, const char* title, bool headless = false);
         ~Window();
 
         bool ShouldClose() const;
+        bool IsHeadless() const { return m_Headless; }
+
+        // Size of what is actually rendered to (offscreen target when headless)
+        void GetFramebufferSize(int& width, int& height) const;
+        // Framebuffer that StartDrawing renders into (0 = the window's default framebuffer)
+        unsigned int GetFramebuffer() const;
+        // Bind GetFramebuffer() and reset the viewport to it
+        void BindDefaultFramebuffer() const;
 
         GLFWwindow* GetNative() const { return m_Window; }
          
@@ -28,6 +41,8 @@ namespace ech {
         GLFWwindow* m_Window = nullptr;
         int m_Width = 0;
         int m_Height = 0;
+        bool m_Headless = false;
+        std::unique_ptr<RenderTarget> m_Offscreen;
 
         glm::mat4 m_Projection{};
         glm::mat4 m_View{};
@@ -0,0 +1,475 @@
+#include "aabb_tree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ech {
+
+    namespace {
+
+        // Extra stretch applied to the displacement passed to Move, so a body moving at a steady
+        // speed stays inside its fat box for a few frames
+        constexpr float DisplacementMultiplier = 2.0f;
+
+        template <typename B>
+        inline B Union(const B& a, const B& b) {
+            return { std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY) };
+        }
+
+        template <typename B>
+        inline float Perimeter(const B& b) {
+            return 2.0f * ((b.maxX - b.minX) + (b.maxY - b.minY));
+        }
+
+        template <typename B>
+        inline bool Contains(const B& outer, const B& inner) {
+            return outer.minX <= inner.minX && outer.minY <= inner.minY && outer.maxX >= inner.maxX && outer.maxY >= inner.maxY;
+        }
+
+        // Inclusive test for pruning fat boxes
+        template <typename B>
+        inline bool Touches(const B& a, const B& b) {
+            return a.minX <= b.maxX && a.maxX >= b.minX && a.minY <= b.maxY && a.maxY >= b.minY;
+        }
+
+        // Same test as CheckCollision: touching edges don't count
+        template <typename B>
+        inline bool Overlaps(const B& a, const B& b) {
+            return a.minX < b.maxX && a.maxX > b.minX && a.minY < b.maxY && a.maxY > b.minY;
+        }
+
+        // Inclusive slab test of the segment p + t * d, t in [0, maxT], for pruning fat boxes.
+        // Leaves use RaycastAABB for the exact hit.
+        template <typename B>
+        bool SegmentTouches(const B& b, float px, float py, float dx, float dy, float maxT) {
+            float tmin = 0.0f, tmax = maxT;
+            const float p[2] = { px, py };
+            const float d[2] = { dx, dy };
+            const float lo[2] = { b.minX, b.minY };
+            const float hi[2] = { b.maxX, b.maxY };
+            for (int axis = 0; axis < 2; ++axis) {
+                if (std::fabs(d[axis]) < 1e-12f) {
+                    if (p[axis] < lo[axis] || p[axis] > hi[axis]) return false;
+                    continue;
+                }
+                float inv = 1.0f / d[axis];
+                float t1 = (lo[axis] - p[axis]) * inv;
+                float t2 = (hi[axis] - p[axis]) * inv;
+                if (t1 > t2) std::swap(t1, t2);
+                tmin = std::max(tmin, t1);
+                tmax = std::min(tmax, t2);
+                if (tmin > tmax) return false;
+            }
+            return true;
+        }
+
+    }
+
+    AABBTree::AABBTree(float fatMargin)
+        : m_Margin(std::max(0.0f, fatMargin)) {
+    }
+
+    int AABBTree::AllocateNode() {
+        if (m_FreeList == Null) {
+            m_Nodes.push_back({});
+            m_Nodes.back().parent = Null;
+            m_Nodes.back().height = -1;
+            m_FreeList = (int)m_Nodes.size() - 1;
+        }
+
+        int node = m_FreeList;
+        Node& n = m_Nodes[node];
+        m_FreeList = n.parent;
+        n.parent = Null;
+        n.child1 = Null;
+        n.child2 = Null;
+        n.height = 0;
+        n.userData = 0;
+        return node;
+    }
+
+    void AABBTree::FreeNode(int node) {
+        m_Nodes[node].parent = m_FreeList;
+        m_Nodes[node].height = -1;
+        m_FreeList = node;
+    }
+
+    int AABBTree::Insert(float x, float y, float w, float h, int userData) {
+        int proxy = AllocateNode();
+        Node& n = m_Nodes[proxy];
+        n.tight = { x, y, x + w, y + h };
+        n.fat = { x - m_Margin, y - m_Margin, x + w + m_Margin, y + h + m_Margin };
+        n.userData = userData;
+        InsertLeaf(proxy);
+        m_LeafCount++;
+        return proxy;
+    }
+
+    bool AABBTree::Move(int proxy, float x, float y, float w, float h, float dx, float dy) {
+        if (proxy < 0 || proxy >= (int)m_Nodes.size() || !m_Nodes[proxy].IsLeaf() || m_Nodes[proxy].height != 0) return false;
+        Node& n = m_Nodes[proxy];
+        n.tight = { x, y, x + w, y + h };
+
+        Bounds fat = { x - m_Margin, y - m_Margin, x + w + m_Margin, y + h + m_Margin };
+        dx *= DisplacementMultiplier;
+        dy *= DisplacementMultiplier;
+        if (dx < 0.0f) fat.minX += dx; else fat.maxX += dx;
+        if (dy < 0.0f) fat.minY += dy; else fat.maxY += dy;
+
+        if (Contains(n.fat, n.tight)) {
+            // Still inside: keep the old fat box unless it has become much larger than needed,
+            // e.g. after a fast mover slowed down
+            Bounds huge = { fat.minX - 4.0f * m_Margin, fat.minY - 4.0f * m_Margin,
+                            fat.maxX + 4.0f * m_Margin, fat.maxY + 4.0f * m_Margin };
+            if (Contains(huge, n.fat)) return false;
+        }
+
+        RemoveLeaf(proxy);
+        m_Nodes[proxy].fat = fat;
+        InsertLeaf(proxy);
+        return true;
+    }
+
+    void AABBTree::Remove(int proxy) {
+        if (proxy < 0 || proxy >= (int)m_Nodes.size() || !m_Nodes[proxy].IsLeaf() || m_Nodes[proxy].height != 0) return;
+        RemoveLeaf(proxy);
+        FreeNode(proxy);
+        m_LeafCount--;
+    }
+
+    void AABBTree::Clear() {
+        m_Nodes.clear();
+        m_Root = Null;
+        m_FreeList = Null;
+        m_LeafCount = 0;
+    }
+
+    int AABBTree::GetUserData(int proxy) const {
+        return (proxy >= 0 && proxy < (int)m_Nodes.size()) ? m_Nodes[proxy].userData : 0;
+    }
+
+    void AABBTree::SetUserData(int proxy, int userData) {
+        if (proxy >= 0 && proxy < (int)m_Nodes.size()) m_Nodes[proxy].userData = userData;
+    }
+
+    int AABBTree::GetHeight() const {
+        return m_Root == Null ? 0 : m_Nodes[m_Root].height;
+    }
+
+    void AABBTree::InsertLeaf(int leaf) {
+        if (m_Root == Null) {
+            m_Root = leaf;
+            m_Nodes[leaf].parent = Null;
+            return;
+        }
+
+        // Walk down toward the sibling that grows the total perimeter the least. Perimeter is
+        // the 2D stand-in for the surface area heuristic.
+        const Bounds leafBounds = m_Nodes[leaf].fat;
+        int index = m_Root;
+        while (!m_Nodes[index].IsLeaf()) {
+            const Node& node = m_Nodes[index];
+            const float area = Perimeter(node.fat);
+            const float combined = Perimeter(Union(node.fat, leafBounds));
+
+            // Cost of making a new parent for this node and the leaf, and the cost pushed down
+            // onto every ancestor if we descend further instead
+            const float cost = 2.0f * combined;
+            const float inheritance = 2.0f * (combined - area);
+
+            auto childCost = [&](int child) {
+                const Node& c = m_Nodes[child];
+                float grown = Perimeter(Union(leafBounds, c.fat));
+                return (c.IsLeaf() ? grown : grown - Perimeter(c.fat)) + inheritance;
+            };
+            const float cost1 = childCost(node.child1);
+            const float cost2 = childCost(node.child2);
+
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        const int sibling = index;
+        const int oldParent = m_Nodes[sibling].parent;
+        const int newParent = AllocateNode();   // may grow the pool, so no references across this
+        m_Nodes[newParent].parent = oldParent;
+        m_Nodes[newParent].fat = Union(leafBounds, m_Nodes[sibling].fat);
+        m_Nodes[newParent].height = m_Nodes[sibling].height + 1;
+        m_Nodes[newParent].child1 = sibling;
+        m_Nodes[newParent].child2 = leaf;
+        m_Nodes[sibling].parent = newParent;
+        m_Nodes[leaf].parent = newParent;
+
+        if (oldParent != Null) {
+            if (m_Nodes[oldParent].child1 == sibling) m_Nodes[oldParent].child1 = newParent;
+            else m_Nodes[oldParent].child2 = newParent;
+        }
+        else {
+            m_Root = newParent;
+        }
+
+        // Refit and rebalance back up to the root
+        index = m_Nodes[leaf].parent;
+        while (index != Null) {
+            index = Balance(index);
+            Node& node = m_Nodes[index];
+            node.height = 1 + std::max(m_Nodes[node.child1].height, m_Nodes[node.child2].height);
+            node.fat = Union(m_Nodes[node.child1].fat, m_Nodes[node.child2].fat);
+            index = node.parent;
+        }
+    }
+
+    void AABBTree::RemoveLeaf(int leaf) {
+        if (leaf == m_Root) {
+            m_Root = Null;
+            return;
+        }
+
+        const int parent = m_Nodes[leaf].parent;
+        const int grandParent = m_Nodes[parent].parent;
+        const int sibling = m_Nodes[parent].child1 == leaf ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+        if (grandParent == Null) {
+            m_Root = sibling;
+            m_Nodes[sibling].parent = Null;
+            FreeNode(parent);
+            return;
+        }
+
+        // The sibling takes the parent's place
+        if (m_Nodes[grandParent].child1 == parent) m_Nodes[grandParent].child1 = sibling;
+        else m_Nodes[grandParent].child2 = sibling;
+        m_Nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+
+        int index = grandParent;
+        while (index != Null) {
+            index = Balance(index);
+            Node& node = m_Nodes[index];
+            node.fat = Union(m_Nodes[node.child1].fat, m_Nodes[node.child2].fat);
+            node.height = 1 + std::max(m_Nodes[node.child1].height, m_Nodes[node.child2].height);
+            index = node.parent;
+        }
+    }
+
+    // If one child of A is more than one level taller than the other, rotate it up into A's place.
+    // Returns the node now at A's position.
+    int AABBTree::Balance(int iA) {
+        Node& A = m_Nodes[iA];
+        if (A.IsLeaf() || A.height < 2) return iA;
+
+        const int iB = A.child1;
+        const int iC = A.child2;
+        Node& B = m_Nodes[iB];
+        Node& C = m_Nodes[iC];
+        const int balance = C.height - B.height;
+
+        auto replaceInParent = [&](int oldChild, int newChild, int parent) {
+            if (parent == Null) {
+                m_Root = newChild;
+                return;
+            }
+            if (m_Nodes[parent].child1 == oldChild) m_Nodes[parent].child1 = newChild;
+            else m_Nodes[parent].child2 = newChild;
+        };
+
+        if (balance > 1) {
+            // Rotate C up: A takes C's shorter child, C takes A's place
+            const int iF = C.child1;
+            const int iG = C.child2;
+            Node& F = m_Nodes[iF];
+            Node& G = m_Nodes[iG];
+
+            C.child1 = iA;
+            C.parent = A.parent;
+            A.parent = iC;
+            replaceInParent(iA, iC, C.parent);
+
+            if (F.height > G.height) {
+                C.child2 = iF;
+                A.child2 = iG;
+                G.parent = iA;
+                A.fat = Union(B.fat, G.fat);
+                C.fat = Union(A.fat, F.fat);
+                A.height = 1 + std::max(B.height, G.height);
+                C.height = 1 + std::max(A.height, F.height);
+            }
+            else {
+                C.child2 = iG;
+                A.child2 = iF;
+                F.parent = iA;
+                A.fat = Union(B.fat, F.fat);
+                C.fat = Union(A.fat, G.fat);
+                A.height = 1 + std::max(B.height, F.height);
+                C.height = 1 + std::max(A.height, G.height);
+            }
+            return iC;
+        }
+
+        if (balance < -1) {
+            // Rotate B up
+            const int iD = B.child1;
+            const int iE = B.child2;
+            Node& D = m_Nodes[iD];
+            Node& E = m_Nodes[iE];
+
+            B.child1 = iA;
+            B.parent = A.parent;
+            A.parent = iB;
+            replaceInParent(iA, iB, B.parent);
+
+            if (D.height > E.height) {
+                B.child2 = iD;
+                A.child1 = iE;
+                E.parent = iA;
+                A.fat = Union(C.fat, E.fat);
+                B.fat = Union(A.fat, D.fat);
+                A.height = 1 + std::max(C.height, E.height);
+                B.height = 1 + std::max(A.height, D.height);
+            }
+            else {
+                B.child2 = iE;
+                A.child1 = iD;
+                D.parent = iA;
+                A.fat = Union(C.fat, D.fat);
+                B.fat = Union(A.fat, E.fat);
+                A.height = 1 + std::max(C.height, D.height);
+                B.height = 1 + std::max(A.height, E.height);
+            }
+            return iB;
+        }
+
+        return iA;
+    }
+
+    int AABBTree::Query(float x, float y, float w, float h, int* proxies, int maxProxies) {
+        if (m_Root == Null) return 0;
+        const Bounds query = { x, y, x + w, y + h };
+
+        int found = 0;
+        m_Stack.clear();
+        m_Stack.push_back(m_Root);
+        while (!m_Stack.empty()) {
+            const int index = m_Stack.back();
+            m_Stack.pop_back();
+            const Node& node = m_Nodes[index];
+            if (!Touches(node.fat, query)) continue;
+
+            if (node.IsLeaf()) {
+                if (!Overlaps(node.tight, query)) continue;
+                if (found < maxProxies) proxies[found] = index;
+                found++;
+            }
+            else {
+                m_Stack.push_back(node.child1);
+                m_Stack.push_back(node.child2);
+            }
+        }
+        return found;
+    }
+
+    int AABBTree::FindOverlappingPairs(CollisionPair* pairs, int maxPairs) {
+        if (m_Root == Null) return 0;
+
+        // Query the tree with every leaf, keeping only partners with a higher index so each pair
+        // comes out once
+        int found = 0;
+        for (int leaf = 0; leaf < (int)m_Nodes.size(); ++leaf) {
+            if (m_Nodes[leaf].height != 0) continue;
+            const Bounds box = m_Nodes[leaf].tight;
+
+            m_Stack.clear();
+            m_Stack.push_back(m_Root);
+            while (!m_Stack.empty()) {
+                const int index = m_Stack.back();
+                m_Stack.pop_back();
+                const Node& node = m_Nodes[index];
+                if (!Touches(node.fat, box)) continue;
+
+                if (node.IsLeaf()) {
+                    if (index <= leaf || !Overlaps(node.tight, box)) continue;
+                    if (found < maxPairs) pairs[found] = { leaf, index };
+                    found++;
+                }
+                else {
+                    m_Stack.push_back(node.child1);
+                    m_Stack.push_back(node.child2);
+                }
+            }
+        }
+        return found;
+    }
+
+    bool AABBTree::RaycastLeaf(int leaf, float x1, float y1, float x2, float y2, float maxT, RaycastHit& hit) const {
+        const Bounds& b = m_Nodes[leaf].tight;
+        SweepHit sweep;
+        if (!RaycastAABB(x1, y1, x2, y2, b.minX, b.minY, b.maxX - b.minX, b.maxY - b.minY, sweep)) return false;
+        if (sweep.time > maxT) return false;
+        hit.proxy = leaf;
+        hit.t = sweep.time;
+        hit.x = x1 + (x2 - x1) * sweep.time;
+        hit.y = y1 + (y2 - y1) * sweep.time;
+        hit.normalX = sweep.normalX;
+        hit.normalY = sweep.normalY;
+        return true;
+    }
+
+    bool AABBTree::Raycast(float x1, float y1, float x2, float y2, RaycastHit& hit) {
+        if (m_Root == Null) return false;
+        const float dx = x2 - x1, dy = y2 - y1;
+
+        // Every hit shortens the segment, pruning everything behind it
+        float maxT = 1.0f;
+        bool any = false;
+        m_Stack.clear();
+        m_Stack.push_back(m_Root);
+        while (!m_Stack.empty()) {
+            const int index = m_Stack.back();
+            m_Stack.pop_back();
+            const Node& node = m_Nodes[index];
+
+            if (!SegmentTouches(node.fat, x1, y1, dx, dy, maxT)) continue;
+
+            if (node.IsLeaf()) {
+                if (RaycastLeaf(index, x1, y1, x2, y2, maxT, hit)) {
+                    maxT = hit.t;
+                    any = true;
+                }
+            }
+            else {
+                m_Stack.push_back(node.child1);
+                m_Stack.push_back(node.child2);
+            }
+        }
+        return any;
+    }
+
+    int AABBTree::RaycastAll(float x1, float y1, float x2, float y2, RaycastHit* hits, int maxHits) {
+        if (m_Root == Null) return 0;
+        const float dx = x2 - x1, dy = y2 - y1;
+
+        int found = 0;
+        m_Stack.clear();
+        m_Stack.push_back(m_Root);
+        while (!m_Stack.empty()) {
+            const int index = m_Stack.back();
+            m_Stack.pop_back();
+            const Node& node = m_Nodes[index];
+
+            if (!SegmentTouches(node.fat, x1, y1, dx, dy, 1.0f)) continue;
+
+            if (node.IsLeaf()) {
+                RaycastHit hit;
+                if (!RaycastLeaf(index, x1, y1, x2, y2, 1.0f, hit)) continue;
+                if (found < maxHits) hits[found] = hit;
+                found++;
+            }
+            else {
+                m_Stack.push_back(node.child1);
+                m_Stack.push_back(node.child2);
+            }
+        }
+        return found;
+    }
+
+}
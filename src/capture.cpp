@@ -0,0 +1,383 @@
+#include "capture.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stb_image_write.h>
+
+#include "internal.hpp"
+#include "graphics_internal.hpp"
+
+namespace ech {
+
+    namespace {
+
+        // Frames stay in flight this many frames before we map them, which is enough for the
+        // GPU to have finished the copy without us ever waiting on it.
+        constexpr int ReadbackRingSize = 3;
+        // 1080p RGBA is ~8 MB, so this caps the writer backlog at ~64 MB
+        constexpr size_t MaxQueuedFrames = 8;
+
+        struct ReadbackSlot {
+            unsigned int pbo = 0;
+            GLsync fence = nullptr;
+            bool busy = false;
+            bool recorded = false;          // part of the recording (vs. screenshot only)
+            long long frameIndex = 0;
+            std::vector<std::string> screenshots;
+        };
+
+        struct WriteJob {
+            std::vector<unsigned char> pixels;  // bottom row first, as GL returns it
+            int width = 0;
+            int height = 0;
+            std::string path;                   // PNG destination; empty = append to the raw stream
+        };
+
+        struct CaptureState {
+            // --- GL side (main thread only) ---
+            ReadbackSlot slots[ReadbackRingSize];
+            int nextSlot = 0;
+            int width = 0;
+            int height = 0;
+            std::vector<std::string> pendingScreenshots;
+
+            bool recording = false;
+            CaptureFormat format = CAPTURE_RAW_RGBA;
+            std::string path;
+            long long frameCounter = 0;
+
+            // --- writer threads ---
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable idle;
+            std::deque<WriteJob> queue;
+            std::vector<std::vector<unsigned char>> freeBuffers;
+            std::vector<std::thread> writers;
+            int busyWriters = 0;
+            bool stopWriters = false;
+            FILE* rawFile = nullptr;
+
+            std::atomic<int> framesRequested{ 0 };
+            std::atomic<int> framesWritten{ 0 };
+            std::atomic<int> framesDropped{ 0 };
+
+            ~CaptureState() { StopWriters(); }
+
+            void StopWriters() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopWriters = true;
+                }
+                wake.notify_all();
+                for (std::thread& t : writers) t.join();
+                writers.clear();
+                stopWriters = false;
+
+                if (rawFile) {
+                    std::fclose(rawFile);
+                    rawFile = nullptr;
+                }
+            }
+        };
+
+        CaptureState& State() {
+            static CaptureState state;
+            return state;
+        }
+
+        void WritePNG(const WriteJob& job) {
+            // Flip into top-down order for the PNG
+            const size_t stride = (size_t)job.width * 4;
+            std::vector<unsigned char> flipped(job.pixels.size());
+            for (int y = 0; y < job.height; ++y) {
+                std::memcpy(flipped.data() + y * stride, job.pixels.data() + (job.height - 1 - y) * stride, stride);
+            }
+            if (!stbi_write_png(job.path.c_str(), job.width, job.height, 4, flipped.data(), (int)stride)) {
+                std::cerr << "Capture: failed to write " << job.path << std::endl;
+            }
+        }
+
+        void WriteRaw(CaptureState& state, const WriteJob& job) {
+            if (!state.rawFile) return;
+            const size_t stride = (size_t)job.width * 4;
+            for (int y = job.height - 1; y >= 0; --y) {
+                std::fwrite(job.pixels.data() + y * stride, 1, stride, state.rawFile);
+            }
+        }
+
+        void WriterLoop(CaptureState& state) {
+            for (;;) {
+                WriteJob job;
+                {
+                    std::unique_lock<std::mutex> lock(state.mutex);
+                    state.wake.wait(lock, [&] { return state.stopWriters || !state.queue.empty(); });
+                    if (state.queue.empty()) return; // stopping and nothing left to write
+
+                    job = std::move(state.queue.front());
+                    state.queue.pop_front();
+                    state.busyWriters++;
+                }
+
+                if (job.path.empty()) WriteRaw(state, job);
+                else WritePNG(job);
+                state.framesWritten++;
+
+                {
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    state.freeBuffers.push_back(std::move(job.pixels));
+                    state.busyWriters--;
+                }
+                state.idle.notify_all();
+            }
+        }
+
+        void EnsureWriters(CaptureState& state, int count) {
+            while ((int)state.writers.size() < count) {
+                state.writers.emplace_back(WriterLoop, std::ref(state));
+            }
+        }
+
+        // Called with the pixels of one finished readback
+        void QueueJobs(CaptureState& state, ReadbackSlot& slot, const unsigned char* pixels) {
+            const size_t bytes = (size_t)state.width * state.height * 4;
+
+            auto makeJob = [&](std::string path) {
+                WriteJob job;
+                {
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    if (!state.freeBuffers.empty()) {
+                        job.pixels = std::move(state.freeBuffers.back());
+                        state.freeBuffers.pop_back();
+                    }
+                }
+                job.pixels.resize(bytes);
+                std::memcpy(job.pixels.data(), pixels, bytes);
+                job.width = state.width;
+                job.height = state.height;
+                job.path = std::move(path);
+                return job;
+            };
+
+            std::vector<WriteJob> jobs;
+            for (std::string& shot : slot.screenshots) jobs.push_back(makeJob(std::move(shot)));
+            slot.screenshots.clear();
+
+            if (slot.recorded) {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (state.queue.size() >= MaxQueuedFrames) {
+                    // Disk can't keep up: drop the frame rather than stall the game
+                    state.framesDropped++;
+                    slot.recorded = false;
+                }
+            }
+            if (slot.recorded) {
+                std::string path;
+                if (state.format == CAPTURE_PNG_SEQUENCE) {
+                    char suffix[32];
+                    std::snprintf(suffix, sizeof(suffix), "_%06lld.png", slot.frameIndex);
+                    path = state.path + suffix;
+                }
+                jobs.push_back(makeJob(std::move(path)));
+            }
+            if (jobs.empty()) return;
+
+            EnsureWriters(state, 1);
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                for (WriteJob& job : jobs) state.queue.push_back(std::move(job));
+            }
+            state.wake.notify_all();
+        }
+
+        // Map every readback whose fence has signaled, oldest first. With `wait` we block until
+        // all of them are done (used when stopping or resizing).
+        void CollectReadbacks(CaptureState& state, bool wait) {
+            for (int i = 0; i < ReadbackRingSize; ++i) {
+                ReadbackSlot& slot = state.slots[(state.nextSlot + i) % ReadbackRingSize];
+                if (!slot.busy) continue;
+
+                GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                    wait ? 1000000000ull : 0);
+                if (status == GL_TIMEOUT_EXPIRED) {
+                    if (wait) continue;
+                    break; // keep frames in order: later slots can't be done before this one
+                }
+
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+                slot.busy = false;
+                if (status == GL_WAIT_FAILED) continue;
+
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+                const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                    (GLsizeiptr)state.width * state.height * 4, GL_MAP_READ_BIT);
+                if (mapped) {
+                    QueueJobs(state, slot, static_cast<const unsigned char*>(mapped));
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+        }
+
+        void DestroySlots(CaptureState& state) {
+            for (ReadbackSlot& slot : state.slots) {
+                if (slot.fence) glDeleteSync(slot.fence);
+                if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+                slot = ReadbackSlot{};
+            }
+            state.nextSlot = 0;
+            state.width = 0;
+            state.height = 0;
+        }
+
+        void CreateSlots(CaptureState& state, int width, int height) {
+            state.width = width;
+            state.height = height;
+            for (ReadbackSlot& slot : state.slots) {
+                glGenBuffers(1, &slot.pbo);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+                glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        bool AnyReadbackInFlight(const CaptureState& state) {
+            for (const ReadbackSlot& slot : state.slots)
+                if (slot.busy) return true;
+            return false;
+        }
+
+    }
+
+    void TakeScreenshot(const std::string& path) {
+        State().pendingScreenshots.push_back(path);
+    }
+
+    bool StartRecording(const std::string& path, CaptureFormat format) {
+        CaptureState& state = State();
+        if (state.recording) StopRecording();
+
+        if (format == CAPTURE_RAW_RGBA) {
+            state.rawFile = std::fopen(path.c_str(), "wb");
+            if (!state.rawFile) {
+                std::cerr << "Capture: failed to open " << path << std::endl;
+                return false;
+            }
+        }
+
+        state.recording = true;
+        state.format = format;
+        state.path = path;
+        state.frameCounter = 0;
+        state.framesRequested = 0;
+        state.framesWritten = 0;
+        state.framesDropped = 0;
+
+        // Raw frames must hit the file in order, so only PNG encoding fans out
+        int writers = 1;
+        if (format == CAPTURE_PNG_SEQUENCE) {
+            unsigned int cores = std::thread::hardware_concurrency();
+            writers = std::clamp((int)(cores / 2), 1, 4);
+        }
+        EnsureWriters(state, writers);
+        return true;
+    }
+
+    void StopRecording() {
+        CaptureState& state = State();
+        if (!state.recording) return;
+
+        CollectReadbacks(state, true);
+        state.recording = false;
+
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.idle.wait(lock, [&] { return state.queue.empty() && state.busyWriters == 0; });
+        }
+        state.StopWriters();
+    }
+
+    bool IsRecording() {
+        return State().recording;
+    }
+
+    CaptureStats GetCaptureStats() {
+        CaptureState& state = State();
+        CaptureStats stats;
+        stats.framesRequested = state.framesRequested;
+        stats.framesWritten = state.framesWritten;
+        stats.framesDropped = state.framesDropped;
+        stats.width = state.width;
+        stats.height = state.height;
+        return stats;
+    }
+
+    void UpdateFrameCapture() {
+        CaptureState& state = State();
+        const bool wantFrame = state.recording || !state.pendingScreenshots.empty();
+        if (!wantFrame && !AnyReadbackInFlight(state)) return;
+
+        CollectReadbacks(state, false);
+        if (!wantFrame) return;
+
+        Window* window = GetDefaultWindow();
+        if (!window) return;
+        int w, h;
+        window->GetFramebufferSize(w, h);
+        if (w <= 0 || h <= 0) return;
+
+        if (w != state.width || h != state.height) {
+            CollectReadbacks(state, true);
+            DestroySlots(state);
+            CreateSlots(state, w, h);
+        }
+
+        if (state.recording) state.framesRequested++;
+
+        ReadbackSlot& slot = state.slots[state.nextSlot];
+        if (slot.busy) {
+            // The GPU is more than a ring behind; skip this frame instead of waiting on it
+            if (state.recording) state.framesDropped++;
+            return;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.busy = true;
+        slot.recorded = state.recording;
+        slot.frameIndex = state.recording ? state.frameCounter++ : 0;
+        slot.screenshots.swap(state.pendingScreenshots);
+        state.pendingScreenshots.clear();
+
+        state.nextSlot = (state.nextSlot + 1) % ReadbackRingSize;
+    }
+
+    void ShutdownFrameCapture() {
+        CaptureState& state = State();
+        StopRecording();
+
+        // Screenshots still in flight are worth the wait at shutdown
+        CollectReadbacks(state, true);
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.idle.wait(lock, [&] { return state.queue.empty() && state.busyWriters == 0; });
+        }
+        state.StopWriters();
+        DestroySlots(state);
+    }
+
+}
@@ -0,0 +1,251 @@
+#include "collision.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ECH_COLLISION_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define ECH_COLLISION_X86 0
+#endif
+
+// GCC/Clang only emit AVX2 code inside functions marked for it; MSVC accepts the intrinsics anywhere
+#if ECH_COLLISION_X86 && (defined(__GNUC__) || defined(__clang__))
+#define ECH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ECH_TARGET_AVX2
+#endif
+
+namespace ech {
+
+    namespace {
+
+        // Query box as edges. The kernels evaluate exactly CheckCollision's expressions
+        // (ax < bx + bw, ax + aw > bx, ...) so results match it bit for bit.
+        struct QueryBox {
+            float x, y, right, bottom;
+        };
+
+        using MaskKernel = void (*)(const QueryBox& q, const BoxArray& boxes, int begin, int end, uint64_t* mask);
+
+        inline bool OverlapsScalar(const QueryBox& q, float x, float y, float w, float h) {
+            return (x < q.right) && (x + w > q.x) && (y < q.bottom) && (y + h > q.y);
+        }
+
+        // All kernels fill the bits for boxes [begin, end) into mask[0..], bit 0 being box `begin`.
+        // Whole words are overwritten.
+        void MaskScalar(const QueryBox& q, const BoxArray& b, int begin, int end, uint64_t* mask) {
+            for (int base = begin; base < end; base += 64) {
+                const int n = std::min(64, end - base);
+                uint64_t word = 0;
+                for (int i = 0; i < n; ++i) {
+                    const int k = base + i;
+                    word |= (uint64_t)OverlapsScalar(q, b.x[k], b.y[k], b.w[k], b.h[k]) << i;
+                }
+                mask[(base - begin) >> 6] = word;
+            }
+        }
+
+#if ECH_COLLISION_X86
+        void MaskSSE2(const QueryBox& q, const BoxArray& b, int begin, int end, uint64_t* mask) {
+            const __m128 qx = _mm_set1_ps(q.x), qy = _mm_set1_ps(q.y);
+            const __m128 qr = _mm_set1_ps(q.right), qb = _mm_set1_ps(q.bottom);
+
+            for (int base = begin; base < end; base += 64) {
+                const int n = std::min(64, end - base);
+                uint64_t word = 0;
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    const int k = base + i;
+                    const __m128 x = _mm_loadu_ps(b.x + k), y = _mm_loadu_ps(b.y + k);
+                    const __m128 w = _mm_loadu_ps(b.w + k), h = _mm_loadu_ps(b.h + k);
+                    __m128 m = _mm_and_ps(_mm_cmplt_ps(x, qr), _mm_cmpgt_ps(_mm_add_ps(x, w), qx));
+                    m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(y, qb), _mm_cmpgt_ps(_mm_add_ps(y, h), qy)));
+                    word |= (uint64_t)_mm_movemask_ps(m) << i;
+                }
+                for (; i < n; ++i) {
+                    const int k = base + i;
+                    word |= (uint64_t)OverlapsScalar(q, b.x[k], b.y[k], b.w[k], b.h[k]) << i;
+                }
+                mask[(base - begin) >> 6] = word;
+            }
+        }
+
+        ECH_TARGET_AVX2
+        void MaskAVX2(const QueryBox& q, const BoxArray& b, int begin, int end, uint64_t* mask) {
+            const __m256 qx = _mm256_set1_ps(q.x), qy = _mm256_set1_ps(q.y);
+            const __m256 qr = _mm256_set1_ps(q.right), qb = _mm256_set1_ps(q.bottom);
+
+            for (int base = begin; base < end; base += 64) {
+                const int n = std::min(64, end - base);
+                uint64_t word = 0;
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    const int k = base + i;
+                    const __m256 x = _mm256_loadu_ps(b.x + k), y = _mm256_loadu_ps(b.y + k);
+                    const __m256 w = _mm256_loadu_ps(b.w + k), h = _mm256_loadu_ps(b.h + k);
+                    // Ordered, non-signalling compares: NaN never overlaps, like the scalar code
+                    __m256 m = _mm256_and_ps(_mm256_cmp_ps(x, qr, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(x, w), qx, _CMP_GT_OQ));
+                    m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(y, qb, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(y, h), qy, _CMP_GT_OQ)));
+                    word |= (uint64_t)(uint32_t)_mm256_movemask_ps(m) << i;
+                }
+                for (; i < n; ++i) {
+                    const int k = base + i;
+                    word |= (uint64_t)OverlapsScalar(q, b.x[k], b.y[k], b.w[k], b.h[k]) << i;
+                }
+                mask[(base - begin) >> 6] = word;
+            }
+        }
+
+        bool CpuHasAVX2() {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            // The OS must save the YMM registers on context switches
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+
+        bool CpuHasSSE2() {
+#if defined(__x86_64__) || defined(_M_X64)
+            return true; // part of x86-64
+#elif defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            return (info[3] & (1 << 26)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+#endif
+        }
+#endif
+
+        SimdLevel DetectSimdLevel() {
+#if ECH_COLLISION_X86
+            if (CpuHasAVX2()) return SIMD_AVX2;
+            if (CpuHasSSE2()) return SIMD_SSE2;
+#endif
+            return SIMD_SCALAR;
+        }
+
+        struct DispatchState {
+            SimdLevel supported = DetectSimdLevel();
+            SimdLevel active = supported;
+            MaskKernel kernel = nullptr;
+        };
+
+        MaskKernel KernelFor(SimdLevel level) {
+            switch (level) {
+#if ECH_COLLISION_X86
+            case SIMD_AVX2: return MaskAVX2;
+            case SIMD_SSE2: return MaskSSE2;
+#endif
+            default: return MaskScalar;
+            }
+        }
+
+        DispatchState& State() {
+            static DispatchState state = [] {
+                DispatchState s;
+                s.kernel = KernelFor(s.active);
+                return s;
+            }();
+            return state;
+        }
+
+        inline int CountTrailingZeros(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, v);
+            return (int)index;
+#elif defined(_MSC_VER)
+            unsigned long index;
+            if (_BitScanForward(&index, (unsigned long)v)) return (int)index;
+            _BitScanForward(&index, (unsigned long)(v >> 32));
+            return (int)index + 32;
+#else
+            return __builtin_ctzll(v);
+#endif
+        }
+
+        inline QueryBox MakeQuery(float x, float y, float w, float h) {
+            return { x, y, x + w, y + h };
+        }
+
+        // Runs the kernel over the array in blocks small enough for a stack mask and hands every
+        // set bit to `emit`
+        template <typename Emit>
+        void ForEachOverlap(const QueryBox& q, const BoxArray& boxes, Emit&& emit) {
+            constexpr int BlockBoxes = 4096;
+            uint64_t mask[BlockBoxes / 64];
+            const MaskKernel kernel = State().kernel;
+
+            for (int begin = 0; begin < boxes.count; begin += BlockBoxes) {
+                const int end = std::min(boxes.count, begin + BlockBoxes);
+                kernel(q, boxes, begin, end, mask);
+                const int words = (end - begin + 63) >> 6;
+                for (int w = 0; w < words; ++w) {
+                    uint64_t bits = mask[w];
+                    while (bits) {
+                        emit(begin + (w << 6) + CountTrailingZeros(bits));
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+    }
+
+    SimdLevel GetSupportedSimdLevel() {
+        return State().supported;
+    }
+
+    SimdLevel GetSimdLevel() {
+        return State().active;
+    }
+
+    void SetSimdLevel(SimdLevel level) {
+        DispatchState& s = State();
+        s.active = std::min(level, s.supported);
+        s.kernel = KernelFor(s.active);
+    }
+
+    void CheckCollisionBatch(float x, float y, float w, float h, const BoxArray& boxes, uint64_t* mask) {
+        if (boxes.count <= 0) return;
+        State().kernel(MakeQuery(x, y, w, h), boxes, 0, boxes.count, mask);
+    }
+
+    int CheckCollisionBatch(float x, float y, float w, float h, const BoxArray& boxes, int* indices, int maxIndices) {
+        int found = 0;
+        ForEachOverlap(MakeQuery(x, y, w, h), boxes, [&](int index) {
+            if (found < maxIndices) indices[found] = index;
+            found++;
+        });
+        return found;
+    }
+
+    int CheckCollisionBatch(const BoxArray& queries, const BoxArray& boxes, CollisionPair* pairs, int maxPairs) {
+        int found = 0;
+        for (int qi = 0; qi < queries.count; ++qi) {
+            const QueryBox q = MakeQuery(queries.x[qi], queries.y[qi], queries.w[qi], queries.h[qi]);
+            ForEachOverlap(q, boxes, [&](int index) {
+                if (found < maxPairs) pairs[found] = { qi, index };
+                found++;
+            });
+        }
+        return found;
+    }
+
+}
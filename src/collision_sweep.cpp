@@ -0,0 +1,280 @@
+#include "collision.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ECH_SWEEP_SSE2 1
+#include <emmintrin.h>
+#else
+#define ECH_SWEEP_SSE2 0
+#endif
+
+namespace ech {
+
+    namespace {
+
+        constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+        // Gap left between a box and the surface it stopped against, so float rounding never
+        // leaves it a hair inside (which would read as an overlap on the next sweep)
+        constexpr float Skin = 1e-3f;
+
+        // Point p moving by d against the open box (lo, hi). Axes without motion must be strictly
+        // inside, which is what lets a box slide along a surface it touches. Every kernel below
+        // evaluates exactly these expressions so they agree with each other.
+        bool SlabEntry(float px, float py, float dx, float dy,
+            float loX, float loY, float hiX, float hiY,
+            float& tEnter, float& tExit, float& nx, float& ny) {
+            tEnter = -Infinity;
+            tExit = Infinity;
+            nx = ny = 0.0f;
+
+            if (dx == 0.0f) {
+                if (!(px > loX && px < hiX)) return false;
+            }
+            else {
+                const float inv = 1.0f / dx;
+                const float t1 = (loX - px) * inv, t2 = (hiX - px) * inv;
+                tEnter = std::min(t1, t2);
+                tExit = std::max(t1, t2);
+                nx = dx > 0.0f ? -1.0f : 1.0f;
+            }
+
+            if (dy == 0.0f) {
+                if (!(py > loY && py < hiY)) return false;
+            }
+            else {
+                const float inv = 1.0f / dy;
+                const float t1 = (loY - py) * inv, t2 = (hiY - py) * inv;
+                const float enterY = std::min(t1, t2);
+                if (enterY > tEnter) {
+                    tEnter = enterY;
+                    nx = 0.0f;
+                    ny = dy > 0.0f ? -1.0f : 1.0f;
+                }
+                tExit = std::min(tExit, std::max(t1, t2));
+            }
+
+            return tEnter < tExit;
+        }
+
+        // Shallowest way out of an overlap
+        void Depenetration(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh, SweepHit& hit) {
+            const float left = (ax + aw) - bx;
+            const float right = (bx + bw) - ax;
+            const float up = (ay + ah) - by;
+            const float down = (by + bh) - ay;
+
+            hit.time = 0.0f;
+            hit.normalX = hit.normalY = 0.0f;
+            hit.penetration = left;
+            hit.normalX = -1.0f;
+            if (right < hit.penetration) { hit.penetration = right; hit.normalX = 1.0f; }
+            if (up < hit.penetration) { hit.penetration = up; hit.normalX = 0.0f; hit.normalY = -1.0f; }
+            if (down < hit.penetration) { hit.penetration = down; hit.normalX = 0.0f; hit.normalY = 1.0f; }
+        }
+
+        struct Mover {
+            float x, y, w, h, dx, dy;
+        };
+
+        // Earliest time of impact (clamped to 0 for overlaps) of the mover against solids
+        // [begin, count). Updates bestT / best only on strictly earlier hits, so ties go to the
+        // lowest index.
+        void FirstHitScalar(const Mover& m, const BoxArray& s, int begin, float& bestT, int& best) {
+            for (int i = begin; i < s.count; ++i) {
+                float tEnter, tExit, nx, ny;
+                if (!SlabEntry(m.x, m.y, m.dx, m.dy, s.x[i] - m.w, s.y[i] - m.h, s.x[i] + s.w[i], s.y[i] + s.h[i],
+                    tEnter, tExit, nx, ny)) continue;
+                if (tExit <= 0.0f || tEnter > 1.0f) continue;
+                const float key = std::max(tEnter, 0.0f);
+                if (key < bestT) {
+                    bestT = key;
+                    best = i;
+                }
+            }
+        }
+
+#if ECH_SWEEP_SSE2
+        inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        // One slab axis for four solids. Motion along the axis is the same for every lane, so the
+        // "no motion" case is a branch outside the loop rather than a per-lane select.
+        inline void SlabAxis4(bool moving, __m128 p, __m128 inv, __m128 lo, __m128 hi, __m128& tmin, __m128& tmax) {
+            if (moving) {
+                const __m128 t1 = _mm_mul_ps(_mm_sub_ps(lo, p), inv);
+                const __m128 t2 = _mm_mul_ps(_mm_sub_ps(hi, p), inv);
+                tmin = _mm_min_ps(t1, t2);
+                tmax = _mm_max_ps(t1, t2);
+            }
+            else {
+                const __m128 inside = _mm_and_ps(_mm_cmpgt_ps(p, lo), _mm_cmplt_ps(p, hi));
+                const __m128 inf = _mm_set1_ps(Infinity), ninf = _mm_set1_ps(-Infinity);
+                tmin = Select(inside, ninf, inf);
+                tmax = Select(inside, inf, ninf);
+            }
+        }
+
+        void FirstHitSSE2(const Mover& m, const BoxArray& s, float& bestT, int& best) {
+            const bool movingX = m.dx != 0.0f, movingY = m.dy != 0.0f;
+            const __m128 ax = _mm_set1_ps(m.x), ay = _mm_set1_ps(m.y);
+            const __m128 aw = _mm_set1_ps(m.w), ah = _mm_set1_ps(m.h);
+            const __m128 invX = _mm_set1_ps(movingX ? 1.0f / m.dx : 0.0f);
+            const __m128 invY = _mm_set1_ps(movingY ? 1.0f / m.dy : 0.0f);
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+            __m128 laneT = _mm_set1_ps(bestT);
+            __m128i laneIndex = _mm_set1_epi32(-1);
+            __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+            const __m128i four = _mm_set1_epi32(4);
+
+            int i = 0;
+            for (; i + 4 <= s.count; i += 4) {
+                const __m128 bx = _mm_loadu_ps(s.x + i), by = _mm_loadu_ps(s.y + i);
+                const __m128 bw = _mm_loadu_ps(s.w + i), bh = _mm_loadu_ps(s.h + i);
+
+                __m128 tminX, tmaxX, tminY, tmaxY;
+                SlabAxis4(movingX, ax, invX, _mm_sub_ps(bx, aw), _mm_add_ps(bx, bw), tminX, tmaxX);
+                SlabAxis4(movingY, ay, invY, _mm_sub_ps(by, ah), _mm_add_ps(by, bh), tminY, tmaxY);
+
+                const __m128 tEnter = _mm_max_ps(tminX, tminY);
+                const __m128 tExit = _mm_min_ps(tmaxX, tmaxY);
+                __m128 valid = _mm_and_ps(_mm_cmplt_ps(tEnter, tExit), _mm_cmpgt_ps(tExit, zero));
+                valid = _mm_and_ps(valid, _mm_cmple_ps(tEnter, one));
+
+                const __m128 key = _mm_max_ps(tEnter, zero);
+                const __m128 better = _mm_and_ps(valid, _mm_cmplt_ps(key, laneT));
+                laneT = Select(better, key, laneT);
+                const __m128i betterI = _mm_castps_si128(better);
+                laneIndex = _mm_or_si128(_mm_and_si128(betterI, index), _mm_andnot_si128(betterI, laneIndex));
+                index = _mm_add_epi32(index, four);
+            }
+
+            alignas(16) float t[4];
+            alignas(16) int idx[4];
+            _mm_store_ps(t, laneT);
+            _mm_store_si128(reinterpret_cast<__m128i*>(idx), laneIndex);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (idx[lane] < 0) continue;
+                if (t[lane] < bestT || (t[lane] == bestT && (best < 0 || idx[lane] < best))) {
+                    bestT = t[lane];
+                    best = idx[lane];
+                }
+            }
+
+            FirstHitScalar(m, s, i, bestT, best);
+        }
+#endif
+
+    }
+
+    bool SweepAABB(float ax, float ay, float aw, float ah, float dx, float dy,
+        float bx, float by, float bw, float bh, SweepHit& hit) {
+        // Sweep A's corner against B grown by A's size (their Minkowski sum)
+        float tEnter, tExit, nx, ny;
+        if (!SlabEntry(ax, ay, dx, dy, bx - aw, by - ah, bx + bw, by + bh, tEnter, tExit, nx, ny)) return false;
+        if (tExit <= 0.0f || tEnter > 1.0f) return false;
+
+        if (tEnter < 0.0f) {
+            Depenetration(ax, ay, aw, ah, bx, by, bw, bh, hit);
+            return true;
+        }
+
+        hit.time = tEnter;
+        hit.normalX = nx;
+        hit.normalY = ny;
+        hit.penetration = 0.0f;
+        return true;
+    }
+
+    bool RaycastAABB(float x1, float y1, float x2, float y2,
+        float bx, float by, float bw, float bh, SweepHit& hit) {
+        float tEnter, tExit, nx, ny;
+        if (!SlabEntry(x1, y1, x2 - x1, y2 - y1, bx, by, bx + bw, by + bh, tEnter, tExit, nx, ny)) return false;
+        if (tExit <= 0.0f || tEnter > 1.0f) return false;
+
+        hit.penetration = 0.0f;
+        if (tEnter < 0.0f) {
+            hit.time = 0.0f;
+            hit.normalX = hit.normalY = 0.0f;
+            return true;
+        }
+        hit.time = tEnter;
+        hit.normalX = nx;
+        hit.normalY = ny;
+        return true;
+    }
+
+    int SweepAABBFirst(float ax, float ay, float aw, float ah, float dx, float dy,
+        const BoxArray& solids, SweepHit& hit) {
+        const Mover m = { ax, ay, aw, ah, dx, dy };
+        float bestT = Infinity;
+        int best = -1;
+
+#if ECH_SWEEP_SSE2
+        if (GetSimdLevel() >= SIMD_SSE2) FirstHitSSE2(m, solids, bestT, best);
+        else FirstHitScalar(m, solids, 0, bestT, best);
+#else
+        FirstHitScalar(m, solids, 0, bestT, best);
+#endif
+
+        if (best < 0) return -1;
+        // Normal and depth for the winner only
+        SweepAABB(ax, ay, aw, ah, dx, dy, solids.x[best], solids.y[best], solids.w[best], solids.h[best], hit);
+        return best;
+    }
+
+    int SweepAABBBatch(const BoxArray& movers, const float* dx, const float* dy,
+        const BoxArray& solids, SweepHit* hits, int* hitIndex) {
+        int hitCount = 0;
+        for (int i = 0; i < movers.count; ++i) {
+            hits[i] = SweepHit{};
+            hitIndex[i] = SweepAABBFirst(movers.x[i], movers.y[i], movers.w[i], movers.h[i], dx[i], dy[i], solids, hits[i]);
+            if (hitIndex[i] >= 0) hitCount++;
+        }
+        return hitCount;
+    }
+
+    SlideResult MoveAndSlide(float x, float y, float w, float h, float dx, float dy,
+        const BoxArray& solids, int maxIterations) {
+        SlideResult result;
+        result.x = x;
+        result.y = y;
+
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            SweepHit hit;
+            if (SweepAABBFirst(result.x, result.y, w, h, dx, dy, solids, hit) < 0) {
+                result.x += dx;
+                result.y += dy;
+                return result;
+            }
+
+            result.normalX = hit.normalX;
+            result.normalY = hit.normalY;
+            if (hit.normalX != 0.0f) result.hitX = true;
+            else result.hitY = true;
+
+            if (hit.penetration > 0.0f) {
+                // Started inside: push out, then try the same movement again
+                result.x += hit.normalX * (hit.penetration + Skin);
+                result.y += hit.normalY * (hit.penetration + Skin);
+                continue;
+            }
+
+            // Advance to the contact, then keep only the part of the movement along the surface
+            result.x += dx * hit.time + hit.normalX * Skin;
+            result.y += dy * hit.time + hit.normalY * Skin;
+            const float remaining = 1.0f - hit.time;
+            dx = hit.normalX != 0.0f ? 0.0f : dx * remaining;
+            dy = hit.normalY != 0.0f ? 0.0f : dy * remaining;
+            if (dx == 0.0f && dy == 0.0f) return result;
+        }
+
+        // Out of iterations: stay at the last safe position
+        return result;
+    }
+
+}
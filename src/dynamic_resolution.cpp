@@ -0,0 +1,273 @@
+#include "dynamic_resolution.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+#include "internal.hpp"
+#include "graphics_internal.hpp"
+#include "render_target.hpp"
+
+namespace ech {
+
+    namespace {
+
+        // Timer results are read this many frames late so we never wait on the GPU
+        constexpr int TimerQueryCount = 4;
+
+        static const char* upscaleVertexShaderSource = R"(
+            #version 330 core
+            layout (location = 0) in vec2 aPos;
+            layout (location = 1) in vec2 aTexCoord;
+            out vec2 TexCoord;
+            uniform vec2 uUvScale;
+            void main() {
+                gl_Position = vec4(aPos, 0.0, 1.0);
+                TexCoord = aTexCoord * uUvScale;
+            }
+        )";
+
+        static const char* upscaleFragmentShaderSource = R"(
+            #version 330 core
+            in vec2 TexCoord;
+            out vec4 FragColor;
+            uniform sampler2D uScene;
+            uniform vec2 uTexel;
+            uniform vec2 uUvMax;
+            uniform float uSharpness;
+            // Only the rendered corner of the target is valid: the rest may hold an older,
+            // larger frame, so no tap may reach past its last texel center
+            vec4 Sample(vec2 uv) {
+                return texture(uScene, clamp(uv, uTexel * 0.5, uUvMax));
+            }
+            void main() {
+                vec4 c = Sample(TexCoord);
+                if (uSharpness > 0.0) {
+                    vec3 n = Sample(TexCoord + vec2(0.0, -uTexel.y)).rgb
+                           + Sample(TexCoord + vec2(0.0,  uTexel.y)).rgb
+                           + Sample(TexCoord + vec2(-uTexel.x, 0.0)).rgb
+                           + Sample(TexCoord + vec2( uTexel.x, 0.0)).rgb;
+                    c.rgb = clamp(c.rgb + (c.rgb * 4.0 - n) * (uSharpness * 0.25), 0.0, 1.0);
+                }
+                FragColor = vec4(c.rgb, 1.0);
+            }
+        )";
+
+        struct DynamicResolutionState {
+            bool enabled = false;
+            DynamicResolutionSettings settings;
+            float scale = 1.0f;
+
+            RenderTarget target;
+            unsigned int program = 0;
+            unsigned int quadVAO = 0, quadVBO = 0;
+
+            unsigned int queries[TimerQueryCount] = {};
+            bool queryPending[TimerQueryCount] = {};
+            int queryIndex = 0;
+            float gpuMs = 0.0f;
+
+            // Active pass
+            bool inWorld = false;
+            int passWidth = 0, passHeight = 0;
+            int windowWidth = 0, windowHeight = 0;
+        };
+
+        DynamicResolutionState& State() {
+            static DynamicResolutionState state;
+            return state;
+        }
+
+        void CreateResources(DynamicResolutionState& s) {
+            if (!s.program)
+                s.program = CreateShaderProgram(upscaleVertexShaderSource, upscaleFragmentShaderSource);
+
+            if (!s.quadVAO) {
+                // Fullscreen quad in clip space; FBO textures are bottom-up like clip space, so no flip
+                const float quad[] = {
+                    -1.0f, -1.0f, 0.0f, 0.0f,
+                     1.0f, -1.0f, 1.0f, 0.0f,
+                     1.0f,  1.0f, 1.0f, 1.0f,
+                    -1.0f,  1.0f, 0.0f, 1.0f
+                };
+                glGenVertexArrays(1, &s.quadVAO);
+                glGenBuffers(1, &s.quadVBO);
+                glBindVertexArray(s.quadVAO);
+                glBindBuffer(GL_ARRAY_BUFFER, s.quadVBO);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+                glBindVertexArray(0);
+            }
+
+            if (!s.queries[0]) glGenQueries(TimerQueryCount, s.queries);
+        }
+
+        void DestroyResources(DynamicResolutionState& s) {
+            s.target.Destroy();
+            if (s.program) { glDeleteProgram(s.program); s.program = 0; }
+            if (s.quadVBO) { glDeleteBuffers(1, &s.quadVBO); s.quadVBO = 0; }
+            if (s.quadVAO) { glDeleteVertexArrays(1, &s.quadVAO); s.quadVAO = 0; }
+            if (s.queries[0]) {
+                glDeleteQueries(TimerQueryCount, s.queries);
+                for (int i = 0; i < TimerQueryCount; ++i) {
+                    s.queries[i] = 0;
+                    s.queryPending[i] = false;
+                }
+            }
+        }
+
+        // Pick up finished timer queries and steer the scale toward the budget
+        void UpdateScale(DynamicResolutionState& s) {
+            for (int i = 0; i < TimerQueryCount; ++i) {
+                if (!s.queryPending[i]) continue;
+                GLint available = 0;
+                glGetQueryObjectiv(s.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) continue;
+
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(s.queries[i], GL_QUERY_RESULT, &ns);
+                s.queryPending[i] = false;
+
+                float ms = (float)((double)ns / 1.0e6);
+                s.gpuMs = (s.gpuMs <= 0.0f) ? ms : s.gpuMs + (ms - s.gpuMs) * 0.2f;
+            }
+
+            if (!s.settings.automatic || s.gpuMs <= 0.0f) return;
+
+            // Fill cost grows with the pixel count, i.e. with scale squared
+            float ratio = s.settings.targetGpuMs / s.gpuMs;
+            if (std::fabs(ratio - 1.0f) < 0.05f) return; // close enough, avoid flicker
+
+            float desired = s.scale * std::sqrt(ratio);
+            desired = std::clamp(desired, s.settings.minScale, s.settings.maxScale);
+            // Drop quickly when over budget, recover slowly
+            float rate = desired < s.scale ? 0.25f : 0.05f;
+            s.scale += (desired - s.scale) * rate;
+        }
+
+    }
+
+    void EnableDynamicResolution(const DynamicResolutionSettings& settings) {
+        DynamicResolutionState& s = State();
+        s.settings = settings;
+        s.settings.minScale = std::clamp(settings.minScale, 0.1f, 1.0f);
+        s.settings.maxScale = std::clamp(settings.maxScale, s.settings.minScale, 2.0f);
+        s.scale = std::clamp(s.scale, s.settings.minScale, s.settings.maxScale);
+        s.enabled = true;
+    }
+
+    void DisableDynamicResolution() {
+        DynamicResolutionState& s = State();
+        if (s.inWorld) EndWorldDrawing();
+        s.enabled = false;
+        s.gpuMs = 0.0f;
+        if (GetDefaultWindow()) DestroyResources(s);
+    }
+
+    bool IsDynamicResolutionEnabled() {
+        return State().enabled;
+    }
+
+    void BeginWorldDrawing() {
+        DynamicResolutionState& s = State();
+        Window* window = GetDefaultWindow();
+        if (!s.enabled || s.inWorld || !window) return;
+
+        window->GetFramebufferSize(s.windowWidth, s.windowHeight);
+        if (s.windowWidth <= 0 || s.windowHeight <= 0) return;
+
+        CreateResources(s);
+        UpdateScale(s);
+
+        // Allocate once for the largest scale and render into a sub-rectangle, so scale changes
+        // never reallocate
+        int targetW = std::max(1, (int)std::ceil(s.windowWidth * s.settings.maxScale));
+        int targetH = std::max(1, (int)std::ceil(s.windowHeight * s.settings.maxScale));
+        if (s.target.Width() != targetW || s.target.Height() != targetH) {
+            if (!s.target.Create(targetW, targetH)) return;
+        }
+
+        s.passWidth = std::clamp((int)std::lround(s.windowWidth * s.scale), 1, targetW);
+        s.passHeight = std::clamp((int)std::lround(s.windowHeight * s.scale), 1, targetH);
+
+        // Projection stays the window's: only the viewport shrinks, so world coordinates,
+        // the camera and mouse picking are unaffected
+        glBindFramebuffer(GL_FRAMEBUFFER, s.target.GetFramebuffer());
+        glViewport(0, 0, s.passWidth, s.passHeight);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, s.passWidth, s.passHeight);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+
+        if (!s.queryPending[s.queryIndex]) {
+            glBeginQuery(GL_TIME_ELAPSED, s.queries[s.queryIndex]);
+        }
+        s.inWorld = true;
+    }
+
+    void EndWorldDrawing() {
+        DynamicResolutionState& s = State();
+        Window* window = GetDefaultWindow();
+        if (!s.inWorld || !window) return;
+        s.inWorld = false;
+
+        if (!s.queryPending[s.queryIndex]) {
+            glEndQuery(GL_TIME_ELAPSED);
+            s.queryPending[s.queryIndex] = true;
+            s.queryIndex = (s.queryIndex + 1) % TimerQueryCount;
+        }
+
+        window->BindDefaultFramebuffer();
+
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_BLEND);
+
+        glUseProgram(s.program);
+        ECH_STATS_SHADER(s.program);
+        glUniform2f(glGetUniformLocation(s.program, "uUvScale"),
+            (float)s.passWidth / s.target.Width(), (float)s.passHeight / s.target.Height());
+        glUniform2f(glGetUniformLocation(s.program, "uTexel"),
+            1.0f / s.target.Width(), 1.0f / s.target.Height());
+        glUniform2f(glGetUniformLocation(s.program, "uUvMax"),
+            (s.passWidth - 0.5f) / s.target.Width(), (s.passHeight - 0.5f) / s.target.Height());
+        glUniform1f(glGetUniformLocation(s.program, "uSharpness"),
+            s.settings.filter == UPSCALE_SHARPEN ? std::clamp(s.settings.sharpness, 0.0f, 1.0f) : 0.0f);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, s.target.GetTexture());
+        ECH_STATS_TEXTURE_BIND(s.target.GetTexture());
+        glUniform1i(glGetUniformLocation(s.program, "uScene"), 0);
+
+        glBindVertexArray(s.quadVAO);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        ECH_STATS_DRAW(4);
+        glBindVertexArray(0);
+
+        if (blend) glEnable(GL_BLEND);
+        glUseProgram(shaderProgramShape);
+        ECH_STATS_SHADER(shaderProgramShape);
+    }
+
+    float GetResolutionScale() {
+        return State().enabled ? State().scale : 1.0f;
+    }
+
+    void SetResolutionScale(float scale) {
+        DynamicResolutionState& s = State();
+        s.scale = std::clamp(scale, s.settings.minScale, s.settings.maxScale);
+    }
+
+    float GetWorldGpuTime() {
+        return State().gpuMs;
+    }
+
+    void ShutdownDynamicResolution() {
+        DynamicResolutionState& s = State();
+        s.inWorld = false;
+        DestroyResources(s);
+    }
+
+}
@@ -5,9 +5,6 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
-#include <unordered_map>
-#include <chrono>
-#include <thread>
 #include <fstream>
 #include <filesystem>
 
@@ -34,16 +31,11 @@ namespace ech {
 
 
 
-    std::unordered_map<int, bool> mouseButtonPreviousStates;
-    std::unordered_map<int, bool> keyPreviousStates;
-
     constexpr float PI = 3.14159265359f;
 
     // === Timing & Globals (CLEANED) ===
+    // The limiter itself lives in frame_pacer.cpp
     static float deltaTime = 0.0f;
-    static std::chrono::high_resolution_clock::time_point lastFrameTime;
-    static std::chrono::high_resolution_clock::time_point frameStart;
-    static double targetFrameTime = 0.0;
 
     glm::vec2 cameraPos(0.0f, 0.0f);
 
@@ -67,6 +59,13 @@ namespace ech {
     }
 
     void CloseWindow() {
+        if (GetDefaultWindow()) {
+            ShutdownFrameCapture();
+            ShutdownDynamicResolution();
+            ShutdownTilemaps();
+            ShutdownParticles();
+            ShutdownProfiler();
+        }
         delete GetDefaultWindow();
         GetDefaultWindow() = nullptr;
     }
@@ -80,12 +79,22 @@ namespace ech {
     }
 
     void SetFpsLimit(int fps) {
-        if (fps <= 0) targetFrameTime = 0.0;
-        else targetFrameTime = 1.0 / static_cast<double>(fps);
+        SetPacerPeriod(fps > 0 ? 1.0 / static_cast<double>(fps) : 0.0);
+    }
+
+    int GetFpsLimit() {
+        double period = GetPacerPeriod();
+        if (period <= 0.0) return 0;
+        return static_cast<int>(std::lround(1.0 / period));
+    }
+
+    void ApplyFpsLimit() {
+        EndFrame();
     }
 
     void StartDrawing() {
-        frameStart = std::chrono::high_resolution_clock::now();
+        ECH_PROFILE_SCOPE("StartDrawing");
+        BeginGpuZone("Frame");
         glClear(GL_COLOR_BUFFER_BIT);
 
         // Sync Matrices for BOTH shaders
@@ -93,47 +102,39 @@ namespace ech {
         for (unsigned int s : list) {
             if (s == 0) continue;
             glUseProgram(s);
+            ECH_STATS_SHADER(s);
             glUniformMatrix4fv(glGetUniformLocation(s, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
             glUniformMatrix4fv(glGetUniformLocation(s, "uView"), 1, GL_FALSE, glm::value_ptr(view));
         }
         glUseProgram(shaderProgramShape); // Default to shapes
+        ECH_STATS_SHADER(shaderProgramShape);
     }
 
     void EndDrawing() {
-        glfwSwapBuffers(GetDefaultWindow()->GetNativeHandle());
-        glfwPollEvents();
-
-        if (targetFrameTime > 0.0) {
-            auto now = std::chrono::high_resolution_clock::now();
-            double elapsed = std::chrono::duration<double>(now - frameStart).count();
-
-            while (elapsed < targetFrameTime) {
-                if (targetFrameTime - elapsed > 0.002) {
-                    std::this_thread::sleep_for(std::chrono::microseconds(500));
-                }
-                else {
-                    std::this_thread::yield();
-                }
-                now = std::chrono::high_resolution_clock::now();
-                elapsed = std::chrono::duration<double>(now - frameStart).count();
-            }
+        EndGpuZone();
+        UpdateFrameCapture();
+
+        // Headless windows render into an offscreen target, there is nothing to present
+        if (!GetDefaultWindow()->IsHeadless()) {
+            ECH_PROFILE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(GetDefaultWindow()->GetNativeHandle());
         }
+        PumpEvents();
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        deltaTime = std::chrono::duration<float>(currentTime - lastFrameTime).count();
-        lastFrameTime = currentTime;
+        EndFrame();
     }
 
     void StartDrawingAdv(Window& window)
     {
-        frameStart = std::chrono::high_resolution_clock::now(); // Use high_res for consistency
+        ECH_PROFILE_SCOPE("StartDrawing");
+        BeginGpuZone("Frame");
 
         GLFWwindow* native = window.GetNativeHandle();
         glfwMakeContextCurrent(native);
 
         int fbw, fbh;
-        glfwGetFramebufferSize(native, &fbw, &fbh);
-        glViewport(0, 0, fbw, fbh);
+        window.GetFramebufferSize(fbw, fbh);
+        window.BindDefaultFramebuffer();
 
         // Update the projection matrix to match the window size (important for multi-window)
         projection = glm::ortho(0.0f, (float)fbw, (float)fbh, 0.0f, -1.0f, 1.0f);
@@ -145,6 +146,7 @@ namespace ech {
         for (unsigned int s : activeShaders) {
             if (s == 0) continue;
             glUseProgram(s);
+            ECH_STATS_SHADER(s);
             glUniformMatrix4fv(glGetUniformLocation(s, "uProjection"), 1, GL_FALSE, &projection[0][0]);
             glUniformMatrix4fv(glGetUniformLocation(s, "uView"), 1, GL_FALSE, &view[0][0]);
         }
@@ -152,53 +154,48 @@ namespace ech {
 
     void EndDrawingAdv(Window& window)
     {
-        glfwSwapBuffers(window.GetNativeHandle());
-
-        auto currentTime = std::chrono::steady_clock::now();
-        deltaTime = std::chrono::duration<float>(currentTime - lastFrameTime).count();
-        lastFrameTime = currentTime;
-		glfwPollEvents();
-    }
-
+        EndGpuZone();
+        if (&window == GetDefaultWindow()) UpdateFrameCapture();
 
+        if (!window.IsHeadless()) {
+            ECH_PROFILE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window.GetNativeHandle());
+        }
 
+        // Once per loop, not once per window drawn: polling again would drop the input edges
+        // the other windows haven't seen yet, and pacing again would divide the frame rate
+        if (&window == GetDefaultWindow()) {
+            PumpEvents();
+            EndFrame();
+        }
+    }
 
-    // void BeginFrame()
-    // {
-    // 
-    //     if (!limiterInitialized)
-    //     {
-    //         nextFrameTime = frameStart;
-    //         limiterInitialized = true;
-    //     }
-    // }
+     void BeginFrame()
+     {
+         StartPacer();
+     }
      
      void PollEvents()
      {
-         glfwPollEvents();
+         PumpEvents();
      }
      
-   // void EndFrame()
-   // {
-   //     if (targetFrameTime <= 0.0)
-   //         return;
-   // 
-   //     auto now = std::chrono::steady_clock::now();
-   // 
-   //     nextFrameTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
-   //         std::chrono::duration<double>(targetFrameTime)
-   //     );
-   // 
-   //     if (nextFrameTime < now)
-   //         nextFrameTime = now;
-   // 
-   //     std::this_thread::sleep_until(nextFrameTime);
-   // }
+     // Wait for the next absolute deadline (fixed mode) and update the delta time
+     void EndFrame()
+     {
+         {
+             ECH_PROFILE_SCOPE("FrameLimiter");
+             deltaTime = static_cast<float>(ReplayEndFrame(PaceFrame()));
+         }
+         RenderStatsEndFrame(GetLastPacerSleep());
+         ProfilerEndFrame();
+     }
 
      void SetVSync(bool enabled) {
          GLFWwindow* native = GetDefaultWindow()->GetNativeHandle();
          glfwMakeContextCurrent(native);
          glfwSwapInterval(enabled ? 1 : 0);
+         SetPacerVSync(enabled);
      }
 
      void ClearBackground(Color color) {
@@ -207,25 +204,30 @@ namespace ech {
 
     // --- DRAW FUNCTIONS ---
     void DrawLine(float x1, float y1, float x2, float y2, Color color) {
+        ECH_PROFILE_SCOPE("DrawLine");
         float vertices[] = {
             x1, y1,
             x2, y2
         };
 
         glUseProgram(shaderProgramShape);
+        ECH_STATS_SHADER(shaderProgramShape);
         glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
 
         glBindVertexArray(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(vertices));
 
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
         glDrawArrays(GL_LINES, 0, 2);
+        ECH_STATS_DRAW(2);
     }
 
     void DrawTriangle(float x, float y, float w, float h, Color color) {
+        ECH_PROFILE_SCOPE("DrawTriangle");
         float vertices[] = {
             x,     y,
             x + w, y,
@@ -233,19 +235,23 @@ namespace ech {
         };
 
         glUseProgram(shaderProgramShape);
+        ECH_STATS_SHADER(shaderProgramShape);
         glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
 
         glBindVertexArray(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(vertices));
 
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
         glDrawArrays(GL_TRIANGLES, 0, 3);
+        ECH_STATS_DRAW(3);
     }
 
     void DrawRectangle(float x, float y, float w, float h, Color color) {
+        ECH_PROFILE_SCOPE("DrawRectangle");
         float vertices[] = {
             x,     y,
             x + w, y,
@@ -255,6 +261,7 @@ namespace ech {
         unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
 
         glUseProgram(shaderProgramShape);
+        ECH_STATS_SHADER(shaderProgramShape);
 
         // Send matrices here
         
@@ -264,18 +271,22 @@ namespace ech {
         glBindVertexArray(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(vertices));
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(indices));
 
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        ECH_STATS_DRAW(6);
     }
 
 
     void DrawCircle(float x, float y, float radius, Color color) {
+        ECH_PROFILE_SCOPE("DrawCircle");
         const int numSegments = 64;
         std::vector<float> verts;
         verts.reserve((numSegments + 2) * 2);
@@ -293,22 +304,26 @@ namespace ech {
         }
 
         glUseProgram(shaderProgramShape);
+        ECH_STATS_SHADER(shaderProgramShape);
         glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
 
         glBindVertexArray(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(verts.size() * sizeof(float));
 
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
         glDrawArrays(GL_TRIANGLE_FAN, 0, (GLsizei)(numSegments + 2));
+        ECH_STATS_DRAW(numSegments + 2);
     }
 
     unsigned int LoadTexture(const char* path) {
         unsigned int textureID;
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_2D, textureID);
+        ECH_STATS_TEXTURE_BIND(textureID);
 
         // Texture params
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -327,6 +342,8 @@ namespace ech {
 
             glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
+            ECH_STATS_UPLOAD((unsigned long long)width * height * nrChannels);
+            ECH_STATS_TEXTURE_LOADED();
         }
         else {
             std::cerr << "Failed to load texture: " << path << std::endl;
@@ -336,17 +353,24 @@ namespace ech {
     }
 
     void DrawTexturedRectangle(float x, float y, float w, float h, unsigned int textureID) {
+        DrawTexturedQuad(x, y, w, h, textureID, 0.0f, 0.0f, 1.0f, 1.0f);
+    }
+
+    void DrawTexturedQuad(float x, float y, float w, float h, unsigned int textureID,
+        float u0, float v0, float u1, float v1) {
+        ECH_PROFILE_SCOPE("DrawTexturedQuad");
         if (textureID == 0) return;
 
         float vertices[] = {
-            x,     y,     0.0f, 0.0f, // Top Left
-            x + w, y,     1.0f, 0.0f, // Top Right
-            x + w, y + h, 1.0f, 1.0f, // Bottom Right
-            x,     y + h, 0.0f, 1.0f  // Bottom Left
+            x,     y,     u0, v0, // Top Left
+            x + w, y,     u1, v0, // Top Right
+            x + w, y + h, u1, v1, // Bottom Right
+            x,     y + h, u0, v1  // Bottom Left
         };
         unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
 
         glUseProgram(shaderProgramTexture);
+        ECH_STATS_SHADER(shaderProgramTexture);
 
         // Sync Matrices
         glUniformMatrix4fv(glGetUniformLocation(shaderProgramTexture, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
@@ -355,14 +379,17 @@ namespace ech {
         // Bind Texture
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, textureID);
+        ECH_STATS_TEXTURE_BIND(textureID);
         glUniform1i(glGetUniformLocation(shaderProgramTexture, "texture1"), 0);
 
         glBindVertexArray(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(vertices));
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(sizeof(indices));
 
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
@@ -370,74 +397,11 @@ namespace ech {
         glEnableVertexAttribArray(1);
 
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        ECH_STATS_DRAW(6);
 
         glBindVertexArray(0);
     }
        
-    // --- Input ---
-    static int TranslateKey(int key) {
-        if (key >= KEY_A && key <= KEY_Z)
-            return GLFW_KEY_A + (key - KEY_A);
-
-        switch (key) {
-        case KEY_SPACE: return GLFW_KEY_SPACE;
-        case KEY_ESCAPE: return GLFW_KEY_ESCAPE;
-        case KEY_ENTER: return GLFW_KEY_ENTER;
-        default: return GLFW_KEY_UNKNOWN;
-        }
-    }
-
-    static int TranslateMouseButton(int button) {
-        switch (button) {
-        case MOUSE_LEFT_BUTTON:   return GLFW_MOUSE_BUTTON_LEFT;
-        case MOUSE_RIGHT_BUTTON:  return GLFW_MOUSE_BUTTON_RIGHT;
-        case MOUSE_MIDDLE_BUTTON: return GLFW_MOUSE_BUTTON_MIDDLE;
-        default: return -1;
-        }
-    }
-
-    int IsKeyPressed(int key) {
-        if (!GetDefaultWindow()->GetNativeHandle()) return 0;
-
-        int state = glfwGetKey(GetDefaultWindow()->GetNativeHandle(), TranslateKey(key)) == GLFW_PRESS;
-        int wasPressed = keyPreviousStates[key];
-
-        keyPreviousStates[key] = state; // update state
-
-        // only return true when key *just* pressed
-        return    state && !wasPressed;
-    }
-
-    int IsKeyHeld(int key) {
-        if (!GetDefaultWindow()->GetNativeHandle()) return 0;
-        int state = glfwGetKey(GetDefaultWindow()->GetNativeHandle(), TranslateKey(key));
-        return state == GLFW_REPEAT || state == GLFW_PRESS;
-    }
-
-    int IsMouseButtonPressed(int button) {
-        if (!GetDefaultWindow()->GetNativeHandle()) return 0;
-
-        int glfwButton = TranslateMouseButton(button);
-        if (glfwButton == -1) return 0;
-
-        int state = glfwGetMouseButton(GetDefaultWindow()->GetNativeHandle(), glfwButton) == GLFW_PRESS;
-        int wasPressed = mouseButtonPreviousStates[glfwButton];
-
-        mouseButtonPreviousStates[glfwButton] = state;
-
-        return state && !wasPressed;
-    }
-
-    int IsMouseButtonHeld(int button) {
-        if (!GetDefaultWindow()->GetNativeHandle()) return 0;
-
-        int glfwButton = TranslateMouseButton(button);
-        if (glfwButton == -1) return 0;
-
-        int state = glfwGetMouseButton(GetDefaultWindow()->GetNativeHandle(), glfwButton);
-        return state == GLFW_PRESS;
-    }
-
     void UpdateCamera(float targetX, float targetY, float lerpFactor, float screenWidth, float screenHeight) {
         // Smooth follow
         camera.x += (targetX - camera.x) * lerpFactor;
@@ -466,7 +430,7 @@ namespace ech {
         view = t;
     }
 
-    bool ech::CheckCollision(float ax, float ay, float aw, float ah,
+    bool CheckCollision(float ax, float ay, float aw, float ah,
         float bx, float by, float bw, float bh) {
         return (ax < bx + bw) &&
             (ax + aw > bx) &&
@@ -535,6 +499,7 @@ namespace ech {
 
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_2D, textureID);
+        ECH_STATS_TEXTURE_BIND(textureID);
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // CRITICAL
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, 512, 512, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -542,6 +507,7 @@ namespace ech {
     }
 
     void Font::Draw(const std::string& text, float x, float y, Color color) {
+        ECH_PROFILE_SCOPE("Font::Draw");
         if (!textureID || !shaderProgramText) return;
 
         std::vector<float> verts;
@@ -558,18 +524,22 @@ namespace ech {
         }
 
         glUseProgram(shaderProgramText);
+        ECH_STATS_SHADER(shaderProgramText);
         glUniform3f(glGetUniformLocation(shaderProgramText, "textColor"), color.r, color.g, color.b);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, textureID);
+        ECH_STATS_TEXTURE_BIND(textureID);
         glUniform1i(glGetUniformLocation(shaderProgramText, "textAtlas"), 0);
 
         glBindVertexArray(textVAO);
         glBindBuffer(GL_ARRAY_BUFFER, textVBO);
         // Use glBufferData to avoid 1281 errors if the string is long
         glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_DYNAMIC_DRAW);
+        ECH_STATS_UPLOAD(verts.size() * sizeof(float));
 
         glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(verts.size() / 4));
+        ECH_STATS_DRAW(verts.size() / 4);
         glBindVertexArray(0);
     
 }
@@ -0,0 +1,363 @@
+#include "ecs.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "jobs.hpp"
+
+namespace ech {
+
+    namespace {
+
+        constexpr size_t ChunkBytes = 16 * 1024;
+        constexpr size_t ChunkAlignment = 64;
+
+        struct ComponentRegistry {
+            std::mutex mutex;
+            ComponentInfo infos[MaxComponentTypes];
+            int count = 0;
+        };
+
+        ComponentRegistry& Registry() {
+            static ComponentRegistry registry;
+            return registry;
+        }
+
+        inline size_t AlignUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        unsigned char* AllocateChunk(size_t bytes) {
+            return static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(ChunkAlignment)));
+        }
+
+        void FreeChunk(unsigned char* data) {
+            ::operator delete(data, std::align_val_t(ChunkAlignment));
+        }
+
+        void* AllocateValue(const ComponentInfo& info) {
+            return ::operator new(info.size, std::align_val_t(info.align));
+        }
+
+        void FreeValue(void* value, const ComponentInfo& info) {
+            ::operator delete(value, std::align_val_t(info.align));
+        }
+
+    }
+
+    ComponentId RegisterComponent(const ComponentInfo& info) {
+        ComponentRegistry& r = Registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.count == MaxComponentTypes) {
+            std::cerr << "World: more than " << MaxComponentTypes << " component types" << std::endl;
+            return -1;
+        }
+        r.infos[r.count] = info;
+        return r.count++;
+    }
+
+    const ComponentInfo& GetComponentInfo(ComponentId id) {
+        // Entries never change once registered, so reads need no lock
+        return Registry().infos[id];
+    }
+
+    int World::Archetype::Column(ComponentId id) const {
+        const auto it = std::lower_bound(types.begin(), types.end(), id);
+        return (it != types.end() && *it == id) ? (int)(it - types.begin()) : -1;
+    }
+
+    World::World(int workerCount)
+        : m_WorkerCount(workerCount) {
+        FindArchetype({}); // archetype 0: entities without components
+    }
+
+    World::~World() {
+        Clear();
+        for (const std::unique_ptr<Archetype>& a : m_Archetypes)
+            for (Chunk& chunk : a->chunks) FreeChunk(chunk.data);
+    }
+
+    int World::GetWorkerCount() const {
+        return m_WorkerCount >= 0 ? std::min(m_WorkerCount, GetJobWorkerCount()) : GetJobWorkerCount();
+    }
+
+    // --- Entities ---
+
+    const World::Record* World::Find(Entity entity) const {
+        if (entity.index >= m_Records.size()) return nullptr;
+        const Record& record = m_Records[entity.index];
+        if (record.archetype < 0 || record.generation != entity.generation) return nullptr;
+        return &record;
+    }
+
+    bool World::IsAlive(Entity entity) const {
+        return Find(entity) != nullptr;
+    }
+
+    void* World::GetRaw(Entity entity, ComponentId id) const {
+        const Record* record = Find(entity);
+        if (!record || id < 0) return nullptr;
+        const Archetype& a = *m_Archetypes[record->archetype];
+        const int column = a.Column(id);
+        if (column < 0) return nullptr;
+        return a.At(a.chunks[record->chunk], column, record->row);
+    }
+
+    Entity World::Allocate() {
+        Entity entity;
+        if (!m_FreeSlots.empty()) {
+            entity.index = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        }
+        else {
+            entity.index = (uint32_t)m_Records.size();
+            m_Records.emplace_back();
+        }
+        entity.generation = m_Records[entity.index].generation;
+        return entity;
+    }
+
+    void World::Place(Entity entity, int archetype) {
+        Archetype& a = *m_Archetypes[archetype];
+        if (a.chunks.empty() || a.chunks.back().count == a.capacity) {
+            Chunk chunk;
+            chunk.data = AllocateChunk(a.chunkBytes);
+            a.chunks.push_back(chunk);
+        }
+        Chunk& chunk = a.chunks.back();
+        const int row = chunk.count++;
+        a.Entities(chunk)[row] = entity;
+        a.count++;
+
+        Record& record = m_Records[entity.index];
+        record.archetype = archetype;
+        record.chunk = (int)a.chunks.size() - 1;
+        record.row = row;
+        m_EntityCount++;
+    }
+
+    Entity World::CreateEntity() {
+        if (Deferring()) return DeferCreate();
+        const Entity entity = Allocate();
+        Place(entity, 0);
+        return entity;
+    }
+
+    void World::DestroyEntity(Entity entity) {
+        if (Deferring()) Defer(COMMAND_DESTROY, entity, -1);
+        else DestroyNow(entity);
+    }
+
+    void World::DestroyNow(Entity entity) {
+        const Record* found = Find(entity);
+        if (!found) return;
+        const Record record = *found;
+
+        Archetype& a = *m_Archetypes[record.archetype];
+        for (int c = 0; c < (int)a.types.size(); ++c)
+            GetComponentInfo(a.types[c]).destroy(a.At(a.chunks[record.chunk], c, record.row));
+        RemoveRow(record.archetype, record.chunk, record.row);
+
+        Record& slot = m_Records[entity.index];
+        slot.archetype = -1;
+        slot.generation++;
+        m_FreeSlots.push_back(entity.index);
+        m_EntityCount--;
+    }
+
+    void World::Clear() {
+        if (Deferring()) {
+            std::cerr << "World: Clear() can't run inside a query" << std::endl;
+            return;
+        }
+        for (uint32_t i = 0; i < (uint32_t)m_Records.size(); ++i)
+            if (m_Records[i].archetype >= 0) DestroyNow({ i, m_Records[i].generation });
+    }
+
+    // Fills the hole at (chunk, row), whose components have already been moved out or
+    // destroyed, with the archetype's last entity
+    void World::RemoveRow(int archetype, int chunkIndex, int row) {
+        Archetype& a = *m_Archetypes[archetype];
+        Chunk& last = a.chunks.back();
+        const int lastChunk = (int)a.chunks.size() - 1;
+        const int lastRow = last.count - 1;
+
+        if (chunkIndex != lastChunk || row != lastRow) {
+            Chunk& chunk = a.chunks[chunkIndex];
+            for (int c = 0; c < (int)a.types.size(); ++c)
+                GetComponentInfo(a.types[c]).move(a.At(chunk, c, row), a.At(last, c, lastRow));
+            const Entity moved = a.Entities(last)[lastRow];
+            a.Entities(chunk)[row] = moved;
+            m_Records[moved.index].chunk = chunkIndex;
+            m_Records[moved.index].row = row;
+        }
+
+        a.count--;
+        if (--last.count == 0) {
+            FreeChunk(last.data);
+            a.chunks.pop_back();
+        }
+    }
+
+    // --- Archetypes ---
+
+    int World::FindArchetype(std::vector<ComponentId> types) {
+        std::sort(types.begin(), types.end());
+        for (int i = 0; i < (int)m_Archetypes.size(); ++i)
+            if (m_Archetypes[i]->types == types) return i;
+
+        std::unique_ptr<Archetype> a(new Archetype());
+        a->types = std::move(types);
+
+        // Entities first, then one array per type, each aligned for its type
+        size_t perEntity = sizeof(Entity), padding = 0;
+        for (ComponentId id : a->types) {
+            const ComponentInfo& info = GetComponentInfo(id);
+            a->mask.set((size_t)id);
+            perEntity += info.size;
+            padding += info.align;
+        }
+        a->chunkBytes = std::max(ChunkBytes, AlignUp(perEntity + padding, ChunkAlignment));
+        a->capacity = (int)((a->chunkBytes - padding) / perEntity);
+
+        size_t offset = (size_t)a->capacity * sizeof(Entity);
+        for (ComponentId id : a->types) {
+            const ComponentInfo& info = GetComponentInfo(id);
+            offset = AlignUp(offset, info.align);
+            a->offsets.push_back(offset);
+            offset += (size_t)a->capacity * info.size;
+        }
+
+        m_Archetypes.push_back(std::move(a));
+        return (int)m_Archetypes.size() - 1;
+    }
+
+    int World::ArchetypeWith(int from, ComponentId id) {
+        Archetype& a = *m_Archetypes[from];
+        const auto it = a.addEdges.find(id);
+        if (it != a.addEdges.end()) return it->second;
+
+        std::vector<ComponentId> types = a.types;
+        types.push_back(id);
+        const int to = FindArchetype(std::move(types));
+        m_Archetypes[from]->addEdges[id] = to;
+        m_Archetypes[to]->removeEdges[id] = from;
+        return to;
+    }
+
+    int World::ArchetypeWithout(int from, ComponentId id) {
+        Archetype& a = *m_Archetypes[from];
+        const auto it = a.removeEdges.find(id);
+        if (it != a.removeEdges.end()) return it->second;
+
+        std::vector<ComponentId> types = a.types;
+        types.erase(std::find(types.begin(), types.end(), id));
+        const int to = FindArchetype(std::move(types));
+        m_Archetypes[from]->removeEdges[id] = to;
+        m_Archetypes[to]->addEdges[id] = from;
+        return to;
+    }
+
+    void World::MoveEntity(Entity entity, int archetype) {
+        const Record record = m_Records[entity.index];
+        Archetype& from = *m_Archetypes[record.archetype];
+        const Chunk& source = from.chunks[record.chunk];
+
+        m_EntityCount--; // Place() counts it again
+        Place(entity, archetype);
+        Archetype& to = *m_Archetypes[archetype];
+        const Record& placed = m_Records[entity.index];
+        const Chunk& target = to.chunks[placed.chunk];
+
+        for (int c = 0; c < (int)from.types.size(); ++c) {
+            const ComponentInfo& info = GetComponentInfo(from.types[c]);
+            const int column = to.Column(from.types[c]);
+            if (column >= 0) info.move(to.At(target, column, placed.row), from.At(source, c, record.row));
+            else info.destroy(from.At(source, c, record.row));
+        }
+        RemoveRow(record.archetype, record.chunk, record.row);
+    }
+
+    void* World::AddRaw(Entity entity, ComponentId id) {
+        const Record* record = Find(entity);
+        if (!record || id < 0) return nullptr;
+        MoveEntity(entity, ArchetypeWith(record->archetype, id));
+        return GetRaw(entity, id);
+    }
+
+    void World::RemoveRaw(Entity entity, ComponentId id) {
+        const Record* record = Find(entity);
+        if (!record || id < 0 || m_Archetypes[record->archetype]->Column(id) < 0) return;
+        MoveEntity(entity, ArchetypeWithout(record->archetype, id));
+    }
+
+    // --- Deferred changes ---
+
+    // Called from query callbacks, possibly on several threads at once: only the command list
+    // and the free slots are touched, under the lock
+    Entity World::DeferCreate() {
+        std::lock_guard<std::mutex> lock(m_CommandMutex);
+        Entity entity;
+        if (!m_FreeSlots.empty()) {
+            entity.index = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+            entity.generation = m_Records[entity.index].generation;
+        }
+        else {
+            entity.index = (uint32_t)m_Records.size() + m_PendingSlots++;
+            entity.generation = 0;
+        }
+        m_Commands.push_back({ COMMAND_CREATE, entity, -1, nullptr });
+        return entity;
+    }
+
+    void World::Defer(CommandType type, Entity entity, ComponentId component) {
+        std::lock_guard<std::mutex> lock(m_CommandMutex);
+        m_Commands.push_back({ type, entity, component, nullptr });
+    }
+
+    void* World::DeferAdd(Entity entity, ComponentId component) {
+        if (component < 0) return nullptr;
+        void* value = AllocateValue(GetComponentInfo(component));
+        std::lock_guard<std::mutex> lock(m_CommandMutex);
+        m_Commands.push_back({ COMMAND_ADD, entity, component, value });
+        return value;
+    }
+
+    void World::Flush() {
+        // Commands may queue more commands only from inside a query, and none runs here
+        std::vector<Command> commands;
+        commands.swap(m_Commands);
+        m_Records.resize(m_Records.size() + m_PendingSlots);
+        m_PendingSlots = 0;
+
+        for (Command& command : commands) {
+            switch (command.type) {
+            case COMMAND_CREATE:
+                Place(command.entity, 0);
+                break;
+            case COMMAND_DESTROY:
+                DestroyNow(command.entity);
+                break;
+            case COMMAND_ADD: {
+                const ComponentInfo& info = GetComponentInfo(command.component);
+                void* slot = GetRaw(command.entity, command.component);
+                if (slot) info.destroy(slot);
+                else slot = AddRaw(command.entity, command.component);
+                if (slot) info.move(slot, command.value);
+                else info.destroy(command.value); // the entity died first
+                FreeValue(command.value, info);
+                break;
+            }
+            case COMMAND_REMOVE:
+                RemoveRaw(command.entity, command.component);
+                break;
+            }
+        }
+    }
+
+    void World::RunParallel(int count, int grain, const std::function<void(int, int)>& fn) {
+        ParallelFor(count, grain, fn, m_WorkerCount);
+    }
+
+}
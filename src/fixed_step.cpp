@@ -0,0 +1,64 @@
+#include "fixed_step.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "echlib.h"
+
+namespace ech {
+
+    // A single frame never feeds more than this into the accumulator (debugger pauses, loading hitches)
+    static constexpr double MaxFrameDelta = 0.25;
+
+    FixedStep::FixedStep(double hz, int maxStepsPerFrame) {
+        SetRate(hz);
+        SetMaxStepsPerFrame(maxStepsPerFrame);
+    }
+
+    void FixedStep::SetRate(double hz) {
+        m_Step = hz > 0.0 ? 1.0 / hz : 1.0 / 60.0;
+    }
+
+    void FixedStep::SetMaxStepsPerFrame(int steps) {
+        m_MaxSteps = std::max(1, steps);
+    }
+
+    int FixedStep::Advance(double frameDelta) {
+        frameDelta = std::clamp(frameDelta, 0.0, MaxFrameDelta);
+        m_Accumulator += frameDelta;
+        m_FrameTime = GetTime();
+
+        int steps = static_cast<int>(std::floor(m_Accumulator / m_Step));
+        if (steps > m_MaxSteps) {
+            // Keep the fractional part so Alpha() stays continuous, drop the rest
+            m_DroppedTicks += steps - m_MaxSteps;
+            m_Accumulator -= (steps - m_MaxSteps) * m_Step;
+            steps = m_MaxSteps;
+        }
+
+        m_Accumulator -= steps * m_Step;
+        if (m_Accumulator < 0.0) m_Accumulator = 0.0;
+        m_PendingSteps = steps;
+        return steps;
+    }
+
+    double FixedStep::TickEndTime() const {
+        // The last owed tick ends `m_Accumulator` before the frame time; earlier ticks one step apart
+        int tick = m_CurrentTick >= 0 ? m_CurrentTick : m_PendingSteps - 1;
+        int ticksAfter = std::max(0, m_PendingSteps - 1 - tick);
+        return m_FrameTime - m_Accumulator - ticksAfter * m_Step;
+    }
+
+    void FixedStep::Reset() {
+        m_Accumulator = 0.0;
+        m_PendingSteps = 0;
+        m_CurrentTick = -1;
+        m_TickCount = 0;
+        m_DroppedTicks = 0;
+    }
+
+    double FixedStep::FrameDelta() {
+        return static_cast<double>(GetDeltaTime());
+    }
+
+}
@@ -0,0 +1,285 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#elif defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define ECH_CPU_RELAX() _mm_pause()
+#else
+#define ECH_CPU_RELAX() std::this_thread::yield()
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include "input.hpp"
+#include "internal.hpp"
+
+namespace ech {
+
+    using PacerClock = std::chrono::steady_clock;
+
+    namespace {
+
+        constexpr int HistorySize = 240;
+
+        struct PacerState {
+            double period = 0.0;            // seconds, 0 = no software limit
+            bool vsync = false;
+
+            bool started = false;
+            PacerClock::time_point nextDeadline{};
+            PacerClock::time_point lastFrameEnd{};
+
+            // How late the OS wakes us from a coarse sleep. Decays slowly so a single lucky
+            // wake-up doesn't shrink the spin window too far.
+            double oversleep = 0.0005;
+            double lastSleep = 0.0;
+
+            double frameMs[HistorySize] = {};
+            double sleepMs[HistorySize] = {};
+            int historyCount = 0;
+            int historyHead = 0;
+        };
+
+        PacerState& State() {
+            static PacerState state;
+            return state;
+        }
+
+        const PacerClock::time_point s_ClockStart = PacerClock::now();
+
+#ifdef _WIN32
+        // High resolution waitable timers (Windows 10 1803+) beat Sleep()'s 1 ms granularity
+        HANDLE WaitableTimer() {
+            static HANDLE timer = [] {
+                HANDLE h = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+                if (!h) h = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+                return h;
+            }();
+            return timer;
+        }
+#endif
+
+        // Block (without spinning) until roughly `until`
+        void CoarseSleepUntil(PacerClock::time_point until) {
+#if defined(__linux__)
+            // steady_clock is CLOCK_MONOTONIC, so the deadline can be handed to the kernel as is
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(until.time_since_epoch()).count();
+            timespec ts;
+            ts.tv_sec = (time_t)(ns / 1000000000LL);
+            ts.tv_nsec = (long)(ns % 1000000000LL);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#elif defined(_WIN32)
+            auto remaining = until - PacerClock::now();
+            if (remaining <= PacerClock::duration::zero()) return;
+            HANDLE timer = WaitableTimer();
+            if (timer) {
+                LARGE_INTEGER due;
+                // Negative = relative, in 100 ns units
+                due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+                if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+                    WaitForSingleObject(timer, INFINITE);
+                    return;
+                }
+            }
+            std::this_thread::sleep_until(until);
+#else
+            std::this_thread::sleep_until(until);
+#endif
+        }
+
+        // Like CoarseSleepUntil, but wakes for window events so input callbacks run (and get their
+        // timestamps) as events arrive instead of at the next poll
+        void WaitEventsUntil(PacerClock::time_point until) {
+            for (;;) {
+                double remaining = std::chrono::duration<double>(until - PacerClock::now()).count();
+                if (remaining <= 0.0) return;
+                glfwWaitEventsTimeout(remaining);
+            }
+        }
+
+        bool ShouldPumpEvents() {
+            Window* window = GetDefaultWindow();
+            return IsInputEventsEnabled() && window && window->GetNativeHandle() && !window->IsHeadless();
+        }
+
+        // Sleep most of the way, then spin for the last stretch the OS can't hit precisely
+        void WaitUntil(PacerState& s, PacerClock::time_point deadline) {
+            double spinWindow = std::clamp(s.oversleep * 1.5 + 0.0001, 0.0002, 0.003);
+            auto coarseTarget = deadline - std::chrono::duration_cast<PacerClock::duration>(
+                std::chrono::duration<double>(spinWindow));
+
+            if (PacerClock::now() < coarseTarget) {
+                if (ShouldPumpEvents()) WaitEventsUntil(coarseTarget);
+                else CoarseSleepUntil(coarseTarget);
+                double late = std::chrono::duration<double>(PacerClock::now() - coarseTarget).count();
+                s.oversleep = std::max(std::max(late, 0.0), s.oversleep * 0.98);
+            }
+
+            while (PacerClock::now() < deadline) {
+                ECH_CPU_RELAX();
+            }
+        }
+
+        void PushHistory(PacerState& s, double frameMs, double sleepMs) {
+            s.frameMs[s.historyHead] = frameMs;
+            s.sleepMs[s.historyHead] = sleepMs;
+            s.historyHead = (s.historyHead + 1) % HistorySize;
+            if (s.historyCount < HistorySize) s.historyCount++;
+        }
+
+    }
+
+    void SetPacerPeriod(double seconds) {
+        PacerState& s = State();
+        s.period = seconds > 0.0 ? seconds : 0.0;
+        s.started = false; // re-anchor the deadlines on the next frame
+    }
+
+    double GetPacerPeriod() {
+        return State().period;
+    }
+
+    void SetPacerVSync(bool enabled) {
+        State().vsync = enabled;
+    }
+
+    void StartPacer() {
+        PacerState& s = State();
+        if (s.started) return;
+
+        auto now = PacerClock::now();
+        s.nextDeadline = now;
+        if (s.lastFrameEnd == PacerClock::time_point{}) s.lastFrameEnd = now;
+        s.started = true;
+    }
+
+    double PaceFrame() {
+        PacerState& s = State();
+        const bool firstFrame = s.lastFrameEnd == PacerClock::time_point{};
+        StartPacer();
+
+        double slept = 0.0;
+        if (s.period > 0.0) {
+            auto period = std::chrono::duration_cast<PacerClock::duration>(std::chrono::duration<double>(s.period));
+            // Absolute deadlines: a frame that finishes early doesn't shift the next one,
+            // so the average rate doesn't drift
+            s.nextDeadline += period;
+
+            auto now = PacerClock::now();
+            if (s.nextDeadline < now - period) {
+                // More than a frame behind (hitch, breakpoint, loading): resync instead of
+                // rushing through a burst of catch-up frames
+                s.nextDeadline = now;
+            }
+            else if (s.nextDeadline > now) {
+                WaitUntil(s, s.nextDeadline);
+                slept = std::chrono::duration<double>(PacerClock::now() - now).count();
+            }
+        }
+
+        auto end = PacerClock::now();
+        double delta = firstFrame ? 0.0 : std::chrono::duration<double>(end - s.lastFrameEnd).count();
+        s.lastFrameEnd = end;
+        s.lastSleep = slept;
+
+        if (!firstFrame) PushHistory(s, delta * 1000.0, slept * 1000.0);
+        return delta;
+    }
+
+    double GetLastPacerSleep() {
+        return State().lastSleep;
+    }
+
+    void SetFramePacing(FramePacingMode mode, int fps) {
+        switch (mode) {
+        case PACING_UNCAPPED:
+            SetPacerPeriod(0.0);
+            SetPacerVSync(false);
+            break;
+        case PACING_FIXED:
+            SetPacerPeriod(fps > 0 ? 1.0 / (double)fps : 0.0);
+            SetPacerVSync(false);
+            break;
+        case PACING_VSYNC:
+            SetPacerPeriod(0.0);
+            SetPacerVSync(true);
+            break;
+        }
+
+        Window* window = GetDefaultWindow();
+        if (window && window->GetNativeHandle()) {
+            glfwMakeContextCurrent(window->GetNativeHandle());
+            glfwSwapInterval(mode == PACING_VSYNC ? 1 : 0);
+        }
+    }
+
+    FramePacingMode GetFramePacing() {
+        const PacerState& s = State();
+        if (s.vsync) return PACING_VSYNC;
+        return s.period > 0.0 ? PACING_FIXED : PACING_UNCAPPED;
+    }
+
+    FrameTimeStats GetFrameTimeStats() {
+        const PacerState& s = State();
+        FrameTimeStats stats;
+        if (s.historyCount == 0) return stats;
+
+        std::vector<double> sorted(s.frameMs, s.frameMs + s.historyCount);
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0, sleepSum = 0.0;
+        for (int i = 0; i < s.historyCount; ++i) {
+            sum += s.frameMs[i];
+            sleepSum += s.sleepMs[i];
+        }
+        const double avg = sum / s.historyCount;
+
+        double variance = 0.0;
+        for (int i = 0; i < s.historyCount; ++i) {
+            double d = s.frameMs[i] - avg;
+            variance += d * d;
+        }
+
+        stats.samples = s.historyCount;
+        stats.minMs = sorted.front();
+        stats.maxMs = sorted.back();
+        stats.avgMs = avg;
+        stats.p50Ms = sorted[(sorted.size() - 1) / 2];
+        stats.p99Ms = sorted[(size_t)std::ceil((sorted.size() - 1) * 0.99)];
+        stats.jitterMs = std::sqrt(variance / s.historyCount);
+        stats.avgSleepMs = sleepSum / s.historyCount;
+        return stats;
+    }
+
+    void ResetFrameTimeStats() {
+        PacerState& s = State();
+        s.historyCount = 0;
+        s.historyHead = 0;
+    }
+
+    double GetTime() {
+        return std::chrono::duration<double>(PacerClock::now() - s_ClockStart).count();
+    }
+
+}
@@ -94,6 +94,22 @@ namespace ech {
         return prog;
     }
 
+    void UploadShapeUniforms() {
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+
+        unsigned int list[] = { shaderProgramShape, shaderProgramTexture, shaderProgramText };
+        for (unsigned int s : list) {
+            if (s == 0) continue;
+            glUseProgram(s);
+            ECH_STATS_SHADER(s);
+            glUniformMatrix4fv(glGetUniformLocation(s, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+            glUniformMatrix4fv(glGetUniformLocation(s, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+        }
+        glUseProgram((GLuint)current);
+        ECH_STATS_SHADER((unsigned int)current);
+    }
+
     void InitGraphics(GLFWwindow* window) {
         assert(window && "Window was null in InitGraphics");
         glfwMakeContextCurrent(window);
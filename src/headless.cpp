@@ -0,0 +1,170 @@
+#include "headless.hpp"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "echlib.h"
+#include "internal.hpp"
+
+namespace ech {
+
+    void CreateHeadlessWindow(int width, int height, const char* title) {
+        if (!GetDefaultWindow())
+            GetDefaultWindow() = new ech::Window(width, height, title, true);
+    }
+
+    bool CaptureFrame(Image& out) {
+        Window* window = GetDefaultWindow();
+        if (!window || !window->GetNativeHandle()) return false;
+
+        int w, h;
+        window->GetFramebufferSize(w, h);
+        if (w <= 0 || h <= 0) return false;
+
+        out.width = w;
+        out.height = h;
+        out.pixels.resize((size_t)w * h * 4);
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, out.pixels.data());
+
+        // GL returns the bottom row first
+        const size_t stride = (size_t)w * 4;
+        std::vector<unsigned char> row(stride);
+        for (int y = 0; y < h / 2; ++y) {
+            unsigned char* top = out.pixels.data() + y * stride;
+            unsigned char* bottom = out.pixels.data() + (h - 1 - y) * stride;
+            std::memcpy(row.data(), top, stride);
+            std::memcpy(top, bottom, stride);
+            std::memcpy(bottom, row.data(), stride);
+        }
+        return true;
+    }
+
+    bool SaveFrame(const std::string& path) {
+        Image frame;
+        if (!CaptureFrame(frame)) return false;
+        return SaveImageFile(frame, path);
+    }
+
+    bool LoadImageFile(const std::string& path, Image& out) {
+        int w, h, channels;
+        stbi_set_flip_vertically_on_load(false);
+        unsigned char* data = stbi_load(path.c_str(), &w, &h, &channels, 4);
+        if (!data) {
+            std::cerr << "Failed to load image: " << path << std::endl;
+            return false;
+        }
+        out.width = w;
+        out.height = h;
+        out.pixels.assign(data, data + (size_t)w * h * 4);
+        stbi_image_free(data);
+        return true;
+    }
+
+    bool SaveImageFile(const Image& image, const std::string& path) {
+        if (image.width <= 0 || image.height <= 0) return false;
+        if (!stbi_write_png(path.c_str(), image.width, image.height, 4, image.pixels.data(), image.width * 4)) {
+            std::cerr << "Failed to write image: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    ImageDiff CompareImages(const Image& a, const Image& b, int tolerance, double maxDifferentRatio) {
+        ImageDiff diff;
+        if (a.width != b.width || a.height != b.height || a.pixels.size() != b.pixels.size()) {
+            diff.differentPixels = std::max(a.width * a.height, b.width * b.height);
+            diff.maxDifference = 255;
+            diff.meanDifference = 255.0;
+            return diff;
+        }
+
+        const size_t pixelCount = (size_t)a.width * a.height;
+        unsigned long long total = 0;
+        for (size_t i = 0; i < pixelCount; ++i) {
+            int worst = 0;
+            for (int c = 0; c < 4; ++c) {
+                int d = std::abs((int)a.pixels[i * 4 + c] - (int)b.pixels[i * 4 + c]);
+                total += d;
+                worst = std::max(worst, d);
+            }
+            diff.maxDifference = std::max(diff.maxDifference, worst);
+            if (worst > tolerance) diff.differentPixels++;
+        }
+
+        diff.meanDifference = pixelCount ? (double)total / (double)(pixelCount * 4) : 0.0;
+        diff.matches = diff.differentPixels <= (int)(maxDifferentRatio * (double)pixelCount);
+        return diff;
+    }
+
+    ImageDiff CompareFrameToGolden(const std::string& goldenPath, int tolerance,
+        double maxDifferentRatio, bool writeIfMissing) {
+        Image frame;
+        if (!CaptureFrame(frame)) return ImageDiff{};
+
+        if (!FileExists(goldenPath)) {
+            if (writeIfMissing && SaveImageFile(frame, goldenPath)) {
+                ImageDiff created;
+                created.matches = true;
+                return created;
+            }
+            std::cerr << "Golden image not found: " << goldenPath << std::endl;
+            return ImageDiff{};
+        }
+
+        Image golden;
+        if (!LoadImageFile(goldenPath, golden)) return ImageDiff{};
+        return CompareImages(frame, golden, tolerance, maxDifferentRatio);
+    }
+
+    FrameTimings RunFrames(int frames, const std::function<void(int)>& drawFrame, bool syncEachFrame) {
+        FrameTimings result;
+        if (frames <= 0 || !GetDefaultWindow()) return result;
+
+        const int previousLimit = GetFpsLimit();
+        SetFpsLimit(0);
+
+        std::vector<double> samples;
+        samples.reserve(frames);
+
+        auto runStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            auto start = std::chrono::steady_clock::now();
+
+            StartDrawing();
+            if (drawFrame) drawFrame(i);
+            if (syncEachFrame) glFinish();
+            EndDrawing();
+
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        glFinish();
+        auto runEnd = std::chrono::steady_clock::now();
+
+        SetFpsLimit(previousLimit);
+
+        result.frames = frames;
+        result.totalMs = std::chrono::duration<double, std::milli>(runEnd - runStart).count();
+        result.avgMs = result.totalMs / frames;
+
+        std::sort(samples.begin(), samples.end());
+        result.minMs = samples.front();
+        result.maxMs = samples.back();
+        result.p50Ms = samples[(samples.size() - 1) / 2];
+        result.p99Ms = samples[(size_t)((samples.size() - 1) * 0.99)];
+        return result;
+    }
+
+}
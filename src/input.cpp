@@ -0,0 +1,353 @@
+#include "Echlib.hpp"
+
+#include <GLFW/glfw3.h>
+#include <vector>
+
+#include "internal.hpp"
+
+namespace ech {
+
+    namespace {
+
+        constexpr int EventCapacity = 1024; // power of two
+
+        // Callbacks that were installed on a window before ours, called after we record the event
+        struct ChainedCallbacks {
+            GLFWwindow* window;
+            GLFWkeyfun key;
+            GLFWmousebuttonfun mouseButton;
+            GLFWcursorposfun cursorPos;
+            GLFWscrollfun scroll;
+        };
+
+        struct InputState {
+            InputSnapshot live;         // written by the callbacks
+            InputSnapshot snapshot;     // what the queries read, published once per poll
+
+            bool eventsEnabled = false;
+            InputEvent events[EventCapacity];
+            unsigned int eventHead = 0;     // next to pop
+            unsigned int eventTail = 0;     // next to push
+            long long droppedEvents = 0;
+
+            std::vector<ChainedCallbacks> chained;     // one per window with our callbacks
+        };
+
+        InputState& State() {
+            static InputState state;
+            return state;
+        }
+
+        const ChainedCallbacks& Chained(InputState& s, GLFWwindow* window) {
+            static const ChainedCallbacks none = {};
+            for (const ChainedCallbacks& c : s.chained) {
+                if (c.window == window) return c;
+            }
+            return none;
+        }
+
+        int KeyFromGlfw(int glfwKey);
+        int MouseButtonFromGlfw(int glfwButton);
+
+        void PushEvent(InputState& s, InputEventType type, int code, float x, float y) {
+            if (s.eventTail - s.eventHead == (unsigned int)EventCapacity) {
+                s.eventHead++;
+                s.droppedEvents++;
+            }
+            InputEvent& e = s.events[s.eventTail & (EventCapacity - 1)];
+            e.type = type;
+            e.code = code;
+            e.time = GetTime();
+            e.x = x;
+            e.y = y;
+            s.eventTail++;
+        }
+
+        inline void SetBit(uint64_t* bits, int index) { bits[index >> 6] |= (uint64_t)1 << (index & 63); }
+        inline void ClearBit(uint64_t* bits, int index) { bits[index >> 6] &= ~((uint64_t)1 << (index & 63)); }
+
+        void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+            InputState& s = State();
+            if (key >= 0 && key < InputKeyCount) {
+                InputSnapshot& in = s.live;
+                if (action == GLFW_PRESS) {
+                    SetBit(in.keysDown, key);
+                    SetBit(in.keysPressed, key);
+                }
+                else if (action == GLFW_RELEASE) {
+                    ClearBit(in.keysDown, key);
+                    SetBit(in.keysReleased, key);
+                }
+                // GLFW_REPEAT: the key is already down, not a new press
+            }
+            if (s.eventsEnabled) {
+                InputEventType type = action == GLFW_PRESS ? INPUT_KEY_DOWN
+                    : action == GLFW_RELEASE ? INPUT_KEY_UP : INPUT_KEY_REPEAT;
+                PushEvent(s, type, KeyFromGlfw(key), (float)s.live.mouseX, (float)s.live.mouseY);
+            }
+            if (GLFWkeyfun prev = Chained(s, window).key) prev(window, key, scancode, action, mods);
+        }
+
+        void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+            InputState& s = State();
+            if (button >= 0 && button < InputButtonCount) {
+                InputSnapshot& in = s.live;
+                uint8_t bit = (uint8_t)(1u << button);
+                if (action == GLFW_PRESS) {
+                    in.buttonsDown |= bit;
+                    in.buttonsPressed |= bit;
+                }
+                else {
+                    in.buttonsDown &= (uint8_t)~bit;
+                    in.buttonsReleased |= bit;
+                }
+            }
+            if (s.eventsEnabled) {
+                PushEvent(s, action == GLFW_PRESS ? INPUT_MOUSE_DOWN : INPUT_MOUSE_UP,
+                    MouseButtonFromGlfw(button), (float)s.live.mouseX, (float)s.live.mouseY);
+            }
+            if (GLFWmousebuttonfun prev = Chained(s, window).mouseButton) prev(window, button, action, mods);
+        }
+
+        void CursorPosCallback(GLFWwindow* window, double x, double y) {
+            InputState& s = State();
+            s.live.mouseX = x;
+            s.live.mouseY = y;
+            if (s.eventsEnabled) PushEvent(s, INPUT_MOUSE_MOVE, -1, (float)x, (float)y);
+            if (GLFWcursorposfun prev = Chained(s, window).cursorPos) prev(window, x, y);
+        }
+
+        void ScrollCallback(GLFWwindow* window, double dx, double dy) {
+            InputState& s = State();
+            s.live.scrollX += dx;
+            s.live.scrollY += dy;
+            if (s.eventsEnabled) PushEvent(s, INPUT_MOUSE_SCROLL, -1, (float)dx, (float)dy);
+            if (GLFWscrollfun prev = Chained(s, window).scroll) prev(window, dx, dy);
+        }
+
+        int TranslateKey(int key) {
+            if (key >= KEY_A && key <= KEY_Z) return GLFW_KEY_A + (key - KEY_A);
+            if (key >= KEY_0 && key <= KEY_9) return GLFW_KEY_0 + (key - KEY_0);
+            if (key >= KEY_F1 && key <= KEY_F12) return GLFW_KEY_F1 + (key - KEY_F1);
+            if (key >= KEY_KP_0 && key <= KEY_KP_9) return GLFW_KEY_KP_0 + (key - KEY_KP_0);
+
+            switch (key) {
+            case KEY_SPACE: return GLFW_KEY_SPACE;
+            case KEY_ESCAPE: return GLFW_KEY_ESCAPE;
+            case KEY_ENTER: return GLFW_KEY_ENTER;
+            case KEY_UP: return GLFW_KEY_UP;
+            case KEY_DOWN: return GLFW_KEY_DOWN;
+            case KEY_LEFT: return GLFW_KEY_LEFT;
+            case KEY_RIGHT: return GLFW_KEY_RIGHT;
+            case KEY_TAB: return GLFW_KEY_TAB;
+            case KEY_BACKSPACE: return GLFW_KEY_BACKSPACE;
+            case KEY_INSERT: return GLFW_KEY_INSERT;
+            case KEY_DELETE: return GLFW_KEY_DELETE;
+            case KEY_HOME: return GLFW_KEY_HOME;
+            case KEY_END: return GLFW_KEY_END;
+            case KEY_PAGE_UP: return GLFW_KEY_PAGE_UP;
+            case KEY_PAGE_DOWN: return GLFW_KEY_PAGE_DOWN;
+            case KEY_LEFT_SHIFT: return GLFW_KEY_LEFT_SHIFT;
+            case KEY_RIGHT_SHIFT: return GLFW_KEY_RIGHT_SHIFT;
+            case KEY_LEFT_CONTROL: return GLFW_KEY_LEFT_CONTROL;
+            case KEY_RIGHT_CONTROL: return GLFW_KEY_RIGHT_CONTROL;
+            case KEY_LEFT_ALT: return GLFW_KEY_LEFT_ALT;
+            case KEY_RIGHT_ALT: return GLFW_KEY_RIGHT_ALT;
+            case KEY_LEFT_SUPER: return GLFW_KEY_LEFT_SUPER;
+            case KEY_RIGHT_SUPER: return GLFW_KEY_RIGHT_SUPER;
+            case KEY_MENU: return GLFW_KEY_MENU;
+            case KEY_CAPS_LOCK: return GLFW_KEY_CAPS_LOCK;
+            case KEY_SCROLL_LOCK: return GLFW_KEY_SCROLL_LOCK;
+            case KEY_NUM_LOCK: return GLFW_KEY_NUM_LOCK;
+            case KEY_PRINT_SCREEN: return GLFW_KEY_PRINT_SCREEN;
+            case KEY_PAUSE: return GLFW_KEY_PAUSE;
+            case KEY_APOSTROPHE: return GLFW_KEY_APOSTROPHE;
+            case KEY_COMMA: return GLFW_KEY_COMMA;
+            case KEY_MINUS: return GLFW_KEY_MINUS;
+            case KEY_PERIOD: return GLFW_KEY_PERIOD;
+            case KEY_SLASH: return GLFW_KEY_SLASH;
+            case KEY_SEMICOLON: return GLFW_KEY_SEMICOLON;
+            case KEY_EQUAL: return GLFW_KEY_EQUAL;
+            case KEY_LEFT_BRACKET: return GLFW_KEY_LEFT_BRACKET;
+            case KEY_BACKSLASH: return GLFW_KEY_BACKSLASH;
+            case KEY_RIGHT_BRACKET: return GLFW_KEY_RIGHT_BRACKET;
+            case KEY_GRAVE_ACCENT: return GLFW_KEY_GRAVE_ACCENT;
+            case KEY_KP_DECIMAL: return GLFW_KEY_KP_DECIMAL;
+            case KEY_KP_DIVIDE: return GLFW_KEY_KP_DIVIDE;
+            case KEY_KP_MULTIPLY: return GLFW_KEY_KP_MULTIPLY;
+            case KEY_KP_SUBTRACT: return GLFW_KEY_KP_SUBTRACT;
+            case KEY_KP_ADD: return GLFW_KEY_KP_ADD;
+            case KEY_KP_ENTER: return GLFW_KEY_KP_ENTER;
+            case KEY_KP_EQUAL: return GLFW_KEY_KP_EQUAL;
+            default: return GLFW_KEY_UNKNOWN;
+            }
+        }
+
+        int TranslateMouseButton(int button) {
+            switch (button) {
+            case MOUSE_LEFT_BUTTON:   return GLFW_MOUSE_BUTTON_LEFT;
+            case MOUSE_RIGHT_BUTTON:  return GLFW_MOUSE_BUTTON_RIGHT;
+            case MOUSE_MIDDLE_BUTTON: return GLFW_MOUSE_BUTTON_MIDDLE;
+            case MOUSE_BUTTON_4:      return GLFW_MOUSE_BUTTON_4;
+            case MOUSE_BUTTON_5:      return GLFW_MOUSE_BUTTON_5;
+            default: return -1;
+            }
+        }
+
+        // GLFW code -> Key / MouseKeys, the inverse of the Translate functions
+        int KeyFromGlfw(int glfwKey) {
+            static const auto table = [] {
+                struct { int keys[InputKeyCount]; } t;
+                for (int& k : t.keys) k = -1;
+                for (int k = 0; k < KEY_COUNT; ++k) {
+                    int g = TranslateKey(k);
+                    if (g >= 0 && g < InputKeyCount) t.keys[g] = k;
+                }
+                return t;
+            }();
+            return glfwKey >= 0 && glfwKey < InputKeyCount ? table.keys[glfwKey] : -1;
+        }
+
+        int MouseButtonFromGlfw(int glfwButton) {
+            for (int b = MOUSE_LEFT_BUTTON; b <= MOUSE_BUTTON_5; ++b) {
+                if (TranslateMouseButton(b) == glfwButton) return b;
+            }
+            return -1;
+        }
+
+    }
+
+    void InstallInputCallbacks(GLFWwindow* window) {
+        InputState& s = State();
+        const bool first = s.chained.empty();
+        ChainedCallbacks c;
+        c.window = window;
+        c.key = glfwSetKeyCallback(window, KeyCallback);
+        c.mouseButton = glfwSetMouseButtonCallback(window, MouseButtonCallback);
+        c.cursorPos = glfwSetCursorPosCallback(window, CursorPosCallback);
+        c.scroll = glfwSetScrollCallback(window, ScrollCallback);
+        s.chained.push_back(c);
+
+        // The cursor callback only fires on movement
+        if (first) {
+            glfwGetCursorPos(window, &s.live.mouseX, &s.live.mouseY);
+            s.snapshot.mouseX = s.live.mouseX;
+            s.snapshot.mouseY = s.live.mouseY;
+        }
+    }
+
+    void RemoveInputCallbacks(GLFWwindow* window) {
+        InputState& s = State();
+        for (size_t i = 0; i < s.chained.size(); ++i) {
+            if (s.chained[i].window == window) {
+                s.chained.erase(s.chained.begin() + i);
+                return;
+            }
+        }
+    }
+
+    void PumpEvents() {
+        InputState& s = State();
+        glfwPollEvents();
+
+        // Publish everything since the last poll (including events delivered while the frame
+        // limiter waited), then start collecting the next frame's edges
+        s.snapshot = s.live;
+        InputSnapshot& in = s.live;
+        for (int i = 0; i < InputKeyWords; ++i) {
+            in.keysPressed[i] = 0;
+            in.keysReleased[i] = 0;
+        }
+        in.buttonsPressed = 0;
+        in.buttonsReleased = 0;
+        in.scrollX = 0.0;
+        in.scrollY = 0.0;
+
+        // During a replay the recorded snapshot replaces live input
+        if (ReplayInputFrame(s.snapshot)) ClearInputEvents();
+    }
+
+    const InputSnapshot& GetInputSnapshot() {
+        return State().snapshot;
+    }
+
+    int IsKeyPressed(int key) {
+        return InputSnapshot::Test(State().snapshot.keysPressed, TranslateKey(key));
+    }
+
+    int IsKeyHeld(int key) {
+        return InputSnapshot::Test(State().snapshot.keysDown, TranslateKey(key));
+    }
+
+    int IsKeyReleased(int key) {
+        return InputSnapshot::Test(State().snapshot.keysReleased, TranslateKey(key));
+    }
+
+    int IsMouseButtonPressed(int button) {
+        return InputSnapshot::Test(State().snapshot.buttonsPressed, TranslateMouseButton(button));
+    }
+
+    int IsMouseButtonHeld(int button) {
+        return InputSnapshot::Test(State().snapshot.buttonsDown, TranslateMouseButton(button));
+    }
+
+    int IsMouseButtonReleased(int button) {
+        return InputSnapshot::Test(State().snapshot.buttonsReleased, TranslateMouseButton(button));
+    }
+
+    void EnableInputEvents(bool enabled) {
+        InputState& s = State();
+        if (s.eventsEnabled == enabled) return;
+        s.eventsEnabled = enabled;
+        ClearInputEvents();
+    }
+
+    bool IsInputEventsEnabled() {
+        return State().eventsEnabled;
+    }
+
+    bool PollInputEvent(InputEvent& event) {
+        InputState& s = State();
+        if (s.eventHead == s.eventTail) return false;
+        event = s.events[s.eventHead & (EventCapacity - 1)];
+        s.eventHead++;
+        return true;
+    }
+
+    bool PollInputEventUntil(double time, InputEvent& event) {
+        InputState& s = State();
+        if (s.eventHead == s.eventTail) return false;
+        const InputEvent& next = s.events[s.eventHead & (EventCapacity - 1)];
+        if (next.time > time) return false;
+        event = next;
+        s.eventHead++;
+        return true;
+    }
+
+    int GetInputEventCount() {
+        return (int)(State().eventTail - State().eventHead);
+    }
+
+    long long GetDroppedInputEvents() {
+        return State().droppedEvents;
+    }
+
+    void ClearInputEvents() {
+        InputState& s = State();
+        s.eventHead = s.eventTail = 0;
+        s.droppedEvents = 0;
+    }
+
+    float GetMouseX() {
+        return (float)State().snapshot.mouseX;
+    }
+
+    float GetMouseY() {
+        return (float)State().snapshot.mouseY;
+    }
+
+    float GetMouseWheel() {
+        return (float)State().snapshot.scrollY;
+    }
+
+}
@@ -0,0 +1,343 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace ech {
+
+    struct JobNode {
+        std::function<void()> fn;
+        JobCounter* counter;
+    };
+
+    namespace {
+
+        // Chase-Lev deque, with the memory orderings of Le et al., "Correct and Efficient
+        // Work-Stealing for Weak Memory Models". The owner pushes and pops at the bottom, other
+        // threads steal from the top; only taking the last job needs a compare-and-swap.
+        class WorkDeque {
+        public:
+            WorkDeque() {
+                m_Rings.emplace_back(new Ring(256));
+                m_Ring.store(m_Rings.back().get(), std::memory_order_relaxed);
+            }
+
+            WorkDeque(const WorkDeque&) = delete;
+            WorkDeque& operator=(const WorkDeque&) = delete;
+
+            void Push(JobNode* job) {
+                const int64_t b = m_Bottom.load(std::memory_order_relaxed);
+                const int64_t t = m_Top.load(std::memory_order_acquire);
+                Ring* ring = m_Ring.load(std::memory_order_relaxed);
+                if (b - t > ring->mask) {
+                    // Thieves may still be reading the old ring, so it is kept
+                    m_Rings.emplace_back(new Ring((ring->mask + 1) * 2));
+                    Ring* grown = m_Rings.back().get();
+                    for (int64_t i = t; i < b; ++i) grown->Put(i, ring->Get(i));
+                    m_Ring.store(grown, std::memory_order_release);
+                    ring = grown;
+                }
+                ring->Put(b, job);
+                std::atomic_thread_fence(std::memory_order_release);
+                m_Bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            JobNode* Pop() {
+                const int64_t b = m_Bottom.load(std::memory_order_relaxed) - 1;
+                Ring* ring = m_Ring.load(std::memory_order_relaxed);
+                m_Bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = m_Top.load(std::memory_order_relaxed);
+                if (t > b) {
+                    m_Bottom.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                JobNode* job = ring->Get(b);
+                if (t == b) {
+                    // The last job: race the thieves for it
+                    if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+                    m_Bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                return job;
+            }
+
+            // nullptr when empty or when another thread took the job first
+            JobNode* Steal() {
+                int64_t t = m_Top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const int64_t b = m_Bottom.load(std::memory_order_acquire);
+                if (t >= b) return nullptr;
+                JobNode* job = m_Ring.load(std::memory_order_acquire)->Get(t);
+                if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+                return job;
+            }
+
+        private:
+            struct Ring {
+                explicit Ring(int64_t capacity) : mask(capacity - 1), items(new std::atomic<JobNode*>[(size_t)capacity]) {}
+                // Slots are published with release stores, so a thief that reads one sees the job
+                JobNode* Get(int64_t i) const { return items[(size_t)(i & mask)].load(std::memory_order_acquire); }
+                void Put(int64_t i, JobNode* job) { items[(size_t)(i & mask)].store(job, std::memory_order_release); }
+
+                int64_t mask;
+                std::unique_ptr<std::atomic<JobNode*>[]> items;
+            };
+
+            alignas(64) std::atomic<int64_t> m_Top{ 0 };
+            alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+            std::atomic<Ring*> m_Ring{ nullptr };
+            std::vector<std::unique_ptr<Ring>> m_Rings;     // the current one last
+        };
+
+        thread_local int t_Deque = -1;
+        thread_local uint64_t t_Epoch = 0;
+        thread_local uint32_t t_Random = 0x9e3779b9u;
+
+        // Failed searches before an idle worker goes to sleep
+        constexpr int IdleSpins = 64;
+
+    }
+
+    struct JobScheduler {
+        ~JobScheduler() { Stop(); }
+
+        static JobScheduler& Get() {
+            static JobScheduler scheduler;
+            return scheduler;
+        }
+
+        void EnsureStarted() {
+            if (started.load(std::memory_order_acquire)) return;
+            std::lock_guard<std::mutex> lock(startMutex);
+            if (!started.load(std::memory_order_relaxed)) Start();
+        }
+
+        void Start() {
+            const int count = workerCount >= 0 ? workerCount : std::max(0, (int)std::thread::hardware_concurrency() - 1);
+            deques.clear();
+            for (int i = 0; i <= count; ++i) deques.emplace_back(new WorkDeque());
+            starter = std::this_thread::get_id();
+            epoch++;
+            for (int i = 1; i <= count; ++i) threads.emplace_back([this, i] { WorkerLoop(i); });
+            started.store(true, std::memory_order_release);
+        }
+
+        void Stop() {
+            std::lock_guard<std::mutex> startLock(startMutex);
+            if (!started.load(std::memory_order_relaxed)) return;
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stop.store(true);
+            }
+            wake.notify_all();
+            for (std::thread& t : threads) t.join();
+            threads.clear();
+
+            // Whatever is still queued runs here, so its counters finish
+            const int self = Current();
+            while (JobNode* job = Find(self)) Execute(job);
+            deques.clear();
+            stop.store(false);
+            started.store(false, std::memory_order_release);
+        }
+
+        // Deque owned by the calling thread, or -1
+        int Current() const {
+            if (t_Deque >= 0 && t_Epoch == epoch) return t_Deque;
+            return std::this_thread::get_id() == starter ? 0 : -1;
+        }
+
+        void Submit(JobNode* job, JobCounter* dependency) {
+            if (job->counter) job->counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+            if (dependency) {
+                std::lock_guard<std::mutex> lock(dependency->m_Mutex);
+                if (!dependency->IsDone()) {
+                    dependency->m_Waiters.push_back(job);
+                    return;
+                }
+            }
+            Schedule(job);
+        }
+
+        void Schedule(JobNode* job) {
+            const int self = Current();
+            if (self >= 0) deques[(size_t)self]->Push(job);
+            else {
+                std::lock_guard<std::mutex> lock(injectMutex);
+                injected.push_back(job);
+                injectedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            // Pairs with the sleeping worker's count and check: one of us sees the other
+            queued.fetch_add(1);
+            if (sleeping.load() > 0) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                wake.notify_one();
+            }
+        }
+
+        JobNode* Find(int self) {
+            if (self >= 0) {
+                if (JobNode* job = deques[(size_t)self]->Pop()) return job;
+            }
+            if (injectedCount.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(injectMutex);
+                if (!injected.empty()) {
+                    JobNode* job = injected.front();
+                    injected.pop_front();
+                    injectedCount.fetch_sub(1, std::memory_order_relaxed);
+                    return job;
+                }
+            }
+
+            // Victims from a random start, so thieves spread out
+            t_Random ^= t_Random << 13;
+            t_Random ^= t_Random >> 17;
+            t_Random ^= t_Random << 5;
+            const size_t n = deques.size();
+            const size_t start = t_Random % n;
+            for (size_t i = 0; i < n; ++i) {
+                const size_t victim = (start + i) % n;
+                if ((int)victim == self) continue;
+                if (JobNode* job = deques[victim]->Steal()) return job;
+            }
+            return nullptr;
+        }
+
+        void Execute(JobNode* job) {
+            queued.fetch_sub(1);
+            job->fn();
+            JobCounter* counter = job->counter;
+            delete job;
+            if (counter) Finish(*counter);
+        }
+
+        void Finish(JobCounter& counter) {
+            int pending = counter.m_Pending.load(std::memory_order_relaxed);
+            while (pending > 1) {
+                if (counter.m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) return;
+            }
+            // Maybe the last one: the drop to zero happens under the lock, so a job being held
+            // back isn't missed and the counter isn't destroyed while still in use here
+            std::vector<JobNode*> ready;
+            {
+                std::lock_guard<std::mutex> lock(counter.m_Mutex);
+                if (counter.m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter.m_Waiters);
+            }
+            for (JobNode* job : ready) Schedule(job);
+        }
+
+        void WorkerLoop(int index) {
+            t_Deque = index;
+            t_Epoch = epoch;
+            t_Random = 0x9e3779b9u * (uint32_t)index | 1u;
+
+            int idle = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (JobNode* job = Find(index)) {
+                    Execute(job);
+                    idle = 0;
+                    continue;
+                }
+                if (++idle < IdleSpins) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                idle = 0;
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleeping.fetch_add(1);
+                wake.wait(lock, [this] { return queued.load() > 0 || stop.load(); });
+                sleeping.fetch_sub(1);
+            }
+        }
+
+        std::vector<std::unique_ptr<WorkDeque>> deques;    // 0 belongs to the thread that started the workers
+        std::vector<std::thread> threads;
+        std::thread::id starter;
+        uint64_t epoch = 0;
+        int workerCount = -1;
+
+        // Jobs from threads without a deque
+        std::mutex injectMutex;
+        std::deque<JobNode*> injected;
+        std::atomic<int> injectedCount{ 0 };
+
+        std::atomic<int> queued{ 0 };                       // scheduled and not yet taken
+        std::atomic<int> sleeping{ 0 };
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<bool> stop{ false };
+
+        std::mutex startMutex;
+        std::atomic<bool> started{ false };
+    };
+
+    JobCounter::~JobCounter() {
+        // Waits out a Finish() that brought the count to zero
+        std::lock_guard<std::mutex> lock(m_Mutex);
+    }
+
+    void RunJob(std::function<void()> fn, JobCounter* counter, JobCounter* dependency) {
+        JobScheduler& s = JobScheduler::Get();
+        s.EnsureStarted();
+        s.Submit(new JobNode{ std::move(fn), counter }, dependency);
+    }
+
+    void WaitForJobs(JobCounter& counter) {
+        if (counter.IsDone()) return;
+        JobScheduler& s = JobScheduler::Get();
+        s.EnsureStarted();
+        const int self = s.Current();
+        while (!counter.IsDone()) {
+            if (JobNode* job = s.Find(self)) s.Execute(job);
+            else std::this_thread::yield();
+        }
+    }
+
+    void ParallelFor(int count, int grain, const std::function<void(int, int)>& fn, int maxWorkers) {
+        if (count <= 0) return;
+        JobScheduler& s = JobScheduler::Get();
+        s.EnsureStarted();
+
+        int workers = (int)s.threads.size();
+        if (maxWorkers >= 0) workers = std::min(workers, maxWorkers);
+        if (grain <= 0) grain = std::max(1, count / ((workers + 1) * 4));
+        const int helpers = std::min(workers, (count - 1) / grain);
+        if (helpers <= 0) {
+            fn(0, count);
+            return;
+        }
+
+        // Every participant pulls chunks until none are left, so a late or slow helper costs
+        // nothing
+        std::atomic<int> next{ 0 };
+        auto work = [&] {
+            for (;;) {
+                const int begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count) return;
+                fn(begin, begin + std::min(grain, count - begin));
+            }
+        };
+        JobCounter done;
+        for (int i = 0; i < helpers; ++i) RunJob(work, &done);
+        work();
+        WaitForJobs(done);
+    }
+
+    int GetJobWorkerCount() {
+        JobScheduler& s = JobScheduler::Get();
+        s.EnsureStarted();
+        return (int)s.threads.size();
+    }
+
+    void SetJobWorkerCount(int count) {
+        JobScheduler& s = JobScheduler::Get();
+        s.Stop();
+        std::lock_guard<std::mutex> lock(s.startMutex);
+        s.workerCount = count;
+    }
+
+}
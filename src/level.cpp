@@ -0,0 +1,366 @@
+#include "level.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "level_internal.hpp"
+#include "tilemap.hpp"
+
+namespace ech {
+
+    namespace {
+
+        const LevelFileHeader& Header(const unsigned char* data) {
+            return *reinterpret_cast<const LevelFileHeader*>(data);
+        }
+
+        bool WriteCompiled(const std::string& path, const std::vector<uint64_t>& data, size_t size) {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            return file && (bool)file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)size);
+        }
+
+        // Every offset and range in the file stays inside it, so the accessors can trust it
+        bool Validate(const unsigned char* data, size_t size) {
+            if (size < sizeof(LevelFileHeader)) return false;
+            const LevelFileHeader& header = Header(data);
+            if (std::memcmp(header.magic, LevelMagic, 4) != 0 || header.version != LevelVersion) return false;
+
+            const char* base = reinterpret_cast<const char*>(data);
+            for (const LevelFileSection& section : header.sections) {
+                if (section.offset % 8 != 0 || section.offset > size || section.size > size - section.offset) return false;
+            }
+            auto count = [&](int section, size_t recordSize) {
+                return header.sections[section].size % recordSize == 0 ? (size_t)(header.sections[section].size / recordSize) : (size_t)-1;
+            };
+            auto at = [&](int section) { return base + header.sections[section].offset; };
+
+            const size_t stringBytes = (size_t)header.sections[LEVEL_STRINGS].size;
+            if (stringBytes == 0 || at(LEVEL_STRINGS)[stringBytes - 1] != '\0') return false;
+
+            const size_t objects = count(LEVEL_OBJECT_X, sizeof(float));
+            const size_t points = count(LEVEL_POINTS, 2 * sizeof(float));
+            const size_t tiles = count(LEVEL_TILES, sizeof(uint32_t));
+            if (objects == (size_t)-1 || points == (size_t)-1 || tiles == (size_t)-1) return false;
+            for (int s = LEVEL_OBJECT_X; s <= LEVEL_OBJECT_POINT_COUNT; ++s) {
+                if (count(s, 4) != objects) return false;
+            }
+
+            const size_t tilesets = count(LEVEL_TILESETS, sizeof(LevelTileset));
+            const size_t tileLayers = count(LEVEL_TILE_LAYERS, sizeof(LevelTileLayer));
+            const size_t objectLayers = count(LEVEL_OBJECT_LAYERS, sizeof(LevelObjectLayer));
+            const size_t dependencies = count(LEVEL_DEPENDENCIES, sizeof(LevelDependency));
+            if (tilesets == (size_t)-1 || tileLayers == (size_t)-1 || objectLayers == (size_t)-1 || dependencies == (size_t)-1) return false;
+
+            const LevelTileset* tilesetRecords = reinterpret_cast<const LevelTileset*>(at(LEVEL_TILESETS));
+            for (size_t i = 0; i < tilesets; ++i) {
+                if (tilesetRecords[i].name >= stringBytes || tilesetRecords[i].image >= stringBytes) return false;
+            }
+            const LevelTileLayer* tileLayerRecords = reinterpret_cast<const LevelTileLayer*>(at(LEVEL_TILE_LAYERS));
+            for (size_t i = 0; i < tileLayers; ++i) {
+                const LevelTileLayer& layer = tileLayerRecords[i];
+                if (layer.name >= stringBytes || layer.width < 0 || layer.height < 0
+                    || layer.firstTile > tiles || (uint64_t)layer.width * (uint64_t)layer.height > tiles - layer.firstTile) return false;
+            }
+            const LevelObjectLayer* objectLayerRecords = reinterpret_cast<const LevelObjectLayer*>(at(LEVEL_OBJECT_LAYERS));
+            for (size_t i = 0; i < objectLayers; ++i) {
+                const LevelObjectLayer& layer = objectLayerRecords[i];
+                if (layer.name >= stringBytes || layer.firstObject > objects || layer.objectCount > objects - layer.firstObject) return false;
+            }
+            const uint32_t* names = reinterpret_cast<const uint32_t*>(at(LEVEL_OBJECT_NAME));
+            const uint32_t* types = reinterpret_cast<const uint32_t*>(at(LEVEL_OBJECT_TYPE));
+            const uint32_t* firstPoint = reinterpret_cast<const uint32_t*>(at(LEVEL_OBJECT_FIRST_POINT));
+            const uint32_t* pointCount = reinterpret_cast<const uint32_t*>(at(LEVEL_OBJECT_POINT_COUNT));
+            for (size_t i = 0; i < objects; ++i) {
+                if (names[i] >= stringBytes || types[i] >= stringBytes
+                    || firstPoint[i] > points || pointCount[i] > points - firstPoint[i]) return false;
+            }
+            const LevelDependency* dependencyRecords = reinterpret_cast<const LevelDependency*>(at(LEVEL_DEPENDENCIES));
+            for (size_t i = 0; i < dependencies; ++i) {
+                if (dependencyRecords[i].path >= stringBytes) return false;
+            }
+            return true;
+        }
+
+        // A cached level is current when the external tilesets it was built from are unchanged
+        bool DependenciesCurrent(const unsigned char* data) {
+            const LevelFileHeader& header = Header(data);
+            const char* base = reinterpret_cast<const char*>(data);
+            const LevelDependency* dependencies = reinterpret_cast<const LevelDependency*>(base + header.sections[LEVEL_DEPENDENCIES].offset);
+            const size_t count = (size_t)(header.sections[LEVEL_DEPENDENCIES].size / sizeof(LevelDependency));
+            const char* strings = base + header.sections[LEVEL_STRINGS].offset;
+
+            std::string bytes;
+            for (size_t i = 0; i < count; ++i) {
+                if (!ReadFileBytes(strings + dependencies[i].path, bytes)) return false;
+                if (HashBytes(bytes.data(), bytes.size()) != dependencies[i].hash) return false;
+            }
+            return true;
+        }
+
+    }
+
+    Level::Level() {}
+
+    Level::~Level() {}
+
+    bool Level::Load(const std::string& path, const std::string& cacheDir) {
+        namespace fs = std::filesystem;
+        Unload();
+
+        std::string source;
+        if (!ReadFileBytes(path, source)) {
+            std::cerr << "Level: failed to open " << path << std::endl;
+            return false;
+        }
+        const uint64_t hash = HashBytes(source.data(), source.size());
+
+        // Maps with the same file name in different folders can share a cache directory, so the
+        // key also hashes where the map is: only its own older caches get cleaned up below
+        std::error_code error;
+        const std::string location = fs::absolute(path, error).lexically_normal().string();
+        char prefix[32], key[32];
+        std::snprintf(prefix, sizeof(prefix), ".%016llx.", (unsigned long long)HashBytes(location.data(), location.size()));
+        std::snprintf(key, sizeof(key), "%016llx.echlevel", (unsigned long long)hash);
+        const fs::path directory = cacheDir.empty() ? fs::path(path).parent_path() : fs::path(cacheDir);
+        const std::string cacheStem = fs::path(path).filename().string() + prefix;
+        const std::string cachePath = (directory / (cacheStem + key)).string();
+
+        if (m_File.Open(cachePath) && Validate(m_File.Data(), m_File.Size())
+            && Header(m_File.Data()).sourceHash == hash && DependenciesCurrent(m_File.Data())) {
+            m_Data = m_File.Data();
+            m_Size = m_File.Size();
+            m_Cached = true;
+            return true;
+        }
+        // Unmapped before the cache is rewritten
+        m_File.Close();
+
+        std::vector<uint64_t> data;
+        size_t size = 0;
+        if (!ImportTiledMap(path, source, data, size)) return false;
+
+        // Caches of older versions of this map are dead now
+        const fs::path searchDirectory = directory.empty() ? fs::path(".") : directory;
+        if (fs::is_directory(searchDirectory, error)) {
+            for (const fs::directory_entry& entry : fs::directory_iterator(searchDirectory, error)) {
+                const std::string name = entry.path().filename().string();
+                if (name.size() == cacheStem.size() + std::strlen(key) && name.compare(0, cacheStem.size(), cacheStem) == 0
+                    && entry.path().extension() == ".echlevel") {
+                    fs::remove(entry.path(), error);
+                }
+            }
+        }
+        else if (!directory.empty()) {
+            fs::create_directories(directory, error);
+        }
+        if (!WriteCompiled(cachePath, data, size)) {
+            std::cerr << "Level: failed to write cache " << cachePath << std::endl;
+        }
+        return Adopt(std::move(data), size, path);
+    }
+
+    bool Level::LoadCompiled(const std::string& path) {
+        Unload();
+
+        if (!m_File.Open(path)) {
+            std::cerr << "Level: failed to open " << path << std::endl;
+            return false;
+        }
+        if (!Validate(m_File.Data(), m_File.Size())) {
+            std::cerr << "Level: not a valid compiled level: " << path << std::endl;
+            m_File.Close();
+            return false;
+        }
+        m_Data = m_File.Data();
+        m_Size = m_File.Size();
+        m_Cached = false;
+        return true;
+    }
+
+    bool Level::Compile(const std::string& sourcePath, const std::string& outputPath) {
+        std::string source;
+        if (!ReadFileBytes(sourcePath, source)) {
+            std::cerr << "Level: failed to open " << sourcePath << std::endl;
+            return false;
+        }
+        std::vector<uint64_t> data;
+        size_t size = 0;
+        if (!ImportTiledMap(sourcePath, source, data, size)) return false;
+        if (!WriteCompiled(outputPath, data, size)) {
+            std::cerr << "Level: failed to write " << outputPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Level::Adopt(std::vector<uint64_t>&& data, size_t size, const std::string& source) {
+        if (!Validate(reinterpret_cast<const unsigned char*>(data.data()), size)) {
+            std::cerr << "Level: not a valid compiled level: " << source << std::endl;
+            return false;
+        }
+        m_Imported = std::move(data);
+        m_Data = reinterpret_cast<const unsigned char*>(m_Imported.data());
+        m_Size = size;
+        m_Cached = false;
+        return true;
+    }
+
+    void Level::Unload() {
+        m_File.Close();
+        m_Imported.clear();
+        m_Imported.shrink_to_fit();
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Cached = false;
+    }
+
+    const void* Level::Section(int section, size_t& count, size_t recordSize) const {
+        if (!m_Data) {
+            count = 0;
+            return nullptr;
+        }
+        const LevelFileSection& entry = Header(m_Data).sections[section];
+        count = (size_t)(entry.size / recordSize);
+        return reinterpret_cast<const char*>(m_Data) + entry.offset;
+    }
+
+    template<typename T>
+    const T* Level::Array(int section) const {
+        size_t count;
+        return static_cast<const T*>(Section(section, count, sizeof(T)));
+    }
+
+    int Level::Width() const { return m_Data ? Header(m_Data).width : 0; }
+    int Level::Height() const { return m_Data ? Header(m_Data).height : 0; }
+    int Level::TileWidth() const { return m_Data ? Header(m_Data).tileWidth : 0; }
+    int Level::TileHeight() const { return m_Data ? Header(m_Data).tileHeight : 0; }
+
+    const char* Level::GetString(uint32_t offset) const {
+        size_t count;
+        const char* strings = static_cast<const char*>(Section(LEVEL_STRINGS, count, 1));
+        return strings && offset < count ? strings + offset : "";
+    }
+
+    int Level::GetTilesetCount() const {
+        size_t count;
+        Section(LEVEL_TILESETS, count, sizeof(LevelTileset));
+        return (int)count;
+    }
+
+    const LevelTileset& Level::GetTileset(int index) const {
+        return Array<LevelTileset>(LEVEL_TILESETS)[index];
+    }
+
+    int Level::FindTileset(uint32_t gid) const {
+        gid &= TileGidMask;
+        if (gid == 0) return -1;
+        size_t count;
+        const LevelTileset* tilesets = static_cast<const LevelTileset*>(Section(LEVEL_TILESETS, count, sizeof(LevelTileset)));
+        // Tiled keeps tilesets in firstGid order
+        int found = -1;
+        for (size_t i = 0; i < count; ++i) {
+            if ((uint32_t)tilesets[i].firstGid <= gid) found = (int)i;
+        }
+        return found;
+    }
+
+    int Level::GetTileLayerCount() const {
+        size_t count;
+        Section(LEVEL_TILE_LAYERS, count, sizeof(LevelTileLayer));
+        return (int)count;
+    }
+
+    const LevelTileLayer& Level::GetTileLayer(int index) const {
+        return Array<LevelTileLayer>(LEVEL_TILE_LAYERS)[index];
+    }
+
+    const uint32_t* Level::GetTiles(int layer) const {
+        if (layer < 0 || layer >= GetTileLayerCount()) return nullptr;
+        return Array<uint32_t>(LEVEL_TILES) + GetTileLayer(layer).firstTile;
+    }
+
+    int Level::FindTileLayer(const char* name) const {
+        for (int i = 0; i < GetTileLayerCount(); ++i) {
+            if (std::strcmp(GetString(GetTileLayer(i).name), name) == 0) return i;
+        }
+        return -1;
+    }
+
+    int Level::GetObjectLayerCount() const {
+        size_t count;
+        Section(LEVEL_OBJECT_LAYERS, count, sizeof(LevelObjectLayer));
+        return (int)count;
+    }
+
+    const LevelObjectLayer& Level::GetObjectLayer(int index) const {
+        return Array<LevelObjectLayer>(LEVEL_OBJECT_LAYERS)[index];
+    }
+
+    int Level::FindObjectLayer(const char* name) const {
+        for (int i = 0; i < GetObjectLayerCount(); ++i) {
+            if (std::strcmp(GetString(GetObjectLayer(i).name), name) == 0) return i;
+        }
+        return -1;
+    }
+
+    int Level::GetObjectCount() const {
+        size_t count;
+        Section(LEVEL_OBJECT_X, count, sizeof(float));
+        return (int)count;
+    }
+
+    const float* Level::GetObjectX() const { return Array<float>(LEVEL_OBJECT_X); }
+    const float* Level::GetObjectY() const { return Array<float>(LEVEL_OBJECT_Y); }
+    const float* Level::GetObjectWidth() const { return Array<float>(LEVEL_OBJECT_WIDTH); }
+    const float* Level::GetObjectHeight() const { return Array<float>(LEVEL_OBJECT_HEIGHT); }
+    const float* Level::GetObjectRotation() const { return Array<float>(LEVEL_OBJECT_ROTATION); }
+    const uint32_t* Level::GetObjectId() const { return Array<uint32_t>(LEVEL_OBJECT_ID); }
+    const uint32_t* Level::GetObjectGid() const { return Array<uint32_t>(LEVEL_OBJECT_GID); }
+    const uint32_t* Level::GetObjectName() const { return Array<uint32_t>(LEVEL_OBJECT_NAME); }
+    const uint32_t* Level::GetObjectType() const { return Array<uint32_t>(LEVEL_OBJECT_TYPE); }
+    const uint32_t* Level::GetObjectShape() const { return Array<uint32_t>(LEVEL_OBJECT_SHAPE); }
+    const uint32_t* Level::GetObjectFirstPoint() const { return Array<uint32_t>(LEVEL_OBJECT_FIRST_POINT); }
+    const uint32_t* Level::GetObjectPointCount() const { return Array<uint32_t>(LEVEL_OBJECT_POINT_COUNT); }
+    const float* Level::GetPoints() const { return Array<float>(LEVEL_POINTS); }
+
+    BoxArray Level::GetObjectBoxes(int layer) const {
+        BoxArray boxes;
+        if (!m_Data || layer >= GetObjectLayerCount()) return boxes;
+
+        size_t first = 0, count = (size_t)GetObjectCount();
+        if (layer >= 0) {
+            first = GetObjectLayer(layer).firstObject;
+            count = GetObjectLayer(layer).objectCount;
+        }
+        boxes.x = GetObjectX() + first;
+        boxes.y = GetObjectY() + first;
+        boxes.w = GetObjectWidth() + first;
+        boxes.h = GetObjectHeight() + first;
+        boxes.count = (int)count;
+        return boxes;
+    }
+
+    bool Level::BuildTilemap(int layer, Tilemap& map, int tileset) const {
+        if (layer < 0 || layer >= GetTileLayerCount() || tileset < 0 || tileset >= GetTilesetCount()) {
+            std::cerr << "Level: no tile layer " << layer << " or tileset " << tileset << std::endl;
+            return false;
+        }
+        const LevelTileLayer& source = GetTileLayer(layer);
+        if (!map.Create(source.width, source.height, (float)TileWidth(), (float)TileHeight())) return false;
+        map.SetPosition(source.offsetX, source.offsetY);
+
+        const uint32_t* gids = GetTiles(layer);
+        const int firstGid = GetTileset(tileset).firstGid;
+        std::vector<int> tiles((size_t)source.width * source.height);
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            const uint32_t gid = gids[i] & TileGidMask;
+            tiles[i] = FindTileset(gid) == tileset ? (int)gid - firstGid : Tilemap::EmptyTile;
+        }
+        map.SetTiles(0, 0, source.width, source.height, tiles.data());
+        return true;
+    }
+
+}
@@ -0,0 +1,888 @@
+#include "level_internal.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace ech {
+
+    uint64_t HashBytes(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool ReadFileBytes(const std::string& path, std::string& bytes) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        const std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        bytes.resize((size_t)size);
+        return size == 0 || (bool)file.read(&bytes[0], size);
+    }
+
+    namespace {
+
+        // --- Minimal XML: elements, attributes and text. Enough for TMX and TSX. ---
+
+        struct XmlNode {
+            std::string name;
+            std::vector<std::pair<std::string, std::string>> attributes;
+            std::string text;
+            std::vector<XmlNode> children;
+
+            const char* Attribute(const char* key) const {
+                for (const auto& attribute : attributes) {
+                    if (attribute.first == key) return attribute.second.c_str();
+                }
+                return nullptr;
+            }
+            std::string String(const char* key, const char* fallback = "") const {
+                const char* value = Attribute(key);
+                return value ? value : fallback;
+            }
+            double Number(const char* key, double fallback = 0.0) const {
+                const char* value = Attribute(key);
+                return value ? std::strtod(value, nullptr) : fallback;
+            }
+            const XmlNode* Child(const char* childName) const {
+                for (const XmlNode& child : children) {
+                    if (child.name == childName) return &child;
+                }
+                return nullptr;
+            }
+        };
+
+        void AppendUtf8(std::string& out, uint32_t c) {
+            if (c < 0x80) {
+                out += (char)c;
+            }
+            else if (c < 0x800) {
+                out += (char)(0xC0 | (c >> 6));
+                out += (char)(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000) {
+                out += (char)(0xE0 | (c >> 12));
+                out += (char)(0x80 | ((c >> 6) & 0x3F));
+                out += (char)(0x80 | (c & 0x3F));
+            }
+            else {
+                out += (char)(0xF0 | (c >> 18));
+                out += (char)(0x80 | ((c >> 12) & 0x3F));
+                out += (char)(0x80 | ((c >> 6) & 0x3F));
+                out += (char)(0x80 | (c & 0x3F));
+            }
+        }
+
+        class XmlParser {
+        public:
+            explicit XmlParser(const std::string& source) : s(source) {}
+
+            bool Parse(XmlNode& root) {
+                // Prolog: declaration, comments, doctype
+                for (;;) {
+                    SkipSpace();
+                    if (Starts("<?")) Skip("?>");
+                    else if (Starts("<!--")) Skip("-->");
+                    else if (Starts("<!")) Skip(">");
+                    else break;
+                }
+                return pos < s.size() && s[pos] == '<' && Element(root);
+            }
+
+        private:
+            bool Starts(const char* text) const { return s.compare(pos, std::strlen(text), text) == 0; }
+            void Skip(const char* end) {
+                const size_t at = s.find(end, pos);
+                pos = at == std::string::npos ? s.size() : at + std::strlen(end);
+            }
+            void SkipSpace() { while (pos < s.size() && std::isspace((unsigned char)s[pos])) ++pos; }
+
+            std::string Name() {
+                const size_t start = pos;
+                while (pos < s.size() && !std::isspace((unsigned char)s[pos]) && s[pos] != '=' && s[pos] != '>' && s[pos] != '/') ++pos;
+                return s.substr(start, pos - start);
+            }
+
+            // Text up to `end`, with entities decoded
+            void Text(std::string& out, char end) {
+                while (pos < s.size() && s[pos] != end) {
+                    if (s[pos] != '&') {
+                        out += s[pos++];
+                        continue;
+                    }
+                    const size_t semi = s.find(';', pos);
+                    if (semi == std::string::npos) { out += s[pos++]; continue; }
+                    const std::string entity = s.substr(pos + 1, semi - pos - 1);
+                    pos = semi + 1;
+                    if (entity == "amp") out += '&';
+                    else if (entity == "lt") out += '<';
+                    else if (entity == "gt") out += '>';
+                    else if (entity == "quot") out += '"';
+                    else if (entity == "apos") out += '\'';
+                    else if (!entity.empty() && entity[0] == '#') {
+                        const bool hex = entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X');
+                        AppendUtf8(out, (uint32_t)std::strtoul(entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10));
+                    }
+                }
+            }
+
+            bool Element(XmlNode& node) {
+                ++pos; // '<'
+                node.name = Name();
+                if (node.name.empty()) return false;
+
+                for (;;) {
+                    SkipSpace();
+                    if (pos >= s.size()) return false;
+                    if (Starts("/>")) { pos += 2; return true; }
+                    if (s[pos] == '>') { ++pos; break; }
+
+                    std::string key = Name();
+                    SkipSpace();
+                    if (key.empty() || pos >= s.size() || s[pos] != '=') return false;
+                    ++pos;
+                    SkipSpace();
+                    if (pos >= s.size() || (s[pos] != '"' && s[pos] != '\'')) return false;
+                    const char quote = s[pos++];
+                    std::string value;
+                    Text(value, quote);
+                    if (pos >= s.size()) return false;
+                    ++pos;
+                    node.attributes.emplace_back(std::move(key), std::move(value));
+                }
+
+                for (;;) {
+                    if (pos >= s.size()) return false;
+                    if (Starts("</")) {
+                        pos += 2;
+                        if (Name() != node.name) return false;
+                        Skip(">");
+                        return true;
+                    }
+                    if (Starts("<!--")) { Skip("-->"); continue; }
+                    if (Starts("<![CDATA[")) {
+                        const size_t end = s.find("]]>", pos);
+                        if (end == std::string::npos) return false;
+                        node.text.append(s, pos + 9, end - pos - 9);
+                        pos = end + 3;
+                        continue;
+                    }
+                    if (s[pos] == '<') {
+                        node.children.emplace_back();
+                        if (!Element(node.children.back())) return false;
+                        continue;
+                    }
+                    Text(node.text, '<');
+                }
+            }
+
+            const std::string& s;
+            size_t pos = 0;
+        };
+
+        // --- Minimal JSON, for TMJ and TSJ ---
+
+        struct JsonValue {
+            enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+            Type type = JSON_NULL;
+            bool boolean = false;
+            double number = 0.0;
+            std::string string;
+            std::vector<JsonValue> items;
+            std::vector<std::pair<std::string, JsonValue>> members;
+
+            const JsonValue* Get(const char* key) const {
+                for (const auto& member : members) {
+                    if (member.first == key) return &member.second;
+                }
+                return nullptr;
+            }
+            double Number(const char* key, double fallback = 0.0) const {
+                const JsonValue* value = Get(key);
+                return value && value->type == JSON_NUMBER ? value->number : fallback;
+            }
+            std::string String(const char* key, const char* fallback = "") const {
+                const JsonValue* value = Get(key);
+                return value && value->type == JSON_STRING ? value->string : fallback;
+            }
+            bool Bool(const char* key, bool fallback = false) const {
+                const JsonValue* value = Get(key);
+                return value && value->type == JSON_BOOL ? value->boolean : fallback;
+            }
+        };
+
+        class JsonParser {
+        public:
+            explicit JsonParser(const std::string& source) : s(source) {}
+
+            bool Parse(JsonValue& root) {
+                if (!Value(root, 0)) return false;
+                SkipSpace();
+                return pos == s.size();
+            }
+
+        private:
+            void SkipSpace() { while (pos < s.size() && std::isspace((unsigned char)s[pos])) ++pos; }
+            bool Literal(const char* text) {
+                const size_t length = std::strlen(text);
+                if (s.compare(pos, length, text) != 0) return false;
+                pos += length;
+                return true;
+            }
+
+            bool Hex4(uint32_t& c) {
+                if (pos + 4 > s.size()) return false;
+                c = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const char h = s[pos++];
+                    c <<= 4;
+                    if (h >= '0' && h <= '9') c |= h - '0';
+                    else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+                    else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+                    else return false;
+                }
+                return true;
+            }
+
+            bool String(std::string& out) {
+                ++pos; // '"'
+                while (pos < s.size() && s[pos] != '"') {
+                    if (s[pos] != '\\') {
+                        out += s[pos++];
+                        continue;
+                    }
+                    if (++pos >= s.size()) return false;
+                    const char e = s[pos++];
+                    switch (e) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        uint32_t c;
+                        if (!Hex4(c)) return false;
+                        // Surrogate pair
+                        if (c >= 0xD800 && c < 0xDC00 && Literal("\\u")) {
+                            uint32_t low;
+                            if (!Hex4(low)) return false;
+                            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        AppendUtf8(out, c);
+                        break;
+                    }
+                    default: out += e; break;
+                    }
+                }
+                if (pos >= s.size()) return false;
+                ++pos;
+                return true;
+            }
+
+            bool Value(JsonValue& value, int depth) {
+                if (depth > 64) return false;
+                SkipSpace();
+                if (pos >= s.size()) return false;
+
+                const char c = s[pos];
+                if (c == '{') {
+                    value.type = JsonValue::JSON_OBJECT;
+                    ++pos;
+                    SkipSpace();
+                    if (pos < s.size() && s[pos] == '}') { ++pos; return true; }
+                    for (;;) {
+                        SkipSpace();
+                        if (pos >= s.size() || s[pos] != '"') return false;
+                        std::string key;
+                        if (!String(key)) return false;
+                        SkipSpace();
+                        if (pos >= s.size() || s[pos] != ':') return false;
+                        ++pos;
+                        value.members.emplace_back(std::move(key), JsonValue());
+                        if (!Value(value.members.back().second, depth + 1)) return false;
+                        SkipSpace();
+                        if (pos < s.size() && s[pos] == ',') { ++pos; continue; }
+                        if (pos < s.size() && s[pos] == '}') { ++pos; return true; }
+                        return false;
+                    }
+                }
+                if (c == '[') {
+                    value.type = JsonValue::JSON_ARRAY;
+                    ++pos;
+                    SkipSpace();
+                    if (pos < s.size() && s[pos] == ']') { ++pos; return true; }
+                    for (;;) {
+                        value.items.emplace_back();
+                        if (!Value(value.items.back(), depth + 1)) return false;
+                        SkipSpace();
+                        if (pos < s.size() && s[pos] == ',') { ++pos; continue; }
+                        if (pos < s.size() && s[pos] == ']') { ++pos; return true; }
+                        return false;
+                    }
+                }
+                if (c == '"') {
+                    value.type = JsonValue::JSON_STRING;
+                    return String(value.string);
+                }
+                if (Literal("true")) { value.type = JsonValue::JSON_BOOL; value.boolean = true; return true; }
+                if (Literal("false")) { value.type = JsonValue::JSON_BOOL; return true; }
+                if (Literal("null")) return true;
+
+                char* end = nullptr;
+                value.number = std::strtod(s.c_str() + pos, &end);
+                if (end == s.c_str() + pos) return false;
+                value.type = JsonValue::JSON_NUMBER;
+                pos = end - s.c_str();
+                return true;
+            }
+
+            const std::string& s;
+            size_t pos = 0;
+        };
+
+        bool DecodeBase64(const std::string& text, std::string& out) {
+            uint32_t buffer = 0;
+            int bits = 0;
+            for (char c : text) {
+                int value;
+                if (c >= 'A' && c <= 'Z') value = c - 'A';
+                else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+                else if (c >= '0' && c <= '9') value = c - '0' + 52;
+                else if (c == '+') value = 62;
+                else if (c == '/') value = 63;
+                else if (c == '=') break;
+                else if (std::isspace((unsigned char)c)) continue;
+                else return false;
+
+                buffer = (buffer << 6) | (uint32_t)value;
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    out += (char)((buffer >> bits) & 0xFF);
+                }
+            }
+            return true;
+        }
+
+        // --- Everything the importer collects, laid out like the compiled sections ---
+
+        struct LevelBuilder {
+            std::string mapDirectory;
+            int width = 0, height = 0, tileWidth = 0, tileHeight = 0;
+
+            std::string strings = std::string(1, '\0');
+            std::unordered_map<std::string, uint32_t> interned;
+
+            std::vector<LevelTileset> tilesets;
+            std::vector<LevelTileLayer> tileLayers;
+            std::vector<uint32_t> tiles;
+            std::vector<LevelObjectLayer> objectLayers;
+            std::vector<float> x, y, w, h, rotation;
+            std::vector<uint32_t> id, gid, name, type, shape, firstPoint, pointCount;
+            std::vector<float> points;
+            std::vector<LevelDependency> dependencies;
+
+            uint32_t Intern(const std::string& text) {
+                if (text.empty()) return 0;
+                auto it = interned.find(text);
+                if (it != interned.end()) return it->second;
+                const uint32_t offset = (uint32_t)strings.size();
+                strings.append(text);
+                strings += '\0';
+                interned.emplace(text, offset);
+                return offset;
+            }
+
+            // Tiled anchors tile objects at their bottom-left corner; everything here uses
+            // the top-left one, turned with the object
+            void AddObject(uint32_t objectId, const std::string& objectName, const std::string& objectType,
+                LevelObjectShape objectShape, float ox, float oy, float ow, float oh, float degrees,
+                uint32_t objectGid, const std::vector<float>& outline) {
+                if (objectShape == OBJECT_TILE) {
+                    const float radians = degrees * 3.14159265358979f / 180.0f;
+                    ox += oh * std::sin(radians);
+                    oy -= oh * std::cos(radians);
+                }
+                id.push_back(objectId);
+                name.push_back(Intern(objectName));
+                type.push_back(Intern(objectType));
+                shape.push_back(objectShape);
+                x.push_back(ox);
+                y.push_back(oy);
+                w.push_back(ow);
+                h.push_back(oh);
+                rotation.push_back(degrees);
+                gid.push_back(objectGid);
+                firstPoint.push_back((uint32_t)(points.size() / 2));
+                pointCount.push_back((uint32_t)(outline.size() / 2));
+                points.insert(points.end(), outline.begin(), outline.end());
+            }
+
+            bool AddTileLayer(const std::string& layerName, int layerWidth, int layerHeight,
+                float offsetX, float offsetY, float opacity, bool visible, const std::vector<uint32_t>& gids) {
+                if (layerWidth <= 0 || layerHeight <= 0 || gids.size() != (size_t)layerWidth * layerHeight) {
+                    std::cerr << "Level: tile layer '" << layerName << "' has " << gids.size() << " tiles, expected "
+                        << layerWidth << "x" << layerHeight << std::endl;
+                    return false;
+                }
+                LevelTileLayer layer;
+                layer.name = Intern(layerName);
+                layer.width = layerWidth;
+                layer.height = layerHeight;
+                layer.firstTile = (uint32_t)tiles.size();
+                layer.offsetX = offsetX;
+                layer.offsetY = offsetY;
+                layer.opacity = opacity;
+                layer.visible = visible ? 1 : 0;
+                tileLayers.push_back(layer);
+                tiles.insert(tiles.end(), gids.begin(), gids.end());
+                return true;
+            }
+        };
+
+        bool ParseCsv(const std::string& text, std::vector<uint32_t>& gids) {
+            const char* p = text.c_str();
+            for (;;) {
+                while (*p && (std::isspace((unsigned char)*p) || *p == ',')) ++p;
+                if (!*p) return true;
+                char* end = nullptr;
+                const unsigned long long value = std::strtoull(p, &end, 10);
+                if (end == p) return false;
+                gids.push_back((uint32_t)value);
+                p = end;
+            }
+        }
+
+        bool DecodeTileData(const std::string& encoding, const std::string& compression,
+            const std::string& text, std::vector<uint32_t>& gids) {
+            if (!compression.empty()) {
+                std::cerr << "Level: compressed tile layers (" << compression << ") are not supported, "
+                    "save the map with CSV or uncompressed base64 layer data" << std::endl;
+                return false;
+            }
+            if (encoding == "csv") return ParseCsv(text, gids);
+            if (encoding == "base64") {
+                std::string bytes;
+                if (!DecodeBase64(text, bytes) || bytes.size() % 4 != 0) return false;
+                gids.resize(bytes.size() / 4);
+                for (size_t i = 0; i < gids.size(); ++i) {
+                    const unsigned char* b = (const unsigned char*)bytes.data() + i * 4;
+                    gids[i] = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+                }
+                return true;
+            }
+            std::cerr << "Level: unknown tile layer encoding '" << encoding << "'" << std::endl;
+            return false;
+        }
+
+        // Path of a file referenced from `relativeTo` (a path relative to the map), relative to the map
+        std::string ResolvePath(const std::string& relativeTo, const std::string& file) {
+            namespace fs = std::filesystem;
+            return (fs::path(relativeTo).parent_path() / fs::path(file)).lexically_normal().generic_string();
+        }
+
+        bool FinishTileset(LevelTileset& tileset, const std::string& source) {
+            if (tileset.tileWidth <= 0 || tileset.tileHeight <= 0) {
+                std::cerr << "Level: tileset in " << source << " has no tile size" << std::endl;
+                return false;
+            }
+            // Older files leave out the column count
+            if (tileset.columns <= 0 && tileset.imageWidth > 0) {
+                tileset.columns = (tileset.imageWidth - 2 * tileset.margin + tileset.spacing) / (tileset.tileWidth + tileset.spacing);
+            }
+            if (tileset.tileCount <= 0 && tileset.columns > 0 && tileset.imageHeight > 0) {
+                const int rows = (tileset.imageHeight - 2 * tileset.margin + tileset.spacing) / (tileset.tileHeight + tileset.spacing);
+                tileset.tileCount = tileset.columns * rows;
+            }
+            return true;
+        }
+
+        // `imageBase` is the tileset file's path relative to the map, for resolving its image
+        bool ReadXmlTileset(LevelBuilder& b, const XmlNode& node, const std::string& imageBase, LevelTileset& tileset) {
+            tileset.name = b.Intern(node.String("name"));
+            tileset.tileWidth = (int32_t)node.Number("tilewidth");
+            tileset.tileHeight = (int32_t)node.Number("tileheight");
+            tileset.margin = (int32_t)node.Number("margin");
+            tileset.spacing = (int32_t)node.Number("spacing");
+            tileset.columns = (int32_t)node.Number("columns");
+            tileset.tileCount = (int32_t)node.Number("tilecount");
+            if (const XmlNode* image = node.Child("image")) {
+                tileset.image = b.Intern(ResolvePath(imageBase, image->String("source")));
+                tileset.imageWidth = (int32_t)image->Number("width");
+                tileset.imageHeight = (int32_t)image->Number("height");
+            }
+            return FinishTileset(tileset, imageBase);
+        }
+
+        bool ReadJsonTileset(LevelBuilder& b, const JsonValue& node, const std::string& imageBase, LevelTileset& tileset) {
+            tileset.name = b.Intern(node.String("name"));
+            tileset.tileWidth = (int32_t)node.Number("tilewidth");
+            tileset.tileHeight = (int32_t)node.Number("tileheight");
+            tileset.margin = (int32_t)node.Number("margin");
+            tileset.spacing = (int32_t)node.Number("spacing");
+            tileset.columns = (int32_t)node.Number("columns");
+            tileset.tileCount = (int32_t)node.Number("tilecount");
+            const std::string image = node.String("image");
+            if (!image.empty()) tileset.image = b.Intern(ResolvePath(imageBase, image));
+            tileset.imageWidth = (int32_t)node.Number("imagewidth");
+            tileset.imageHeight = (int32_t)node.Number("imageheight");
+            return FinishTileset(tileset, imageBase);
+        }
+
+        bool EndsWith(const std::string& text, const char* suffix) {
+            const size_t length = std::strlen(suffix);
+            return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+        }
+
+        // External .tsx or .tsj tileset; its hash is recorded so edits to it invalidate the cache
+        bool ReadExternalTileset(LevelBuilder& b, const std::string& source, int firstGid) {
+            const std::string relative = std::filesystem::path(source).lexically_normal().generic_string();
+            const std::string path = (std::filesystem::path(b.mapDirectory) / relative).generic_string();
+            std::string bytes;
+            if (!ReadFileBytes(path, bytes)) {
+                std::cerr << "Level: failed to open tileset " << path << std::endl;
+                return false;
+            }
+            b.dependencies.push_back({ b.Intern(path), 0, HashBytes(bytes.data(), bytes.size()) });
+
+            LevelTileset tileset = {};
+            tileset.firstGid = firstGid;
+            bool ok;
+            if (EndsWith(source, ".tsx")) {
+                XmlNode root;
+                ok = XmlParser(bytes).Parse(root) && root.name == "tileset" && ReadXmlTileset(b, root, relative, tileset);
+            }
+            else {
+                JsonValue root;
+                ok = JsonParser(bytes).Parse(root) && root.type == JsonValue::JSON_OBJECT && ReadJsonTileset(b, root, relative, tileset);
+            }
+            if (!ok) {
+                std::cerr << "Level: invalid tileset " << path << std::endl;
+                return false;
+            }
+            b.tilesets.push_back(tileset);
+            return true;
+        }
+
+        bool ParsePointList(const std::string& text, std::vector<float>& outline) {
+            // "x,y x,y ..."
+            const char* p = text.c_str();
+            for (;;) {
+                while (*p && (std::isspace((unsigned char)*p) || *p == ',')) ++p;
+                if (!*p) return outline.size() % 2 == 0;
+                char* end = nullptr;
+                const float value = std::strtof(p, &end);
+                if (end == p) return false;
+                outline.push_back(value);
+                p = end;
+            }
+        }
+
+        // --- TMX ---
+
+        bool ReadXmlLayers(LevelBuilder& b, const XmlNode& parent, float offsetX, float offsetY, bool visible) {
+            for (const XmlNode& node : parent.children) {
+                const float layerX = offsetX + (float)node.Number("offsetx");
+                const float layerY = offsetY + (float)node.Number("offsety");
+                const bool layerVisible = visible && node.Number("visible", 1.0) != 0.0;
+
+                if (node.name == "layer") {
+                    const XmlNode* data = node.Child("data");
+                    if (!data) continue;
+                    if (data->Child("chunk")) {
+                        std::cerr << "Level: infinite maps are not supported" << std::endl;
+                        return false;
+                    }
+                    std::vector<uint32_t> gids;
+                    const std::string encoding = data->String("encoding");
+                    if (encoding.empty()) {
+                        for (const XmlNode& tile : data->children) {
+                            if (tile.name == "tile") gids.push_back((uint32_t)(uint64_t)tile.Number("gid"));
+                        }
+                    }
+                    else if (!DecodeTileData(encoding, data->String("compression"), data->text, gids)) {
+                        return false;
+                    }
+                    if (!b.AddTileLayer(node.String("name"), (int)node.Number("width", b.width), (int)node.Number("height", b.height),
+                        layerX, layerY, (float)node.Number("opacity", 1.0), layerVisible, gids)) {
+                        return false;
+                    }
+                }
+                else if (node.name == "objectgroup") {
+                    LevelObjectLayer layer;
+                    layer.name = b.Intern(node.String("name"));
+                    layer.firstObject = (uint32_t)b.x.size();
+                    layer.visible = layerVisible ? 1 : 0;
+
+                    std::vector<float> outline;
+                    for (const XmlNode& object : node.children) {
+                        if (object.name != "object") continue;
+                        const uint32_t objectGid = (uint32_t)(uint64_t)object.Number("gid");
+                        LevelObjectShape objectShape = objectGid ? OBJECT_TILE : OBJECT_RECTANGLE;
+                        outline.clear();
+                        if (object.Child("ellipse")) objectShape = OBJECT_ELLIPSE;
+                        else if (object.Child("point")) objectShape = OBJECT_POINT;
+                        else if (const XmlNode* polygon = object.Child("polygon")) {
+                            objectShape = OBJECT_POLYGON;
+                            if (!ParsePointList(polygon->String("points"), outline)) return false;
+                        }
+                        else if (const XmlNode* polyline = object.Child("polyline")) {
+                            objectShape = OBJECT_POLYLINE;
+                            if (!ParsePointList(polyline->String("points"), outline)) return false;
+                        }
+                        // Tiled 1.9 renamed "type" to "class"
+                        const std::string objectType = object.Attribute("class") ? object.String("class") : object.String("type");
+                        b.AddObject((uint32_t)object.Number("id"), object.String("name"), objectType, objectShape,
+                            layerX + (float)object.Number("x"), layerY + (float)object.Number("y"),
+                            (float)object.Number("width"), (float)object.Number("height"), (float)object.Number("rotation"),
+                            objectGid, outline);
+                    }
+                    layer.objectCount = (uint32_t)b.x.size() - layer.firstObject;
+                    b.objectLayers.push_back(layer);
+                }
+                else if (node.name == "group") {
+                    if (!ReadXmlLayers(b, node, layerX, layerY, layerVisible)) return false;
+                }
+            }
+            return true;
+        }
+
+        bool ImportTmx(LevelBuilder& b, const std::string& source) {
+            XmlNode map;
+            if (!XmlParser(source).Parse(map) || map.name != "map") {
+                std::cerr << "Level: not a TMX map" << std::endl;
+                return false;
+            }
+            if (map.Number("infinite") != 0.0) {
+                std::cerr << "Level: infinite maps are not supported" << std::endl;
+                return false;
+            }
+            b.width = (int)map.Number("width");
+            b.height = (int)map.Number("height");
+            b.tileWidth = (int)map.Number("tilewidth");
+            b.tileHeight = (int)map.Number("tileheight");
+
+            for (const XmlNode& node : map.children) {
+                if (node.name != "tileset") continue;
+                const int firstGid = (int)node.Number("firstgid", 1.0);
+                if (node.Attribute("source")) {
+                    if (!ReadExternalTileset(b, node.String("source"), firstGid)) return false;
+                }
+                else {
+                    LevelTileset tileset = {};
+                    tileset.firstGid = firstGid;
+                    if (!ReadXmlTileset(b, node, "", tileset)) return false;
+                    b.tilesets.push_back(tileset);
+                }
+            }
+            return ReadXmlLayers(b, map, 0.0f, 0.0f, true);
+        }
+
+        // --- TMJ ---
+
+        bool ReadJsonLayers(LevelBuilder& b, const JsonValue& parent, float offsetX, float offsetY, bool visible) {
+            const JsonValue* layers = parent.Get("layers");
+            if (!layers || layers->type != JsonValue::JSON_ARRAY) return true;
+
+            for (const JsonValue& node : layers->items) {
+                const std::string layerType = node.String("type");
+                const float layerX = offsetX + (float)node.Number("offsetx");
+                const float layerY = offsetY + (float)node.Number("offsety");
+                const bool layerVisible = visible && node.Bool("visible", true);
+
+                if (layerType == "tilelayer") {
+                    if (node.Get("chunks")) {
+                        std::cerr << "Level: infinite maps are not supported" << std::endl;
+                        return false;
+                    }
+                    const JsonValue* data = node.Get("data");
+                    std::vector<uint32_t> gids;
+                    if (data && data->type == JsonValue::JSON_ARRAY) {
+                        gids.reserve(data->items.size());
+                        for (const JsonValue& gid : data->items) gids.push_back((uint32_t)(uint64_t)gid.number);
+                    }
+                    else if (data && data->type == JsonValue::JSON_STRING) {
+                        if (!DecodeTileData(node.String("encoding", "base64"), node.String("compression"), data->string, gids)) return false;
+                    }
+                    if (!b.AddTileLayer(node.String("name"), (int)node.Number("width", b.width), (int)node.Number("height", b.height),
+                        layerX, layerY, (float)node.Number("opacity", 1.0), layerVisible, gids)) {
+                        return false;
+                    }
+                }
+                else if (layerType == "objectgroup") {
+                    LevelObjectLayer layer;
+                    layer.name = b.Intern(node.String("name"));
+                    layer.firstObject = (uint32_t)b.x.size();
+                    layer.visible = layerVisible ? 1 : 0;
+
+                    const JsonValue* objects = node.Get("objects");
+                    std::vector<float> outline;
+                    for (size_t i = 0; objects && i < objects->items.size(); ++i) {
+                        const JsonValue& object = objects->items[i];
+                        const uint32_t objectGid = (uint32_t)(uint64_t)object.Number("gid");
+                        LevelObjectShape objectShape = objectGid ? OBJECT_TILE : OBJECT_RECTANGLE;
+                        outline.clear();
+                        const JsonValue* polygon = object.Get("polygon");
+                        const JsonValue* polyline = object.Get("polyline");
+                        if (object.Bool("ellipse")) objectShape = OBJECT_ELLIPSE;
+                        else if (object.Bool("point")) objectShape = OBJECT_POINT;
+                        else if (polygon || polyline) {
+                            objectShape = polygon ? OBJECT_POLYGON : OBJECT_POLYLINE;
+                            for (const JsonValue& point : (polygon ? polygon : polyline)->items) {
+                                outline.push_back((float)point.Number("x"));
+                                outline.push_back((float)point.Number("y"));
+                            }
+                        }
+                        const std::string objectType = object.Get("class") ? object.String("class") : object.String("type");
+                        b.AddObject((uint32_t)object.Number("id"), object.String("name"), objectType, objectShape,
+                            layerX + (float)object.Number("x"), layerY + (float)object.Number("y"),
+                            (float)object.Number("width"), (float)object.Number("height"), (float)object.Number("rotation"),
+                            objectGid, outline);
+                    }
+                    layer.objectCount = (uint32_t)b.x.size() - layer.firstObject;
+                    b.objectLayers.push_back(layer);
+                }
+                else if (layerType == "group") {
+                    if (!ReadJsonLayers(b, node, layerX, layerY, layerVisible)) return false;
+                }
+            }
+            return true;
+        }
+
+        bool ImportTmj(LevelBuilder& b, const std::string& source) {
+            JsonValue map;
+            if (!JsonParser(source).Parse(map) || map.type != JsonValue::JSON_OBJECT || map.String("type") != "map") {
+                std::cerr << "Level: not a Tiled JSON map" << std::endl;
+                return false;
+            }
+            if (map.Bool("infinite")) {
+                std::cerr << "Level: infinite maps are not supported" << std::endl;
+                return false;
+            }
+            b.width = (int)map.Number("width");
+            b.height = (int)map.Number("height");
+            b.tileWidth = (int)map.Number("tilewidth");
+            b.tileHeight = (int)map.Number("tileheight");
+
+            if (const JsonValue* tilesets = map.Get("tilesets")) {
+                for (const JsonValue& node : tilesets->items) {
+                    const int firstGid = (int)node.Number("firstgid", 1.0);
+                    const std::string external = node.String("source");
+                    if (!external.empty()) {
+                        if (!ReadExternalTileset(b, external, firstGid)) return false;
+                    }
+                    else {
+                        LevelTileset tileset = {};
+                        tileset.firstGid = firstGid;
+                        if (!ReadJsonTileset(b, node, "", tileset)) return false;
+                        b.tilesets.push_back(tileset);
+                    }
+                }
+            }
+            return ReadJsonLayers(b, map, 0.0f, 0.0f, true);
+        }
+
+        // --- Writing the compiled file ---
+
+        template<typename T>
+        void PlaceSection(LevelFileHeader& header, int section, const std::vector<T>& data, uint64_t& offset) {
+            header.sections[section].offset = offset;
+            header.sections[section].size = data.size() * sizeof(T);
+            offset += (header.sections[section].size + 7) & ~(uint64_t)7;
+        }
+
+        void Serialize(const LevelBuilder& b, uint64_t sourceHash, std::vector<uint64_t>& compiled, size_t& size) {
+            LevelFileHeader header = {};
+            std::memcpy(header.magic, LevelMagic, 4);
+            header.version = LevelVersion;
+            header.sourceHash = sourceHash;
+            header.width = b.width;
+            header.height = b.height;
+            header.tileWidth = b.tileWidth;
+            header.tileHeight = b.tileHeight;
+
+            uint64_t offset = (sizeof(LevelFileHeader) + 7) & ~(uint64_t)7;
+            PlaceSection(header, LEVEL_TILESETS, b.tilesets, offset);
+            PlaceSection(header, LEVEL_TILE_LAYERS, b.tileLayers, offset);
+            PlaceSection(header, LEVEL_TILES, b.tiles, offset);
+            PlaceSection(header, LEVEL_OBJECT_LAYERS, b.objectLayers, offset);
+            PlaceSection(header, LEVEL_OBJECT_X, b.x, offset);
+            PlaceSection(header, LEVEL_OBJECT_Y, b.y, offset);
+            PlaceSection(header, LEVEL_OBJECT_WIDTH, b.w, offset);
+            PlaceSection(header, LEVEL_OBJECT_HEIGHT, b.h, offset);
+            PlaceSection(header, LEVEL_OBJECT_ROTATION, b.rotation, offset);
+            PlaceSection(header, LEVEL_OBJECT_ID, b.id, offset);
+            PlaceSection(header, LEVEL_OBJECT_GID, b.gid, offset);
+            PlaceSection(header, LEVEL_OBJECT_NAME, b.name, offset);
+            PlaceSection(header, LEVEL_OBJECT_TYPE, b.type, offset);
+            PlaceSection(header, LEVEL_OBJECT_SHAPE, b.shape, offset);
+            PlaceSection(header, LEVEL_OBJECT_FIRST_POINT, b.firstPoint, offset);
+            PlaceSection(header, LEVEL_OBJECT_POINT_COUNT, b.pointCount, offset);
+            PlaceSection(header, LEVEL_POINTS, b.points, offset);
+            PlaceSection(header, LEVEL_STRINGS, std::vector<char>(b.strings.begin(), b.strings.end()), offset);
+            PlaceSection(header, LEVEL_DEPENDENCIES, b.dependencies, offset);
+
+            size = (size_t)offset;
+            compiled.assign(size / 8, 0);
+            char* out = reinterpret_cast<char*>(compiled.data());
+            std::memcpy(out, &header, sizeof(header));
+
+            auto copy = [&](int section, const void* data) {
+                if (header.sections[section].size) std::memcpy(out + header.sections[section].offset, data, (size_t)header.sections[section].size);
+            };
+            copy(LEVEL_TILESETS, b.tilesets.data());
+            copy(LEVEL_TILE_LAYERS, b.tileLayers.data());
+            copy(LEVEL_TILES, b.tiles.data());
+            copy(LEVEL_OBJECT_LAYERS, b.objectLayers.data());
+            copy(LEVEL_OBJECT_X, b.x.data());
+            copy(LEVEL_OBJECT_Y, b.y.data());
+            copy(LEVEL_OBJECT_WIDTH, b.w.data());
+            copy(LEVEL_OBJECT_HEIGHT, b.h.data());
+            copy(LEVEL_OBJECT_ROTATION, b.rotation.data());
+            copy(LEVEL_OBJECT_ID, b.id.data());
+            copy(LEVEL_OBJECT_GID, b.gid.data());
+            copy(LEVEL_OBJECT_NAME, b.name.data());
+            copy(LEVEL_OBJECT_TYPE, b.type.data());
+            copy(LEVEL_OBJECT_SHAPE, b.shape.data());
+            copy(LEVEL_OBJECT_FIRST_POINT, b.firstPoint.data());
+            copy(LEVEL_OBJECT_POINT_COUNT, b.pointCount.data());
+            copy(LEVEL_POINTS, b.points.data());
+            copy(LEVEL_STRINGS, b.strings.data());
+            copy(LEVEL_DEPENDENCIES, b.dependencies.data());
+        }
+
+    }
+
+    bool ImportTiledMap(const std::string& path, const std::string& source,
+        std::vector<uint64_t>& compiled, size_t& size) {
+        LevelBuilder b;
+        b.mapDirectory = std::filesystem::path(path).parent_path().generic_string();
+
+        // TMX is XML; .tmj and older .json maps start with an object
+        size_t first = 0;
+        while (first < source.size() && std::isspace((unsigned char)source[first])) ++first;
+        const bool json = first < source.size() && source[first] == '{';
+        if (!(json ? ImportTmj(b, source) : ImportTmx(b, source))) {
+            std::cerr << "Level: failed to import " << path << std::endl;
+            return false;
+        }
+        if (b.width <= 0 || b.height <= 0 || b.tileWidth <= 0 || b.tileHeight <= 0) {
+            std::cerr << "Level: " << path << " has no valid map size" << std::endl;
+            return false;
+        }
+
+        Serialize(b, HashBytes(source.data(), source.size()), compiled, size);
+        return true;
+    }
+
+}
@@ -1,5 +1,7 @@
 #include "openglErrorReporting.h"
 #include <iostream>
+#include <cstring>
+#include <string>
 
 //https://learnopengl.com/In-Practice/Debugging
 void GLAPIENTRY glDebugOutput(GLenum source,
@@ -14,7 +16,11 @@ void GLAPIENTRY glDebugOutput(GLenum source,
 	if (id == 131169 || id == 131185 || id == 131218 || id == 131204
 		|| id == 131222
 		) return;
-	if (type == GL_DEBUG_TYPE_PERFORMANCE) return;
+	// Performance hints are too chatty for stdout, but useful next to the zones that caused them
+	if (type == GL_DEBUG_TYPE_PERFORMANCE) {
+		ech::ProfilerMarker(std::string("GL perf: ") + std::string(message, length > 0 ? (size_t)length : std::strlen(message)));
+		return;
+	}
 
 	std::cout << "---------------" << std::endl;
 	std::cout << "Debug message (" << id << "): " << message << std::endl;
@@ -0,0 +1,533 @@
+#include "particles.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "collision.hpp"
+#include "graphics_internal.hpp"
+#include "jobs.hpp"
+#include "profiler.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ECH_PARTICLES_X86 1
+#include <immintrin.h>
+#else
+#define ECH_PARTICLES_X86 0
+#endif
+
+#if ECH_PARTICLES_X86 && (defined(__GNUC__) || defined(__clang__))
+#define ECH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ECH_TARGET_AVX2
+#endif
+
+namespace ech {
+
+    namespace {
+
+        // Particles per update task: big enough that the memory traffic dwarfs the scheduling
+        constexpr int UpdateGrain = 16384;
+
+        static const char* particleVertexShaderSource = R"(
+            #version 330 core
+            layout (location = 0) in vec2 aCorner;
+            layout (location = 1) in float aX;
+            layout (location = 2) in float aY;
+            layout (location = 3) in float aAge;
+            out vec2 TexCoord;
+            out vec4 ParticleColor;
+            uniform mat4 uProjection;
+            uniform mat4 uView;
+            uniform vec2 uSize;
+            uniform vec4 uStartColor;
+            uniform vec4 uEndColor;
+            void main() {
+                float size = mix(uSize.x, uSize.y, aAge);
+                gl_Position = uProjection * uView * vec4(vec2(aX, aY) + aCorner * size, 0.0, 1.0);
+                TexCoord = aCorner + 0.5;
+                ParticleColor = mix(uStartColor, uEndColor, aAge);
+            }
+        )";
+
+        static const char* particleFragmentShaderSource = R"(
+            #version 330 core
+            in vec2 TexCoord;
+            in vec4 ParticleColor;
+            out vec4 FragColor;
+            uniform sampler2D texture1;
+            uniform bool uTextured;
+            void main() {
+                vec4 color = ParticleColor;
+                if (uTextured) color *= texture(texture1, TexCoord);
+                FragColor = color;
+            }
+        )";
+
+        // Shared by every particle system: the program and the unit quad the instances stretch
+        struct ParticleRenderer {
+            unsigned int program = 0;
+            unsigned int cornerVBO = 0;
+            int projection = -1, view = -1, size = -1;
+            int startColor = -1, endColor = -1, textured = -1, texture = -1;
+        };
+
+        ParticleRenderer& Renderer() {
+            static ParticleRenderer renderer;
+            return renderer;
+        }
+
+        ParticleRenderer& GetRenderer() {
+            ParticleRenderer& r = Renderer();
+            if (r.program) return r;
+
+            r.program = CreateShaderProgram(particleVertexShaderSource, particleFragmentShaderSource);
+            r.projection = glGetUniformLocation(r.program, "uProjection");
+            r.view = glGetUniformLocation(r.program, "uView");
+            r.size = glGetUniformLocation(r.program, "uSize");
+            r.startColor = glGetUniformLocation(r.program, "uStartColor");
+            r.endColor = glGetUniformLocation(r.program, "uEndColor");
+            r.textured = glGetUniformLocation(r.program, "uTextured");
+            r.texture = glGetUniformLocation(r.program, "texture1");
+
+            // Triangle strip
+            const float corners[] = { -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+            glGenBuffers(1, &r.cornerVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, r.cornerVBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+            ECH_STATS_UPLOAD(sizeof(corners));
+            return r;
+        }
+
+        // Pointers into one pool's arrays
+        struct Streams {
+            float* x;
+            float* y;
+            float* vx;
+            float* vy;
+            float* age;
+            float* ageRate;
+        };
+
+        struct Integration {
+            float dt, gravityX, gravityY, damping;
+        };
+
+        using IntegrateKernel = void (*)(const Streams& s, int begin, int end, const Integration& in);
+
+        // Semi-implicit Euler with the same damping as Physics: v = (v + g dt) / (1 + drag dt)
+        inline void IntegrateOne(const Streams& s, int i, const Integration& in) {
+            const float vx = (s.vx[i] + in.gravityX * in.dt) * in.damping;
+            const float vy = (s.vy[i] + in.gravityY * in.dt) * in.damping;
+            s.vx[i] = vx;
+            s.vy[i] = vy;
+            s.x[i] += vx * in.dt;
+            s.y[i] += vy * in.dt;
+            s.age[i] += s.ageRate[i] * in.dt;
+        }
+
+        void IntegrateScalar(const Streams& s, int begin, int end, const Integration& in) {
+            for (int i = begin; i < end; ++i) IntegrateOne(s, i, in);
+        }
+
+#if ECH_PARTICLES_X86
+        void IntegrateSSE2(const Streams& s, int begin, int end, const Integration& in) {
+            const __m128 dt = _mm_set1_ps(in.dt), damping = _mm_set1_ps(in.damping);
+            const __m128 gx = _mm_set1_ps(in.gravityX * in.dt), gy = _mm_set1_ps(in.gravityY * in.dt);
+            int i = begin;
+            for (; i + 4 <= end; i += 4) {
+                const __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(s.vx + i), gx), damping);
+                const __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(s.vy + i), gy), damping);
+                _mm_storeu_ps(s.vx + i, vx);
+                _mm_storeu_ps(s.vy + i, vy);
+                _mm_storeu_ps(s.x + i, _mm_add_ps(_mm_loadu_ps(s.x + i), _mm_mul_ps(vx, dt)));
+                _mm_storeu_ps(s.y + i, _mm_add_ps(_mm_loadu_ps(s.y + i), _mm_mul_ps(vy, dt)));
+                _mm_storeu_ps(s.age + i, _mm_add_ps(_mm_loadu_ps(s.age + i), _mm_mul_ps(_mm_loadu_ps(s.ageRate + i), dt)));
+            }
+            for (; i < end; ++i) IntegrateOne(s, i, in);
+        }
+
+        ECH_TARGET_AVX2
+        void IntegrateAVX2(const Streams& s, int begin, int end, const Integration& in) {
+            const __m256 dt = _mm256_set1_ps(in.dt), damping = _mm256_set1_ps(in.damping);
+            const __m256 gx = _mm256_set1_ps(in.gravityX * in.dt), gy = _mm256_set1_ps(in.gravityY * in.dt);
+            int i = begin;
+            for (; i + 8 <= end; i += 8) {
+                const __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.vx + i), gx), damping);
+                const __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.vy + i), gy), damping);
+                _mm256_storeu_ps(s.vx + i, vx);
+                _mm256_storeu_ps(s.vy + i, vy);
+                _mm256_storeu_ps(s.x + i, _mm256_add_ps(_mm256_loadu_ps(s.x + i), _mm256_mul_ps(vx, dt)));
+                _mm256_storeu_ps(s.y + i, _mm256_add_ps(_mm256_loadu_ps(s.y + i), _mm256_mul_ps(vy, dt)));
+                _mm256_storeu_ps(s.age + i, _mm256_add_ps(_mm256_loadu_ps(s.age + i), _mm256_mul_ps(_mm256_loadu_ps(s.ageRate + i), dt)));
+            }
+            for (; i < end; ++i) IntegrateOne(s, i, in);
+        }
+#endif
+
+        IntegrateKernel KernelFor(SimdLevel level) {
+            switch (level) {
+#if ECH_PARTICLES_X86
+            case SIMD_AVX2: return IntegrateAVX2;
+            case SIMD_SSE2: return IntegrateSSE2;
+#endif
+            default: return IntegrateScalar;
+            }
+        }
+
+        inline void CopyParticle(const Streams& s, int from, int to) {
+            s.x[to] = s.x[from];
+            s.y[to] = s.y[from];
+            s.vx[to] = s.vx[from];
+            s.vy[to] = s.vy[from];
+            s.age[to] = s.age[from];
+            s.ageRate[to] = s.ageRate[from];
+        }
+
+        // Swap-removes the dead particles of [begin, end) and returns how many are left, packed
+        // at begin. A NaN age counts as dead.
+        int CompactRange(const Streams& s, int begin, int end) {
+            int i = begin;
+            while (i < end) {
+                if (s.age[i] < 1.0f) {
+                    ++i;
+                    continue;
+                }
+                --end;
+                CopyParticle(s, end, i);
+            }
+            return end - begin;
+        }
+
+        void MoveRange(const Streams& s, int from, int to, int count) {
+            float* arrays[] = { s.x, s.y, s.vx, s.vy, s.age, s.ageRate };
+            for (float* a : arrays) std::memmove(a + to, a + from, (size_t)count * sizeof(float));
+        }
+
+        bool ValidDef(const EmitterDef& def) {
+            if (def.maxParticles <= 0 || !(def.lifeMin > 0.0f) || !(def.lifeMax >= def.lifeMin) ||
+                !(def.speedMax >= def.speedMin) || !(def.rate >= 0.0f) ||
+                !(def.width >= 0.0f) || !(def.height >= 0.0f) || !(def.drag >= 0.0f)) {
+                std::cerr << "ParticleSystem: invalid emitter (needs maxParticles > 0, 0 < lifeMin <= lifeMax, "
+                    "speedMin <= speedMax and non-negative rate, area and drag)" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+    }
+
+    struct ParticleSystem::Impl {
+        struct Emitter {
+            EmitterDef def;
+            bool alive = false;
+            float spawnDebt = 0.0f;
+            int count = 0;
+            std::vector<float> x, y, vx, vy, age, ageRate;
+            // Instance buffer: all x, then all y, then all ages, each maxParticles long
+            unsigned int vao = 0, instanceVBO = 0;
+            int instanceCapacity = 0;
+
+            Streams GetStreams() {
+                return { x.data(), y.data(), vx.data(), vy.data(), age.data(), ageRate.data() };
+            }
+
+            void Resize(int capacity) {
+                for (std::vector<float>* a : { &x, &y, &vx, &vy, &age, &ageRate }) {
+                    a->resize((size_t)capacity);
+                    a->shrink_to_fit();
+                }
+                count = std::min(count, capacity);
+            }
+
+            void ReleaseBuffers() {
+                if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+                if (vao) glDeleteVertexArrays(1, &vao);
+                vao = instanceVBO = 0;
+                instanceCapacity = 0;
+            }
+        };
+
+        explicit Impl(int workerCount) : workerCount(workerCount) {}
+
+        Emitter* Get(int emitter) {
+            if (emitter < 0 || emitter >= (int)emitters.size() || !emitters[emitter].alive) return nullptr;
+            return &emitters[emitter];
+        }
+
+        // xorshift32: cheap, and the same sequence on every platform
+        float Random() {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            return (float)(rng >> 8) * (1.0f / 16777216.0f);
+        }
+
+        void Spawn(Emitter& e, int n);
+        void UpdateEmitter(Emitter& e, float dt, IntegrateKernel kernel);
+        void BeginDraw();
+        void DrawEmitter(Emitter& e);
+
+        std::vector<Emitter> emitters;
+        std::vector<int> freeList;
+        std::vector<int> chunkAlive;
+        int workerCount;
+        uint32_t rng = 0x9e3779b9u;
+    };
+
+    void ParticleSystem::Impl::Spawn(Emitter& e, int n) {
+        const EmitterDef& d = e.def;
+        n = std::min(n, d.maxParticles - e.count);
+        for (int k = 0; k < n; ++k) {
+            const int i = e.count++;
+            const float angle = d.direction + (Random() - 0.5f) * d.spread;
+            const float speed = d.speedMin + (d.speedMax - d.speedMin) * Random();
+            const float life = d.lifeMin + (d.lifeMax - d.lifeMin) * Random();
+            e.x[i] = d.x + (Random() - 0.5f) * d.width;
+            e.y[i] = d.y + (Random() - 0.5f) * d.height;
+            e.vx[i] = std::cos(angle) * speed;
+            e.vy[i] = std::sin(angle) * speed;
+            e.age[i] = 0.0f;
+            e.ageRate[i] = 1.0f / life;
+        }
+    }
+
+    void ParticleSystem::Impl::UpdateEmitter(Emitter& e, float dt, IntegrateKernel kernel) {
+        if (e.count > 0) {
+            const Streams s = e.GetStreams();
+            const Integration in = { dt, e.def.gravityX, e.def.gravityY, 1.0f / (1.0f + dt * e.def.drag) };
+
+            // Each task integrates its range and packs its survivors at the start of it; the
+            // gaps between ranges are closed afterwards
+            const int chunks = (e.count + UpdateGrain - 1) / UpdateGrain;
+            chunkAlive.assign((size_t)chunks, 0);
+            ParallelFor(e.count, UpdateGrain, [&](int begin, int end) {
+                kernel(s, begin, end, in);
+                chunkAlive[begin / UpdateGrain] = CompactRange(s, begin, end);
+            }, workerCount);
+
+            int count = chunkAlive[0];
+            for (int c = 1; c < chunks; ++c) {
+                if (chunkAlive[c] > 0 && count != c * UpdateGrain) MoveRange(s, c * UpdateGrain, count, chunkAlive[c]);
+                count += chunkAlive[c];
+            }
+            e.count = count;
+        }
+
+        e.spawnDebt += e.def.rate * dt;
+        const int spawn = (int)e.spawnDebt;
+        e.spawnDebt -= (float)spawn;
+        Spawn(e, spawn);
+    }
+
+    void ParticleSystem::Impl::BeginDraw() {
+        const ParticleRenderer& r = GetRenderer();
+        glUseProgram(r.program);
+        ECH_STATS_SHADER(r.program);
+        glUniformMatrix4fv(r.projection, 1, GL_FALSE, glm::value_ptr(projection));
+        glUniformMatrix4fv(r.view, 1, GL_FALSE, glm::value_ptr(view));
+        glUniform1i(r.texture, 0);
+    }
+
+    void ParticleSystem::Impl::DrawEmitter(Emitter& e) {
+        const ParticleRenderer& r = Renderer();
+        const int capacity = e.def.maxParticles;
+
+        if (!e.vao || e.instanceCapacity != capacity) {
+            e.ReleaseBuffers();
+            glGenVertexArrays(1, &e.vao);
+            glGenBuffers(1, &e.instanceVBO);
+            glBindVertexArray(e.vao);
+
+            glBindBuffer(GL_ARRAY_BUFFER, r.cornerVBO);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+
+            glBindBuffer(GL_ARRAY_BUFFER, e.instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, (size_t)capacity * 3 * sizeof(float), nullptr, GL_STREAM_DRAW);
+            for (int a = 0; a < 3; ++a) {
+                glVertexAttribPointer(1 + a, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)((size_t)a * capacity * sizeof(float)));
+                glEnableVertexAttribArray(1 + a);
+                glVertexAttribDivisor(1 + a, 1);
+            }
+            e.instanceCapacity = capacity;
+        }
+        else {
+            glBindVertexArray(e.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, e.instanceVBO);
+            // Orphan last frame's storage so the upload never waits on draws still reading it
+            glBufferData(GL_ARRAY_BUFFER, (size_t)capacity * 3 * sizeof(float), nullptr, GL_STREAM_DRAW);
+        }
+
+        // The SoA arrays go up as they are: no per-particle packing on the CPU
+        const size_t bytes = (size_t)e.count * sizeof(float);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, e.x.data());
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)capacity * sizeof(float), bytes, e.y.data());
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)capacity * 2 * sizeof(float), bytes, e.age.data());
+        ECH_STATS_UPLOAD(bytes * 3);
+
+        const EmitterDef& d = e.def;
+        glUniform2f(r.size, d.startSize, d.endSize);
+        glUniform4fv(r.startColor, 1, d.startColor);
+        glUniform4fv(r.endColor, 1, d.endColor);
+        glUniform1i(r.textured, d.texture != 0);
+        if (d.texture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, d.texture);
+            ECH_STATS_TEXTURE_BIND(d.texture);
+        }
+
+        if (d.additive) glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, e.count);
+        ECH_STATS_DRAW(4 * e.count);
+        if (d.additive) glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glBindVertexArray(0);
+    }
+
+    ParticleSystem::ParticleSystem(int workerCount)
+        : m_Impl(new Impl(workerCount)) {}
+
+    ParticleSystem::~ParticleSystem() {
+        for (Impl::Emitter& e : m_Impl->emitters) e.ReleaseBuffers();
+    }
+
+    int ParticleSystem::CreateEmitter(const EmitterDef& def) {
+        if (!ValidDef(def)) return -1;
+
+        Impl& p = *m_Impl;
+        int handle;
+        if (!p.freeList.empty()) {
+            handle = p.freeList.back();
+            p.freeList.pop_back();
+        }
+        else {
+            handle = (int)p.emitters.size();
+            p.emitters.emplace_back();
+        }
+
+        Impl::Emitter& e = p.emitters[handle];
+        e.def = def;
+        e.alive = true;
+        e.spawnDebt = 0.0f;
+        e.count = 0;
+        e.Resize(def.maxParticles);
+        return handle;
+    }
+
+    void ParticleSystem::DestroyEmitter(int emitter) {
+        Impl::Emitter* e = m_Impl->Get(emitter);
+        if (!e) return;
+        e->ReleaseBuffers();
+        e->alive = false;
+        e->count = 0;
+        e->Resize(0);
+        m_Impl->freeList.push_back(emitter);
+    }
+
+    bool ParticleSystem::IsValid(int emitter) const {
+        return m_Impl->Get(emitter) != nullptr;
+    }
+
+    const EmitterDef& ParticleSystem::GetEmitterDef(int emitter) const {
+        static const EmitterDef none;
+        const Impl::Emitter* e = m_Impl->Get(emitter);
+        return e ? e->def : none;
+    }
+
+    void ParticleSystem::SetEmitterDef(int emitter, const EmitterDef& def) {
+        Impl::Emitter* e = m_Impl->Get(emitter);
+        if (!e || !ValidDef(def)) return;
+        if (def.maxParticles != e->def.maxParticles) e->Resize(def.maxParticles);
+        e->def = def;
+    }
+
+    void ParticleSystem::SetEmitterPosition(int emitter, float x, float y) {
+        if (Impl::Emitter* e = m_Impl->Get(emitter)) {
+            e->def.x = x;
+            e->def.y = y;
+        }
+    }
+
+    void ParticleSystem::SetEmitterRate(int emitter, float rate) {
+        if (Impl::Emitter* e = m_Impl->Get(emitter)) e->def.rate = std::max(0.0f, rate);
+    }
+
+    void ParticleSystem::Burst(int emitter, int count) {
+        if (Impl::Emitter* e = m_Impl->Get(emitter)) m_Impl->Spawn(*e, count);
+    }
+
+    void ParticleSystem::Clear(int emitter) {
+        if (Impl::Emitter* e = m_Impl->Get(emitter)) e->count = 0;
+    }
+
+    void ParticleSystem::Update(float dt) {
+        ECH_PROFILE_SCOPE("ParticleSystem::Update");
+        if (!(dt > 0.0f)) return;
+        const IntegrateKernel kernel = KernelFor(GetSimdLevel());
+        for (Impl::Emitter& e : m_Impl->emitters)
+            if (e.alive) m_Impl->UpdateEmitter(e, dt, kernel);
+    }
+
+    void ParticleSystem::Draw() {
+        ECH_PROFILE_SCOPE("ParticleSystem::Draw");
+        bool begun = false;
+        for (Impl::Emitter& e : m_Impl->emitters) {
+            if (!e.alive || e.count == 0) continue;
+            if (!begun) m_Impl->BeginDraw();
+            begun = true;
+            m_Impl->DrawEmitter(e);
+        }
+    }
+
+    void ParticleSystem::Draw(int emitter) {
+        Impl::Emitter* e = m_Impl->Get(emitter);
+        if (!e || e->count == 0) return;
+        ECH_PROFILE_SCOPE("ParticleSystem::Draw");
+        m_Impl->BeginDraw();
+        m_Impl->DrawEmitter(*e);
+    }
+
+    int ParticleSystem::GetParticleCount() const {
+        int total = 0;
+        for (const Impl::Emitter& e : m_Impl->emitters) total += e.count;
+        return total;
+    }
+
+    int ParticleSystem::GetParticleCount(int emitter) const {
+        const Impl::Emitter* e = m_Impl->Get(emitter);
+        return e ? e->count : 0;
+    }
+
+    const float* ParticleSystem::GetParticleX(int emitter) const {
+        const Impl::Emitter* e = m_Impl->Get(emitter);
+        return e ? e->x.data() : nullptr;
+    }
+
+    const float* ParticleSystem::GetParticleY(int emitter) const {
+        const Impl::Emitter* e = m_Impl->Get(emitter);
+        return e ? e->y.data() : nullptr;
+    }
+
+    const float* ParticleSystem::GetParticleAge(int emitter) const {
+        const Impl::Emitter* e = m_Impl->Get(emitter);
+        return e ? e->age.data() : nullptr;
+    }
+
+    int ParticleSystem::GetWorkerCount() const {
+        const int workers = GetJobWorkerCount();
+        return m_Impl->workerCount >= 0 ? std::min(m_Impl->workerCount, workers) : workers;
+    }
+
+    void ShutdownParticles() {
+        ParticleRenderer& r = Renderer();
+        if (r.cornerVBO) glDeleteBuffers(1, &r.cornerVBO);
+        if (r.program) glDeleteProgram(r.program);
+        r = ParticleRenderer();
+    }
+
+}
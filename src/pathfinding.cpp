@@ -0,0 +1,931 @@
+#include "pathfinding.hpp"
+#include "jobs.hpp"
+#include "tile_collision.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <mutex>
+
+namespace ech {
+
+    namespace {
+
+        constexpr float Sqrt2 = 1.41421356f;
+        constexpr float Unreachable = std::numeric_limits<float>::infinity();
+        constexpr int DefaultClusterSize = 16;
+        // Open stretches of a cluster edge shorter than this get one link in the middle,
+        // longer ones a link at each end
+        constexpr int LongEntrance = 6;
+
+        // The four straight moves, then the diagonals
+        constexpr int StepX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+        constexpr int StepY[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+        int Sign(int v) { return (v > 0) - (v < 0); }
+
+        struct HeapEntry {
+            float f, h;
+            int node;
+
+            // Ties go to the node closest to the goal, which saves most of the work on open maps
+            bool Before(const HeapEntry& o) const { return f < o.f || (f == o.f && h < o.h); }
+        };
+
+        // Node arrays for one search at a time. A node whose stamp isn't the current
+        // generation hasn't been reached by this search, so nothing is cleared between them.
+        struct SearchSpace {
+            std::vector<float> g;
+            std::vector<int> parent;
+            std::vector<int> heapIndex;         // position in the open list, -1 once closed
+            std::vector<uint32_t> stamp;
+            std::vector<HeapEntry> heap;
+            uint32_t generation = 0;
+
+            void Resize(size_t size) {
+                if (g.size() >= size) return;
+                g.resize(size);
+                parent.resize(size);
+                heapIndex.resize(size);
+                stamp.resize(size, 0);
+            }
+
+            void Begin() {
+                heap.clear();
+                if (++generation == 0) {
+                    std::fill(stamp.begin(), stamp.end(), 0u);
+                    generation = 1;
+                }
+            }
+
+            bool Reached(int n) const { return stamp[(size_t)n] == generation; }
+
+            // Opens the node, or lowers its cost if it's still open; false if nothing changed
+            bool Relax(int n, float cost, int from, float h) {
+                if (stamp[(size_t)n] != generation) {
+                    stamp[(size_t)n] = generation;
+                    heapIndex[(size_t)n] = (int)heap.size();
+                    heap.push_back({ 0.0f, 0.0f, n });
+                }
+                else if (heapIndex[(size_t)n] < 0 || cost >= g[(size_t)n]) return false;
+                g[(size_t)n] = cost;
+                parent[(size_t)n] = from;
+                SiftUp(heapIndex[(size_t)n], { cost + h, h, n });
+                return true;
+            }
+
+            int Pop() {
+                const int n = heap[0].node;
+                heapIndex[(size_t)n] = -1;
+                const HeapEntry last = heap.back();
+                heap.pop_back();
+                if (heap.empty()) return n;
+
+                const int size = (int)heap.size();
+                int i = 0;
+                for (;;) {
+                    int child = 2 * i + 1;
+                    if (child >= size) break;
+                    if (child + 1 < size && heap[(size_t)child + 1].Before(heap[(size_t)child])) child++;
+                    if (!heap[(size_t)child].Before(last)) break;
+                    Place(i, heap[(size_t)child]);
+                    i = child;
+                }
+                Place(i, last);
+                return n;
+            }
+
+            void SiftUp(int i, const HeapEntry& e) {
+                while (i > 0) {
+                    const int up = (i - 1) / 2;
+                    if (!e.Before(heap[(size_t)up])) break;
+                    Place(i, heap[(size_t)up]);
+                    i = up;
+                }
+                Place(i, e);
+            }
+
+            void Place(int i, const HeapEntry& e) {
+                heap[(size_t)i] = e;
+                heapIndex[(size_t)e.node] = i;
+            }
+        };
+
+        struct Bounds {
+            int x0, y0, x1, y1;     // x1 and y1 excluded
+        };
+
+    }
+
+    struct PathGrid::Impl {
+        // Search state of one thread
+        struct Context {
+            SearchSpace grid, graph;
+            std::vector<float> goalCost;        // per graph node, to the goal of a hierarchical query
+            std::vector<int> route;
+            std::vector<float> along;           // path cost up to each tile, while smoothing
+            std::vector<PathPoint> smoothed;
+        };
+
+        struct Cluster {
+            Bounds bounds;
+            std::vector<int> cells;             // linked tiles, sorted
+            std::vector<float> costs;           // between every two of them, inside the cluster
+            std::vector<int> pathOffset;        // path from cells[i] to cells[j], i < j: paths[offset] tiles follow
+            std::vector<int> paths;
+            int firstNode = 0;                  // graph node of cells[0]
+            bool dirty = true;
+        };
+
+        struct Edge {
+            int to;
+            float cost;
+        };
+
+        struct Request {
+            int startX, startY, goalX, goalY;
+            PathMethod method;
+            PathStatus status = PATH_INVALID;
+            std::vector<PathPoint> path;
+        };
+
+        // Copied from the request, which the game thread may move meanwhile
+        struct Work {
+            int request;
+            int startX, startY, goalX, goalY;
+            PathMethod method;
+            bool found;
+            std::vector<PathPoint> path;
+        };
+
+        explicit Impl(int workerCount) : workerCount(workerCount) {}
+
+        int Index(int x, int y) const { return (y + 1) * stride + x + 1; }
+        int X(int i) const { return i % stride - 1; }
+        int Y(int i) const { return i / stride - 1; }
+        bool Inside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+        float StepCost(int a, int b, bool diagonal) const {
+            return (float)(cost[(size_t)a] + cost[(size_t)b]) * (diagonal ? Sqrt2 * 0.5f : 0.5f);
+        }
+
+        // Exact for a grid of cost 1, and never more than the real cost otherwise
+        float Heuristic(int ax, int ay, int bx, int by) const {
+            const int dx = std::abs(ax - bx), dy = std::abs(ay - by);
+            if (!diagonal) return (float)(dx + dy);
+            return (float)std::max(dx, dy) + (Sqrt2 - 1.0f) * (float)std::min(dx, dy);
+        }
+
+        bool Create(int w, int h);
+        void LayoutClusters();
+        void SetCost(int x, int y, int value);
+
+        Context* Acquire();
+        void Release(Context* ctx);
+
+        bool Find(Context& ctx, int startX, int startY, int goalX, int goalY, std::vector<PathPoint>& path, PathMethod method);
+        float AStar(SearchSpace& s, int start, int goal, const Bounds& b) const;
+        float JumpPoint(SearchSpace& s, int start, int goal) const;
+        int JumpStraight(int x, int y, int dx, int dy, int goal) const;
+        int JumpDiagonal(int x, int y, int dx, int dy, int goal) const;
+        void AppendPath(const SearchSpace& s, int goal, std::vector<PathPoint>& path) const;
+
+        bool Hierarchical(Context& ctx, int start, int goal, std::vector<PathPoint>& path);
+        void Smooth(Context& ctx, std::vector<PathPoint>& path) const;
+        bool Line(const PathPoint& a, const PathPoint& b, float& total, std::vector<PathPoint>* out) const;
+        void EnsureGraph();
+        void RebuildGraph();
+        void LinkEdge(int ax, int ay, int bx, int by, int length, std::vector<std::vector<int>>& cells, std::vector<int>& links) const;
+        void ComputeCluster(Cluster& c, SearchSpace& s);
+        int ClusterOf(int cell) const { return (Y(cell) / clusterSize) * clustersX + X(cell) / clusterSize; }
+        int NodeOf(int cell) const;
+
+        void WaitForBatch() { WaitForJobs(batch); }
+        void CompleteBatch();
+        void StartBatch();
+
+        int width = 0, height = 0, stride = 0;
+        std::vector<uint8_t> cost;              // padded with a blocked border, so neighbours need no bounds checks
+        int weighted = 0;                       // walkable tiles costing more than 1
+        bool diagonal = true;
+
+        std::mutex contextMutex;
+        std::vector<std::unique_ptr<Context>> contexts;
+        std::vector<Context*> freeContexts;
+
+        // Cluster graph for PATH_HIERARCHICAL, rebuilt by the first query after a change
+        int clusterSize = DefaultClusterSize;
+        int clustersX = 0, clustersY = 0;
+        std::vector<Cluster> clusters;
+        std::vector<int> nodeCell;
+        std::vector<int> edgeStart;             // edges of node n: edges[edgeStart[n] .. edgeStart[n + 1])
+        std::vector<Edge> edges;
+        std::mutex graphMutex;
+        std::atomic<bool> graphDirty{ true };
+
+        std::vector<Request> requests;
+        std::vector<int> freeRequests;
+        std::vector<int> queued;                // waiting for the next Update()
+        std::vector<Work> running;              // the batch in flight
+        JobCounter batch;
+        int workerCount;
+    };
+
+    bool PathGrid::Impl::Create(int w, int h) {
+        WaitForBatch();
+        if (w <= 0 || h <= 0) {
+            std::cerr << "PathGrid: invalid size " << w << "x" << h << std::endl;
+            return false;
+        }
+        width = w;
+        height = h;
+        stride = w + 2;
+        cost.assign((size_t)stride * (size_t)(h + 2), 0);
+        for (int y = 0; y < h; ++y) std::fill_n(cost.begin() + Index(0, y), w, (uint8_t)1);
+        weighted = 0;
+        LayoutClusters();
+        return true;
+    }
+
+    void PathGrid::Impl::LayoutClusters() {
+        clustersX = (width + clusterSize - 1) / clusterSize;
+        clustersY = (height + clusterSize - 1) / clusterSize;
+        clusters.assign((size_t)clustersX * (size_t)clustersY, Cluster());
+        for (int cy = 0; cy < clustersY; ++cy) {
+            for (int cx = 0; cx < clustersX; ++cx) {
+                clusters[(size_t)(cy * clustersX + cx)].bounds = {
+                    cx * clusterSize, cy * clusterSize,
+                    std::min(width, (cx + 1) * clusterSize), std::min(height, (cy + 1) * clusterSize) };
+            }
+        }
+        graphDirty.store(true, std::memory_order_release);
+    }
+
+    void PathGrid::Impl::SetCost(int x, int y, int value) {
+        if (!Inside(x, y)) return;
+        const uint8_t c = (uint8_t)std::max(0, std::min(255, value));
+        uint8_t& tile = cost[(size_t)Index(x, y)];
+        if (tile == c) return;
+        WaitForBatch();
+        weighted += (c > 1) - (tile > 1);
+        tile = c;
+        // Diagonal moves check the tiles beside them, so paths in the clusters around may change too
+        for (int cy = std::max(0, y - 1) / clusterSize; cy <= std::min(height - 1, y + 1) / clusterSize; ++cy)
+            for (int cx = std::max(0, x - 1) / clusterSize; cx <= std::min(width - 1, x + 1) / clusterSize; ++cx)
+                clusters[(size_t)(cy * clustersX + cx)].dirty = true;
+        graphDirty.store(true, std::memory_order_release);
+    }
+
+    PathGrid::Impl::Context* PathGrid::Impl::Acquire() {
+        Context* ctx;
+        {
+            std::lock_guard<std::mutex> lock(contextMutex);
+            if (freeContexts.empty()) {
+                contexts.emplace_back(new Context());
+                freeContexts.push_back(contexts.back().get());
+            }
+            ctx = freeContexts.back();
+            freeContexts.pop_back();
+        }
+        ctx->grid.Resize(cost.size());
+        return ctx;
+    }
+
+    void PathGrid::Impl::Release(Context* ctx) {
+        std::lock_guard<std::mutex> lock(contextMutex);
+        freeContexts.push_back(ctx);
+    }
+
+    bool PathGrid::Impl::Find(Context& ctx, int startX, int startY, int goalX, int goalY, std::vector<PathPoint>& path, PathMethod method) {
+        path.clear();
+        if (!Inside(startX, startY) || !Inside(goalX, goalY)) return false;
+        const int start = Index(startX, startY), goal = Index(goalX, goalY);
+        if (!cost[(size_t)start] || !cost[(size_t)goal]) return false;
+        if (start == goal) {
+            path.push_back({ startX, startY });
+            return true;
+        }
+
+        if (method == PATH_HIERARCHICAL) return Hierarchical(ctx, start, goal, path);
+        const bool jump = method == PATH_JUMP_POINT && diagonal && weighted == 0;
+        const float found = jump ? JumpPoint(ctx.grid, start, goal) : AStar(ctx.grid, start, goal, { 0, 0, width, height });
+        if (found == Unreachable) return false;
+        AppendPath(ctx.grid, goal, path);
+        return true;
+    }
+
+    // Without a goal (-1), reaches every tile it can inside the bounds and returns 0
+    float PathGrid::Impl::AStar(SearchSpace& s, int start, int goal, const Bounds& b) const {
+        const int goalX = goal >= 0 ? X(goal) : 0, goalY = goal >= 0 ? Y(goal) : 0;
+        const int directions = diagonal ? 8 : 4;
+        s.Begin();
+        s.Relax(start, 0.0f, -1, goal >= 0 ? Heuristic(X(start), Y(start), goalX, goalY) : 0.0f);
+        while (!s.heap.empty()) {
+            const int n = s.Pop();
+            if (n == goal) return s.g[(size_t)n];
+            const int x = X(n), y = Y(n);
+            const float g = s.g[(size_t)n];
+            for (int d = 0; d < directions; ++d) {
+                const int nx = x + StepX[d], ny = y + StepY[d];
+                if (nx < b.x0 || ny < b.y0 || nx >= b.x1 || ny >= b.y1) continue;
+                const int m = n + StepY[d] * stride + StepX[d];
+                if (!cost[(size_t)m]) continue;
+                if (d >= 4 && (!cost[(size_t)(n + StepX[d])] || !cost[(size_t)(n + StepY[d] * stride)])) continue;
+                s.Relax(m, g + StepCost(n, m, d >= 4), n, goal >= 0 ? Heuristic(nx, ny, goalX, goalY) : 0.0f);
+            }
+        }
+        return goal >= 0 ? Unreachable : 0.0f;
+    }
+
+    // Jump point search (Harabor and Grastien), in its variant without corner cutting. Only
+    // the tiles where the shortest path may turn are ever put on the open list: straight
+    // runs are scanned past as long as nothing around them opens up.
+    float PathGrid::Impl::JumpPoint(SearchSpace& s, int start, int goal) const {
+        const int goalX = X(goal), goalY = Y(goal);
+        s.Begin();
+        s.Relax(start, 0.0f, -1, Heuristic(X(start), Y(start), goalX, goalY));
+        while (!s.heap.empty()) {
+            const int n = s.Pop();
+            if (n == goal) return s.g[(size_t)n];
+            const int x = X(n), y = Y(n);
+
+            // Directions worth following given where the search came from
+            int dirX[8], dirY[8], count = 0;
+            const int from = s.parent[(size_t)n];
+            if (from < 0) {
+                for (int d = 0; d < 8; ++d) {
+                    dirX[count] = StepX[d];
+                    dirY[count++] = StepY[d];
+                }
+            }
+            else {
+                const int dx = Sign(x - X(from)), dy = Sign(y - Y(from));
+                if (dx && dy) {
+                    const bool openX = cost[(size_t)(n + dx)] != 0, openY = cost[(size_t)(n + dy * stride)] != 0;
+                    if (openY) { dirX[count] = 0; dirY[count++] = dy; }
+                    if (openX) { dirX[count] = dx; dirY[count++] = 0; }
+                    if (openX && openY) { dirX[count] = dx; dirY[count++] = dy; }
+                }
+                else if (dx) {
+                    const bool ahead = cost[(size_t)(n + dx)] != 0;
+                    const bool up = cost[(size_t)(n - stride)] != 0, down = cost[(size_t)(n + stride)] != 0;
+                    if (ahead) { dirX[count] = dx; dirY[count++] = 0; }
+                    if (ahead && up) { dirX[count] = dx; dirY[count++] = -1; }
+                    if (ahead && down) { dirX[count] = dx; dirY[count++] = 1; }
+                    if (up) { dirX[count] = 0; dirY[count++] = -1; }
+                    if (down) { dirX[count] = 0; dirY[count++] = 1; }
+                }
+                else {
+                    const bool ahead = cost[(size_t)(n + dy * stride)] != 0;
+                    const bool left = cost[(size_t)(n - 1)] != 0, right = cost[(size_t)(n + 1)] != 0;
+                    if (ahead) { dirX[count] = 0; dirY[count++] = dy; }
+                    if (ahead && left) { dirX[count] = -1; dirY[count++] = dy; }
+                    if (ahead && right) { dirX[count] = 1; dirY[count++] = dy; }
+                    if (left) { dirX[count] = -1; dirY[count++] = 0; }
+                    if (right) { dirX[count] = 1; dirY[count++] = 0; }
+                }
+            }
+
+            const float g = s.g[(size_t)n];
+            for (int i = 0; i < count; ++i) {
+                const int next = dirX[i] && dirY[i] ? JumpDiagonal(x, y, dirX[i], dirY[i], goal) : JumpStraight(x, y, dirX[i], dirY[i], goal);
+                if (next < 0) continue;
+                const int nx = X(next), ny = Y(next);
+                s.Relax(next, g + Heuristic(x, y, nx, ny), n, Heuristic(nx, ny, goalX, goalY));
+            }
+        }
+        return Unreachable;
+    }
+
+    // First jump point going straight from (x, y), or -1. The blocked border stops every scan.
+    int PathGrid::Impl::JumpStraight(int x, int y, int dx, int dy, int goal) const {
+        const int step = dy * stride + dx;
+        int n = Index(x, y);
+        for (;;) {
+            n += step;
+            if (!cost[(size_t)n]) return -1;
+            if (n == goal) return n;
+            // A tile beside the run opens up right after a blocked one: the path may turn there
+            if (dx) {
+                if ((cost[(size_t)(n - stride)] && !cost[(size_t)(n - dx - stride)]) ||
+                    (cost[(size_t)(n + stride)] && !cost[(size_t)(n - dx + stride)])) return n;
+            }
+            else {
+                if ((cost[(size_t)(n - 1)] && !cost[(size_t)(n - 1 - dy * stride)]) ||
+                    (cost[(size_t)(n + 1)] && !cost[(size_t)(n + 1 - dy * stride)])) return n;
+            }
+        }
+    }
+
+    int PathGrid::Impl::JumpDiagonal(int x, int y, int dx, int dy, int goal) const {
+        int n = Index(x, y);
+        for (;;) {
+            if (!cost[(size_t)(n + dx)] || !cost[(size_t)(n + dy * stride)]) return -1;
+            n += dy * stride + dx;
+            x += dx;
+            y += dy;
+            if (!cost[(size_t)n]) return -1;
+            if (n == goal) return n;
+            // Any straight run from here that finds something makes this a turning point
+            if (JumpStraight(x, y, dx, 0, goal) >= 0 || JumpStraight(x, y, 0, dy, goal) >= 0) return n;
+        }
+    }
+
+    // Appends the tiles from the search's start to goal. Parents may be jump points some
+    // tiles apart, always in a straight or diagonal line, so the gaps are filled in.
+    void PathGrid::Impl::AppendPath(const SearchSpace& s, int goal, std::vector<PathPoint>& path) const {
+        const size_t first = path.size();
+        for (int n = goal; n >= 0; n = s.parent[(size_t)n]) {
+            const int from = s.parent[(size_t)n];
+            int x = X(n), y = Y(n);
+            path.push_back({ x, y });
+            if (from < 0) break;
+            const int fx = X(from), fy = Y(from);
+            const int dx = Sign(fx - x), dy = Sign(fy - y);
+            for (x += dx, y += dy; x != fx || y != fy; x += dx, y += dy) path.push_back({ x, y });
+        }
+        std::reverse(path.begin() + (std::ptrdiff_t)first, path.end());
+    }
+
+    bool PathGrid::Impl::Hierarchical(Context& ctx, int start, int goal, std::vector<PathPoint>& path) {
+        EnsureGraph();
+        const Cluster& from = clusters[(size_t)ClusterOf(start)];
+        const Cluster& to = clusters[(size_t)ClusterOf(goal)];
+        // Close by, a plain search over the one or two clusters is cheap and avoids detours
+        // through the links
+        const Bounds near = {
+            std::min(from.bounds.x0, to.bounds.x0), std::min(from.bounds.y0, to.bounds.y0),
+            std::max(from.bounds.x1, to.bounds.x1), std::max(from.bounds.y1, to.bounds.y1) };
+        if (near.x1 - near.x0 <= 2 * clusterSize && near.y1 - near.y0 <= 2 * clusterSize && AStar(ctx.grid, start, goal, near) != Unreachable) {
+            AppendPath(ctx.grid, goal, path);
+            return true;
+        }
+
+        // The goal and the start join the graph through the linked tiles they reach inside
+        // their cluster. Costs are symmetric, so one search from the goal gives them all.
+        const int nodes = (int)nodeCell.size();
+        const int startNode = nodes, goalNode = nodes + 1;
+        if (ctx.goalCost.size() < (size_t)nodes) ctx.goalCost.resize((size_t)nodes, Unreachable);
+        AStar(ctx.grid, goal, -1, to.bounds);
+        bool linked = false;
+        for (size_t i = 0; i < to.cells.size(); ++i) {
+            if (!ctx.grid.Reached(to.cells[i])) continue;
+            ctx.goalCost[(size_t)to.firstNode + i] = ctx.grid.g[(size_t)to.cells[i]];
+            linked = true;
+        }
+
+        SearchSpace& s = ctx.graph;
+        s.Resize((size_t)nodes + 2);
+        s.Begin();
+        if (linked) {
+            AStar(ctx.grid, start, -1, from.bounds);
+            const int goalX = X(goal), goalY = Y(goal);
+            for (size_t i = 0; i < from.cells.size(); ++i) {
+                const int cell = from.cells[i];
+                if (ctx.grid.Reached(cell)) s.Relax(from.firstNode + (int)i, ctx.grid.g[(size_t)cell], startNode, Heuristic(X(cell), Y(cell), goalX, goalY));
+            }
+            while (!s.heap.empty()) {
+                const int n = s.Pop();
+                if (n == goalNode) break;
+                const float g = s.g[(size_t)n];
+                for (int e = edgeStart[(size_t)n]; e < edgeStart[(size_t)n + 1]; ++e) {
+                    const int m = edges[(size_t)e].to;
+                    s.Relax(m, g + edges[(size_t)e].cost, n, Heuristic(X(nodeCell[(size_t)m]), Y(nodeCell[(size_t)m]), goalX, goalY));
+                }
+                if (ctx.goalCost[(size_t)n] != Unreachable) s.Relax(goalNode, g + ctx.goalCost[(size_t)n], n, 0.0f);
+            }
+        }
+        for (size_t i = 0; i < to.cells.size(); ++i) ctx.goalCost[(size_t)to.firstNode + i] = Unreachable;
+        if (!linked || !s.Reached(goalNode) || s.heapIndex[(size_t)goalNode] >= 0) return false;
+
+        // Stitch the path together: searches inside the end clusters, cached paths between
+        // the links of one cluster, and single steps from one cluster to the next
+        ctx.route.clear();
+        for (int n = s.parent[(size_t)goalNode]; n != startNode; n = s.parent[(size_t)n]) ctx.route.push_back(n);
+        std::reverse(ctx.route.begin(), ctx.route.end());
+
+        AStar(ctx.grid, start, nodeCell[(size_t)ctx.route.front()], from.bounds);
+        AppendPath(ctx.grid, nodeCell[(size_t)ctx.route.front()], path);
+        for (size_t k = 1; k < ctx.route.size(); ++k) {
+            const int a = nodeCell[(size_t)ctx.route[k - 1]], b = nodeCell[(size_t)ctx.route[k]];
+            const Cluster& c = clusters[(size_t)ClusterOf(a)];
+            if (ClusterOf(b) != ClusterOf(a)) {
+                path.push_back({ X(b), Y(b) });
+                continue;
+            }
+            const int i = ctx.route[k - 1] - c.firstNode, j = ctx.route[k] - c.firstNode;
+            const int count = (int)c.cells.size();
+            const int* cached = &c.paths[(size_t)c.pathOffset[(size_t)(std::min(i, j) * count + std::max(i, j))]];
+            const int length = cached[0];
+            for (int t = 1; t < length; ++t) {
+                const int cell = cached[i < j ? 1 + t : length - t];
+                path.push_back({ X(cell), Y(cell) });
+            }
+        }
+        AStar(ctx.grid, nodeCell[(size_t)ctx.route.back()], goal, to.bounds);
+        const size_t joint = path.size();
+        AppendPath(ctx.grid, goal, path);
+        path.erase(path.begin() + (std::ptrdiff_t)joint);
+        Smooth(ctx, path);
+        return true;
+    }
+
+    // The stitched path bends wherever it goes through a link. Each stretch is replaced with
+    // the straightest line from its first tile to the furthest tile ahead that the line
+    // reaches for no more cost, looking a few clusters ahead at most.
+    void PathGrid::Impl::Smooth(Context& ctx, std::vector<PathPoint>& path) const {
+        const size_t count = path.size();
+        if (count < 3) return;
+        std::vector<float>& along = ctx.along;
+        along.resize(count);
+        along[0] = 0.0f;
+        for (size_t i = 1; i < count; ++i) {
+            const PathPoint& a = path[i - 1];
+            const PathPoint& b = path[i];
+            along[i] = along[i - 1] + StepCost(Index(a.x, a.y), Index(b.x, b.y), a.x != b.x && a.y != b.y);
+        }
+
+        std::vector<PathPoint>& out = ctx.smoothed;
+        out.clear();
+        out.push_back(path[0]);
+        const size_t window = (size_t)(4 * clusterSize);
+        size_t anchor = 0;
+        while (anchor + 1 < count) {
+            size_t next = anchor + 1;
+            float cost;
+            for (size_t j = std::min(count - 1, anchor + window); j > anchor + 1; --j) {
+                const float stretch = along[j] - along[anchor];
+                if (Line(path[anchor], path[j], cost, nullptr) && cost <= stretch * 1.0001f) {
+                    next = j;
+                    break;
+                }
+            }
+            if (next == anchor + 1) out.push_back(path[next]);
+            else Line(path[anchor], path[next], cost, &out);
+            anchor = next;
+        }
+        path.swap(out);
+    }
+
+    // Tiles of the straight line from a to b, without a: as many diagonal steps as the
+    // shortest path takes, spread evenly (or pairs of straight steps when diagonals are off).
+    // False if it crosses a blocked tile or cuts a corner.
+    bool PathGrid::Impl::Line(const PathPoint& a, const PathPoint& b, float& total, std::vector<PathPoint>* out) const {
+        const int dx = std::abs(b.x - a.x), dy = std::abs(b.y - a.y);
+        const int sx = Sign(b.x - a.x), sy = Sign(b.y - a.y);
+        const bool alongX = dx >= dy;
+        const int major = std::max(dx, dy), minor = std::min(dx, dy);
+        const int majorStep = alongX ? sx : sy * stride, minorStep = alongX ? sy * stride : sx;
+
+        int n = Index(a.x, a.y), error = 0;
+        total = 0.0f;
+        auto step = [&](int to, bool diagonalStep) {
+            if (!cost[(size_t)to]) return false;
+            total += StepCost(n, to, diagonalStep);
+            n = to;
+            if (out) out->push_back({ X(n), Y(n) });
+            return true;
+        };
+        for (int k = 0; k < major; ++k) {
+            error += 2 * minor;
+            if (error < major) {
+                if (!step(n + majorStep, false)) return false;
+                continue;
+            }
+            error -= 2 * major;
+            if (diagonal) {
+                if (!cost[(size_t)(n + majorStep)] || !cost[(size_t)(n + minorStep)] || !step(n + majorStep + minorStep, true)) return false;
+            }
+            else {
+                // Around whichever side is open
+                const int first = cost[(size_t)(n + majorStep)] ? majorStep : minorStep;
+                if (!step(n + first, false) || !step(n + (majorStep + minorStep - first), false)) return false;
+            }
+        }
+        return true;
+    }
+
+    void PathGrid::Impl::EnsureGraph() {
+        if (!graphDirty.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> lock(graphMutex);
+        if (!graphDirty.load(std::memory_order_relaxed)) return;
+        RebuildGraph();
+        graphDirty.store(false, std::memory_order_release);
+    }
+
+    // Links are found again along every cluster edge, which is cheap; the searches inside a
+    // cluster only run again when its tiles or its links changed
+    void PathGrid::Impl::RebuildGraph() {
+        std::vector<std::vector<int>> cells(clusters.size());
+        std::vector<int> links;                 // pairs of tiles on either side of an edge
+        for (const Cluster& c : clusters) {
+            const Bounds& b = c.bounds;
+            if (b.x1 < width) LinkEdge(b.x1 - 1, b.y0, b.x1, b.y0, b.y1 - b.y0, cells, links);
+            if (b.y1 < height) LinkEdge(b.x0, b.y1 - 1, b.x0, b.y1, b.x1 - b.x0, cells, links);
+        }
+
+        Context* ctx = Acquire();
+        int nodes = 0;
+        for (size_t i = 0; i < clusters.size(); ++i) {
+            Cluster& c = clusters[i];
+            std::vector<int>& linked = cells[i];
+            std::sort(linked.begin(), linked.end());
+            linked.erase(std::unique(linked.begin(), linked.end()), linked.end());
+            if (c.dirty || linked != c.cells) {
+                c.cells.swap(linked);
+                ComputeCluster(c, ctx->grid);
+            }
+            c.firstNode = nodes;
+            nodes += (int)c.cells.size();
+        }
+        Release(ctx);
+
+        nodeCell.resize((size_t)nodes);
+        for (const Cluster& c : clusters) std::copy(c.cells.begin(), c.cells.end(), nodeCell.begin() + c.firstNode);
+
+        // Edges inside each cluster, then one step across each link
+        std::vector<int> degree((size_t)nodes, 0);
+        for (const Cluster& c : clusters) {
+            const int count = (int)c.cells.size();
+            for (int i = 0; i < count; ++i)
+                for (int j = 0; j < count; ++j)
+                    if (i != j && c.costs[(size_t)(i * count + j)] != Unreachable) degree[(size_t)(c.firstNode + i)]++;
+        }
+        for (size_t k = 0; k < links.size(); k += 2) {
+            degree[(size_t)NodeOf(links[k])]++;
+            degree[(size_t)NodeOf(links[k + 1])]++;
+        }
+        edgeStart.assign((size_t)nodes + 1, 0);
+        for (int n = 0; n < nodes; ++n) edgeStart[(size_t)n + 1] = edgeStart[(size_t)n] + degree[(size_t)n];
+        edges.resize((size_t)edgeStart[(size_t)nodes]);
+        std::vector<int> fill(edgeStart.begin(), edgeStart.end() - 1);
+        for (const Cluster& c : clusters) {
+            const int count = (int)c.cells.size();
+            for (int i = 0; i < count; ++i) {
+                for (int j = 0; j < count; ++j) {
+                    const float cst = c.costs[(size_t)(i * count + j)];
+                    if (i != j && cst != Unreachable) edges[(size_t)fill[(size_t)(c.firstNode + i)]++] = { c.firstNode + j, cst };
+                }
+            }
+        }
+        for (size_t k = 0; k < links.size(); k += 2) {
+            const int a = NodeOf(links[k]), b = NodeOf(links[k + 1]);
+            const float cst = StepCost(links[k], links[k + 1], false);
+            edges[(size_t)fill[(size_t)a]++] = { b, cst };
+            edges[(size_t)fill[(size_t)b]++] = { a, cst };
+        }
+    }
+
+    // Scans `length` tile pairs along an edge, (ax, ay) on one side and (bx, by) on the other,
+    // and links each open stretch
+    void PathGrid::Impl::LinkEdge(int ax, int ay, int bx, int by, int length, std::vector<std::vector<int>>& cells, std::vector<int>& links) const {
+        const int along = ax == bx - 1 ? stride : 1;
+        const int a = Index(ax, ay), b = Index(bx, by);
+        auto link = [&](int offset) {
+            const int ca = a + offset * along, cb = b + offset * along;
+            cells[(size_t)ClusterOf(ca)].push_back(ca);
+            cells[(size_t)ClusterOf(cb)].push_back(cb);
+            links.push_back(ca);
+            links.push_back(cb);
+        };
+        int run = 0;
+        for (int i = 0; i <= length; ++i) {
+            if (i < length && cost[(size_t)(a + i * along)] && cost[(size_t)(b + i * along)]) {
+                run++;
+                continue;
+            }
+            if (run >= LongEntrance) {
+                link(i - run);
+                link(i - 1);
+            }
+            else if (run > 0) link(i - run + run / 2);
+            run = 0;
+        }
+    }
+
+    // Costs and paths between every two linked tiles of the cluster, without leaving it
+    void PathGrid::Impl::ComputeCluster(Cluster& c, SearchSpace& s) {
+        const int count = (int)c.cells.size();
+        c.costs.assign((size_t)(count * count), Unreachable);
+        c.pathOffset.assign((size_t)(count * count), -1);
+        c.paths.clear();
+        c.dirty = false;
+        for (int i = 0; i < count; ++i) {
+            c.costs[(size_t)(i * count + i)] = 0.0f;
+            if (i + 1 == count) break;
+            AStar(s, c.cells[(size_t)i], -1, c.bounds);
+            for (int j = i + 1; j < count; ++j) {
+                const int target = c.cells[(size_t)j];
+                if (!s.Reached(target)) continue;
+                c.costs[(size_t)(i * count + j)] = c.costs[(size_t)(j * count + i)] = s.g[(size_t)target];
+
+                // Stored as the tile count, then the tiles from cells[i] to cells[j]
+                c.pathOffset[(size_t)(i * count + j)] = (int)c.paths.size();
+                c.paths.push_back(0);
+                const size_t first = c.paths.size();
+                for (int n = target; n >= 0; n = s.parent[(size_t)n]) c.paths.push_back(n);
+                std::reverse(c.paths.begin() + (std::ptrdiff_t)first, c.paths.end());
+                c.paths[first - 1] = (int)(c.paths.size() - first);
+            }
+        }
+    }
+
+    int PathGrid::Impl::NodeOf(int cell) const {
+        const Cluster& c = clusters[(size_t)ClusterOf(cell)];
+        return c.firstNode + (int)(std::lower_bound(c.cells.begin(), c.cells.end(), cell) - c.cells.begin());
+    }
+
+    void PathGrid::Impl::CompleteBatch() {
+        WaitForBatch();
+        for (Work& w : running) {
+            Request& r = requests[(size_t)w.request];
+            if (r.status == PATH_INVALID) {
+                freeRequests.push_back(w.request);
+                continue;
+            }
+            r.status = w.found ? PATH_FOUND : PATH_NOT_FOUND;
+            r.path.swap(w.path);
+        }
+        running.clear();
+    }
+
+    void PathGrid::Impl::StartBatch() {
+        bool hierarchical = false;
+        for (int handle : queued) {
+            const Request& r = requests[(size_t)handle];
+            if (r.status == PATH_INVALID) {
+                freeRequests.push_back(handle);
+                continue;
+            }
+            running.push_back({ handle, r.startX, r.startY, r.goalX, r.goalY, r.method, false, {} });
+            hierarchical |= r.method == PATH_HIERARCHICAL;
+        }
+        queued.clear();
+        if (running.empty()) return;
+        // The graph is shared by the whole batch, so it's brought up to date here first
+        if (hierarchical) EnsureGraph();
+
+        RunJob([this] {
+            ParallelFor((int)running.size(), 1, [this](int begin, int end) {
+                Context* ctx = Acquire();
+                for (int i = begin; i < end; ++i) {
+                    Work& w = running[(size_t)i];
+                    w.found = Find(*ctx, w.startX, w.startY, w.goalX, w.goalY, w.path, w.method);
+                }
+                Release(ctx);
+            }, workerCount);
+        }, &batch);
+    }
+
+    PathGrid::PathGrid(int workerCount)
+        : m_Impl(new Impl(workerCount)) {}
+
+    PathGrid::PathGrid(int width, int height, int workerCount)
+        : m_Impl(new Impl(workerCount)) {
+        m_Impl->Create(width, height);
+    }
+
+    PathGrid::~PathGrid() {
+        m_Impl->WaitForBatch();
+    }
+
+    bool PathGrid::Create(int width, int height) {
+        return m_Impl->Create(width, height);
+    }
+
+    bool PathGrid::Build(const TileCollision& tiles) {
+        if (!Create(tiles.Width(), tiles.Height())) return false;
+        Impl& p = *m_Impl;
+        for (int y = 0; y < p.height; ++y) {
+            for (int x = 0; x < p.width; ++x) {
+                if (tiles.GetTile(x, y) == TILE_SOLID) p.cost[(size_t)p.Index(x, y)] = 0;
+            }
+        }
+        return true;
+    }
+
+    void PathGrid::SetWalkable(int x, int y, bool walkable) {
+        m_Impl->SetCost(x, y, walkable ? 1 : 0);
+    }
+
+    bool PathGrid::IsWalkable(int x, int y) const {
+        return GetCost(x, y) > 0;
+    }
+
+    void PathGrid::SetCost(int x, int y, int cost) {
+        m_Impl->SetCost(x, y, cost);
+    }
+
+    int PathGrid::GetCost(int x, int y) const {
+        const Impl& p = *m_Impl;
+        return p.Inside(x, y) ? p.cost[(size_t)p.Index(x, y)] : 0;
+    }
+
+    void PathGrid::SetDiagonal(bool allow) {
+        Impl& p = *m_Impl;
+        if (p.diagonal == allow) return;
+        p.WaitForBatch();
+        p.diagonal = allow;
+        for (Impl::Cluster& c : p.clusters) c.dirty = true;
+        p.graphDirty.store(true, std::memory_order_release);
+    }
+
+    bool PathGrid::GetDiagonal() const {
+        return m_Impl->diagonal;
+    }
+
+    void PathGrid::SetClusterSize(int size) {
+        Impl& p = *m_Impl;
+        if (size < 2) {
+            std::cerr << "PathGrid: cluster size must be at least 2" << std::endl;
+            return;
+        }
+        if (p.clusterSize == size) return;
+        p.WaitForBatch();
+        p.clusterSize = size;
+        p.LayoutClusters();
+    }
+
+    int PathGrid::GetClusterSize() const {
+        return m_Impl->clusterSize;
+    }
+
+    int PathGrid::Width() const {
+        return m_Impl->width;
+    }
+
+    int PathGrid::Height() const {
+        return m_Impl->height;
+    }
+
+    bool PathGrid::FindPath(int startX, int startY, int goalX, int goalY, std::vector<PathPoint>& path, PathMethod method) {
+        Impl& p = *m_Impl;
+        Impl::Context* ctx = p.Acquire();
+        const bool found = p.Find(*ctx, startX, startY, goalX, goalY, path, method);
+        p.Release(ctx);
+        return found;
+    }
+
+    int PathGrid::RequestPath(int startX, int startY, int goalX, int goalY, PathMethod method) {
+        Impl& p = *m_Impl;
+        int handle;
+        if (!p.freeRequests.empty()) {
+            handle = p.freeRequests.back();
+            p.freeRequests.pop_back();
+        }
+        else {
+            handle = (int)p.requests.size();
+            p.requests.emplace_back();
+        }
+        Impl::Request& r = p.requests[(size_t)handle];
+        r.startX = startX;
+        r.startY = startY;
+        r.goalX = goalX;
+        r.goalY = goalY;
+        r.method = method;
+        r.status = PATH_PENDING;
+        r.path.clear();
+        p.queued.push_back(handle);
+        return handle;
+    }
+
+    void PathGrid::Update() {
+        m_Impl->CompleteBatch();
+        m_Impl->StartBatch();
+    }
+
+    PathStatus PathGrid::GetPathStatus(int request) const {
+        const Impl& p = *m_Impl;
+        if (request < 0 || request >= (int)p.requests.size()) return PATH_INVALID;
+        return p.requests[(size_t)request].status;
+    }
+
+    bool PathGrid::GetPath(int request, std::vector<PathPoint>& path) const {
+        if (GetPathStatus(request) != PATH_FOUND) {
+            path.clear();
+            return false;
+        }
+        path = m_Impl->requests[(size_t)request].path;
+        return true;
+    }
+
+    void PathGrid::ReleasePath(int request) {
+        Impl& p = *m_Impl;
+        if (GetPathStatus(request) == PATH_INVALID) return;
+        Impl::Request& r = p.requests[(size_t)request];
+        // Pending handles are freed by Update(), once no search refers to them
+        const bool pending = r.status == PATH_PENDING;
+        r.status = PATH_INVALID;
+        r.path.clear();
+        if (!pending) p.freeRequests.push_back(request);
+    }
+
+    int PathGrid::GetWorkerCount() const {
+        const int workers = GetJobWorkerCount();
+        return m_Impl->workerCount >= 0 ? std::min(m_Impl->workerCount, workers) : workers;
+    }
+
+}
@@ -0,0 +1,1014 @@
+#include "physics_internal.hpp"
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ech {
+
+    namespace {
+
+        constexpr float Pi = 3.14159265f;
+
+        inline uint64_t PairKey(int a, int b) {
+            return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+        }
+
+        // Soft constraint coefficients for a spring of the given frequency and damping ratio,
+        // integrated with substep h
+        struct Softness {
+            float biasRate, massScale, impulseScale;
+        };
+
+        Softness MakeSoft(float hertz, float dampingRatio, float h) {
+            if (hertz <= 0.0f) return { 0.0f, 1.0f, 0.0f };
+            const float omega = 2.0f * Pi * hertz;
+            const float a1 = 2.0f * dampingRatio + h * omega;
+            const float a2 = h * omega * a1;
+            const float a3 = 1.0f / (1.0f + a2);
+            return { omega / a1, a2 * a3, a3 };
+        }
+
+        // Per-island copy of a dynamic body's state while it is being solved
+        struct SolverBody {
+            float vx, vy, w;
+            float dpx, dpy;     // movement since the start of the step
+            float dAngle;
+            float dc, ds;       // cos/sin of dAngle
+            float invMass, invI;
+        };
+
+        struct ConstraintPoint {
+            float rAx, rAy, rBx, rBy;
+            float baseSeparation;
+            float normalMass, tangentMass;
+            float normalImpulse, tangentImpulse;
+            float maxNormalImpulse;
+            float relativeVelocity;
+        };
+
+        // A contact as the solver sees it. a or b is -1 for a static or kinematic partner,
+        // whose (constant) velocity is kept in fixedVx/fixedVy/fixedW.
+        struct Constraint {
+            int contact;
+            int a, b;
+            float normalX, normalY;
+            float friction, restitution;
+            float fixedVx, fixedVy, fixedW;
+            Softness softness;
+            int pointCount;
+            ConstraintPoint points[2];
+            bool block;                     // two points with a well conditioned 2x2 mass
+            float invK11, invK12, invK22;   // inverse of that mass matrix
+        };
+
+    }
+
+    struct Physics::Impl {
+        struct Contact {
+            uint64_t key;
+            int a, b;           // a < b
+            bool computed;      // manifold built this step
+            bool touching;
+            Manifold manifold;
+            float normalImpulse[2], tangentImpulse[2];
+        };
+
+        // Body pools, indexed by handle
+        std::vector<uint8_t> alive, type, awake, fixedRotation, allowSleep;
+        std::vector<float> x, y, angle, c, s;
+        std::vector<float> vx, vy, w, fx, fy, torque;
+        std::vector<float> mass, invMass, invI;
+        std::vector<float> linearDamping, angularDamping, gravityScale;
+        std::vector<float> friction, restitution, sleepTime;
+        std::vector<int> proxy, userData, sleepGroup;
+        std::vector<PhysicsShape> shapes;
+        std::vector<int> freeBodies;
+
+        AABBTree tree;
+
+        // Bodies that went to sleep together wake together
+        std::vector<std::vector<int>> sleepGroups;
+        std::vector<int> freeSleepGroups;
+
+        std::vector<int> proxies;
+        std::vector<Contact> contacts, previous;
+        std::vector<int> pending;
+
+        // Islands: bodies and constraints grouped contiguously, island i spanning
+        // [islandBodyStart[i], islandBodyStart[i + 1]) and likewise for constraints
+        std::vector<int> unionFind, islandOf, islandBodies, islandBodyStart;
+        std::vector<int> islandConstraintStart, islandOrder, localIndex;
+        std::vector<Constraint> constraints;
+        std::vector<SolverBody> solverBodies;
+        std::vector<uint8_t> islandSleeps;
+
+        int touchingCount = 0;
+        int islandCount = 0;
+
+        int workerCount;
+
+        Impl(const PhysicsSettings& settings)
+            : tree(8.0f * settings.linearSlop),
+              workerCount(settings.workerCount) {}
+
+        int Capacity() const { return (int)alive.size(); }
+
+        PhysicsTransform Transform(int b) const { return { x[b], y[b], c[b], s[b] }; }
+
+        void UpdateProxy(int b, float dt, float speculative) {
+            float minX, minY, maxX, maxY;
+            ComputeShapeBounds(shapes[b], Transform(b), minX, minY, maxX, maxY);
+            // Grown by the speculative distance so near misses still make a contact
+            tree.Move(proxy[b], minX - speculative, minY - speculative,
+                maxX - minX + 2.0f * speculative, maxY - minY + 2.0f * speculative, vx[b] * dt, vy[b] * dt);
+        }
+
+        void Wake(int b) {
+            if (awake[b]) return;
+            const int group = sleepGroup[b];
+            if (group < 0) {
+                awake[b] = 1;
+                sleepTime[b] = 0.0f;
+                return;
+            }
+            for (int member : sleepGroups[group]) {
+                awake[member] = 1;
+                sleepTime[member] = 0.0f;
+                sleepGroup[member] = -1;
+            }
+            sleepGroups[group].clear();
+            freeSleepGroups.push_back(group);
+        }
+
+        // Wakes whatever was touching the body in the last step
+        void WakeTouching(int b) {
+            for (const Contact& contact : previous) {
+                if (!contact.touching) continue;
+                if (contact.a == b && type[contact.b] == BODY_DYNAMIC) Wake(contact.b);
+                if (contact.b == b && type[contact.a] == BODY_DYNAMIC) Wake(contact.a);
+            }
+        }
+
+        int Find(int b) {
+            while (unionFind[b] != b) {
+                unionFind[b] = unionFind[unionFind[b]];
+                b = unionFind[b];
+            }
+            return b;
+        }
+
+        bool Active(int b) const { return type[b] != BODY_STATIC && awake[b]; }
+        bool Solvable(int b) const { return type[b] == BODY_DYNAMIC && awake[b]; }
+    };
+
+    Physics::Physics(const PhysicsSettings& settings)
+        : m_Impl(new Impl(settings)), m_Settings(settings) {
+        m_Settings.subSteps = std::max(1, m_Settings.subSteps);
+    }
+
+    Physics::~Physics() = default;
+
+    int Physics::CreateBody(const BodyDef& def, const ShapeDef& shapeDef) {
+        Impl& p = *m_Impl;
+        PhysicsShape shape;
+        float centroidX, centroidY;
+        if (!MakePhysicsShape(shapeDef, shape, centroidX, centroidY)) return -1;
+
+        int b;
+        if (!p.freeBodies.empty()) {
+            b = p.freeBodies.back();
+            p.freeBodies.pop_back();
+        }
+        else {
+            b = p.Capacity();
+            for (auto* v : { &p.alive, &p.type, &p.awake, &p.fixedRotation, &p.allowSleep }) v->push_back(0);
+            for (auto* v : { &p.x, &p.y, &p.angle, &p.c, &p.s, &p.vx, &p.vy, &p.w, &p.fx, &p.fy, &p.torque,
+                             &p.mass, &p.invMass, &p.invI, &p.linearDamping, &p.angularDamping, &p.gravityScale,
+                             &p.friction, &p.restitution, &p.sleepTime }) v->push_back(0.0f);
+            for (auto* v : { &p.proxy, &p.userData, &p.sleepGroup }) v->push_back(-1);
+            p.shapes.push_back(shape);
+        }
+
+        p.alive[b] = 1;
+        p.type[b] = (uint8_t)def.type;
+        p.awake[b] = def.type != BODY_STATIC;
+        p.fixedRotation[b] = def.fixedRotation;
+        p.allowSleep[b] = def.allowSleep;
+        p.angle[b] = def.angle;
+        p.c[b] = std::cos(def.angle);
+        p.s[b] = std::sin(def.angle);
+        // Polygons were re-centered on their centroid; move the body to match
+        p.x[b] = def.x + p.c[b] * centroidX - p.s[b] * centroidY;
+        p.y[b] = def.y + p.s[b] * centroidX + p.c[b] * centroidY;
+        const bool moves = def.type != BODY_STATIC;
+        p.vx[b] = moves ? def.velocityX : 0.0f;
+        p.vy[b] = moves ? def.velocityY : 0.0f;
+        p.w[b] = moves && !def.fixedRotation ? def.angularVelocity : 0.0f;
+        p.fx[b] = p.fy[b] = p.torque[b] = 0.0f;
+        p.linearDamping[b] = def.linearDamping;
+        p.angularDamping[b] = def.angularDamping;
+        p.gravityScale[b] = def.gravityScale;
+        p.friction[b] = shapeDef.friction;
+        p.restitution[b] = shapeDef.restitution;
+        p.sleepTime[b] = 0.0f;
+        p.userData[b] = def.userData;
+        p.sleepGroup[b] = -1;
+        p.shapes[b] = shape;
+
+        float mass = 0.0f, inertia = 0.0f;
+        if (def.type == BODY_DYNAMIC) ComputeShapeMass(shape, shapeDef.density, mass, inertia);
+        if (def.type == BODY_DYNAMIC && mass <= 0.0f) {
+            // Massless dynamic bodies would fly off at the first contact
+            mass = 1.0f;
+            inertia = 0.0f;
+        }
+        p.mass[b] = mass;
+        p.invMass[b] = mass > 0.0f ? 1.0f / mass : 0.0f;
+        p.invI[b] = inertia > 0.0f && !def.fixedRotation ? 1.0f / inertia : 0.0f;
+
+        const float speculative = 4.0f * m_Settings.linearSlop;
+        float minX, minY, maxX, maxY;
+        ComputeShapeBounds(shape, p.Transform(b), minX, minY, maxX, maxY);
+        p.proxy[b] = p.tree.Insert(minX - speculative, minY - speculative,
+            maxX - minX + 2.0f * speculative, maxY - minY + 2.0f * speculative, b);
+
+        m_BodyCount++;
+        return b;
+    }
+
+    void Physics::DestroyBody(int b) {
+        if (!IsValid(b)) return;
+        Impl& p = *m_Impl;
+        p.WakeTouching(b);
+
+        if (p.sleepGroup[b] >= 0) {
+            std::vector<int>& group = p.sleepGroups[p.sleepGroup[b]];
+            group.erase(std::find(group.begin(), group.end(), b));
+            if (group.empty()) p.freeSleepGroups.push_back(p.sleepGroup[b]);
+        }
+        p.previous.erase(std::remove_if(p.previous.begin(), p.previous.end(),
+            [b](const Impl::Contact& contact) { return contact.a == b || contact.b == b; }), p.previous.end());
+
+        p.tree.Remove(p.proxy[b]);
+        p.alive[b] = 0;
+        p.awake[b] = 0;
+        p.proxy[b] = -1;
+        p.sleepGroup[b] = -1;
+        p.freeBodies.push_back(b);
+        m_BodyCount--;
+    }
+
+    void Physics::Clear() {
+        Impl& p = *m_Impl;
+        for (int b = 0; b < p.Capacity(); ++b) {
+            if (p.alive[b]) DestroyBody(b);
+        }
+        p.contacts.clear();
+        p.previous.clear();
+        p.sleepGroups.clear();
+        p.freeSleepGroups.clear();
+        p.touchingCount = p.islandCount = 0;
+    }
+
+    bool Physics::IsValid(int b) const {
+        return b >= 0 && b < m_Impl->Capacity() && m_Impl->alive[b];
+    }
+
+    void Physics::SetGravity(float gx, float gy) {
+        m_Settings.gravityX = gx;
+        m_Settings.gravityY = gy;
+        Impl& p = *m_Impl;
+        for (int b = 0; b < p.Capacity(); ++b) {
+            if (p.alive[b] && p.type[b] == BODY_DYNAMIC) p.Wake(b);
+        }
+    }
+
+    namespace {
+
+        // Velocities of the two bodies of a contact, copied out of the solver bodies so the
+        // compiler can keep them in registers while the points are solved
+        struct PairVelocity {
+            float vAx, vAy, wA, vBx, vBy, wB;
+            float mA, iA, mB, iB;
+
+            PairVelocity(const SolverBody& A, const SolverBody& B)
+                : vAx(A.vx), vAy(A.vy), wA(A.w), vBx(B.vx), vBy(B.vy), wB(B.w),
+                  mA(A.invMass), iA(A.invI), mB(B.invMass), iB(B.invI) {}
+
+            float Relative(const ConstraintPoint& cp, float nx, float ny) const {
+                const float dvx = (vBx - wB * cp.rBy) - (vAx - wA * cp.rAy);
+                const float dvy = (vBy + wB * cp.rBx) - (vAy + wA * cp.rAx);
+                return dvx * nx + dvy * ny;
+            }
+
+            void Apply(const ConstraintPoint& cp, float px, float py) {
+                vAx -= mA * px;
+                vAy -= mA * py;
+                wA -= iA * (cp.rAx * py - cp.rAy * px);
+                vBx += mB * px;
+                vBy += mB * py;
+                wB += iB * (cp.rBx * py - cp.rBy * px);
+            }
+
+            void Store(SolverBody& A, SolverBody& B) const {
+                A.vx = vAx;
+                A.vy = vAy;
+                A.w = wA;
+                B.vx = vBx;
+                B.vy = vBy;
+                B.w = wB;
+            }
+        };
+
+        // Static and kinematic partners stand in as a body with no inverse mass, moving at
+        // their constant velocity
+        SolverBody FixedBody(const Constraint& cc, float elapsed) {
+            SolverBody fixed = { cc.fixedVx, cc.fixedVy, cc.fixedW, cc.fixedVx * elapsed, cc.fixedVy * elapsed,
+                                 cc.fixedW * elapsed, 1.0f, 0.0f, 0.0f, 0.0f };
+            if (fixed.dAngle != 0.0f) {
+                fixed.dc = std::cos(fixed.dAngle);
+                fixed.ds = std::sin(fixed.dAngle);
+            }
+            return fixed;
+        }
+
+        void WarmStart(Constraint& cc, std::vector<SolverBody>& bodies) {
+            SolverBody fixed = FixedBody(cc, 0.0f);
+            SolverBody& A = cc.a >= 0 ? bodies[cc.a] : fixed;
+            SolverBody& B = cc.b >= 0 ? bodies[cc.b] : fixed;
+            PairVelocity v(A, B);
+            const float nx = cc.normalX, ny = cc.normalY, tx = ny, ty = -nx;
+            for (int i = 0; i < cc.pointCount; ++i) {
+                const ConstraintPoint& cp = cc.points[i];
+                v.Apply(cp, cp.normalImpulse * nx + cp.tangentImpulse * tx, cp.normalImpulse * ny + cp.tangentImpulse * ty);
+            }
+            v.Store(A, B);
+        }
+
+        // One pass over a contact. With useBias the soft spring pushes overlapping shapes apart;
+        // the relax pass without it removes the velocity that push added. `elapsed` is the
+        // time into the step, used to move a kinematic partner.
+        void SolveContact(Constraint& cc, std::vector<SolverBody>& bodies, float invH, float elapsed,
+            bool useBias, float maxPushout) {
+            SolverBody fixed = FixedBody(cc, elapsed);
+            SolverBody& A = cc.a >= 0 ? bodies[cc.a] : fixed;
+            SolverBody& B = cc.b >= 0 ? bodies[cc.b] : fixed;
+            PairVelocity v(A, B);
+            const float nx = cc.normalX, ny = cc.normalY, tx = ny, ty = -nx;
+
+            float bias[2] = {}, massScale[2] = { 1.0f, 1.0f }, impulseScale[2] = {};
+            for (int i = 0; i < cc.pointCount; ++i) {
+                const ConstraintPoint& cp = cc.points[i];
+
+                // Current separation from how far the bodies moved, with the anchors rotated along
+                const float prAx = A.dc * cp.rAx - A.ds * cp.rAy, prAy = A.ds * cp.rAx + A.dc * cp.rAy;
+                const float prBx = B.dc * cp.rBx - B.ds * cp.rBy, prBy = B.ds * cp.rBx + B.dc * cp.rBy;
+                const float dx = (B.dpx - A.dpx) + (prBx - prAx);
+                const float dy = (B.dpy - A.dpy) + (prBy - prAy);
+                const float separation = dx * nx + dy * ny + cp.baseSeparation;
+
+                bias[i] = 0.0f;
+                massScale[i] = 1.0f;
+                impulseScale[i] = 0.0f;
+                if (separation > 0.0f) {
+                    // Speculative: allow closing exactly the gap this substep
+                    bias[i] = separation * invH;
+                }
+                else if (useBias) {
+                    bias[i] = std::max(cc.softness.biasRate * separation, -maxPushout);
+                    massScale[i] = cc.softness.massScale;
+                    impulseScale[i] = cc.softness.impulseScale;
+                }
+            }
+
+            // Two points are solved together when possible. Solving them one after the other
+            // favours whichever goes first, which slowly tips tall stacks over.
+            bool solved = false;
+            if (cc.block && massScale[0] == massScale[1] && impulseScale[0] == impulseScale[1]) {
+                ConstraintPoint& c1 = cc.points[0];
+                ConstraintPoint& c2 = cc.points[1];
+                const float b1 = v.Relative(c1, nx, ny) + bias[0];
+                const float b2 = v.Relative(c2, nx, ny) + bias[1];
+                const float x1 = c1.normalImpulse - massScale[0] * (cc.invK11 * b1 + cc.invK12 * b2) - impulseScale[0] * c1.normalImpulse;
+                const float x2 = c2.normalImpulse - massScale[0] * (cc.invK12 * b1 + cc.invK22 * b2) - impulseScale[0] * c2.normalImpulse;
+                // Only usable if neither point would pull
+                if (x1 >= 0.0f && x2 >= 0.0f) {
+                    const float d1 = x1 - c1.normalImpulse, d2 = x2 - c2.normalImpulse;
+                    c1.normalImpulse = x1;
+                    c2.normalImpulse = x2;
+                    c1.maxNormalImpulse = std::max(c1.maxNormalImpulse, d1);
+                    c2.maxNormalImpulse = std::max(c2.maxNormalImpulse, d2);
+                    v.Apply(c1, d1 * nx, d1 * ny);
+                    v.Apply(c2, d2 * nx, d2 * ny);
+                    solved = true;
+                }
+            }
+
+            for (int i = 0; i < cc.pointCount && !solved; ++i) {
+                ConstraintPoint& cp = cc.points[i];
+                float impulse = -cp.normalMass * massScale[i] * (v.Relative(cp, nx, ny) + bias[i]) - impulseScale[i] * cp.normalImpulse;
+                const float newImpulse = std::max(cp.normalImpulse + impulse, 0.0f);
+                impulse = newImpulse - cp.normalImpulse;
+                cp.normalImpulse = newImpulse;
+                cp.maxNormalImpulse = std::max(cp.maxNormalImpulse, impulse);
+                v.Apply(cp, impulse * nx, impulse * ny);
+            }
+
+            for (int i = 0; i < cc.pointCount; ++i) {
+                ConstraintPoint& cp = cc.points[i];
+                const float maxFriction = cc.friction * cp.normalImpulse;
+                float impulse = -cp.tangentMass * v.Relative(cp, tx, ty);
+                const float newImpulse = std::max(-maxFriction, std::min(cp.tangentImpulse + impulse, maxFriction));
+                impulse = newImpulse - cp.tangentImpulse;
+                cp.tangentImpulse = newImpulse;
+                v.Apply(cp, impulse * tx, impulse * ty);
+            }
+
+            v.Store(A, B);
+        }
+
+        void ApplyRestitution(Constraint& cc, std::vector<SolverBody>& bodies, float threshold) {
+            if (cc.restitution == 0.0f) return;
+            SolverBody fixed = FixedBody(cc, 0.0f);
+            SolverBody& A = cc.a >= 0 ? bodies[cc.a] : fixed;
+            SolverBody& B = cc.b >= 0 ? bodies[cc.b] : fixed;
+            PairVelocity v(A, B);
+            const float nx = cc.normalX, ny = cc.normalY;
+
+            for (int i = 0; i < cc.pointCount; ++i) {
+                ConstraintPoint& cp = cc.points[i];
+                // Only points that were approaching fast and actually pushed
+                if (cp.relativeVelocity > -threshold || cp.maxNormalImpulse == 0.0f) continue;
+
+                float impulse = -cp.normalMass * (v.Relative(cp, nx, ny) + cc.restitution * cp.relativeVelocity);
+                const float newImpulse = std::max(cp.normalImpulse + impulse, 0.0f);
+                impulse = newImpulse - cp.normalImpulse;
+                cp.normalImpulse = newImpulse;
+                v.Apply(cp, impulse * nx, impulse * ny);
+            }
+            v.Store(A, B);
+        }
+
+    }
+
+    void Physics::Step(float dt) {
+        if (!(dt > 0.0f)) return;
+        Impl& p = *m_Impl;
+        const PhysicsSettings& settings = m_Settings;
+        const float speculative = 4.0f * settings.linearSlop;
+        const int capacity = p.Capacity();
+
+        // Broadphase: only awake bodies look for partners, so a sleeping pile costs nothing
+        // here. Pairs of two awake bodies are reported by the lower handle.
+        p.contacts.clear();
+        for (int a = 0; a < capacity; ++a) {
+            if (!p.alive[a] || !p.Active(a)) continue;
+            float minX, minY, maxX, maxY;
+            ComputeShapeBounds(p.shapes[a], p.Transform(a), minX, minY, maxX, maxY);
+            const float qx = minX - speculative, qy = minY - speculative;
+            const float qw = maxX - minX + 2.0f * speculative, qh = maxY - minY + 2.0f * speculative;
+            int count = p.tree.Query(qx, qy, qw, qh, p.proxies.data(), (int)p.proxies.size());
+            if (count > (int)p.proxies.size()) {
+                p.proxies.resize(count + count / 2);
+                count = p.tree.Query(qx, qy, qw, qh, p.proxies.data(), (int)p.proxies.size());
+            }
+
+            for (int i = 0; i < count; ++i) {
+                const int b = p.tree.GetUserData(p.proxies[i]);
+                if (b == a || (p.Active(b) && b < a)) continue;
+                // At least one side must be dynamic for the contact to do anything
+                if (p.type[a] != BODY_DYNAMIC && p.type[b] != BODY_DYNAMIC) continue;
+                Impl::Contact contact;
+                contact.a = std::min(a, b);
+                contact.b = std::max(a, b);
+                contact.key = PairKey(contact.a, contact.b);
+                contact.computed = false;
+                contact.touching = false;
+                contact.manifold.pointCount = 0;
+                p.contacts.push_back(contact);
+            }
+        }
+
+        // Contacts inside sleeping groups carry over untouched, keeping their impulses for
+        // when the group wakes
+        for (const Impl::Contact& old : p.previous) {
+            if (p.Active(old.a) || p.Active(old.b)) continue;
+            p.contacts.push_back(old);
+            p.contacts.back().computed = false;
+        }
+
+        // Sorted by body pair, so they can be matched with the last step's by a merge
+        std::sort(p.contacts.begin(), p.contacts.end(),
+            [](const Impl::Contact& l, const Impl::Contact& r) { return l.key < r.key; });
+
+        // Narrowphase for contacts with an awake side, in parallel. Touching a sleeping body
+        // wakes it (and everything that fell asleep with it), which can make more contacts
+        // active, so repeat until nothing new wakes up.
+        for (;;) {
+            p.pending.clear();
+            for (int i = 0; i < (int)p.contacts.size(); ++i) {
+                const Impl::Contact& contact = p.contacts[i];
+                if (!contact.computed && (p.Active(contact.a) || p.Active(contact.b))) p.pending.push_back(i);
+            }
+            if (p.pending.empty()) break;
+
+            ParallelFor((int)p.pending.size(), 64, [&](int begin, int end) {
+                for (int k = begin; k < end; ++k) {
+                    Impl::Contact& contact = p.contacts[p.pending[k]];
+                    CollideShapes(p.shapes[contact.a], p.Transform(contact.a), p.shapes[contact.b], p.Transform(contact.b),
+                        speculative, contact.manifold);
+                    contact.computed = true;
+                    contact.touching = contact.manifold.pointCount > 0;
+                }
+            }, p.workerCount);
+
+            bool woke = false;
+            for (int i : p.pending) {
+                const Impl::Contact& contact = p.contacts[i];
+                if (!contact.touching) continue;
+                for (int side = 0; side < 2; ++side) {
+                    const int sleeper = side ? contact.b : contact.a, other = side ? contact.a : contact.b;
+                    if (p.type[sleeper] == BODY_DYNAMIC && !p.awake[sleeper] && p.Active(other)) {
+                        p.Wake(sleeper);
+                        woke = true;
+                    }
+                }
+            }
+            if (!woke) break;
+        }
+
+        // Warm starting: carry impulses over from matching points of the last step. Contacts
+        // that stayed asleep keep their old manifold as is.
+        for (size_t i = 0, j = 0; i < p.contacts.size(); ++i) {
+            Impl::Contact& contact = p.contacts[i];
+            contact.normalImpulse[0] = contact.normalImpulse[1] = 0.0f;
+            contact.tangentImpulse[0] = contact.tangentImpulse[1] = 0.0f;
+            while (j < p.previous.size() && p.previous[j].key < contact.key) j++;
+            if (j == p.previous.size() || p.previous[j].key != contact.key) continue;
+            const Impl::Contact& old = p.previous[j];
+            if (!contact.computed) {
+                contact = old;
+                continue;
+            }
+            if (!contact.touching) continue;
+            for (int k = 0; k < contact.manifold.pointCount; ++k) {
+                for (int m = 0; m < old.manifold.pointCount; ++m) {
+                    if (old.manifold.points[m].id != contact.manifold.points[k].id) continue;
+                    contact.normalImpulse[k] = old.normalImpulse[m];
+                    contact.tangentImpulse[k] = old.tangentImpulse[m];
+                    break;
+                }
+            }
+        }
+
+        // Islands: awake dynamic bodies joined by touching contacts. Static and kinematic bodies
+        // don't link islands, so everything resting on the same ground can still split up.
+        p.unionFind.resize(capacity);
+        for (int b = 0; b < capacity; ++b) p.unionFind[b] = b;
+        p.touchingCount = 0;
+        for (const Impl::Contact& contact : p.contacts) {
+            if (!contact.touching) continue;
+            p.touchingCount++;
+            if (p.Solvable(contact.a) && p.Solvable(contact.b)) {
+                const int ra = p.Find(contact.a), rb = p.Find(contact.b);
+                if (ra != rb) p.unionFind[std::max(ra, rb)] = std::min(ra, rb);
+            }
+        }
+
+        p.islandOf.assign(capacity, -1);
+        p.islandBodyStart.clear();
+        p.islandCount = 0;
+        for (int b = 0; b < capacity; ++b) {
+            if (!p.alive[b] || !p.Solvable(b)) continue;
+            const int root = p.Find(b);
+            if (p.islandOf[root] < 0) {
+                p.islandOf[root] = p.islandCount++;
+                p.islandBodyStart.push_back(0);
+            }
+            p.islandOf[b] = p.islandOf[root];
+            p.islandBodyStart[p.islandOf[b]]++;
+        }
+
+        // Counting sort of bodies by island
+        p.islandBodyStart.push_back(0);
+        for (int i = 0, sum = 0; i <= p.islandCount; ++i) {
+            const int n = p.islandBodyStart[i];
+            p.islandBodyStart[i] = sum;
+            sum += n;
+        }
+        p.islandBodies.resize(p.islandBodyStart[p.islandCount]);
+        p.localIndex.assign(capacity, -1);
+        {
+            std::vector<int>& cursor = p.pending;
+            cursor.assign(p.islandBodyStart.begin(), p.islandBodyStart.end() - 1);
+            for (int b = 0; b < capacity; ++b) {
+                if (p.islandOf[b] < 0) continue;
+                const int slot = cursor[p.islandOf[b]]++;
+                p.islandBodies[slot] = b;
+                p.localIndex[b] = slot;
+            }
+        }
+
+        // Constraints, grouped the same way
+        p.islandConstraintStart.assign(p.islandCount + 1, 0);
+        for (const Impl::Contact& contact : p.contacts) {
+            if (!contact.touching) continue;
+            const int island = p.islandOf[p.Solvable(contact.a) ? contact.a : contact.b];
+            if (island >= 0) p.islandConstraintStart[island]++;
+        }
+        for (int i = 0, sum = 0; i <= p.islandCount; ++i) {
+            const int n = p.islandConstraintStart[i];
+            p.islandConstraintStart[i] = sum;
+            sum += n;
+        }
+        p.constraints.resize(p.islandConstraintStart[p.islandCount]);
+        {
+            std::vector<int>& cursor = p.pending;
+            cursor.assign(p.islandConstraintStart.begin(), p.islandConstraintStart.end() - 1);
+            for (int i = 0; i < (int)p.contacts.size(); ++i) {
+                const Impl::Contact& contact = p.contacts[i];
+                if (!contact.touching) continue;
+                const int island = p.islandOf[p.Solvable(contact.a) ? contact.a : contact.b];
+                if (island >= 0) p.constraints[cursor[island]++].contact = i;
+            }
+        }
+
+        // Biggest islands first so one large pile doesn't end up last on a single thread
+        p.islandOrder.resize(p.islandCount);
+        for (int i = 0; i < p.islandCount; ++i) p.islandOrder[i] = i;
+        std::sort(p.islandOrder.begin(), p.islandOrder.end(), [&](int l, int r) {
+            const int sizeL = p.islandBodyStart[l + 1] - p.islandBodyStart[l];
+            const int sizeR = p.islandBodyStart[r + 1] - p.islandBodyStart[r];
+            return sizeL != sizeR ? sizeL > sizeR : l < r;
+        });
+
+        p.solverBodies.resize(p.islandBodies.size());
+        p.islandSleeps.assign(p.islandCount, 0);
+
+        const int subSteps = settings.subSteps;
+        const float h = dt / subSteps, invH = 1.0f / h;
+        const float contactHertz = std::min(settings.contactHertz, 0.25f * invH);
+        const Softness contactSoftness = MakeSoft(contactHertz, settings.contactDampingRatio, h);
+        const Softness staticSoftness = MakeSoft(2.0f * contactHertz, settings.contactDampingRatio, h);
+        const float maxSpeedSq = settings.maxLinearSpeed * settings.maxLinearSpeed;
+
+        // Islands share no dynamic bodies, so they solve independently
+        ParallelFor(p.islandCount, 1, [&](int begin, int end) {
+            for (int k = begin; k < end; ++k) {
+                const int island = p.islandOrder[k];
+                const int bodyBegin = p.islandBodyStart[island], bodyEnd = p.islandBodyStart[island + 1];
+                Constraint* cs = p.constraints.data() + p.islandConstraintStart[island];
+                const int constraintCount = p.islandConstraintStart[island + 1] - p.islandConstraintStart[island];
+                std::vector<SolverBody>& bodies = p.solverBodies;
+
+                for (int i = bodyBegin; i < bodyEnd; ++i) {
+                    const int b = p.islandBodies[i];
+                    bodies[i] = { p.vx[b], p.vy[b], p.w[b], 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, p.invMass[b], p.invI[b] };
+                }
+
+                bool movingPartner = false;
+                for (int i = 0; i < constraintCount; ++i) {
+                    Constraint& cc = cs[i];
+                    const Impl::Contact& contact = p.contacts[cc.contact];
+                    const int a = contact.a, b = contact.b;
+                    const int fixedBody = p.Solvable(a) ? (p.Solvable(b) ? -1 : b) : a;
+                    cc.a = p.Solvable(a) ? p.localIndex[a] : -1;
+                    cc.b = p.Solvable(b) ? p.localIndex[b] : -1;
+                    cc.fixedVx = cc.fixedVy = cc.fixedW = 0.0f;
+                    if (fixedBody >= 0 && p.type[fixedBody] == BODY_KINEMATIC) {
+                        cc.fixedVx = p.vx[fixedBody];
+                        cc.fixedVy = p.vy[fixedBody];
+                        cc.fixedW = p.w[fixedBody];
+                        if (cc.fixedVx != 0.0f || cc.fixedVy != 0.0f || cc.fixedW != 0.0f) movingPartner = true;
+                    }
+                    cc.normalX = contact.manifold.normalX;
+                    cc.normalY = contact.manifold.normalY;
+                    cc.friction = std::sqrt(p.friction[a] * p.friction[b]);
+                    cc.restitution = std::max(p.restitution[a], p.restitution[b]);
+                    cc.softness = fixedBody >= 0 ? staticSoftness : contactSoftness;
+                    cc.pointCount = contact.manifold.pointCount;
+
+                    const SolverBody* A = cc.a >= 0 ? &bodies[cc.a] : nullptr;
+                    const SolverBody* B = cc.b >= 0 ? &bodies[cc.b] : nullptr;
+                    const float mA = A ? A->invMass : 0.0f, iA = A ? A->invI : 0.0f;
+                    const float mB = B ? B->invMass : 0.0f, iB = B ? B->invI : 0.0f;
+                    const float vAx = A ? A->vx : cc.fixedVx, vAy = A ? A->vy : cc.fixedVy, wA = A ? A->w : cc.fixedW;
+                    const float vBx = B ? B->vx : cc.fixedVx, vBy = B ? B->vy : cc.fixedVy, wB = B ? B->w : cc.fixedW;
+                    const float nx = cc.normalX, ny = cc.normalY, tx = ny, ty = -nx;
+
+                    for (int j = 0; j < cc.pointCount; ++j) {
+                        const ManifoldPoint& mp = contact.manifold.points[j];
+                        ConstraintPoint& cp = cc.points[j];
+                        cp.rAx = mp.anchorAX;
+                        cp.rAy = mp.anchorAY;
+                        cp.rBx = mp.anchorBX;
+                        cp.rBy = mp.anchorBY;
+                        cp.baseSeparation = mp.separation - ((cp.rBx - cp.rAx) * nx + (cp.rBy - cp.rAy) * ny);
+                        cp.normalImpulse = contact.normalImpulse[j];
+                        cp.tangentImpulse = contact.tangentImpulse[j];
+                        cp.maxNormalImpulse = 0.0f;
+
+                        const float rnA = cp.rAx * ny - cp.rAy * nx, rnB = cp.rBx * ny - cp.rBy * nx;
+                        const float kNormal = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+                        cp.normalMass = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+                        const float rtA = cp.rAx * ty - cp.rAy * tx, rtB = cp.rBx * ty - cp.rBy * tx;
+                        const float kTangent = mA + mB + iA * rtA * rtA + iB * rtB * rtB;
+                        cp.tangentMass = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+
+                        const float dvx = (vBx - wB * cp.rBy) - (vAx - wA * cp.rAy);
+                        const float dvy = (vBy + wB * cp.rBx) - (vAy + wA * cp.rAx);
+                        cp.relativeVelocity = dvx * nx + dvy * ny;
+                    }
+
+                    cc.block = false;
+                    if (cc.pointCount == 2) {
+                        const ConstraintPoint& c1 = cc.points[0];
+                        const ConstraintPoint& c2 = cc.points[1];
+                        const float rn1A = c1.rAx * ny - c1.rAy * nx, rn1B = c1.rBx * ny - c1.rBy * nx;
+                        const float rn2A = c2.rAx * ny - c2.rAy * nx, rn2B = c2.rBx * ny - c2.rBy * nx;
+                        const float k11 = mA + mB + iA * rn1A * rn1A + iB * rn1B * rn1B;
+                        const float k22 = mA + mB + iA * rn2A * rn2A + iB * rn2B * rn2B;
+                        const float k12 = mA + mB + iA * rn1A * rn2A + iB * rn1B * rn2B;
+                        const float det = k11 * k22 - k12 * k12;
+                        // Nearly coincident points make the matrix singular; those stay sequential
+                        if (k11 * k11 < 1000.0f * det) {
+                            const float invDet = 1.0f / det;
+                            cc.block = true;
+                            cc.invK11 = k22 * invDet;
+                            cc.invK12 = -k12 * invDet;
+                            cc.invK22 = k11 * invDet;
+                        }
+                    }
+                }
+
+                for (int sub = 0; sub < subSteps; ++sub) {
+                    for (int i = bodyBegin; i < bodyEnd; ++i) {
+                        const int b = p.islandBodies[i];
+                        SolverBody& body = bodies[i];
+                        const float gs = p.gravityScale[b];
+                        body.vx += h * (body.invMass * p.fx[b] + gs * settings.gravityX);
+                        body.vy += h * (body.invMass * p.fy[b] + gs * settings.gravityY);
+                        body.w += h * body.invI * p.torque[b];
+                        body.vx *= 1.0f / (1.0f + h * p.linearDamping[b]);
+                        body.vy *= 1.0f / (1.0f + h * p.linearDamping[b]);
+                        body.w *= 1.0f / (1.0f + h * p.angularDamping[b]);
+                        const float speedSq = body.vx * body.vx + body.vy * body.vy;
+                        if (speedSq > maxSpeedSq) {
+                            const float scale = settings.maxLinearSpeed / std::sqrt(speedSq);
+                            body.vx *= scale;
+                            body.vy *= scale;
+                        }
+                    }
+
+                    for (int i = 0; i < constraintCount; ++i) WarmStart(cs[i], bodies);
+                    const float elapsed = sub * h;
+                    for (int i = 0; i < constraintCount; ++i) SolveContact(cs[i], bodies, invH, elapsed, true, settings.maxPushoutSpeed);
+
+                    for (int i = bodyBegin; i < bodyEnd; ++i) {
+                        SolverBody& body = bodies[i];
+                        body.dpx += h * body.vx;
+                        body.dpy += h * body.vy;
+                        if (body.w != 0.0f) {
+                            body.dAngle += h * body.w;
+                            body.dc = std::cos(body.dAngle);
+                            body.ds = std::sin(body.dAngle);
+                        }
+                    }
+
+                    for (int i = 0; i < constraintCount; ++i) SolveContact(cs[i], bodies, invH, elapsed + h, false, settings.maxPushoutSpeed);
+                }
+
+                for (int i = 0; i < constraintCount; ++i) ApplyRestitution(cs[i], bodies, settings.restitutionThreshold);
+
+                // Write back and keep impulses for the next step's warm start
+                for (int i = 0; i < constraintCount; ++i) {
+                    Impl::Contact& contact = p.contacts[cs[i].contact];
+                    for (int j = 0; j < cs[i].pointCount; ++j) {
+                        contact.normalImpulse[j] = cs[i].points[j].normalImpulse;
+                        contact.tangentImpulse[j] = cs[i].points[j].tangentImpulse;
+                    }
+                }
+
+                float minSleepTime = movingPartner ? 0.0f : settings.timeToSleep;
+                const float linearSq = settings.sleepLinearSpeed * settings.sleepLinearSpeed;
+                const float angularSq = settings.sleepAngularSpeed * settings.sleepAngularSpeed;
+                for (int i = bodyBegin; i < bodyEnd; ++i) {
+                    const int b = p.islandBodies[i];
+                    const SolverBody& body = bodies[i];
+                    p.x[b] += body.dpx;
+                    p.y[b] += body.dpy;
+                    p.vx[b] = body.vx;
+                    p.vy[b] = body.vy;
+                    p.w[b] = body.w;
+                    if (body.dAngle != 0.0f) {
+                        p.angle[b] += body.dAngle;
+                        p.c[b] = std::cos(p.angle[b]);
+                        p.s[b] = std::sin(p.angle[b]);
+                    }
+
+                    if (!p.allowSleep[b] || body.vx * body.vx + body.vy * body.vy > linearSq || body.w * body.w > angularSq) {
+                        p.sleepTime[b] = 0.0f;
+                    }
+                    else {
+                        p.sleepTime[b] += dt;
+                    }
+                    minSleepTime = std::min(minSleepTime, p.sleepTime[b]);
+                }
+                p.islandSleeps[island] = minSleepTime >= settings.timeToSleep;
+            }
+        }, p.workerCount);
+
+        // Kinematic bodies just follow their velocity
+        for (int b = 0; b < capacity; ++b) {
+            if (!p.alive[b] || p.type[b] != BODY_KINEMATIC) continue;
+            p.x[b] += dt * p.vx[b];
+            p.y[b] += dt * p.vy[b];
+            if (p.w[b] != 0.0f) {
+                p.angle[b] += dt * p.w[b];
+                p.c[b] = std::cos(p.angle[b]);
+                p.s[b] = std::sin(p.angle[b]);
+            }
+        }
+
+        // Islands that have been still long enough go to sleep as a group
+        for (int island = 0; island < p.islandCount; ++island) {
+            if (!p.islandSleeps[island]) continue;
+            int group;
+            if (!p.freeSleepGroups.empty()) {
+                group = p.freeSleepGroups.back();
+                p.freeSleepGroups.pop_back();
+            }
+            else {
+                group = (int)p.sleepGroups.size();
+                p.sleepGroups.emplace_back();
+            }
+            for (int i = p.islandBodyStart[island]; i < p.islandBodyStart[island + 1]; ++i) {
+                const int b = p.islandBodies[i];
+                p.awake[b] = 0;
+                p.vx[b] = p.vy[b] = p.w[b] = 0.0f;
+                p.sleepGroup[b] = group;
+                p.sleepGroups[group].push_back(b);
+            }
+        }
+
+        for (int b = 0; b < capacity; ++b) {
+            if (!p.alive[b]) continue;
+            if (p.Active(b) || p.islandOf[b] >= 0) p.UpdateProxy(b, dt, speculative);
+            p.fx[b] = p.fy[b] = p.torque[b] = 0.0f;
+        }
+
+        std::swap(p.contacts, p.previous);
+    }
+
+    float Physics::GetX(int b) const { return IsValid(b) ? m_Impl->x[b] : 0.0f; }
+    float Physics::GetY(int b) const { return IsValid(b) ? m_Impl->y[b] : 0.0f; }
+    float Physics::GetAngle(int b) const { return IsValid(b) ? m_Impl->angle[b] : 0.0f; }
+    float Physics::GetVelocityX(int b) const { return IsValid(b) ? m_Impl->vx[b] : 0.0f; }
+    float Physics::GetVelocityY(int b) const { return IsValid(b) ? m_Impl->vy[b] : 0.0f; }
+    float Physics::GetAngularVelocity(int b) const { return IsValid(b) ? m_Impl->w[b] : 0.0f; }
+    float Physics::GetMass(int b) const { return IsValid(b) ? m_Impl->mass[b] : 0.0f; }
+    BodyType Physics::GetType(int b) const { return IsValid(b) ? (BodyType)m_Impl->type[b] : BODY_STATIC; }
+    int Physics::GetUserData(int b) const { return IsValid(b) ? m_Impl->userData[b] : 0; }
+
+    void Physics::SetUserData(int b, int userData) {
+        if (IsValid(b)) m_Impl->userData[b] = userData;
+    }
+
+    void Physics::SetTransform(int b, float x, float y, float angle) {
+        if (!IsValid(b)) return;
+        Impl& p = *m_Impl;
+        // Whatever rested on it may now be floating
+        p.WakeTouching(b);
+        if (p.type[b] != BODY_STATIC) p.Wake(b);
+        p.x[b] = x;
+        p.y[b] = y;
+        p.angle[b] = angle;
+        p.c[b] = std::cos(angle);
+        p.s[b] = std::sin(angle);
+        p.UpdateProxy(b, 0.0f, 4.0f * m_Settings.linearSlop);
+    }
+
+    void Physics::SetVelocity(int b, float vx, float vy) {
+        if (!IsValid(b) || m_Impl->type[b] == BODY_STATIC) return;
+        if (vx != 0.0f || vy != 0.0f) m_Impl->Wake(b);
+        m_Impl->vx[b] = vx;
+        m_Impl->vy[b] = vy;
+    }
+
+    void Physics::SetAngularVelocity(int b, float w) {
+        if (!IsValid(b) || m_Impl->type[b] == BODY_STATIC || m_Impl->fixedRotation[b]) return;
+        if (w != 0.0f) m_Impl->Wake(b);
+        m_Impl->w[b] = w;
+    }
+
+    void Physics::ApplyForce(int b, float fx, float fy) {
+        if (!IsValid(b) || m_Impl->type[b] != BODY_DYNAMIC) return;
+        m_Impl->Wake(b);
+        m_Impl->fx[b] += fx;
+        m_Impl->fy[b] += fy;
+    }
+
+    void Physics::ApplyForce(int b, float fx, float fy, float px, float py) {
+        if (!IsValid(b) || m_Impl->type[b] != BODY_DYNAMIC) return;
+        ApplyForce(b, fx, fy);
+        m_Impl->torque[b] += (px - m_Impl->x[b]) * fy - (py - m_Impl->y[b]) * fx;
+    }
+
+    void Physics::ApplyTorque(int b, float torque) {
+        if (!IsValid(b) || m_Impl->type[b] != BODY_DYNAMIC) return;
+        m_Impl->Wake(b);
+        m_Impl->torque[b] += torque;
+    }
+
+    void Physics::ApplyImpulse(int b, float ix, float iy) {
+        if (!IsValid(b) || m_Impl->type[b] != BODY_DYNAMIC) return;
+        Impl& p = *m_Impl;
+        p.Wake(b);
+        p.vx[b] += p.invMass[b] * ix;
+        p.vy[b] += p.invMass[b] * iy;
+    }
+
+    void Physics::ApplyImpulse(int b, float ix, float iy, float px, float py) {
+        if (!IsValid(b) || m_Impl->type[b] != BODY_DYNAMIC) return;
+        Impl& p = *m_Impl;
+        ApplyImpulse(b, ix, iy);
+        p.w[b] += p.invI[b] * ((px - p.x[b]) * iy - (py - p.y[b]) * ix);
+    }
+
+    bool Physics::IsAwake(int b) const {
+        return IsValid(b) && m_Impl->awake[b];
+    }
+
+    void Physics::WakeUp(int b) {
+        if (IsValid(b) && m_Impl->type[b] != BODY_STATIC) m_Impl->Wake(b);
+    }
+
+    int Physics::GetShapeVertices(int b, float* xy) const {
+        if (!IsValid(b)) return 0;
+        const Impl& p = *m_Impl;
+        const PhysicsShape& shape = p.shapes[b];
+        const float c = p.c[b], s = p.s[b];
+        if (shape.type == SHAPE_CIRCLE) {
+            xy[0] = p.x[b];
+            xy[1] = p.y[b];
+            xy[2] = p.x[b] + c * shape.radius;
+            xy[3] = p.y[b] + s * shape.radius;
+            return 2;
+        }
+        for (int i = 0; i < shape.count; ++i) {
+            xy[2 * i] = p.x[b] + c * shape.x[i] - s * shape.y[i];
+            xy[2 * i + 1] = p.y[b] + s * shape.x[i] + c * shape.y[i];
+        }
+        return shape.count;
+    }
+
+    void Physics::GetBounds(int b, float& x, float& y, float& w, float& h) const {
+        x = y = w = h = 0.0f;
+        if (!IsValid(b)) return;
+        float minX, minY, maxX, maxY;
+        ComputeShapeBounds(m_Impl->shapes[b], m_Impl->Transform(b), minX, minY, maxX, maxY);
+        x = minX;
+        y = minY;
+        w = maxX - minX;
+        h = maxY - minY;
+    }
+
+    int Physics::QueryBounds(float x, float y, float w, float h, int* bodies, int maxBodies) {
+        Impl& p = *m_Impl;
+        // The tree holds bounds grown by the speculative distance; filter on the real ones
+        std::vector<int>& proxies = p.proxies;
+        proxies.resize(std::max<size_t>(proxies.size(), 64));
+        int count = p.tree.Query(x, y, w, h, proxies.data(), (int)proxies.size());
+        if (count > (int)proxies.size()) {
+            proxies.resize(count);
+            count = p.tree.Query(x, y, w, h, proxies.data(), count);
+        }
+
+        int found = 0;
+        for (int i = 0; i < count; ++i) {
+            const int b = p.tree.GetUserData(proxies[i]);
+            float bx, by, bw, bh;
+            GetBounds(b, bx, by, bw, bh);
+            if (!(bx < x + w && bx + bw > x && by < y + h && by + bh > y)) continue;
+            if (found < maxBodies) bodies[found] = b;
+            found++;
+        }
+        return found;
+    }
+
+    int Physics::GetAwakeBodyCount() const {
+        const Impl& p = *m_Impl;
+        int count = 0;
+        for (int b = 0; b < p.Capacity(); ++b) count += p.alive[b] && p.type[b] != BODY_STATIC && p.awake[b];
+        return count;
+    }
+
+    int Physics::GetContactCount() const { return m_Impl->touchingCount; }
+    int Physics::GetIslandCount() const { return m_Impl->islandCount; }
+    int Physics::GetWorkerCount() const {
+        const int workers = GetJobWorkerCount();
+        return m_Impl->workerCount >= 0 ? std::min(m_Impl->workerCount, workers) : workers;
+    }
+
+}
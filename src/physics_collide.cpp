@@ -0,0 +1,402 @@
+#include "physics_internal.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+namespace ech {
+
+    namespace {
+
+        struct V2 {
+            float x, y;
+        };
+
+        inline V2 operator+(V2 a, V2 b) { return { a.x + b.x, a.y + b.y }; }
+        inline V2 operator-(V2 a, V2 b) { return { a.x - b.x, a.y - b.y }; }
+        inline V2 operator*(float s, V2 v) { return { s * v.x, s * v.y }; }
+        inline float Dot(V2 a, V2 b) { return a.x * b.x + a.y * b.y; }
+        inline float Cross(V2 a, V2 b) { return a.x * b.y - a.y * b.x; }
+
+        inline V2 Rotate(const PhysicsTransform& xf, V2 v) { return { xf.c * v.x - xf.s * v.y, xf.s * v.x + xf.c * v.y }; }
+        inline V2 InvRotate(const PhysicsTransform& xf, V2 v) { return { xf.c * v.x + xf.s * v.y, -xf.s * v.x + xf.c * v.y }; }
+        inline V2 Apply(const PhysicsTransform& xf, V2 v) { return Rotate(xf, v) + V2{ xf.x, xf.y }; }
+        inline V2 InvApply(const PhysicsTransform& xf, V2 v) { return InvRotate(xf, v - V2{ xf.x, xf.y }); }
+
+        // Transform taking B's body space to A's
+        PhysicsTransform Relative(const PhysicsTransform& a, const PhysicsTransform& b) {
+            const V2 t = InvRotate(a, V2{ b.x - a.x, b.y - a.y });
+            return { t.x, t.y, a.c * b.c + a.s * b.s, a.c * b.s - a.s * b.c };
+        }
+
+        inline V2 Vertex(const PhysicsShape& s, int i) { return { s.x[i], s.y[i] }; }
+        inline V2 Normal(const PhysicsShape& s, int i) { return { s.nx[i], s.ny[i] }; }
+
+        // Feature ids: which vertex/face of each shape produced a point
+        enum : uint8_t { FEATURE_VERTEX = 0, FEATURE_FACE = 1 };
+
+        inline uint32_t MakeId(uint8_t indexA, uint8_t indexB, uint8_t typeA, uint8_t typeB) {
+            return (uint32_t)indexA | ((uint32_t)indexB << 8) | ((uint32_t)typeA << 16) | ((uint32_t)typeB << 24);
+        }
+
+        inline uint32_t FlipId(uint32_t id) {
+            return ((id & 0xFFu) << 8) | ((id >> 8) & 0xFFu) | (((id >> 16) & 0xFFu) << 24) | (((id >> 24) & 0xFFu) << 16);
+        }
+
+        void AddPoint(Manifold& m, V2 point, const PhysicsTransform& xfA, const PhysicsTransform& xfB, float separation, uint32_t id) {
+            ManifoldPoint& p = m.points[m.pointCount++];
+            p.anchorAX = point.x - xfA.x;
+            p.anchorAY = point.y - xfA.y;
+            p.anchorBX = point.x - xfB.x;
+            p.anchorBY = point.y - xfB.y;
+            p.separation = separation;
+            p.id = id;
+        }
+
+        bool FinishPolygon(PhysicsShape& shape) {
+            for (int i = 0; i < shape.count; ++i) {
+                const int next = i + 1 < shape.count ? i + 1 : 0;
+                const V2 edge = Vertex(shape, next) - Vertex(shape, i);
+                const float length = std::sqrt(Dot(edge, edge));
+                if (length <= FLT_EPSILON) return false;
+                shape.nx[i] = edge.y / length;
+                shape.ny[i] = -edge.x / length;
+            }
+            return true;
+        }
+
+        // Area-weighted centroid, triangulating from the first vertex
+        V2 PolygonCentroid(const PhysicsShape& shape, float& area) {
+            const V2 origin = Vertex(shape, 0);
+            V2 center = { 0.0f, 0.0f };
+            area = 0.0f;
+            for (int i = 1; i + 1 < shape.count; ++i) {
+                const V2 e1 = Vertex(shape, i) - origin, e2 = Vertex(shape, i + 1) - origin;
+                const float triangleArea = 0.5f * Cross(e1, e2);
+                area += triangleArea;
+                center = center + (triangleArea / 3.0f) * (e1 + e2);
+            }
+            if (area != 0.0f) center = (1.0f / area) * center;
+            return center + origin;
+        }
+
+        // Deepest separation of poly2 along the face normals of poly1, in poly2's space
+        float FindMaxSeparation(const PhysicsShape& poly1, const PhysicsTransform& xf1,
+            const PhysicsShape& poly2, const PhysicsTransform& xf2, int& edge) {
+            const PhysicsTransform xf = Relative(xf2, xf1);
+            float maxSeparation = -FLT_MAX;
+            edge = 0;
+            for (int i = 0; i < poly1.count; ++i) {
+                const V2 n = Rotate(xf, Normal(poly1, i));
+                const V2 v1 = Apply(xf, Vertex(poly1, i));
+                float si = FLT_MAX;
+                for (int j = 0; j < poly2.count; ++j) si = std::min(si, Dot(n, Vertex(poly2, j) - v1));
+                if (si > maxSeparation) {
+                    maxSeparation = si;
+                    edge = i;
+                }
+            }
+            return maxSeparation;
+        }
+
+        struct ClipVertex {
+            V2 v;
+            uint32_t id;
+        };
+
+        // Edge of poly2 most anti-parallel to the reference face normal, in world space
+        void FindIncidentEdge(ClipVertex out[2], const PhysicsShape& poly1, const PhysicsTransform& xf1, int edge1,
+            const PhysicsShape& poly2, const PhysicsTransform& xf2) {
+            const V2 normal = InvRotate(xf2, Rotate(xf1, Normal(poly1, edge1)));
+            int index = 0;
+            float minDot = FLT_MAX;
+            for (int i = 0; i < poly2.count; ++i) {
+                const float d = Dot(normal, Normal(poly2, i));
+                if (d < minDot) {
+                    minDot = d;
+                    index = i;
+                }
+            }
+            const int next = index + 1 < poly2.count ? index + 1 : 0;
+            out[0] = { Apply(xf2, Vertex(poly2, index)), MakeId((uint8_t)edge1, (uint8_t)index, FEATURE_FACE, FEATURE_VERTEX) };
+            out[1] = { Apply(xf2, Vertex(poly2, next)), MakeId((uint8_t)edge1, (uint8_t)next, FEATURE_FACE, FEATURE_VERTEX) };
+        }
+
+        // Sutherland-Hodgman against the half plane dot(normal, v) <= offset
+        int ClipSegmentToLine(ClipVertex out[2], const ClipVertex in[2], V2 normal, float offset, int vertexIndexA) {
+            int count = 0;
+            const float d0 = Dot(normal, in[0].v) - offset;
+            const float d1 = Dot(normal, in[1].v) - offset;
+            if (d0 <= 0.0f) out[count++] = in[0];
+            if (d1 <= 0.0f) out[count++] = in[1];
+            if (d0 * d1 < 0.0f) {
+                const float t = d0 / (d0 - d1);
+                out[count].v = in[0].v + t * (in[1].v - in[0].v);
+                out[count].id = MakeId((uint8_t)vertexIndexA, (uint8_t)((in[0].id >> 8) & 0xFF), FEATURE_VERTEX, FEATURE_FACE);
+                count++;
+            }
+            return count;
+        }
+
+        void CollidePolygons(const PhysicsShape& polyA, const PhysicsTransform& xfA,
+            const PhysicsShape& polyB, const PhysicsTransform& xfB, float speculative, Manifold& m) {
+            int edgeA, edgeB;
+            const float separationA = FindMaxSeparation(polyA, xfA, polyB, xfB, edgeA);
+            if (separationA > speculative) return;
+            const float separationB = FindMaxSeparation(polyB, xfB, polyA, xfA, edgeB);
+            if (separationB > speculative) return;
+
+            // Prefer A's face unless B's is clearly better, so the reference face doesn't flicker
+            // between two nearly parallel faces
+            const bool flip = separationB > separationA + 0.1f * speculative;
+            const PhysicsShape& poly1 = flip ? polyB : polyA;
+            const PhysicsShape& poly2 = flip ? polyA : polyB;
+            const PhysicsTransform& xf1 = flip ? xfB : xfA;
+            const PhysicsTransform& xf2 = flip ? xfA : xfB;
+            const int edge1 = flip ? edgeB : edgeA;
+
+            ClipVertex incident[2];
+            FindIncidentEdge(incident, poly1, xf1, edge1, poly2, xf2);
+
+            const int edge2 = edge1 + 1 < poly1.count ? edge1 + 1 : 0;
+            const V2 v11 = Apply(xf1, Vertex(poly1, edge1));
+            const V2 v12 = Apply(xf1, Vertex(poly1, edge2));
+            V2 tangent = v12 - v11;
+            tangent = (1.0f / std::sqrt(Dot(tangent, tangent))) * tangent;
+            const V2 normal = { tangent.y, -tangent.x };
+
+            const float frontOffset = Dot(normal, v11);
+            const float sideOffset1 = -Dot(tangent, v11);
+            const float sideOffset2 = Dot(tangent, v12);
+
+            ClipVertex clip1[2], clip2[2];
+            if (ClipSegmentToLine(clip1, incident, V2{ -tangent.x, -tangent.y }, sideOffset1, edge1) < 2) return;
+            if (ClipSegmentToLine(clip2, clip1, tangent, sideOffset2, edge2) < 2) return;
+
+            m.normalX = flip ? -normal.x : normal.x;
+            m.normalY = flip ? -normal.y : normal.y;
+            for (int i = 0; i < 2; ++i) {
+                const float separation = Dot(normal, clip2[i].v) - frontOffset;
+                if (separation > speculative) continue;
+                // Midway between the incident vertex and the reference face
+                const V2 point = clip2[i].v - (0.5f * separation) * normal;
+                AddPoint(m, point, xfA, xfB, separation, flip ? FlipId(clip2[i].id) : clip2[i].id);
+            }
+        }
+
+        void CollideCircles(const PhysicsShape& a, const PhysicsTransform& xfA,
+            const PhysicsShape& b, const PhysicsTransform& xfB, float speculative, Manifold& m) {
+            const V2 d = { xfB.x - xfA.x, xfB.y - xfA.y };
+            const float distance = std::sqrt(Dot(d, d));
+            const float separation = distance - a.radius - b.radius;
+            if (separation > speculative) return;
+
+            const V2 normal = distance > FLT_EPSILON ? (1.0f / distance) * d : V2{ 0.0f, -1.0f };
+            const V2 onA = V2{ xfA.x, xfA.y } + a.radius * normal;
+            const V2 onB = V2{ xfB.x, xfB.y } - b.radius * normal;
+            m.normalX = normal.x;
+            m.normalY = normal.y;
+            AddPoint(m, 0.5f * (onA + onB), xfA, xfB, separation, 0);
+        }
+
+        void CollidePolygonCircle(const PhysicsShape& poly, const PhysicsTransform& xfA,
+            const PhysicsShape& circle, const PhysicsTransform& xfB, float speculative, Manifold& m) {
+            const V2 c = InvApply(xfA, V2{ xfB.x, xfB.y });
+            const float radius = circle.radius;
+
+            int normalIndex = 0;
+            float separation = -FLT_MAX;
+            for (int i = 0; i < poly.count; ++i) {
+                const float s = Dot(Normal(poly, i), c - Vertex(poly, i));
+                if (s > separation) {
+                    separation = s;
+                    normalIndex = i;
+                }
+            }
+            if (separation > radius + speculative) return;
+
+            const int next = normalIndex + 1 < poly.count ? normalIndex + 1 : 0;
+            const V2 v1 = Vertex(poly, normalIndex), v2 = Vertex(poly, next);
+
+            // Closest feature: one of the face's vertices, or the face itself
+            V2 normal, onPoly;
+            uint32_t id;
+            const float u1 = Dot(c - v1, v2 - v1);
+            const float u2 = Dot(c - v2, v1 - v2);
+            if (separation > FLT_EPSILON && (u1 <= 0.0f || u2 <= 0.0f)) {
+                onPoly = u1 <= 0.0f ? v1 : v2;
+                const V2 d = c - onPoly;
+                const float distance = std::sqrt(Dot(d, d));
+                if (distance - radius > speculative) return;
+                normal = distance > FLT_EPSILON ? (1.0f / distance) * d : Normal(poly, normalIndex);
+                separation = distance;
+                id = MakeId((uint8_t)(u1 <= 0.0f ? normalIndex : next), 0, FEATURE_VERTEX, FEATURE_VERTEX);
+            }
+            else {
+                normal = Normal(poly, normalIndex);
+                onPoly = c - separation * normal;
+                id = MakeId((uint8_t)normalIndex, 0, FEATURE_FACE, FEATURE_VERTEX);
+            }
+
+            const V2 onCircle = c - radius * normal;
+            const V2 worldNormal = Rotate(xfA, normal);
+            m.normalX = worldNormal.x;
+            m.normalY = worldNormal.y;
+            AddPoint(m, Apply(xfA, 0.5f * (onPoly + onCircle)), xfA, xfB, separation - radius, id);
+        }
+
+    }
+
+    bool MakePhysicsShape(const ShapeDef& def, PhysicsShape& shape, float& centroidX, float& centroidY) {
+        shape = PhysicsShape{};
+        shape.type = def.type;
+        centroidX = centroidY = 0.0f;
+
+        if (!(def.density >= 0.0f) || !(def.friction >= 0.0f) || !(def.restitution >= 0.0f)) {
+            std::cerr << "Physics: density, friction and restitution must not be negative" << std::endl;
+            return false;
+        }
+
+        switch (def.type) {
+        case SHAPE_CIRCLE:
+            if (!(def.radius > 0.0f)) {
+                std::cerr << "Physics: circle radius must be positive" << std::endl;
+                return false;
+            }
+            shape.radius = def.radius;
+            return true;
+
+        case SHAPE_BOX: {
+            if (!(def.width > 0.0f) || !(def.height > 0.0f)) {
+                std::cerr << "Physics: box size must be positive" << std::endl;
+                return false;
+            }
+            const float hw = 0.5f * def.width, hh = 0.5f * def.height;
+            const float xs[4] = { -hw, hw, hw, -hw }, ys[4] = { -hh, -hh, hh, hh };
+            shape.count = 4;
+            std::copy(xs, xs + 4, shape.x);
+            std::copy(ys, ys + 4, shape.y);
+            return FinishPolygon(shape);
+        }
+
+        case SHAPE_POLYGON: {
+            if (!def.vertices || def.vertexCount < 3 || def.vertexCount > MaxPolygonVertices) {
+                std::cerr << "Physics: polygons need 3 to " << MaxPolygonVertices << " vertices" << std::endl;
+                return false;
+            }
+            shape.count = def.vertexCount;
+            for (int i = 0; i < shape.count; ++i) {
+                shape.x[i] = def.vertices[2 * i];
+                shape.y[i] = def.vertices[2 * i + 1];
+            }
+
+            float area;
+            const V2 center = PolygonCentroid(shape, area);
+            if (std::fabs(area) <= FLT_EPSILON) {
+                std::cerr << "Physics: polygon has no area" << std::endl;
+                return false;
+            }
+            if (area < 0.0f) {
+                std::reverse(shape.x, shape.x + shape.count);
+                std::reverse(shape.y, shape.y + shape.count);
+            }
+            for (int i = 0; i < shape.count; ++i) {
+                shape.x[i] -= center.x;
+                shape.y[i] -= center.y;
+            }
+            if (!FinishPolygon(shape)) {
+                std::cerr << "Physics: polygon has repeated vertices" << std::endl;
+                return false;
+            }
+            for (int i = 0; i < shape.count; ++i) {
+                const int next = i + 1 < shape.count ? i + 1 : 0;
+                if (Cross(Normal(shape, i), Normal(shape, next)) <= 0.0f) {
+                    std::cerr << "Physics: polygon is not convex" << std::endl;
+                    return false;
+                }
+            }
+            centroidX = center.x;
+            centroidY = center.y;
+            return true;
+        }
+        }
+        return false;
+    }
+
+    void ComputeShapeMass(const PhysicsShape& shape, float density, float& mass, float& inertia) {
+        if (shape.type == SHAPE_CIRCLE) {
+            const float r2 = shape.radius * shape.radius;
+            mass = density * 3.14159265f * r2;
+            inertia = 0.5f * mass * r2;
+            return;
+        }
+
+        // Triangle fan around the first vertex; the polygon is already centered on its centroid
+        const V2 origin = Vertex(shape, 0);
+        V2 center = { 0.0f, 0.0f };
+        float area = 0.0f, I = 0.0f;
+        for (int i = 1; i + 1 < shape.count; ++i) {
+            const V2 e1 = Vertex(shape, i) - origin, e2 = Vertex(shape, i + 1) - origin;
+            const float D = Cross(e1, e2);
+            const float triangleArea = 0.5f * D;
+            area += triangleArea;
+            center = center + (triangleArea / 3.0f) * (e1 + e2);
+            const float intx2 = e1.x * e1.x + e2.x * e1.x + e2.x * e2.x;
+            const float inty2 = e1.y * e1.y + e2.y * e1.y + e2.y * e2.y;
+            I += (0.25f / 3.0f * D) * (intx2 + inty2);
+        }
+        mass = density * area;
+        center = (1.0f / area) * center;
+        // Shift from the first vertex to the centroid
+        inertia = density * I - mass * Dot(center, center);
+    }
+
+    void ComputeShapeBounds(const PhysicsShape& shape, const PhysicsTransform& xf,
+        float& minX, float& minY, float& maxX, float& maxY) {
+        if (shape.type == SHAPE_CIRCLE) {
+            minX = xf.x - shape.radius;
+            minY = xf.y - shape.radius;
+            maxX = xf.x + shape.radius;
+            maxY = xf.y + shape.radius;
+            return;
+        }
+        minX = minY = FLT_MAX;
+        maxX = maxY = -FLT_MAX;
+        for (int i = 0; i < shape.count; ++i) {
+            const V2 v = Apply(xf, Vertex(shape, i));
+            minX = std::min(minX, v.x);
+            minY = std::min(minY, v.y);
+            maxX = std::max(maxX, v.x);
+            maxY = std::max(maxY, v.y);
+        }
+    }
+
+    void CollideShapes(const PhysicsShape& a, const PhysicsTransform& xfA,
+        const PhysicsShape& b, const PhysicsTransform& xfB, float speculativeDistance, Manifold& manifold) {
+        manifold.pointCount = 0;
+        const bool circleA = a.type == SHAPE_CIRCLE, circleB = b.type == SHAPE_CIRCLE;
+        if (circleA && circleB) {
+            CollideCircles(a, xfA, b, xfB, speculativeDistance, manifold);
+        }
+        else if (circleB) {
+            CollidePolygonCircle(a, xfA, b, xfB, speculativeDistance, manifold);
+        }
+        else if (circleA) {
+            // Solve as polygon vs circle and turn the result around
+            CollidePolygonCircle(b, xfB, a, xfA, speculativeDistance, manifold);
+            manifold.normalX = -manifold.normalX;
+            manifold.normalY = -manifold.normalY;
+            for (int i = 0; i < manifold.pointCount; ++i) {
+                ManifoldPoint& p = manifold.points[i];
+                std::swap(p.anchorAX, p.anchorBX);
+                std::swap(p.anchorAY, p.anchorBY);
+                p.id = FlipId(p.id);
+            }
+        }
+        else {
+            CollidePolygons(a, xfA, b, xfB, speculativeDistance, manifold);
+        }
+    }
+
+}
@@ -0,0 +1,487 @@
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "echlib.h"
+#include "graphics_internal.hpp"
+
+namespace ech {
+
+    namespace {
+
+        using ProfilerClock = std::chrono::steady_clock;
+
+        constexpr uint32_t RingCapacity = 1u << 14;     // events per thread between two frame ends
+        constexpr size_t HistoryFrames = 600;           // what ExportChromeTrace can see
+        constexpr int GpuReadbackLatency = 3;           // frames before we ask for GPU results
+        constexpr uint32_t GpuThreadId = 1000;          // Chrome trace track for GPU zones
+        constexpr double Smoothing = 0.1;
+
+        struct ZoneEvent {
+            const char* name;
+            uint64_t startNs;
+            uint64_t endNs;
+            uint32_t threadId;
+            uint32_t depth;
+        };
+
+        struct MarkerEvent {
+            std::string text;
+            uint64_t timeNs;
+            uint32_t threadId;
+        };
+
+        // Single producer (the owning thread) / single consumer (the frame end on the main thread)
+        struct ThreadRing {
+            ZoneEvent events[RingCapacity];
+            std::atomic<uint32_t> head{ 0 };
+            std::atomic<uint32_t> tail{ 0 };
+            std::atomic<uint32_t> dropped{ 0 };     // zones lost to a full ring
+            uint32_t threadId = 0;
+            std::thread::id owner;
+        };
+
+        struct OpenZone {
+            const char* name;
+            uint64_t startNs;
+        };
+
+        struct ThreadContext {
+            ThreadRing* ring = nullptr;
+            OpenZone stack[64];
+            int depth = 0;
+            int suspended = 0;
+        };
+
+        struct GpuZone {
+            const char* name;
+            GLuint begin;
+            GLuint end;
+            uint64_t frame;
+            uint32_t depth;
+        };
+
+        struct ZoneAccum {
+            double avgMs = 0;
+            double maxMs = 0;
+            double avgCalls = 0;
+            double frameMs = 0;     // accumulated during the current frame
+            int frameCalls = 0;
+            bool gpu = false;
+            bool seen = false;
+        };
+
+        struct ProfilerState {
+            std::atomic<bool> enabled{ false };
+
+            std::mutex registryMutex;
+            std::vector<std::unique_ptr<ThreadRing>> rings;
+            std::thread::id mainThread;         // the one calling ProfilerEndFrame
+
+            std::mutex markerMutex;
+            std::vector<MarkerEvent> markers;
+
+            // Main thread only below
+            std::deque<std::vector<ZoneEvent>> history;
+            std::deque<std::vector<MarkerEvent>> markerHistory;
+            std::unordered_map<std::string_view, ZoneAccum> zones;
+            uint64_t frameIndex = 0;
+
+            std::vector<GLuint> freeQueries;
+            std::vector<GpuZone> gpuPending;
+            std::vector<size_t> gpuOpen;
+            std::vector<ZoneEvent> gpuFinished;
+        };
+
+        ProfilerState& State() {
+            static ProfilerState state;
+            return state;
+        }
+
+        const ProfilerClock::time_point s_Epoch = ProfilerClock::now();
+
+        uint64_t NowNs() {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(ProfilerClock::now() - s_Epoch).count();
+        }
+
+        thread_local ThreadContext t_Context;
+
+        // Registers this thread's ring on first use
+        ThreadContext& Context() {
+            ThreadContext& context = t_Context;
+            if (!context.ring) {
+                ProfilerState& state = State();
+                auto ring = std::make_unique<ThreadRing>();
+                std::lock_guard<std::mutex> lock(state.registryMutex);
+                ring->threadId = (uint32_t)state.rings.size();
+                ring->owner = std::this_thread::get_id();
+                context.ring = ring.get();
+                // Rings live as long as the profiler so late drains never touch freed memory
+                state.rings.push_back(std::move(ring));
+            }
+            return context;
+        }
+
+        void Push(ThreadRing& ring, const ZoneEvent& e) {
+            uint32_t head = ring.head.load(std::memory_order_relaxed);
+            uint32_t tail = ring.tail.load(std::memory_order_acquire);
+            if (head - tail >= RingCapacity) {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ring.events[head % RingCapacity] = e;
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        GLuint AcquireQuery(ProfilerState& state) {
+            if (state.freeQueries.empty()) {
+                GLuint batch[32];
+                glGenQueries(32, batch);
+                state.freeQueries.insert(state.freeQueries.end(), batch, batch + 32);
+            }
+            GLuint q = state.freeQueries.back();
+            state.freeQueries.pop_back();
+            return q;
+        }
+
+        void Accumulate(ProfilerState& state, const ZoneEvent& e, bool gpu) {
+            ZoneAccum& zone = state.zones[std::string_view(e.name)];
+            zone.frameMs += (double)(e.endNs - e.startNs) / 1.0e6;
+            zone.frameCalls++;
+            zone.gpu = gpu;
+        }
+
+        // Fetch GPU zones whose results are ready and convert them onto the CPU timeline
+        void CollectGpuZones(ProfilerState& state) {
+            if (state.gpuPending.empty()) return;
+
+            GLint64 gpuNow = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            const int64_t offset = (int64_t)NowNs() - (int64_t)gpuNow;
+
+            size_t keep = 0;
+            for (size_t i = 0; i < state.gpuPending.size(); ++i) {
+                GpuZone& zone = state.gpuPending[i];
+                bool ready = false;
+                if (zone.end && zone.frame + GpuReadbackLatency <= state.frameIndex) {
+                    GLint available = 0;
+                    glGetQueryObjectiv(zone.end, GL_QUERY_RESULT_AVAILABLE, &available);
+                    ready = available != 0;
+                }
+                if (!ready) {
+                    state.gpuPending[keep++] = zone;
+                    continue;
+                }
+
+                GLuint64 t0 = 0, t1 = 0;
+                glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &t0);
+                glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &t1);
+                state.freeQueries.push_back(zone.begin);
+                state.freeQueries.push_back(zone.end);
+
+                ZoneEvent e;
+                e.name = zone.name;
+                e.startNs = (uint64_t)((int64_t)t0 + offset);
+                e.endNs = (uint64_t)((int64_t)std::max(t0, t1) + offset);
+                e.threadId = GpuThreadId;
+                e.depth = zone.depth;
+                state.gpuFinished.push_back(e);
+            }
+            state.gpuPending.resize(keep);
+        }
+
+        void WriteJsonString(std::ofstream& out, std::string_view text) {
+            out << '"';
+            for (char c : text) {
+                switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if ((unsigned char)c < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out << buf;
+                    }
+                    else out << c;
+                }
+            }
+            out << '"';
+        }
+
+    }
+
+    void EnableProfiler(bool enabled) {
+        State().enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool IsProfilerEnabled() {
+        return State().enabled.load(std::memory_order_relaxed);
+    }
+
+    void BeginCpuZone(const char* name) {
+        if (!State().enabled.load(std::memory_order_relaxed)) return;
+        ThreadContext& ctx = Context();
+        if (ctx.suspended) return;
+        if (ctx.depth < (int)(sizeof(ctx.stack) / sizeof(ctx.stack[0]))) {
+            ctx.stack[ctx.depth] = { name, NowNs() };
+        }
+        ctx.depth++;
+    }
+
+    void EndCpuZone() {
+        // Begin registered the ring if anything is open, so don't allocate one here
+        ThreadContext& ctx = t_Context;
+        if (ctx.suspended || ctx.depth == 0) return;
+        ctx.depth--;
+        if (ctx.depth >= (int)(sizeof(ctx.stack) / sizeof(ctx.stack[0]))) return;
+
+        const OpenZone& open = ctx.stack[ctx.depth];
+        ZoneEvent e;
+        e.name = open.name;
+        e.startNs = open.startNs;
+        e.endNs = NowNs();
+        e.threadId = ctx.ring->threadId;
+        e.depth = (uint32_t)ctx.depth;
+        Push(*ctx.ring, e);
+    }
+
+    void BeginGpuZone(const char* name) {
+        ProfilerState& state = State();
+        if (!state.enabled.load(std::memory_order_relaxed) || !GetDefaultWindow()) return;
+
+        GpuZone zone;
+        zone.name = name;
+        zone.begin = AcquireQuery(state);
+        zone.end = 0;
+        zone.frame = state.frameIndex;
+        zone.depth = (uint32_t)state.gpuOpen.size();
+        // Timestamps (unlike GL_TIME_ELAPSED) can nest and overlap other timer queries
+        glQueryCounter(zone.begin, GL_TIMESTAMP);
+
+        state.gpuOpen.push_back(state.gpuPending.size());
+        state.gpuPending.push_back(zone);
+    }
+
+    void EndGpuZone() {
+        ProfilerState& state = State();
+        if (state.gpuOpen.empty()) return;
+
+        GpuZone& zone = state.gpuPending[state.gpuOpen.back()];
+        state.gpuOpen.pop_back();
+        zone.end = AcquireQuery(state);
+        glQueryCounter(zone.end, GL_TIMESTAMP);
+    }
+
+    void ProfilerMarker(const std::string& text) {
+        ProfilerState& state = State();
+        if (!state.enabled.load(std::memory_order_relaxed)) return;
+        MarkerEvent marker{ text, NowNs(), Context().ring->threadId };
+        std::lock_guard<std::mutex> lock(state.markerMutex);
+        state.markers.push_back(std::move(marker));
+    }
+
+    void ProfilerEndFrame() {
+        ProfilerState& state = State();
+        const bool enabled = state.enabled.load(std::memory_order_relaxed);
+        if (!enabled && state.gpuPending.empty()) return;
+
+        std::vector<ZoneEvent> frame;
+        {
+            std::lock_guard<std::mutex> lock(state.registryMutex);
+            state.mainThread = std::this_thread::get_id();
+            for (auto& ring : state.rings) {
+                uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint32_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) frame.push_back(ring->events[tail % RingCapacity]);
+                ring->tail.store(tail, std::memory_order_release);
+            }
+        }
+
+        if (GetDefaultWindow() && state.gpuOpen.empty()) CollectGpuZones(state);
+
+        for (const ZoneEvent& e : frame) Accumulate(state, e, false);
+        for (const ZoneEvent& e : state.gpuFinished) Accumulate(state, e, true);
+        frame.insert(frame.end(), state.gpuFinished.begin(), state.gpuFinished.end());
+        state.gpuFinished.clear();
+
+        for (auto& [name, zone] : state.zones) {
+            if (!zone.seen) {
+                zone.avgMs = zone.frameMs;
+                zone.avgCalls = zone.frameCalls;
+                zone.seen = true;
+            }
+            else {
+                zone.avgMs += (zone.frameMs - zone.avgMs) * Smoothing;
+                zone.avgCalls += (zone.frameCalls - zone.avgCalls) * Smoothing;
+            }
+            // Slowly forget old spikes so the max reflects recent history
+            zone.maxMs = std::max(zone.frameMs, zone.maxMs * 0.995);
+            zone.frameMs = 0;
+            zone.frameCalls = 0;
+        }
+
+        std::vector<MarkerEvent> markers;
+        {
+            std::lock_guard<std::mutex> lock(state.markerMutex);
+            markers.swap(state.markers);
+        }
+
+        if (enabled) {
+            state.history.push_back(std::move(frame));
+            state.markerHistory.push_back(std::move(markers));
+            while (state.history.size() > HistoryFrames) {
+                state.history.pop_front();
+                state.markerHistory.pop_front();
+            }
+        }
+        state.frameIndex++;
+    }
+
+    std::vector<ProfileZoneStats> GetProfilerZones() {
+        std::vector<ProfileZoneStats> result;
+        for (const auto& [name, zone] : State().zones) {
+            ProfileZoneStats stats;
+            stats.name = std::string(name);
+            stats.gpu = zone.gpu;
+            stats.avgMs = zone.avgMs;
+            stats.maxMs = zone.maxMs;
+            stats.calls = zone.avgCalls;
+            result.push_back(std::move(stats));
+        }
+        std::sort(result.begin(), result.end(), [](const ProfileZoneStats& a, const ProfileZoneStats& b) {
+            return a.avgMs > b.avgMs;
+        });
+        return result;
+    }
+
+    void DrawProfilerOverlay(Font& font, float x, float y, float lineHeight) {
+        // The overlay's own draw calls shouldn't show up in what it displays
+        ThreadContext& ctx = t_Context;
+        ctx.suspended++;
+
+        glm::mat4 savedView = view;
+        view = glm::mat4(1.0f);
+        UploadShapeUniforms();
+
+        const size_t maxRows = 14;
+        std::vector<ProfileZoneStats> zones = GetProfilerZones();
+        if (zones.size() > maxRows) zones.resize(maxRows);
+
+        FrameTimeStats frame = GetFrameTimeStats();
+        const float width = 460.0f;
+        const float height = lineHeight * (float)(zones.size() + 2) + 8.0f;
+        DrawRectangle(x, y, width, height, { 0.0f, 0.0f, 0.0f, 0.65f });
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "frame %.2f ms  p99 %.2f  jitter %.2f", frame.avgMs, frame.p99Ms, frame.jitterMs);
+        font.Draw(line, x + 6.0f, y + lineHeight, WHITE);
+
+        const double budget = frame.avgMs > 0.0 ? frame.avgMs : 16.667;
+        float rowY = y + lineHeight * 2.0f;
+        for (const ProfileZoneStats& zone : zones) {
+            float bar = (float)std::min(1.0, zone.avgMs / budget) * (width - 12.0f);
+            DrawRectangle(x + 6.0f, rowY - lineHeight * 0.75f, bar, lineHeight * 0.8f,
+                zone.gpu ? Color{ 0.2f, 0.5f, 1.0f, 0.5f } : Color{ 1.0f, 0.6f, 0.1f, 0.5f });
+
+            std::snprintf(line, sizeof(line), "%s %-22.22s %6.3f ms  x%.0f",
+                zone.gpu ? "GPU" : "CPU", zone.name.c_str(), zone.avgMs, zone.calls);
+            font.Draw(line, x + 6.0f, rowY, WHITE);
+            rowY += lineHeight;
+        }
+
+        view = savedView;
+        UploadShapeUniforms();
+        ctx.suspended--;
+    }
+
+    bool ExportChromeTrace(const std::string& path) {
+        ProfilerState& state = State();
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&] {
+            if (!first) out << ",\n";
+            first = false;
+        };
+
+        uint64_t dropped = 0;
+        {
+            // The main thread is the one ending frames, whichever thread recorded first
+            std::lock_guard<std::mutex> lock(state.registryMutex);
+            for (const auto& ring : state.rings) {
+                const uint32_t ringDropped = ring->dropped.load(std::memory_order_relaxed);
+                dropped += ringDropped;
+                separator();
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId << ",\"args\":{\"name\":\"";
+                if (ring->owner == state.mainThread) out << "Main";
+                else out << "Worker " << ring->threadId;
+                out << "\",\"dropped\":" << ringDropped << "}}";
+            }
+        }
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuThreadId
+            << ",\"args\":{\"name\":\"GPU\"}}";
+
+        char number[64];
+        for (size_t f = 0; f < state.history.size(); ++f) {
+            for (const ZoneEvent& e : state.history[f]) {
+                separator();
+                out << "{\"name\":";
+                WriteJsonString(out, e.name);
+                std::snprintf(number, sizeof(number), "%.3f", e.startNs / 1000.0);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.threadId << ",\"ts\":" << number;
+                std::snprintf(number, sizeof(number), "%.3f", (e.endNs - e.startNs) / 1000.0);
+                out << ",\"dur\":" << number << "}";
+            }
+            for (const MarkerEvent& m : state.markerHistory[f]) {
+                separator();
+                out << "{\"name\":";
+                WriteJsonString(out, m.text);
+                std::snprintf(number, sizeof(number), "%.3f", m.timeNs / 1000.0);
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << m.threadId << ",\"ts\":" << number << "}";
+            }
+        }
+        out << "\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+        return out.good();
+    }
+
+    uint64_t GetProfilerDroppedEvents() {
+        ProfilerState& state = State();
+        std::lock_guard<std::mutex> lock(state.registryMutex);
+        uint64_t dropped = 0;
+        for (const auto& ring : state.rings) dropped += ring->dropped.load(std::memory_order_relaxed);
+        return dropped;
+    }
+
+    void ShutdownProfiler() {
+        ProfilerState& state = State();
+        for (const GpuZone& zone : state.gpuPending) {
+            state.freeQueries.push_back(zone.begin);
+            if (zone.end) state.freeQueries.push_back(zone.end);
+        }
+        state.gpuPending.clear();
+        state.gpuOpen.clear();
+        if (!state.freeQueries.empty()) {
+            glDeleteQueries((GLsizei)state.freeQueries.size(), state.freeQueries.data());
+            state.freeQueries.clear();
+        }
+    }
+
+}
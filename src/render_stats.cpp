@@ -0,0 +1,91 @@
+#include "render_stats.hpp"
+
+#include "graphics_internal.hpp"
+
+namespace ech {
+
+    RenderStats g_RenderStatsFrame;
+
+    namespace {
+
+        RenderStats s_History[RenderStatsHistorySize];
+        int s_HistoryHead = 0;      // next slot to write
+        int s_HistoryCount = 0;
+
+        unsigned int s_LastTexture = 0;
+        unsigned int s_LastProgram = 0;
+
+        const RenderStats s_Empty{};
+
+    }
+
+    void TrackTextureBind(unsigned int texture) {
+        if (texture == s_LastTexture) return;
+        s_LastTexture = texture;
+        g_RenderStatsFrame.textureBinds++;
+    }
+
+    void TrackShaderSwitch(unsigned int program) {
+        if (program == s_LastProgram) return;
+        s_LastProgram = program;
+        g_RenderStatsFrame.shaderSwitches++;
+    }
+
+    void RenderStatsEndFrame(double limiterSleepSeconds) {
+#if ECH_RENDER_STATS
+        g_RenderStatsFrame.limiterSleepMs = limiterSleepSeconds * 1000.0;
+
+        s_History[s_HistoryHead] = g_RenderStatsFrame;
+        s_HistoryHead = (s_HistoryHead + 1) % RenderStatsHistorySize;
+        if (s_HistoryCount < RenderStatsHistorySize) s_HistoryCount++;
+
+        g_RenderStatsFrame = RenderStats{};
+#else
+        (void)limiterSleepSeconds;
+#endif
+    }
+
+    const RenderStats& GetRenderStats() {
+        return GetRenderStatsHistory(0);
+    }
+
+    const RenderStats& GetRenderStatsHistory(int framesAgo) {
+        if (framesAgo < 0 || framesAgo >= s_HistoryCount) return s_Empty;
+        int index = (s_HistoryHead - 1 - framesAgo + RenderStatsHistorySize) % RenderStatsHistorySize;
+        return s_History[index];
+    }
+
+    int GetRenderStatsHistoryCount() {
+        return s_HistoryCount;
+    }
+
+    RenderStats GetAverageRenderStats() {
+        RenderStats avg;
+        if (s_HistoryCount == 0) return avg;
+
+        unsigned long long drawCalls = 0, uploads = 0, binds = 0, switches = 0, loaded = 0;
+        for (int i = 0; i < s_HistoryCount; ++i) {
+            const RenderStats& s = s_History[i];
+            drawCalls += s.drawCalls;
+            avg.vertices += s.vertices;
+            uploads += s.bufferUploads;
+            avg.bytesUploaded += s.bytesUploaded;
+            binds += s.textureBinds;
+            switches += s.shaderSwitches;
+            loaded += s.texturesLoaded;
+            avg.limiterSleepMs += s.limiterSleepMs;
+        }
+
+        const unsigned long long n = (unsigned long long)s_HistoryCount;
+        avg.drawCalls = (unsigned int)(drawCalls / n);
+        avg.vertices /= n;
+        avg.bufferUploads = (unsigned int)(uploads / n);
+        avg.bytesUploaded /= n;
+        avg.textureBinds = (unsigned int)(binds / n);
+        avg.shaderSwitches = (unsigned int)(switches / n);
+        avg.texturesLoaded = (unsigned int)(loaded / n);
+        avg.limiterSleepMs /= (double)n;
+        return avg;
+    }
+
+}
@@ -0,0 +1,136 @@
+#include "render_target.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+#include "graphics_internal.hpp"
+
+namespace ech {
+
+    RenderTarget::RenderTarget() {}
+
+    RenderTarget::RenderTarget(int width, int height, int colorAttachments) {
+        Create(width, height, colorAttachments);
+    }
+
+    RenderTarget::~RenderTarget() {
+        Destroy();
+    }
+
+    bool RenderTarget::Create(int width, int height, int colorAttachments) {
+        Destroy();
+
+        if (width <= 0 || height <= 0) {
+            std::cerr << "RenderTarget: invalid size " << width << "x" << height << std::endl;
+            return false;
+        }
+        if (colorAttachments < 1) colorAttachments = 1;
+        if (colorAttachments > MaxColorAttachments) colorAttachments = MaxColorAttachments;
+
+        m_Width = width;
+        m_Height = height;
+        m_ColorCount = colorAttachments;
+
+        GLint prevFramebuffer = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFramebuffer);
+
+        glGenFramebuffers(1, &m_Framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+
+        glGenTextures(m_ColorCount, m_ColorTextures);
+        GLenum drawBuffers[MaxColorAttachments];
+        for (int i = 0; i < m_ColorCount; ++i) {
+            glBindTexture(GL_TEXTURE_2D, m_ColorTextures[i]);
+            ECH_STATS_TEXTURE_BIND(m_ColorTextures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            // No mipmaps: the texture is rewritten whenever the target is re-rendered
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_ColorTextures[i], 0);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        glDrawBuffers(m_ColorCount, drawBuffers);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prevFramebuffer);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "RenderTarget: framebuffer incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+            Destroy();
+            return false;
+        }
+
+        m_Dirty = true;
+        return true;
+    }
+
+    void RenderTarget::Destroy() {
+        if (m_ColorCount > 0) {
+            glDeleteTextures(m_ColorCount, m_ColorTextures);
+            for (unsigned int& tex : m_ColorTextures) tex = 0;
+            m_ColorCount = 0;
+        }
+        if (m_Framebuffer) {
+            glDeleteFramebuffers(1, &m_Framebuffer);
+            m_Framebuffer = 0;
+        }
+        m_Width = 0;
+        m_Height = 0;
+        m_Dirty = true;
+    }
+
+    void RenderTarget::Begin() {
+        if (!m_Framebuffer || m_Active) return;
+        m_Active = true;
+
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_PrevFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, m_PrevViewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, m_PrevClearColor);
+        m_PrevProjection = projection;
+        m_PrevView = view;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glViewport(0, 0, m_Width, m_Height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // Same y-down pixel space as the window, sized to the target
+        projection = glm::ortho(0.0f, (float)m_Width, (float)m_Height, 0.0f, -1.0f, 1.0f);
+        view = glm::mat4(1.0f);
+        UploadShapeUniforms();
+    }
+
+    void RenderTarget::End() {
+        if (!m_Active) return;
+        m_Active = false;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_PrevFramebuffer);
+        glViewport(m_PrevViewport[0], m_PrevViewport[1], m_PrevViewport[2], m_PrevViewport[3]);
+        glClearColor(m_PrevClearColor[0], m_PrevClearColor[1], m_PrevClearColor[2], m_PrevClearColor[3]);
+
+        projection = m_PrevProjection;
+        view = m_PrevView;
+        UploadShapeUniforms();
+
+        m_Dirty = false;
+    }
+
+    unsigned int RenderTarget::GetTexture(int attachment) const {
+        if (attachment < 0 || attachment >= m_ColorCount) return 0;
+        return m_ColorTextures[attachment];
+    }
+
+    void DrawRenderTarget(const RenderTarget& target, float x, float y) {
+        DrawRenderTarget(target, x, y, (float)target.Width(), (float)target.Height(), 0);
+    }
+
+    void DrawRenderTarget(const RenderTarget& target, float x, float y, float w, float h, int attachment) {
+        // FBO rows start at the bottom while our projection is y-down, so flip V
+        DrawTexturedQuad(x, y, w, h, target.GetTexture(attachment), 0.0f, 1.0f, 1.0f, 0.0f);
+    }
+
+}
@@ -0,0 +1,378 @@
+#include "replay.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "input.hpp"
+#include "frame_pacer.hpp"
+#include "internal.hpp"
+
+namespace ech {
+
+    namespace {
+
+        // File layout (fields written in host byte order, no padding):
+        //   header: "ECHR" | u32 version | u32 seed | u32 frameCount | u32 keyWords
+        //   frame:  f32 deltaTime | u8 flags | payload for each flag set, in flag order
+        // Only what changed since the previous frame is stored, so idle frames cost 5 bytes.
+        constexpr char Magic[4] = { 'E', 'C', 'H', 'R' };
+        constexpr uint32_t Version = 1;
+        constexpr size_t HeaderSize = 20;
+        constexpr size_t FrameCountOffset = 12;
+        constexpr size_t FlushThreshold = 64 * 1024;
+
+        enum FrameFlags : uint8_t {
+            FRAME_KEYS_DOWN = 1 << 0,   // keysDown words
+            FRAME_KEY_EDGES = 1 << 1,   // keysPressed + keysReleased words
+            FRAME_BUTTONS   = 1 << 2,   // buttonsDown, buttonsPressed, buttonsReleased
+            FRAME_MOUSE     = 1 << 3,   // mouseX, mouseY (f64)
+            FRAME_SCROLL    = 1 << 4    // scrollX, scrollY (f64)
+        };
+
+        struct RecorderState {
+            bool active = false;
+            std::ofstream file;
+            std::vector<uint8_t> buffer;
+            InputSnapshot previous;
+            uint32_t frames = 0;
+        };
+
+        struct ReplayState {
+            bool active = false;
+            bool finished = false;
+            bool fastForward = false;
+            std::vector<uint8_t> data;
+            size_t cursor = 0;
+            InputSnapshot current;
+            int frame = 0;
+            int frameCount = 0;
+
+            bool decoded = false;   // current frame's record already applied by the poll
+            float delta = 0.0f;
+
+            double savedPeriod = 0.0;
+            bool savedVSync = false;
+        };
+
+        struct RngState {
+            uint64_t state = 0x853c49e6748fea9bULL;
+            uint64_t inc = 0xda3e39cb94b95bdbULL;
+        };
+
+        RecorderState& Recorder() {
+            static RecorderState state;
+            return state;
+        }
+
+        ReplayState& Replay() {
+            static ReplayState state;
+            return state;
+        }
+
+        RngState& Rng() {
+            static RngState state;
+            return state;
+        }
+
+        uint32_t NextRandom() {
+            RngState& r = Rng();
+            uint64_t old = r.state;
+            r.state = old * 6364136223846793005ULL + r.inc;
+            uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = (uint32_t)(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        template <typename T>
+        void Put(std::vector<uint8_t>& out, const T& value) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), p, p + sizeof(T));
+        }
+
+        void PutWords(std::vector<uint8_t>& out, const uint64_t* words) {
+            for (int i = 0; i < InputKeyWords; ++i) Put(out, words[i]);
+        }
+
+        template <typename T>
+        bool Get(ReplayState& r, T& value) {
+            if (r.cursor + sizeof(T) > r.data.size()) return false;
+            std::memcpy(&value, r.data.data() + r.cursor, sizeof(T));
+            r.cursor += sizeof(T);
+            return true;
+        }
+
+        bool GetWords(ReplayState& r, uint64_t* words) {
+            for (int i = 0; i < InputKeyWords; ++i) {
+                if (!Get(r, words[i])) return false;
+            }
+            return true;
+        }
+
+        bool AnyBits(const uint64_t* words) {
+            for (int i = 0; i < InputKeyWords; ++i) {
+                if (words[i]) return true;
+            }
+            return false;
+        }
+
+        void FlushRecording(RecorderState& rec) {
+            if (rec.buffer.empty()) return;
+            rec.file.write(reinterpret_cast<const char*>(rec.buffer.data()), (std::streamsize)rec.buffer.size());
+            rec.buffer.clear();
+        }
+
+        void RecordFrame(RecorderState& rec, const InputSnapshot& in, float delta) {
+            const InputSnapshot& prev = rec.previous;
+            uint8_t flags = 0;
+            if (std::memcmp(in.keysDown, prev.keysDown, sizeof(in.keysDown)) != 0) flags |= FRAME_KEYS_DOWN;
+            if (AnyBits(in.keysPressed) || AnyBits(in.keysReleased)) flags |= FRAME_KEY_EDGES;
+            if (in.buttonsDown != prev.buttonsDown || in.buttonsPressed || in.buttonsReleased) flags |= FRAME_BUTTONS;
+            if (in.mouseX != prev.mouseX || in.mouseY != prev.mouseY) flags |= FRAME_MOUSE;
+            if (in.scrollX != 0.0 || in.scrollY != 0.0) flags |= FRAME_SCROLL;
+
+            std::vector<uint8_t>& out = rec.buffer;
+            Put(out, delta);
+            Put(out, flags);
+            if (flags & FRAME_KEYS_DOWN) PutWords(out, in.keysDown);
+            if (flags & FRAME_KEY_EDGES) {
+                PutWords(out, in.keysPressed);
+                PutWords(out, in.keysReleased);
+            }
+            if (flags & FRAME_BUTTONS) {
+                Put(out, in.buttonsDown);
+                Put(out, in.buttonsPressed);
+                Put(out, in.buttonsReleased);
+            }
+            if (flags & FRAME_MOUSE) {
+                Put(out, in.mouseX);
+                Put(out, in.mouseY);
+            }
+            if (flags & FRAME_SCROLL) {
+                Put(out, in.scrollX);
+                Put(out, in.scrollY);
+            }
+
+            rec.previous = in;
+            rec.frames++;
+            if (rec.buffer.size() >= FlushThreshold) FlushRecording(rec);
+        }
+
+        // Decode the next frame record into r.current / r.delta
+        bool DecodeFrame(ReplayState& r) {
+            InputSnapshot& in = r.current;
+            uint8_t flags = 0;
+            if (!Get(r, r.delta) || !Get(r, flags)) return false;
+
+            // Edges and scroll only exist for the frame that stored them
+            std::memset(in.keysPressed, 0, sizeof(in.keysPressed));
+            std::memset(in.keysReleased, 0, sizeof(in.keysReleased));
+            in.buttonsPressed = in.buttonsReleased = 0;
+            in.scrollX = in.scrollY = 0.0;
+
+            bool ok = true;
+            if (flags & FRAME_KEYS_DOWN) ok = ok && GetWords(r, in.keysDown);
+            if (flags & FRAME_KEY_EDGES) ok = ok && GetWords(r, in.keysPressed) && GetWords(r, in.keysReleased);
+            if (flags & FRAME_BUTTONS) ok = ok && Get(r, in.buttonsDown) && Get(r, in.buttonsPressed) && Get(r, in.buttonsReleased);
+            if (flags & FRAME_MOUSE) ok = ok && Get(r, in.mouseX) && Get(r, in.mouseY);
+            if (flags & FRAME_SCROLL) ok = ok && Get(r, in.scrollX) && Get(r, in.scrollY);
+            return ok;
+        }
+
+        void RestorePacing(ReplayState& r) {
+            if (!r.fastForward) return;
+            SetFramePacing(r.savedVSync ? PACING_VSYNC : PACING_UNCAPPED);
+            SetPacerPeriod(r.savedPeriod);
+        }
+
+        void FinishReplay(ReplayState& r) {
+            RestorePacing(r);
+            r.active = false;
+            r.finished = true;
+            r.decoded = false;
+            r.data.clear();
+            r.data.shrink_to_fit();
+        }
+
+    }
+
+    bool StartInputRecording(const char* path, uint32_t seed) {
+        RecorderState& rec = Recorder();
+        if (rec.active) StopInputRecording();
+
+        rec.file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!rec.file) {
+            std::cerr << "Failed to open input recording: " << path << std::endl;
+            return false;
+        }
+
+        rec.buffer.assign(Magic, Magic + 4);
+        Put(rec.buffer, Version);
+        Put(rec.buffer, seed);
+        Put(rec.buffer, (uint32_t)0);   // frame count, patched on stop
+        Put(rec.buffer, (uint32_t)InputKeyWords);
+
+        rec.previous = InputSnapshot{};
+        rec.frames = 0;
+        rec.active = true;
+        SetRandomSeed(seed);
+        return true;
+    }
+
+    bool StopInputRecording() {
+        RecorderState& rec = Recorder();
+        if (!rec.active) return false;
+        rec.active = false;
+
+        FlushRecording(rec);
+        rec.file.seekp((std::streamoff)FrameCountOffset);
+        rec.file.write(reinterpret_cast<const char*>(&rec.frames), sizeof(rec.frames));
+        rec.file.close();
+
+        if (rec.file.fail()) {
+            std::cerr << "Failed to write input recording" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool IsInputRecording() {
+        return Recorder().active;
+    }
+
+    bool StartInputReplay(const char* path, bool fastForward) {
+        ReplayState& r = Replay();
+        if (r.active) StopInputReplay();
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            std::cerr << "Failed to open input recording: " << path << std::endl;
+            return false;
+        }
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        r.data.resize(size > 0 ? (size_t)size : 0);
+        if (size <= 0 || !file.read(reinterpret_cast<char*>(r.data.data()), size)) {
+            std::cerr << "Failed to read input recording: " << path << std::endl;
+            r.data.clear();
+            return false;
+        }
+
+        uint32_t version = 0, seed = 0, frames = 0, keyWords = 0;
+        r.cursor = 4;
+        if (r.data.size() < HeaderSize || std::memcmp(r.data.data(), Magic, 4) != 0
+            || !Get(r, version) || !Get(r, seed) || !Get(r, frames) || !Get(r, keyWords)
+            || version != Version || keyWords != (uint32_t)InputKeyWords) {
+            std::cerr << "Not a valid input recording: " << path << std::endl;
+            r.data.clear();
+            return false;
+        }
+
+        r.current = InputSnapshot{};
+        r.frame = 0;
+        r.frameCount = (int)frames;
+        r.decoded = false;
+        r.finished = false;
+        r.fastForward = fastForward;
+        r.active = true;
+
+        if (fastForward) {
+            r.savedPeriod = GetPacerPeriod();
+            r.savedVSync = GetFramePacing() == PACING_VSYNC;
+            SetFramePacing(PACING_UNCAPPED);
+        }
+
+        SetRandomSeed(seed);
+        if (r.frameCount == 0) FinishReplay(r);
+        return true;
+    }
+
+    void StopInputReplay() {
+        ReplayState& r = Replay();
+        if (!r.active) return;
+        FinishReplay(r);
+        r.finished = false;
+    }
+
+    bool IsInputReplaying() {
+        return Replay().active;
+    }
+
+    bool IsInputReplayFinished() {
+        return Replay().finished;
+    }
+
+    int GetReplayFrame() {
+        return Replay().frame;
+    }
+
+    int GetReplayFrameCount() {
+        return Replay().frameCount;
+    }
+
+    bool ReplayInputFrame(InputSnapshot& snapshot) {
+        ReplayState& r = Replay();
+        if (!r.active) return false;
+
+        if (!r.decoded) {
+            if (!DecodeFrame(r)) {
+                std::cerr << "Input recording ended early at frame " << r.frame << std::endl;
+                FinishReplay(r);
+                return false;
+            }
+            r.decoded = true;
+        }
+        snapshot = r.current;
+        return true;
+    }
+
+    double ReplayEndFrame(double measuredDelta) {
+        double delta = measuredDelta;
+
+        ReplayState& r = Replay();
+        if (r.active) {
+            // The game didn't poll this frame; still consume the record to stay in step
+            if (!r.decoded && !DecodeFrame(r)) {
+                std::cerr << "Input recording ended early at frame " << r.frame << std::endl;
+                FinishReplay(r);
+            }
+            else {
+                r.decoded = false;
+                delta = r.delta;
+                if (++r.frame >= r.frameCount) FinishReplay(r);
+            }
+        }
+
+        // Recording a replay re-records the replayed input and timing
+        RecorderState& rec = Recorder();
+        if (rec.active) RecordFrame(rec, GetInputSnapshot(), (float)delta);
+        return delta;
+    }
+
+    void SetRandomSeed(uint32_t seed) {
+        // PCG32 seeding sequence
+        RngState& r = Rng();
+        r.state = 0;
+        r.inc = (0xda3e39cb94b95bdbULL << 1u) | 1u;
+        NextRandom();
+        r.state += seed;
+        NextRandom();
+    }
+
+    int GetRandomValue(int min, int max) {
+        if (min > max) {
+            int t = min;
+            min = max;
+            max = t;
+        }
+        uint64_t range = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+        // Multiply-shift maps 32 random bits onto the range without a modulo
+        return (int)((int64_t)min + (int64_t)(((uint64_t)NextRandom() * range) >> 32));
+    }
+
+    float GetRandomFloat() {
+        return (NextRandom() >> 8) * (1.0f / 16777216.0f);
+    }
+
+}
@@ -0,0 +1,810 @@
+#include "scene.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "collision.hpp"
+#include "echlib.h"
+#include "graphics_internal.hpp"
+#include "profiler.hpp"
+#include "serialize.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ECH_SCENE_X86 1
+#include <immintrin.h>
+#else
+#define ECH_SCENE_X86 0
+#endif
+
+#if ECH_SCENE_X86 && (defined(__GNUC__) || defined(__clang__))
+#define ECH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ECH_TARGET_AVX2
+#endif
+
+namespace ech {
+
+    namespace {
+
+        constexpr int CircleSegments = 32;
+        // Vertices per draw call before the batch is flushed
+        constexpr size_t BatchVertices = 16384;
+
+        struct MatrixArrays {
+            float* a;
+            float* b;
+            float* c;
+            float* d;
+            float* tx;
+            float* ty;
+        };
+
+        // world[p] = world[parent[p]] * local[p] for the dirty slots of [begin, end). Parents
+        // are all outside the range.
+        using ComposeKernel = void (*)(const MatrixArrays& local, const MatrixArrays& world,
+            const int* parent, const uint8_t* dirty, int begin, int end);
+
+        inline void ComposeOne(const MatrixArrays& l, const MatrixArrays& w, int p, int q) {
+            const float pa = w.a[q], pb = w.b[q], pc = w.c[q], pd = w.d[q];
+            const float la = l.a[p], lb = l.b[p], lc = l.c[p], ld = l.d[p], ltx = l.tx[p], lty = l.ty[p];
+            w.a[p] = pa * la + pc * lb;
+            w.b[p] = pb * la + pd * lb;
+            w.c[p] = pa * lc + pc * ld;
+            w.d[p] = pb * lc + pd * ld;
+            w.tx[p] = pa * ltx + pc * lty + w.tx[q];
+            w.ty[p] = pb * ltx + pd * lty + w.ty[q];
+        }
+
+        void ComposeScalar(const MatrixArrays& l, const MatrixArrays& w, const int* parent, const uint8_t* dirty, int begin, int end) {
+            for (int p = begin; p < end; ++p)
+                if (dirty[p]) ComposeOne(l, w, p, parent[p]);
+        }
+
+#if ECH_SCENE_X86
+        // Blocks of eight with any dirty slot are recomputed whole: the clean ones come out
+        // the same, since neither their parent nor their local transform changed
+        ECH_TARGET_AVX2
+        void ComposeAVX2(const MatrixArrays& l, const MatrixArrays& w, const int* parent, const uint8_t* dirty, int begin, int end) {
+            int p = begin;
+            for (; p + 8 <= end; p += 8) {
+                uint64_t flags;
+                std::memcpy(&flags, dirty + p, sizeof(flags));
+                if (!flags) continue;
+
+                const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(parent + p));
+                const __m256 pa = _mm256_i32gather_ps(w.a, q, 4), pb = _mm256_i32gather_ps(w.b, q, 4);
+                const __m256 pc = _mm256_i32gather_ps(w.c, q, 4), pd = _mm256_i32gather_ps(w.d, q, 4);
+                const __m256 ptx = _mm256_i32gather_ps(w.tx, q, 4), pty = _mm256_i32gather_ps(w.ty, q, 4);
+                const __m256 la = _mm256_loadu_ps(l.a + p), lb = _mm256_loadu_ps(l.b + p);
+                const __m256 lc = _mm256_loadu_ps(l.c + p), ld = _mm256_loadu_ps(l.d + p);
+                const __m256 ltx = _mm256_loadu_ps(l.tx + p), lty = _mm256_loadu_ps(l.ty + p);
+
+                _mm256_storeu_ps(w.a + p, _mm256_add_ps(_mm256_mul_ps(pa, la), _mm256_mul_ps(pc, lb)));
+                _mm256_storeu_ps(w.b + p, _mm256_add_ps(_mm256_mul_ps(pb, la), _mm256_mul_ps(pd, lb)));
+                _mm256_storeu_ps(w.c + p, _mm256_add_ps(_mm256_mul_ps(pa, lc), _mm256_mul_ps(pc, ld)));
+                _mm256_storeu_ps(w.d + p, _mm256_add_ps(_mm256_mul_ps(pb, lc), _mm256_mul_ps(pd, ld)));
+                _mm256_storeu_ps(w.tx + p, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa, ltx), _mm256_mul_ps(pc, lty)), ptx));
+                _mm256_storeu_ps(w.ty + p, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pb, ltx), _mm256_mul_ps(pd, lty)), pty));
+            }
+            ComposeScalar(l, w, parent, dirty, p, end);
+        }
+#endif
+
+        ComposeKernel KernelFor(SimdLevel level) {
+#if ECH_SCENE_X86
+            if (level == SIMD_AVX2) return ComposeAVX2;
+#endif
+            (void)level;
+            return ComposeScalar;
+        }
+
+        // Unit circle points for circle drawables
+        struct CircleTable {
+            float x[CircleSegments], y[CircleSegments];
+            CircleTable() {
+                for (int i = 0; i < CircleSegments; ++i) {
+                    const float angle = 6.2831853f * i / CircleSegments;
+                    x[i] = std::cos(angle);
+                    y[i] = std::sin(angle);
+                }
+            }
+        };
+
+        const CircleTable& Circle() {
+            static const CircleTable table;
+            return table;
+        }
+
+        // One saved node. Parents come before their children.
+        struct NodeRecord {
+            int32_t parent;                     // record index, -1 for roots
+            float x, y, rotation, scaleX, scaleY;
+            uint8_t visible;
+            uint8_t drawable;                   // DrawableType
+            uint8_t reserved[2];
+            int32_t layer;
+            float w, h, originX, originY;
+            float color[4];
+            uint32_t texture;
+            float u0, v0, u1, v1;
+        };
+
+        const Schema& NodeSchema() {
+            static const Schema schema = { 1, sizeof(NodeRecord), {
+                ECH_SCHEMA_FIELD(NodeRecord, parent),
+                ECH_SCHEMA_FIELD(NodeRecord, x),
+                ECH_SCHEMA_FIELD(NodeRecord, y),
+                ECH_SCHEMA_FIELD(NodeRecord, rotation),
+                ECH_SCHEMA_FIELD(NodeRecord, scaleX),
+                ECH_SCHEMA_FIELD(NodeRecord, scaleY),
+                ECH_SCHEMA_FIELD(NodeRecord, visible),
+                ECH_SCHEMA_FIELD(NodeRecord, drawable),
+                ECH_SCHEMA_FIELD(NodeRecord, layer),
+                ECH_SCHEMA_FIELD(NodeRecord, w),
+                ECH_SCHEMA_FIELD(NodeRecord, h),
+                ECH_SCHEMA_FIELD(NodeRecord, originX),
+                ECH_SCHEMA_FIELD(NodeRecord, originY),
+                ECH_SCHEMA_FIELD(NodeRecord, color),
+                ECH_SCHEMA_FIELD(NodeRecord, texture),
+                ECH_SCHEMA_FIELD(NodeRecord, u0),
+                ECH_SCHEMA_FIELD(NodeRecord, v0),
+                ECH_SCHEMA_FIELD(NodeRecord, u1),
+                ECH_SCHEMA_FIELD(NodeRecord, v1)
+            } };
+            return schema;
+        }
+
+        template <typename T>
+        void Gather(std::vector<T>& values, const std::vector<int>& from) {
+            std::vector<T> sorted(from.size());
+            for (size_t i = 0; i < from.size(); ++i) sorted[i] = values[(size_t)from[i]];
+            values.swap(sorted);
+        }
+
+    }
+
+    void Scene::Matrices::Resize(size_t n) {
+        a.resize(n, 1.0f);
+        b.resize(n, 0.0f);
+        c.resize(n, 0.0f);
+        d.resize(n, 1.0f);
+        tx.resize(n, 0.0f);
+        ty.resize(n, 0.0f);
+    }
+
+    // --- Nodes ---
+
+    int Scene::Slot(int node) const {
+        if (node < 0 || node >= (int)m_Nodes.size()) return -1;
+        return m_Nodes[node].slot;
+    }
+
+    bool Scene::IsValid(int node) const {
+        return Slot(node) >= 0;
+    }
+
+    int Scene::CreateNode(int parent) {
+        if (parent != -1 && !IsValid(parent)) {
+            std::cerr << "Scene: invalid parent " << parent << std::endl;
+            return -1;
+        }
+
+        int node;
+        if (!m_FreeNodes.empty()) {
+            node = m_FreeNodes.back();
+            m_FreeNodes.pop_back();
+        }
+        else {
+            node = (int)m_Nodes.size();
+            m_Nodes.emplace_back();
+            m_Drawables.emplace_back();
+        }
+
+        // New slots go at the end; the next Update() sorts them into place
+        const int slot = (int)m_Handle.size();
+        m_Nodes[node] = Node();
+        m_Nodes[node].slot = slot;
+        m_Drawables[node] = Drawable();
+        m_Handle.push_back(node);
+        m_ParentSlot.push_back(parent >= 0 ? m_Nodes[parent].slot : -1);
+        m_X.push_back(0.0f);
+        m_Y.push_back(0.0f);
+        m_Rotation.push_back(0.0f);
+        m_ScaleX.push_back(1.0f);
+        m_ScaleY.push_back(1.0f);
+        m_Local.Resize(m_Handle.size());
+        m_World.Resize(m_Handle.size());
+        m_Dirty.push_back(1);
+        m_Visible.push_back(1);
+        m_Shown.push_back(1);
+        if (parent >= 0) Link(node, parent);
+
+        m_NodeCount++;
+        m_OrderDirty = m_AnyDirty = true;
+        return node;
+    }
+
+    void Scene::DestroyNode(int node) {
+        if (!IsValid(node)) return;
+        Unlink(node);
+
+        // The subtree, breadth first
+        std::vector<int> doomed(1, node);
+        for (size_t i = 0; i < doomed.size(); ++i)
+            for (int child = m_Nodes[doomed[i]].firstChild; child >= 0; child = m_Nodes[child].nextSibling)
+                doomed.push_back(child);
+
+        for (int n : doomed) {
+            m_Handle[m_Nodes[n].slot] = -1;
+            m_Nodes[n] = Node();
+            m_Drawables[n] = Drawable();
+            m_FreeNodes.push_back(n);
+        }
+        m_NodeCount -= (int)doomed.size();
+        m_OrderDirty = m_DrawListDirty = true;
+    }
+
+    void Scene::Clear() {
+        m_Nodes.clear();
+        m_FreeNodes.clear();
+        m_Drawables.clear();
+        m_NodeCount = 0;
+        m_Handle.clear();
+        m_ParentSlot.clear();
+        m_X.clear();
+        m_Y.clear();
+        m_Rotation.clear();
+        m_ScaleX.clear();
+        m_ScaleY.clear();
+        m_Local.Resize(0);
+        m_World.Resize(0);
+        m_Dirty.clear();
+        m_Visible.clear();
+        m_Shown.clear();
+        m_LevelStart.clear();
+        m_DrawList.clear();
+        m_OrderDirty = m_DrawListDirty = m_AnyDirty = false;
+    }
+
+    void Scene::Link(int node, int parent) {
+        Node& n = m_Nodes[node];
+        Node& p = m_Nodes[parent];
+        n.parent = parent;
+        n.prevSibling = p.lastChild;
+        n.nextSibling = -1;
+        if (p.lastChild >= 0) m_Nodes[p.lastChild].nextSibling = node;
+        else p.firstChild = node;
+        p.lastChild = node;
+    }
+
+    void Scene::Unlink(int node) {
+        Node& n = m_Nodes[node];
+        if (n.parent < 0) return;
+        Node& p = m_Nodes[n.parent];
+        if (n.prevSibling >= 0) m_Nodes[n.prevSibling].nextSibling = n.nextSibling;
+        else p.firstChild = n.nextSibling;
+        if (n.nextSibling >= 0) m_Nodes[n.nextSibling].prevSibling = n.prevSibling;
+        else p.lastChild = n.prevSibling;
+        n.parent = n.prevSibling = n.nextSibling = -1;
+    }
+
+    bool Scene::SetParent(int node, int parent, bool keepWorldTransform) {
+        if (!IsValid(node) || (parent != -1 && !IsValid(parent))) return false;
+        if (m_Nodes[node].parent == parent) return true;
+        for (int p = parent; p >= 0; p = m_Nodes[p].parent) {
+            if (p == node) {
+                std::cerr << "Scene: can't parent node " << node << " to " << parent << ", which is in its subtree" << std::endl;
+                return false;
+            }
+        }
+
+        if (keepWorldTransform) {
+            Update();
+            const int s = m_Nodes[node].slot;
+            float a = m_World.a[s], b = m_World.b[s], c = m_World.c[s], d = m_World.d[s];
+            float tx = m_World.tx[s], ty = m_World.ty[s];
+            if (parent >= 0) {
+                // local = inverse(parent world) * world
+                const int q = m_Nodes[parent].slot;
+                const float pa = m_World.a[q], pb = m_World.b[q], pc = m_World.c[q], pd = m_World.d[q];
+                const float det = pa * pd - pb * pc;
+                const float inv = det != 0.0f ? 1.0f / det : 0.0f;
+                const float ia = pd * inv, ib = -pb * inv, ic = -pc * inv, id = pa * inv;
+                const float rx = tx - m_World.tx[q], ry = ty - m_World.ty[q];
+                const float na = ia * a + ic * b, nb = ib * a + id * b;
+                const float nc = ia * c + ic * d, nd = ib * c + id * d;
+                tx = ia * rx + ic * ry;
+                ty = ib * rx + id * ry;
+                a = na; b = nb; c = nc; d = nd;
+            }
+            const float scaleX = std::sqrt(a * a + b * b);
+            m_X[s] = tx;
+            m_Y[s] = ty;
+            m_Rotation[s] = std::atan2(b, a);
+            m_ScaleX[s] = scaleX;
+            m_ScaleY[s] = scaleX > 0.0f ? (a * d - b * c) / scaleX : std::sqrt(c * c + d * d);
+            SetLocal(s);
+        }
+
+        Unlink(node);
+        if (parent >= 0) Link(node, parent);
+        const int slot = m_Nodes[node].slot;
+        m_ParentSlot[slot] = parent >= 0 ? m_Nodes[parent].slot : -1;
+        m_Dirty[slot] = 1;
+        m_OrderDirty = m_AnyDirty = true;
+        return true;
+    }
+
+    int Scene::GetParent(int node) const {
+        return IsValid(node) ? m_Nodes[node].parent : -1;
+    }
+
+    // --- Local transforms ---
+
+    void Scene::SetLocal(int slot) {
+        const float s = std::sin(m_Rotation[slot]), c = std::cos(m_Rotation[slot]);
+        m_Local.a[slot] = c * m_ScaleX[slot];
+        m_Local.b[slot] = s * m_ScaleX[slot];
+        m_Local.c[slot] = -s * m_ScaleY[slot];
+        m_Local.d[slot] = c * m_ScaleY[slot];
+        m_Local.tx[slot] = m_X[slot];
+        m_Local.ty[slot] = m_Y[slot];
+        m_Dirty[slot] = 1;
+        m_AnyDirty = true;
+    }
+
+    void Scene::SetPosition(int node, float x, float y) {
+        const int s = Slot(node);
+        if (s < 0) return;
+        // Translation only: no need to redo the rotation
+        m_X[s] = m_Local.tx[s] = x;
+        m_Y[s] = m_Local.ty[s] = y;
+        m_Dirty[s] = 1;
+        m_AnyDirty = true;
+    }
+
+    void Scene::SetRotation(int node, float radians) {
+        const int s = Slot(node);
+        if (s < 0) return;
+        m_Rotation[s] = radians;
+        SetLocal(s);
+    }
+
+    void Scene::SetScale(int node, float scaleX, float scaleY) {
+        const int s = Slot(node);
+        if (s < 0) return;
+        m_ScaleX[s] = scaleX;
+        m_ScaleY[s] = scaleY;
+        SetLocal(s);
+    }
+
+    void Scene::SetTransform(int node, float x, float y, float radians, float scaleX, float scaleY) {
+        const int s = Slot(node);
+        if (s < 0) return;
+        m_X[s] = x;
+        m_Y[s] = y;
+        m_Rotation[s] = radians;
+        m_ScaleX[s] = scaleX;
+        m_ScaleY[s] = scaleY;
+        SetLocal(s);
+    }
+
+    float Scene::GetX(int node) const { const int s = Slot(node); return s >= 0 ? m_X[s] : 0.0f; }
+    float Scene::GetY(int node) const { const int s = Slot(node); return s >= 0 ? m_Y[s] : 0.0f; }
+    float Scene::GetRotation(int node) const { const int s = Slot(node); return s >= 0 ? m_Rotation[s] : 0.0f; }
+    float Scene::GetScaleX(int node) const { const int s = Slot(node); return s >= 0 ? m_ScaleX[s] : 0.0f; }
+    float Scene::GetScaleY(int node) const { const int s = Slot(node); return s >= 0 ? m_ScaleY[s] : 0.0f; }
+
+    float Scene::GetWorldX(int node) const { const int s = Slot(node); return s >= 0 ? m_World.tx[s] : 0.0f; }
+    float Scene::GetWorldY(int node) const { const int s = Slot(node); return s >= 0 ? m_World.ty[s] : 0.0f; }
+
+    float Scene::GetWorldRotation(int node) const {
+        const int s = Slot(node);
+        return s >= 0 ? std::atan2(m_World.b[s], m_World.a[s]) : 0.0f;
+    }
+
+    void Scene::TransformPoint(int node, float x, float y, float& worldX, float& worldY) const {
+        const int s = Slot(node);
+        if (s < 0) {
+            worldX = x;
+            worldY = y;
+            return;
+        }
+        worldX = m_World.a[s] * x + m_World.c[s] * y + m_World.tx[s];
+        worldY = m_World.b[s] * x + m_World.d[s] * y + m_World.ty[s];
+    }
+
+    // --- Drawables ---
+
+    void Scene::SetRectangle(int node, float w, float h, const Color& color) {
+        if (!IsValid(node)) return;
+        Drawable& d = m_Drawables[node];
+        d.type = DRAWABLE_RECTANGLE;
+        d.w = w;
+        d.h = h;
+        SetColor(node, color);
+        m_DrawListDirty = true;
+    }
+
+    void Scene::SetCircle(int node, float radius, const Color& color) {
+        if (!IsValid(node)) return;
+        Drawable& d = m_Drawables[node];
+        d.type = DRAWABLE_CIRCLE;
+        d.w = d.h = radius * 2.0f;
+        SetColor(node, color);
+        m_DrawListDirty = true;
+    }
+
+    void Scene::SetSprite(int node, unsigned int texture, float w, float h) {
+        if (!IsValid(node)) return;
+        Drawable& d = m_Drawables[node];
+        d.type = DRAWABLE_SPRITE;
+        d.texture = texture;
+        d.w = w;
+        d.h = h;
+        m_DrawListDirty = true;
+    }
+
+    void Scene::SetSpriteRegion(int node, float u0, float v0, float u1, float v1) {
+        if (!IsValid(node)) return;
+        Drawable& d = m_Drawables[node];
+        d.u0 = u0;
+        d.v0 = v0;
+        d.u1 = u1;
+        d.v1 = v1;
+    }
+
+    void Scene::SetColor(int node, const Color& color) {
+        if (!IsValid(node)) return;
+        float* c = m_Drawables[node].color;
+        c[0] = color.r;
+        c[1] = color.g;
+        c[2] = color.b;
+        c[3] = color.a;
+    }
+
+    void Scene::SetOrigin(int node, float x, float y) {
+        if (!IsValid(node)) return;
+        m_Drawables[node].originX = x;
+        m_Drawables[node].originY = y;
+    }
+
+    void Scene::ClearDrawable(int node) {
+        if (!IsValid(node)) return;
+        m_Drawables[node].type = DRAWABLE_NONE;
+        m_DrawListDirty = true;
+    }
+
+    void Scene::SetVisible(int node, bool visible) {
+        const int s = Slot(node);
+        if (s < 0) return;
+        m_Visible[s] = visible ? 1 : 0;
+        m_AnyDirty = true;
+    }
+
+    bool Scene::IsVisible(int node) const {
+        const int s = Slot(node);
+        return s >= 0 && m_Visible[s];
+    }
+
+    void Scene::SetLayer(int node, int layer) {
+        if (!IsValid(node) || m_Drawables[node].layer == layer) return;
+        m_Drawables[node].layer = layer;
+        m_DrawListDirty = true;
+    }
+
+    // --- Update ---
+
+    // Breadth-first order from the roots: parents first, one contiguous range per depth, and
+    // siblings in the order they were attached
+    void Scene::Rebuild() {
+        std::vector<int> order;
+        order.reserve((size_t)m_NodeCount);
+        for (int handle : m_Handle)
+            if (handle >= 0 && m_Nodes[handle].parent < 0) order.push_back(handle);
+
+        m_LevelStart.clear();
+        size_t begin = 0;
+        while (begin < order.size()) {
+            m_LevelStart.push_back((int)begin);
+            const size_t end = order.size();
+            for (size_t i = begin; i < end; ++i)
+                for (int child = m_Nodes[order[i]].firstChild; child >= 0; child = m_Nodes[child].nextSibling)
+                    order.push_back(child);
+            begin = end;
+        }
+        m_LevelStart.push_back((int)order.size());
+
+        std::vector<int> from(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            from[i] = m_Nodes[order[i]].slot;
+            m_Nodes[order[i]].slot = (int)i;
+        }
+        Gather(m_X, from);
+        Gather(m_Y, from);
+        Gather(m_Rotation, from);
+        Gather(m_ScaleX, from);
+        Gather(m_ScaleY, from);
+        for (Matrices* m : { &m_Local, &m_World }) {
+            Gather(m->a, from);
+            Gather(m->b, from);
+            Gather(m->c, from);
+            Gather(m->d, from);
+            Gather(m->tx, from);
+            Gather(m->ty, from);
+        }
+        Gather(m_Dirty, from);
+        Gather(m_Visible, from);
+        Gather(m_Shown, from);
+
+        m_Handle = std::move(order);
+        m_ParentSlot.resize(m_Handle.size());
+        for (size_t i = 0; i < m_Handle.size(); ++i) {
+            const int parent = m_Nodes[m_Handle[i]].parent;
+            m_ParentSlot[i] = parent >= 0 ? m_Nodes[parent].slot : -1;
+        }
+
+        m_OrderDirty = false;
+        m_DrawListDirty = true;
+        m_AnyDirty = true;
+    }
+
+    void Scene::Update() {
+        ECH_PROFILE_SCOPE("Scene::Update");
+        if (m_OrderDirty) Rebuild();
+        m_UpdatedCount = 0;
+        if (!m_AnyDirty || m_LevelStart.size() < 2) return;
+
+        const MatrixArrays local = { m_Local.a.data(), m_Local.b.data(), m_Local.c.data(), m_Local.d.data(), m_Local.tx.data(), m_Local.ty.data() };
+        const MatrixArrays world = { m_World.a.data(), m_World.b.data(), m_World.c.data(), m_World.d.data(), m_World.tx.data(), m_World.ty.data() };
+        const ComposeKernel kernel = KernelFor(GetSimdLevel());
+
+        // Roots: the world transform is the local one
+        for (int p = m_LevelStart[0]; p < m_LevelStart[1]; ++p) {
+            m_Shown[p] = m_Visible[p];
+            if (!m_Dirty[p]) continue;
+            m_World.a[p] = m_Local.a[p];
+            m_World.b[p] = m_Local.b[p];
+            m_World.c[p] = m_Local.c[p];
+            m_World.d[p] = m_Local.d[p];
+            m_World.tx[p] = m_Local.tx[p];
+            m_World.ty[p] = m_Local.ty[p];
+            m_UpdatedCount++;
+        }
+
+        // Each deeper level only reads the one above it, which is final by then
+        for (size_t level = 1; level + 1 < m_LevelStart.size(); ++level) {
+            const int begin = m_LevelStart[level], end = m_LevelStart[level + 1];
+            for (int p = begin; p < end; ++p) {
+                const int q = m_ParentSlot[p];
+                m_Dirty[p] |= m_Dirty[q];
+                m_Shown[p] = m_Visible[p] & m_Shown[q];
+                m_UpdatedCount += m_Dirty[p];
+            }
+            kernel(local, world, m_ParentSlot.data(), m_Dirty.data(), begin, end);
+        }
+
+        std::fill(m_Dirty.begin(), m_Dirty.end(), (uint8_t)0);
+        m_AnyDirty = false;
+    }
+
+    // --- Drawing ---
+
+    void Scene::BuildDrawList() {
+        m_DrawList.clear();
+        for (int handle : m_Handle)
+            if (handle >= 0 && m_Drawables[handle].type != DRAWABLE_NONE) m_DrawList.push_back(handle);
+        std::stable_sort(m_DrawList.begin(), m_DrawList.end(), [this](int a, int b) {
+            return m_Drawables[a].layer < m_Drawables[b].layer;
+        });
+        m_DrawListDirty = false;
+    }
+
+    void Scene::Draw() {
+        Update();
+        if (m_DrawListDirty) BuildDrawList();
+        ECH_PROFILE_SCOPE("Scene::Draw");
+
+        // Current batch: shapes of one color, or sprites of one texture
+        bool sprites = false;
+        unsigned int texture = 0;
+        const float* color = nullptr;
+
+        auto flush = [&]() {
+            if (m_Indices.empty()) return;
+            const int stride = sprites ? 4 : 2;
+            if (sprites) {
+                glUseProgram(shaderProgramTexture);
+                ECH_STATS_SHADER(shaderProgramTexture);
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgramTexture, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgramTexture, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                ECH_STATS_TEXTURE_BIND(texture);
+                glUniform1i(glGetUniformLocation(shaderProgramTexture, "texture1"), 0);
+            }
+            else {
+                glUseProgram(shaderProgramShape);
+                ECH_STATS_SHADER(shaderProgramShape);
+                glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color[0], color[1], color[2], color[3]);
+            }
+
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(float), m_Vertices.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), m_Indices.data(), GL_DYNAMIC_DRAW);
+            ECH_STATS_UPLOAD(m_Vertices.size() * sizeof(float) + m_Indices.size() * sizeof(unsigned int));
+
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            if (sprites) {
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)(2 * sizeof(float)));
+                glEnableVertexAttribArray(1);
+            }
+
+            glDrawElements(GL_TRIANGLES, (GLsizei)m_Indices.size(), GL_UNSIGNED_INT, 0);
+            ECH_STATS_DRAW(m_Indices.size());
+            glBindVertexArray(0);
+
+            m_Vertices.clear();
+            m_Indices.clear();
+        };
+
+        for (int handle : m_DrawList) {
+            const int s = m_Nodes[handle].slot;
+            if (!m_Shown[s]) continue;
+            const Drawable& d = m_Drawables[handle];
+            const bool isSprite = d.type == DRAWABLE_SPRITE;
+            if (isSprite && d.texture == 0) continue;
+
+            const bool sameBatch = isSprite == sprites &&
+                (isSprite ? d.texture == texture : (color && std::memcmp(color, d.color, sizeof(d.color)) == 0));
+            const int stride = sprites ? 4 : 2;
+            if (!sameBatch || m_Vertices.size() / stride + CircleSegments + 1 > BatchVertices) {
+                flush();
+                sprites = isSprite;
+                texture = d.texture;
+                color = d.color;
+            }
+
+            const float a = m_World.a[s], b = m_World.b[s], c = m_World.c[s], dd = m_World.d[s];
+            const float tx = m_World.tx[s], ty = m_World.ty[s];
+            const unsigned int base = (unsigned int)(m_Vertices.size() / (isSprite ? 4 : 2));
+
+            if (d.type == DRAWABLE_CIRCLE) {
+                const CircleTable& unit = Circle();
+                const float r = d.w * 0.5f;
+                m_Vertices.push_back(tx);
+                m_Vertices.push_back(ty);
+                for (int i = 0; i < CircleSegments; ++i) {
+                    const float x = r * unit.x[i], y = r * unit.y[i];
+                    m_Vertices.push_back(a * x + c * y + tx);
+                    m_Vertices.push_back(b * x + dd * y + ty);
+                    m_Indices.push_back(base);
+                    m_Indices.push_back(base + 1 + i);
+                    m_Indices.push_back(base + 1 + (i + 1) % CircleSegments);
+                }
+                continue;
+            }
+
+            const float x0 = -d.originX * d.w, y0 = -d.originY * d.h;
+            const float corners[4][4] = {
+                { x0,       y0,       d.u0, d.v0 },
+                { x0 + d.w, y0,       d.u1, d.v0 },
+                { x0 + d.w, y0 + d.h, d.u1, d.v1 },
+                { x0,       y0 + d.h, d.u0, d.v1 }
+            };
+            for (const float* corner : corners) {
+                m_Vertices.push_back(a * corner[0] + c * corner[1] + tx);
+                m_Vertices.push_back(b * corner[0] + dd * corner[1] + ty);
+                if (isSprite) {
+                    m_Vertices.push_back(corner[2]);
+                    m_Vertices.push_back(corner[3]);
+                }
+            }
+            const unsigned int quad[] = { base, base + 1, base + 2, base + 2, base + 3, base };
+            m_Indices.insert(m_Indices.end(), quad, quad + 6);
+        }
+        flush();
+    }
+
+    // --- Saving ---
+
+    bool Scene::Save(const std::string& path) {
+        // Sorting puts parents first
+        Update();
+
+        std::vector<NodeRecord> records(m_Handle.size());
+        for (size_t s = 0; s < m_Handle.size(); ++s) {
+            const Drawable& d = m_Drawables[m_Handle[s]];
+            NodeRecord& r = records[s];
+            r = NodeRecord();
+            r.parent = m_ParentSlot[s];
+            r.x = m_X[s];
+            r.y = m_Y[s];
+            r.rotation = m_Rotation[s];
+            r.scaleX = m_ScaleX[s];
+            r.scaleY = m_ScaleY[s];
+            r.visible = m_Visible[s];
+            r.drawable = (uint8_t)d.type;
+            r.layer = d.layer;
+            r.w = d.w;
+            r.h = d.h;
+            r.originX = d.originX;
+            r.originY = d.originY;
+            std::memcpy(r.color, d.color, sizeof(r.color));
+            r.texture = d.texture;
+            r.u0 = d.u0;
+            r.v0 = d.v0;
+            r.u1 = d.u1;
+            r.v1 = d.v1;
+        }
+
+        BinaryWriter writer;
+        writer.AddTable("SceneNodes", NodeSchema(), records);
+        return writer.Save(path);
+    }
+
+    bool Scene::Load(const std::string& path) {
+        BinaryFile file;
+        if (!file.Open(path)) return false;
+
+        // In place when the layout is current, converted from an older one otherwise
+        size_t count = 0;
+        const NodeRecord* records = file.GetRecords<NodeRecord>("SceneNodes", NodeSchema(), count);
+        std::vector<NodeRecord> converted;
+        if (!records) {
+            NodeRecord defaults = NodeRecord();
+            defaults.parent = -1;
+            defaults.scaleX = defaults.scaleY = 1.0f;
+            defaults.visible = 1;
+            defaults.originX = defaults.originY = 0.5f;
+            for (float& c : defaults.color) c = 1.0f;
+            defaults.u1 = defaults.v1 = 1.0f;
+            if (!file.ReadTable("SceneNodes", NodeSchema(), converted, defaults)) {
+                std::cerr << "Scene: no nodes in " << path << std::endl;
+                return false;
+            }
+            records = converted.data();
+            count = converted.size();
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            if (records[i].parent < -1 || records[i].parent >= (int32_t)i || records[i].drawable > DRAWABLE_SPRITE) {
+                std::cerr << "Scene: corrupt node " << i << " in " << path << std::endl;
+                return false;
+            }
+        }
+
+        Clear();
+        for (size_t i = 0; i < count; ++i) {
+            const NodeRecord& r = records[i];
+            // Handles are handed out in order on an empty scene
+            const int node = CreateNode(r.parent);
+            SetTransform(node, r.x, r.y, r.rotation, r.scaleX, r.scaleY);
+            m_Visible[m_Nodes[node].slot] = r.visible ? 1 : 0;
+
+            Drawable& d = m_Drawables[node];
+            d.type = (DrawableType)r.drawable;
+            d.layer = r.layer;
+            d.w = r.w;
+            d.h = r.h;
+            d.originX = r.originX;
+            d.originY = r.originY;
+            std::memcpy(d.color, r.color, sizeof(d.color));
+            d.texture = r.texture;
+            d.u0 = r.u0;
+            d.v0 = r.v0;
+            d.u1 = r.u1;
+            d.v1 = r.v1;
+        }
+        m_DrawListDirty = true;
+        return true;
+    }
+
+}
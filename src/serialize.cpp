@@ -0,0 +1,467 @@
+#include "serialize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace ech {
+
+    namespace {
+
+        constexpr char BinaryMagic[4] = { 'E', 'C', 'H', 'B' };
+        constexpr uint32_t BinaryFormatVersion = 1;
+        constexpr uint32_t ByteOrderMark = 0x01020304u;
+        constexpr size_t TableAlignment = 64;
+
+        constexpr uint32_t BlobRecordSize = 0;  // blobs count bytes
+
+        struct FieldEntry {
+            RelPtr<char> name;
+            uint32_t type, offset, count, reserved;
+        };
+
+        struct FileTable {
+            RelPtr<char> name;
+            uint32_t schemaVersion;
+            uint32_t recordSize;            // BlobRecordSize for blobs
+            RelArray<FieldEntry> fields;
+            RelPtr<unsigned char> data;
+            uint64_t count;                 // records, or bytes for blobs
+        };
+
+        struct FileHeader {
+            char magic[4];
+            uint32_t formatVersion;
+            uint32_t byteOrder;
+            uint32_t version;               // the caller's
+            uint64_t size;                  // of the whole file
+            uint64_t checksum;              // of everything after the header
+            RelArray<FileTable> tables;
+            uint64_t reserved[2];
+        };
+
+        static_assert(sizeof(FileHeader) == 64, "the header fills the space before the first table");
+
+        const size_t FieldSizes[FIELD_TYPE_COUNT] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+        size_t Align(size_t value, size_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // --- XXH64 ---
+
+        constexpr uint64_t Prime1 = 11400714785074694791ull;
+        constexpr uint64_t Prime2 = 14029467366897019727ull;
+        constexpr uint64_t Prime3 = 1609587929392839161ull;
+        constexpr uint64_t Prime4 = 9650029242287828579ull;
+        constexpr uint64_t Prime5 = 2870177450012600261ull;
+
+        inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        inline uint64_t Read64(const unsigned char* p) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t Read32(const unsigned char* p) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t Round(uint64_t acc, uint64_t input) {
+            acc += input * Prime2;
+            return Rotl(acc, 31) * Prime1;
+        }
+
+        inline uint64_t MergeRound(uint64_t acc, uint64_t value) {
+            acc ^= Round(0, value);
+            return acc * Prime1 + Prime4;
+        }
+
+        // --- Field conversion ---
+
+        bool IsFloat(uint32_t type) { return type == FIELD_FLOAT32 || type == FIELD_FLOAT64; }
+
+        int64_t LoadInteger(const unsigned char* p, uint32_t type) {
+            switch (type) {
+            case FIELD_INT8: { int8_t v; std::memcpy(&v, p, 1); return v; }
+            case FIELD_UINT8: return *p;
+            case FIELD_INT16: { int16_t v; std::memcpy(&v, p, 2); return v; }
+            case FIELD_UINT16: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+            case FIELD_INT32: { int32_t v; std::memcpy(&v, p, 4); return v; }
+            case FIELD_UINT32: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+            default: { int64_t v; std::memcpy(&v, p, 8); return v; }
+            }
+        }
+
+        double LoadFloat(const unsigned char* p, uint32_t type) {
+            if (type == FIELD_FLOAT32) { float v; std::memcpy(&v, p, 4); return v; }
+            if (type == FIELD_FLOAT64) { double v; std::memcpy(&v, p, 8); return v; }
+            if (type == FIELD_UINT64) { uint64_t v; std::memcpy(&v, p, 8); return (double)v; }
+            return (double)LoadInteger(p, type);
+        }
+
+        void StoreInteger(unsigned char* p, uint32_t type, int64_t value) {
+            switch (type) {
+            case FIELD_INT8: case FIELD_UINT8: { uint8_t v = (uint8_t)value; std::memcpy(p, &v, 1); break; }
+            case FIELD_INT16: case FIELD_UINT16: { uint16_t v = (uint16_t)value; std::memcpy(p, &v, 2); break; }
+            case FIELD_INT32: case FIELD_UINT32: { uint32_t v = (uint32_t)value; std::memcpy(p, &v, 4); break; }
+            default: std::memcpy(p, &value, 8); break;
+            }
+        }
+
+        // Floats going into integers are rounded toward zero and clamped to the type's range
+        void StoreFloat(unsigned char* p, uint32_t type, double value) {
+            if (type == FIELD_FLOAT32) { float v = (float)value; std::memcpy(p, &v, 4); return; }
+            if (type == FIELD_FLOAT64) { std::memcpy(p, &value, 8); return; }
+            static const double Low[] = { -128.0, 0.0, -32768.0, 0.0, -2147483648.0, 0.0, -9223372036854775808.0, 0.0 };
+            static const double High[] = { 127.0, 255.0, 32767.0, 65535.0, 2147483647.0, 4294967295.0, 9223372036854774784.0, 18446744073709549568.0 };
+            if (std::isnan(value)) value = 0.0;
+            value = std::min(std::max(std::trunc(value), Low[type]), High[type]);
+            if (type == FIELD_UINT64) {
+                const uint64_t v = (uint64_t)value;
+                std::memcpy(p, &v, 8);
+            }
+            else StoreInteger(p, type, (int64_t)value);
+        }
+
+        const FileHeader& HeaderOf(const MappedFile& file) {
+            return *reinterpret_cast<const FileHeader*>(file.Data());
+        }
+
+        const FileTable* TableAt(const MappedFile& file, int table) {
+            if (!file.IsOpen() || table < 0 || (size_t)table >= HeaderOf(file).tables.Size()) return nullptr;
+            return &HeaderOf(file).tables[(size_t)table];
+        }
+
+        bool SameLayout(const FileTable& table, const Schema& schema) {
+            if (table.recordSize != schema.size || table.fields.Size() != schema.fields.size()) return false;
+            for (size_t i = 0; i < schema.fields.size(); ++i) {
+                const FieldEntry& entry = table.fields[i];
+                const SchemaField& field = schema.fields[i];
+                if (entry.type != (uint32_t)field.type || entry.offset != field.offset || entry.count != field.count
+                    || field.name != entry.name.Get()) return false;
+            }
+            return true;
+        }
+
+        bool ValidSchema(const Schema& schema) {
+            for (const SchemaField& field : schema.fields) {
+                if (field.type >= FIELD_TYPE_COUNT
+                    || (uint64_t)field.offset + (uint64_t)field.count * FieldSizes[field.type] > schema.size) return false;
+            }
+            return true;
+        }
+
+    }
+
+    uint64_t ComputeChecksum(const void* data, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* const end = p + size;
+        uint64_t h;
+
+        if (size >= 32) {
+            uint64_t v1 = Prime1 + Prime2, v2 = Prime2, v3 = 0, v4 = 0 - Prime1;
+            const unsigned char* const limit = end - 32;
+            do {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+            h = MergeRound(h, v1);
+            h = MergeRound(h, v2);
+            h = MergeRound(h, v3);
+            h = MergeRound(h, v4);
+        }
+        else h = Prime5;
+
+        h += (uint64_t)size;
+        for (; p + 8 <= end; p += 8) {
+            h ^= Round(0, Read64(p));
+            h = Rotl(h, 27) * Prime1 + Prime4;
+        }
+        if (p + 4 <= end) {
+            h ^= (uint64_t)Read32(p) * Prime1;
+            h = Rotl(h, 23) * Prime2 + Prime3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h ^= *p * Prime5;
+            h = Rotl(h, 11) * Prime1;
+        }
+
+        h ^= h >> 33;
+        h *= Prime2;
+        h ^= h >> 29;
+        h *= Prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    // --- BinaryWriter ---
+
+    BinaryWriter::BinaryWriter() {
+        Clear();
+    }
+
+    void BinaryWriter::Clear() {
+        m_Data.assign(sizeof(FileHeader), 0);
+        m_Tables.clear();
+    }
+
+    void BinaryWriter::AddTable(const std::string& name, const Schema& schema, const void* records, size_t count) {
+        if (schema.size == 0 || !ValidSchema(schema)) {
+            std::cerr << "BinaryWriter: invalid schema for table " << name << std::endl;
+            return;
+        }
+        const size_t offset = Align(m_Data.size(), TableAlignment);
+        const size_t bytes = count * schema.size;
+        m_Data.resize(offset + bytes, 0);
+        if (bytes) std::memcpy(m_Data.data() + offset, records, bytes);
+        m_Tables.push_back({ name, schema, false, offset, count });
+    }
+
+    void BinaryWriter::AddBlob(const std::string& name, const void* data, size_t size) {
+        const size_t offset = Align(m_Data.size(), TableAlignment);
+        m_Data.resize(offset + size, 0);
+        if (size) std::memcpy(m_Data.data() + offset, data, size);
+        m_Tables.push_back({ name, Schema(), true, offset, size });
+    }
+
+    bool BinaryWriter::Save(const std::string& path, uint32_t version) {
+        // The directory goes after the data: table entries, then the fields, then the names
+        const size_t dataEnd = m_Data.size();
+        const size_t tablesAt = Align(dataEnd, 8);
+        size_t fieldsAt = tablesAt + m_Tables.size() * sizeof(FileTable);
+        size_t namesAt = fieldsAt;
+        for (const Table& table : m_Tables) namesAt += table.schema.fields.size() * sizeof(FieldEntry);
+        size_t end = namesAt;
+        for (const Table& table : m_Tables) {
+            end += table.name.size() + 1;
+            for (const SchemaField& field : table.schema.fields) end += field.name.size() + 1;
+        }
+        m_Data.resize(end, 0);
+
+        unsigned char* const base = m_Data.data();
+        auto name = [&](RelPtr<char>& ptr, const std::string& text) {
+            std::memcpy(base + namesAt, text.c_str(), text.size() + 1);
+            ptr.Set(reinterpret_cast<const char*>(base + namesAt));
+            namesAt += text.size() + 1;
+        };
+
+        FileTable* tables = reinterpret_cast<FileTable*>(base + tablesAt);
+        for (size_t t = 0; t < m_Tables.size(); ++t) {
+            const Table& source = m_Tables[t];
+            FileTable& table = tables[t];
+            name(table.name, source.name);
+            table.schemaVersion = source.blob ? 0 : source.schema.version;
+            table.recordSize = source.blob ? BlobRecordSize : source.schema.size;
+            table.data.Set(base + source.offset);
+            table.count = source.count;
+
+            FieldEntry* fields = reinterpret_cast<FieldEntry*>(base + fieldsAt);
+            for (size_t f = 0; f < source.schema.fields.size(); ++f) {
+                const SchemaField& field = source.schema.fields[f];
+                name(fields[f].name, field.name);
+                fields[f].type = field.type;
+                fields[f].offset = field.offset;
+                fields[f].count = field.count;
+                fields[f].reserved = 0;
+            }
+            table.fields.Set(fields, source.schema.fields.size());
+            fieldsAt += source.schema.fields.size() * sizeof(FieldEntry);
+        }
+
+        FileHeader& header = *reinterpret_cast<FileHeader*>(base);
+        std::memcpy(header.magic, BinaryMagic, sizeof(header.magic));
+        header.formatVersion = BinaryFormatVersion;
+        header.byteOrder = ByteOrderMark;
+        header.version = version;
+        header.size = end;
+        header.tables.Set(tables, m_Tables.size());
+        header.checksum = ComputeChecksum(base + sizeof(FileHeader), end - sizeof(FileHeader));
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        const bool written = file && file.write(reinterpret_cast<const char*>(base), (std::streamsize)end);
+        // Drop the directory again so more tables can be added
+        m_Data.resize(dataEnd);
+        if (!written) {
+            std::cerr << "BinaryWriter: failed to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // --- BinaryFile ---
+
+    bool BinaryFile::Open(const std::string& path, bool verifyChecksum) {
+        Close();
+        if (!m_File.Open(path)) {
+            std::cerr << "BinaryFile: failed to open " << path << std::endl;
+            return false;
+        }
+
+        const unsigned char* const base = m_File.Data();
+        const size_t size = m_File.Size();
+
+        // Where a relative offset stored at `field` lands, if `bytes` from there fit in the file.
+        // An offset of 0 reads back as null, so it only stands for something empty.
+        auto target = [&](const void* field, int64_t offset, uint64_t bytes, size_t alignment, size_t& at) {
+            if (offset == 0 && bytes != 0) return false;
+            const int64_t from = static_cast<const unsigned char*>(field) - base;
+            if (offset < -from || offset > (int64_t)size - from) return false;
+            at = (size_t)(from + offset);
+            return at % alignment == 0 && bytes <= size - at;
+        };
+        auto validName = [&](const RelPtr<char>& name) {
+            size_t at;
+            return name.offset != 0 && target(&name, name.offset, 0, 1, at) && std::memchr(base + at, '\0', size - at) != nullptr;
+        };
+
+        auto fail = [&](const char* reason) {
+            std::cerr << "BinaryFile: " << path << ": " << reason << std::endl;
+            m_File.Close();
+            return false;
+        };
+
+        if (size < sizeof(FileHeader)) return fail("not a binary file");
+        const FileHeader& header = *reinterpret_cast<const FileHeader*>(base);
+        if (std::memcmp(header.magic, BinaryMagic, sizeof(header.magic)) != 0) return fail("not a binary file");
+        if (header.formatVersion != BinaryFormatVersion) return fail("unsupported format version");
+        if (header.byteOrder != ByteOrderMark) return fail("written with another byte order");
+        if (header.size != size) return fail("truncated");
+        if (verifyChecksum && ComputeChecksum(base + sizeof(FileHeader), size - sizeof(FileHeader)) != header.checksum)
+            return fail("checksum mismatch");
+
+        size_t at;
+        if (header.tables.count > size / sizeof(FileTable)
+            || !target(&header.tables, header.tables.offset, header.tables.count * sizeof(FileTable), 8, at)) return fail("corrupt table directory");
+
+        for (const FileTable& table : header.tables) {
+            if (!validName(table.name)) return fail("corrupt table name");
+            if (table.fields.count > size / sizeof(FieldEntry)
+                || !target(&table.fields, table.fields.offset, table.fields.count * sizeof(FieldEntry), 8, at))
+                return fail("corrupt schema");
+
+            const uint64_t recordSize = table.recordSize == BlobRecordSize ? 1 : table.recordSize;
+            if (table.count > size / recordSize || !target(&table.data, table.data.offset, table.count * recordSize, TableAlignment, at))
+                return fail("corrupt table data");
+            if (table.recordSize == BlobRecordSize && table.fields.count != 0) return fail("corrupt schema");
+
+            for (const FieldEntry& field : table.fields) {
+                if (!validName(field.name) || field.type >= FIELD_TYPE_COUNT
+                    || (uint64_t)field.offset + (uint64_t)field.count * FieldSizes[field.type] > table.recordSize) return fail("corrupt schema");
+            }
+        }
+        return true;
+    }
+
+    void BinaryFile::Close() {
+        m_File.Close();
+    }
+
+    uint32_t BinaryFile::GetVersion() const {
+        return IsOpen() ? HeaderOf(m_File).version : 0;
+    }
+
+    int BinaryFile::GetTableCount() const {
+        return IsOpen() ? (int)HeaderOf(m_File).tables.Size() : 0;
+    }
+
+    int BinaryFile::FindTable(const std::string& name) const {
+        for (int i = 0; i < GetTableCount(); ++i) {
+            if (name == TableAt(m_File, i)->name.Get()) return i;
+        }
+        return -1;
+    }
+
+    const char* BinaryFile::GetTableName(int table) const {
+        const FileTable* entry = TableAt(m_File, table);
+        return entry ? entry->name.Get() : "";
+    }
+
+    uint32_t BinaryFile::GetSchemaVersion(int table) const {
+        const FileTable* entry = TableAt(m_File, table);
+        return entry ? entry->schemaVersion : 0;
+    }
+
+    size_t BinaryFile::GetRecordCount(int table) const {
+        const FileTable* entry = TableAt(m_File, table);
+        return entry && entry->recordSize != BlobRecordSize ? (size_t)entry->count : 0;
+    }
+
+    const void* BinaryFile::GetRecords(int table, const Schema& schema) const {
+        const FileTable* entry = TableAt(m_File, table);
+        if (!entry || entry->recordSize == BlobRecordSize || !SameLayout(*entry, schema)) return nullptr;
+        return entry->data.Get();
+    }
+
+    bool BinaryFile::ReadRecords(int table, const Schema& schema, void* out, const void* defaults) const {
+        const FileTable* entry = TableAt(m_File, table);
+        if (!entry || entry->recordSize == BlobRecordSize || schema.size == 0 || !ValidSchema(schema)) return false;
+
+        const size_t count = (size_t)entry->count;
+        unsigned char* const records = static_cast<unsigned char*>(out);
+        if (SameLayout(*entry, schema)) {
+            if (count) std::memcpy(records, entry->data.Get(), count * schema.size);
+            return true;
+        }
+
+        // Match the fields by name once, then copy them record by record
+        struct Match {
+            const SchemaField* field;
+            const FieldEntry* source;
+            uint32_t count;
+        };
+        std::vector<Match> matches;
+        for (const SchemaField& field : schema.fields) {
+            for (const FieldEntry& source : entry->fields) {
+                if (field.name == source.name.Get()) {
+                    matches.push_back({ &field, &source, std::min(field.count, source.count) });
+                    break;
+                }
+            }
+        }
+
+        const unsigned char* from = entry->data.Get();
+        for (size_t r = 0; r < count; ++r, from += entry->recordSize) {
+            unsigned char* const to = records + r * schema.size;
+            if (defaults) std::memcpy(to, defaults, schema.size);
+            else std::memset(to, 0, schema.size);
+
+            for (const Match& m : matches) {
+                const uint32_t toType = m.field->type, fromType = m.source->type;
+                const size_t toSize = FieldSizes[toType], fromSize = FieldSizes[fromType];
+                unsigned char* dst = to + m.field->offset;
+                const unsigned char* src = from + m.source->offset;
+                if (toType == fromType) {
+                    std::memcpy(dst, src, m.count * toSize);
+                    continue;
+                }
+                for (uint32_t i = 0; i < m.count; ++i, dst += toSize, src += fromSize) {
+                    if (!IsFloat(toType) && !IsFloat(fromType)) StoreInteger(dst, toType, LoadInteger(src, fromType));
+                    else StoreFloat(dst, toType, LoadFloat(src, fromType));
+                }
+            }
+        }
+        return true;
+    }
+
+    const void* BinaryFile::GetBlob(const std::string& name, size_t& size) const {
+        const FileTable* entry = TableAt(m_File, FindTable(name));
+        if (!entry || entry->recordSize != BlobRecordSize) {
+            size = 0;
+            return nullptr;
+        }
+        size = (size_t)entry->count;
+        return entry->data.Get();
+    }
+
+}
@@ -0,0 +1,204 @@
+#include "spatial_hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ech {
+
+    namespace {
+
+        inline uint64_t PackCell(int cx, int cy) {
+            return ((uint64_t)(uint32_t)cx << 32) | (uint64_t)(uint32_t)cy;
+        }
+
+        inline int CellX(uint64_t cell) { return (int)(int32_t)(uint32_t)(cell >> 32); }
+        inline int CellY(uint64_t cell) { return (int)(int32_t)(uint32_t)cell; }
+
+        // Same test as CheckCollision: touching edges don't count
+        inline bool Overlaps(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh) {
+            return ax < bx + bw && ax + aw > bx && ay < by + bh && ay + ah > by;
+        }
+
+    }
+
+    SpatialHash::SpatialHash(float cellSize) {
+        m_CellSize = 64.0f;
+        m_InvCellSize = 1.0f / 64.0f;
+        SetCellSize(cellSize);
+    }
+
+    void SpatialHash::SetCellSize(float cellSize) {
+        if (!(cellSize > 0.0f)) return;
+        m_CellSize = cellSize;
+        m_InvCellSize = 1.0f / cellSize;
+        for (Box& box : m_Boxes) {
+            if (box.alive) CellRange(box.x, box.y, box.w, box.h, box.minCx, box.minCy, box.maxCx, box.maxCy);
+        }
+        m_Dirty = true;
+    }
+
+    void SpatialHash::CellRange(float x, float y, float w, float h, int& minCx, int& minCy, int& maxCx, int& maxCy) const {
+        minCx = (int)std::floor(x * m_InvCellSize);
+        minCy = (int)std::floor(y * m_InvCellSize);
+        maxCx = std::max(minCx, (int)std::floor((x + w) * m_InvCellSize));
+        maxCy = std::max(minCy, (int)std::floor((y + h) * m_InvCellSize));
+    }
+
+    uint32_t SpatialHash::Bucket(uint64_t cell) const {
+        return (uint32_t)((cell * 0x9E3779B97F4A7C15ULL) >> 32) & m_BucketMask;
+    }
+
+    int SpatialHash::Insert(float x, float y, float w, float h) {
+        int handle;
+        if (!m_FreeHandles.empty()) {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+        }
+        else {
+            handle = (int)m_Boxes.size();
+            m_Boxes.push_back({});
+            m_QueryStamp.push_back(0);
+        }
+
+        Box& box = m_Boxes[handle];
+        box.x = x; box.y = y; box.w = w; box.h = h;
+        CellRange(x, y, w, h, box.minCx, box.minCy, box.maxCx, box.maxCy);
+        box.alive = true;
+        m_Count++;
+        m_Dirty = true;
+        return handle;
+    }
+
+    void SpatialHash::Move(int handle, float x, float y, float w, float h) {
+        if (!IsValid(handle)) return;
+        Box& box = m_Boxes[handle];
+        box.x = x; box.y = y; box.w = w; box.h = h;
+
+        int minCx, minCy, maxCx, maxCy;
+        CellRange(x, y, w, h, minCx, minCy, maxCx, maxCy);
+        // The cell table only stores handles, so moving within the same cells needs no rebuild
+        if (minCx != box.minCx || minCy != box.minCy || maxCx != box.maxCx || maxCy != box.maxCy) {
+            box.minCx = minCx; box.minCy = minCy;
+            box.maxCx = maxCx; box.maxCy = maxCy;
+            m_Dirty = true;
+        }
+    }
+
+    void SpatialHash::Remove(int handle) {
+        if (!IsValid(handle)) return;
+        m_Boxes[handle].alive = false;
+        m_FreeHandles.push_back(handle);
+        m_Count--;
+        m_Dirty = true;
+    }
+
+    void SpatialHash::Clear() {
+        m_Boxes.clear();
+        m_FreeHandles.clear();
+        m_QueryStamp.clear();
+        m_Count = 0;
+        m_Dirty = true;
+    }
+
+    bool SpatialHash::IsValid(int handle) const {
+        return handle >= 0 && handle < (int)m_Boxes.size() && m_Boxes[handle].alive;
+    }
+
+    void SpatialHash::Rebuild() {
+        m_Dirty = false;
+
+        m_Scratch.clear();
+        for (int i = 0; i < (int)m_Boxes.size(); ++i) {
+            const Box& box = m_Boxes[i];
+            if (!box.alive) continue;
+            for (int cy = box.minCy; cy <= box.maxCy; ++cy)
+                for (int cx = box.minCx; cx <= box.maxCx; ++cx)
+                    m_Scratch.push_back({ PackCell(cx, cy), i });
+        }
+
+        // About one bucket per entry keeps buckets short without a hash map per cell
+        uint32_t buckets = 1;
+        while (buckets < m_Scratch.size()) buckets <<= 1;
+        m_BucketMask = buckets - 1;
+
+        // Counting sort by bucket: O(n), and every cell's entries end up contiguous
+        m_BucketStart.assign(buckets + 1, 0);
+        for (const CellEntry& e : m_Scratch) m_BucketStart[Bucket(e.cell)]++;
+        uint32_t sum = 0;
+        for (uint32_t b = 0; b <= buckets; ++b) {
+            uint32_t count = m_BucketStart[b];
+            m_BucketStart[b] = sum;
+            sum += count;
+        }
+        m_Entries.resize(m_Scratch.size());
+        for (const CellEntry& e : m_Scratch) m_Entries[m_BucketStart[Bucket(e.cell)]++] = e;
+        // The scatter left each start at the end of its bucket, i.e. the start of the next one
+        for (uint32_t b = buckets; b > 0; --b) m_BucketStart[b] = m_BucketStart[b - 1];
+        m_BucketStart[0] = 0;
+    }
+
+    int SpatialHash::FindOverlappingPairs(CollisionPair* pairs, int maxPairs) {
+        if (m_Dirty) Rebuild();
+
+        int found = 0;
+        const uint32_t buckets = m_BucketMask + 1;
+        for (uint32_t b = 0; b < buckets; ++b) {
+            const uint32_t begin = m_BucketStart[b], end = m_BucketStart[b + 1];
+            for (uint32_t i = begin; i < end; ++i) {
+                const CellEntry& ei = m_Entries[i];
+                const Box& A = m_Boxes[ei.handle];
+                for (uint32_t j = i + 1; j < end; ++j) {
+                    const CellEntry& ej = m_Entries[j];
+                    if (ej.cell != ei.cell) continue; // another cell that hashed to this bucket
+                    const Box& B = m_Boxes[ej.handle];
+
+                    // Boxes sharing several cells would be found in each of them; only report the
+                    // pair from the first cell of their shared range
+                    if (CellX(ei.cell) != std::max(A.minCx, B.minCx) || CellY(ei.cell) != std::max(A.minCy, B.minCy))
+                        continue;
+                    if (!Overlaps(A.x, A.y, A.w, A.h, B.x, B.y, B.w, B.h)) continue;
+
+                    if (found < maxPairs) {
+                        pairs[found].a = std::min(ei.handle, ej.handle);
+                        pairs[found].b = std::max(ei.handle, ej.handle);
+                    }
+                    found++;
+                }
+            }
+        }
+        return found;
+    }
+
+    int SpatialHash::Query(float x, float y, float w, float h, int* handles, int maxHandles) {
+        if (m_Dirty) Rebuild();
+        if (m_Entries.empty()) return 0;
+
+        if (++m_QueryCounter == 0) {
+            std::fill(m_QueryStamp.begin(), m_QueryStamp.end(), 0);
+            m_QueryCounter = 1;
+        }
+
+        int minCx, minCy, maxCx, maxCy;
+        CellRange(x, y, w, h, minCx, minCy, maxCx, maxCy);
+
+        int found = 0;
+        for (int cy = minCy; cy <= maxCy; ++cy) {
+            for (int cx = minCx; cx <= maxCx; ++cx) {
+                const uint64_t cell = PackCell(cx, cy);
+                const uint32_t b = Bucket(cell);
+                for (uint32_t i = m_BucketStart[b]; i < m_BucketStart[b + 1]; ++i) {
+                    const CellEntry& e = m_Entries[i];
+                    if (e.cell != cell || m_QueryStamp[e.handle] == m_QueryCounter) continue;
+                    m_QueryStamp[e.handle] = m_QueryCounter;
+
+                    const Box& box = m_Boxes[e.handle];
+                    if (!Overlaps(x, y, w, h, box.x, box.y, box.w, box.h)) continue;
+                    if (found < maxHandles) handles[found] = e.handle;
+                    found++;
+                }
+            }
+        }
+        return found;
+    }
+
+}
@@ -0,0 +1,355 @@
+#include "tile_collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "tilemap.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ech {
+
+    namespace {
+
+        // Edges closer than this fraction of a tile to a grid line count as on it, so a box
+        // resting against a tile stays outside it despite rounding
+        constexpr float EdgeEpsilon = 1e-4f;
+
+        inline int CountTrailingZeros(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, v);
+            return (int)index;
+#elif defined(_MSC_VER)
+            unsigned long index;
+            if (_BitScanForward(&index, (unsigned long)v)) return (int)index;
+            _BitScanForward(&index, (unsigned long)(v >> 32));
+            return (int)index + 32;
+#else
+            return __builtin_ctzll(v);
+#endif
+        }
+
+        inline int HighestBit(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanReverse64(&index, v);
+            return (int)index;
+#elif defined(_MSC_VER)
+            unsigned long index;
+            if (_BitScanReverse(&index, (unsigned long)(v >> 32))) return (int)index + 32;
+            _BitScanReverse(&index, (unsigned long)v);
+            return (int)index;
+#else
+            return 63 - __builtin_clzll(v);
+#endif
+        }
+
+        // Lowest set bit in [from, to], or -1
+        int FindFirst(const uint64_t* bits, int from, int to) {
+            int word = from >> 6;
+            const int last = to >> 6;
+            uint64_t v = bits[word] & (~0ull << (from & 63));
+            for (;;) {
+                if (word == last) v &= ~0ull >> (63 - (to & 63));
+                if (v) return (word << 6) + CountTrailingZeros(v);
+                if (++word > last) return -1;
+                v = bits[word];
+            }
+        }
+
+        // Highest set bit in [from, to], or -1
+        int FindLast(const uint64_t* bits, int from, int to) {
+            int word = to >> 6;
+            const int first = from >> 6;
+            uint64_t v = bits[word] & (~0ull >> (63 - (to & 63)));
+            for (;;) {
+                if (word == first) v &= ~0ull << (from & 63);
+                if (v) return (word << 6) + HighestBit(v);
+                if (--word < first) return -1;
+                v = bits[word];
+            }
+        }
+
+        // Cells covered by the span [a, b)
+        inline int FirstCell(float a, float size) { return (int)std::floor(a / size + EdgeEpsilon); }
+        inline int LastCell(float b, float size) { return (int)std::ceil(b / size - EdgeEpsilon) - 1; }
+
+        // Floor height across a slope tile as a fraction of the tile height, t in [0, 1] from
+        // the left edge
+        float SlopeHeight(TileShape shape, float t) {
+            switch (shape) {
+            case TILE_SLOPE_UP_RIGHT: return t;
+            case TILE_SLOPE_UP_LEFT: return 1.0f - t;
+            case TILE_SLOPE_UP_RIGHT_LOW: return 0.5f * t;
+            case TILE_SLOPE_UP_RIGHT_HIGH: return 0.5f + 0.5f * t;
+            case TILE_SLOPE_UP_LEFT_HIGH: return 1.0f - 0.5f * t;
+            case TILE_SLOPE_UP_LEFT_LOW: return 0.5f - 0.5f * t;
+            default: return -1.0f;
+            }
+        }
+
+    }
+
+    TileCollision::TileCollision() {}
+
+    TileCollision::TileCollision(int width, int height, float tileWidth, float tileHeight) {
+        Create(width, height, tileWidth, tileHeight);
+    }
+
+    bool TileCollision::Create(int width, int height, float tileWidth, float tileHeight) {
+        if (width <= 0 || height <= 0 || tileWidth <= 0.0f || tileHeight <= 0.0f) {
+            std::cerr << "TileCollision: invalid size " << width << "x" << height << " with tiles of "
+                << tileWidth << "x" << tileHeight << std::endl;
+            return false;
+        }
+        m_Width = width;
+        m_Height = height;
+        m_TileWidth = tileWidth;
+        m_TileHeight = tileHeight;
+        m_RowWords = (width + 63) / 64;
+        m_ColumnWords = (height + 63) / 64;
+
+        m_Shapes.assign((size_t)width * height, TILE_EMPTY);
+        m_SolidRows.assign((size_t)m_RowWords * height, 0);
+        m_OneWayRows.assign((size_t)m_RowWords * height, 0);
+        m_SolidColumns.assign((size_t)m_ColumnWords * width, 0);
+        m_OneWayColumns.assign((size_t)m_ColumnWords * width, 0);
+        return true;
+    }
+
+    bool TileCollision::Build(const Tilemap& map, const TileShape* shapes, int shapeCount) {
+        if (!Create(map.Width(), map.Height(), map.TileWidth(), map.TileHeight())) return false;
+        SetPosition(map.GetX(), map.GetY());
+        for (int y = 0; y < m_Height; ++y) {
+            for (int x = 0; x < m_Width; ++x) {
+                const int tile = map.GetTile(x, y);
+                if (tile >= 0 && tile < shapeCount) SetTile(x, y, shapes[tile]);
+            }
+        }
+        return true;
+    }
+
+    void TileCollision::SetPosition(float x, float y) {
+        m_X = x;
+        m_Y = y;
+    }
+
+    void TileCollision::SetBit(std::vector<uint64_t>& rows, std::vector<uint64_t>& columns, int x, int y, bool set) {
+        uint64_t& row = rows[(size_t)y * m_RowWords + (x >> 6)];
+        uint64_t& column = columns[(size_t)x * m_ColumnWords + (y >> 6)];
+        if (set) {
+            row |= 1ull << (x & 63);
+            column |= 1ull << (y & 63);
+        }
+        else {
+            row &= ~(1ull << (x & 63));
+            column &= ~(1ull << (y & 63));
+        }
+    }
+
+    void TileCollision::SetTile(int x, int y, TileShape shape) {
+        if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) return;
+        m_Shapes[(size_t)y * m_Width + x] = shape;
+        SetBit(m_SolidRows, m_SolidColumns, x, y, shape == TILE_SOLID);
+        SetBit(m_OneWayRows, m_OneWayColumns, x, y, shape == TILE_ONE_WAY);
+    }
+
+    TileShape TileCollision::GetTile(int x, int y) const {
+        if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) return TILE_EMPTY;
+        return (TileShape)m_Shapes[(size_t)y * m_Width + x];
+    }
+
+    bool TileCollision::OverlapsSolid(float x, float y, float w, float h) const {
+        x -= m_X;
+        y -= m_Y;
+        const int c0 = std::max(0, FirstCell(x, m_TileWidth));
+        const int c1 = std::min(m_Width - 1, LastCell(x + w, m_TileWidth));
+        const int r0 = std::max(0, FirstCell(y, m_TileHeight));
+        const int r1 = std::min(m_Height - 1, LastCell(y + h, m_TileHeight));
+        if (c0 > c1 || r0 > r1) return false;
+
+        for (int r = r0; r <= r1; ++r) {
+            if (FindFirst(&m_SolidRows[(size_t)r * m_RowWords], c0, c1) >= 0) return true;
+        }
+        return false;
+    }
+
+    float TileCollision::SweepX(float x, float y, float w, float h, float dx) const {
+        if (dx == 0.0f || m_Width == 0) return dx;
+        x -= m_X;
+        y -= m_Y;
+        const int r0 = std::max(0, FirstCell(y, m_TileHeight));
+        const int r1 = std::min(m_Height - 1, LastCell(y + h, m_TileHeight));
+        if (r0 > r1) return dx;
+
+        if (dx > 0.0f) {
+            // Columns entered on the way, nearest first; each row narrows the search
+            const float right = x + w;
+            const int from = std::max(0, LastCell(right, m_TileWidth) + 1);
+            int to = std::min(m_Width - 1, LastCell(right + dx, m_TileWidth));
+            int hit = -1;
+            for (int r = r0; r <= r1 && from <= to; ++r) {
+                const int c = FindFirst(&m_SolidRows[(size_t)r * m_RowWords], from, to);
+                if (c >= 0) {
+                    hit = c;
+                    to = c - 1;
+                }
+            }
+            return hit < 0 ? dx : std::min(dx, std::max(0.0f, hit * m_TileWidth - right));
+        }
+
+        const int from = std::min(m_Width - 1, FirstCell(x, m_TileWidth) - 1);
+        int to = std::max(0, FirstCell(x + dx, m_TileWidth));
+        int hit = -1;
+        for (int r = r0; r <= r1 && to <= from; ++r) {
+            const int c = FindLast(&m_SolidRows[(size_t)r * m_RowWords], to, from);
+            if (c >= 0) {
+                hit = c;
+                to = c + 1;
+            }
+        }
+        return hit < 0 ? dx : std::max(dx, std::min(0.0f, (hit + 1) * m_TileWidth - x));
+    }
+
+    float TileCollision::SweepY(float x, float y, float w, float h, float dy, bool dropThrough) const {
+        if (dy == 0.0f || m_Width == 0) return dy;
+        x -= m_X;
+        y -= m_Y;
+        const int c0 = std::max(0, FirstCell(x, m_TileWidth));
+        const int c1 = std::min(m_Width - 1, LastCell(x + w, m_TileWidth));
+        if (c0 > c1) return dy;
+
+        if (dy > 0.0f) {
+            // Rows the bottom edge enters. One-way tiles in them start below the box, so they
+            // block the fall just like solid ones.
+            const float bottom = y + h;
+            const int from = std::max(0, LastCell(bottom, m_TileHeight) + 1);
+            int to = std::min(m_Height - 1, LastCell(bottom + dy, m_TileHeight));
+            int hit = -1;
+            for (int c = c0; c <= c1 && from <= to; ++c) {
+                const size_t column = (size_t)c * m_ColumnWords;
+                int r = FindFirst(&m_SolidColumns[column], from, to);
+                if (!dropThrough) {
+                    const int platform = FindFirst(&m_OneWayColumns[column], from, to);
+                    if (platform >= 0 && (r < 0 || platform < r)) r = platform;
+                }
+                if (r >= 0) {
+                    hit = r;
+                    to = r - 1;
+                }
+            }
+            return hit < 0 ? dy : std::min(dy, std::max(0.0f, hit * m_TileHeight - bottom));
+        }
+
+        const int from = std::min(m_Height - 1, FirstCell(y, m_TileHeight) - 1);
+        int to = std::max(0, FirstCell(y + dy, m_TileHeight));
+        int hit = -1;
+        for (int c = c0; c <= c1 && to <= from; ++c) {
+            const int r = FindLast(&m_SolidColumns[(size_t)c * m_ColumnWords], to, from);
+            if (r >= 0) {
+                hit = r;
+                to = r + 1;
+            }
+        }
+        return hit < 0 ? dy : std::max(dy, std::min(0.0f, (hit + 1) * m_TileHeight - y));
+    }
+
+    bool TileCollision::SlopeSurface(int tx, int ty, float localX, float& surfaceY) const {
+        const float height = SlopeHeight(GetTile(tx, ty), std::min(1.0f, std::max(0.0f, localX / m_TileWidth - tx)));
+        if (height < 0.0f) return false;
+        surfaceY = (ty + 1.0f - height) * m_TileHeight;
+        return true;
+    }
+
+    bool TileCollision::GetSlopeSurface(float x, float y, float& surfaceY) const {
+        if (m_Width == 0) return false;
+        x -= m_X;
+        y -= m_Y;
+        if (!SlopeSurface((int)std::floor(x / m_TileWidth), (int)std::floor(y / m_TileHeight), x, surfaceY)) return false;
+        surfaceY += m_Y;
+        return true;
+    }
+
+    bool TileCollision::StandsOnSlope(float footX, float bottom) const {
+        const float tolerance = 0.01f * m_TileHeight;
+        const int tx = (int)std::floor(footX / m_TileWidth);
+        const int r0 = (int)std::floor((bottom - tolerance) / m_TileHeight);
+        const int r1 = (int)std::floor((bottom + tolerance) / m_TileHeight);
+        for (int r = r0; r <= r1; ++r) {
+            float surface;
+            if (SlopeSurface(tx, r, footX, surface) && std::fabs(surface - bottom) <= tolerance) return true;
+        }
+        return false;
+    }
+
+    TileMoveResult TileCollision::Move(float x, float y, float w, float h, float dx, float dy, bool dropThrough) const {
+        TileMoveResult result;
+
+        // On a slope the front edge is higher up than the feet (half the width on a 45 degree
+        // slope), so the tiles under the slope ahead must not stop it
+        float step = 0.0f;
+        if (m_Width > 0 && StandsOnSlope(x + 0.5f * w - m_X, y + h - m_Y)) {
+            step = std::min(0.5f * h, 0.5f * w + std::fabs(dx));
+        }
+        float movedX = SweepX(x, y, w, h - step, dx);
+        if (step > 0.0f && OverlapsSolid(x + movedX, y, w, h)) {
+            // The front edge went into the tiles under the slope ahead, or the floor at its
+            // top: stand on the highest of them, or walk into them like a wall if that is
+            // no way out either
+            const float localX = x + movedX - m_X, bottom = y + h - m_Y;
+            const int c0 = std::max(0, FirstCell(localX, m_TileWidth));
+            const int c1 = std::min(m_Width - 1, LastCell(localX + w, m_TileWidth));
+            const int r0 = std::max(0, FirstCell(bottom - step, m_TileHeight));
+            const int r1 = std::min(m_Height - 1, LastCell(bottom, m_TileHeight));
+            int top = r1 + 1;
+            for (int c = c0; c <= c1 && r0 < top; ++c) {
+                const int r = FindFirst(&m_SolidColumns[(size_t)c * m_ColumnWords], r0, top - 1);
+                if (r >= 0) top = r;
+            }
+            const float lifted = top * m_TileHeight - h + m_Y;
+            if (top <= r1 && !OverlapsSolid(x + movedX, lifted, w, h)) y = lifted;
+            else movedX = SweepX(x, y, w, h, dx);
+        }
+        result.x = x + movedX;
+        result.hitX = movedX != dx;
+
+        const float movedY = SweepY(result.x, y, w, h, dy, dropThrough);
+        result.y = y + movedY;
+        result.hitY = movedY != dy;
+        result.onGround = result.hitY && dy > 0.0f;
+        if (m_Width == 0) return result;
+
+        // Slopes: lift a bottom center that sank into one onto its surface, and when not
+        // moving up, pull it down onto a slope it just walked off the top of
+        const float footX = result.x + 0.5f * w - m_X;
+        const float bottom = result.y + h - m_Y;
+        const float snap = dy >= 0.0f ? std::fabs(movedX) : 0.0f;
+        const int tx = (int)std::floor(footX / m_TileWidth);
+        const int rFirst = (int)std::floor((bottom - m_TileHeight) / m_TileHeight);
+        const int rLast = (int)std::floor((bottom + snap) / m_TileHeight);
+
+        float best = 0.0f;
+        bool found = false;
+        for (int r = rFirst; r <= rLast; ++r) {
+            float surface;
+            if (!SlopeSurface(tx, r, footX, surface)) continue;
+            const bool below = bottom >= surface && bottom - surface <= m_TileHeight;
+            const bool near = surface > bottom && surface - bottom <= snap;
+            if ((below || near) && (!found || surface < best)) {
+                best = surface;
+                found = true;
+            }
+        }
+        if (found) {
+            result.y = best - h + m_Y;
+            result.onGround = true;
+            if (dy > 0.0f) result.hitY = true;
+        }
+        return result;
+    }
+
+}
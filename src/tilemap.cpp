@@ -0,0 +1,286 @@
+#include "tilemap.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "graphics_internal.hpp"
+#include "profiler.hpp"
+
+namespace ech {
+
+    namespace {
+
+        constexpr int QuadsPerChunk = Tilemap::ChunkSize * Tilemap::ChunkSize;
+
+        // Index buffer shared by every chunk of every map: quads are always 4 vertices in
+        // the same order, so one buffer of QuadsPerChunk quads covers any chunk
+        unsigned int& SharedIndexBuffer() {
+            static unsigned int ebo = 0;
+            return ebo;
+        }
+
+        unsigned int GetQuadIndexBuffer() {
+            unsigned int& ebo = SharedIndexBuffer();
+            if (ebo) return ebo;
+
+            std::vector<unsigned short> indices(QuadsPerChunk * 6);
+            for (int q = 0; q < QuadsPerChunk; ++q) {
+                const unsigned short v = (unsigned short)(q * 4);
+                unsigned short* out = &indices[q * 6];
+                out[0] = v; out[1] = v + 1; out[2] = v + 2;
+                out[3] = v + 2; out[4] = v + 3; out[5] = v;
+            }
+            glGenBuffers(1, &ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+            ECH_STATS_UPLOAD(indices.size() * sizeof(unsigned short));
+            return ebo;
+        }
+
+    }
+
+    void ShutdownTilemaps() {
+        unsigned int& ebo = SharedIndexBuffer();
+        if (ebo) {
+            glDeleteBuffers(1, &ebo);
+            ebo = 0;
+        }
+    }
+
+    Tilemap::Tilemap() {}
+
+    Tilemap::Tilemap(int width, int height, float tileWidth, float tileHeight) {
+        Create(width, height, tileWidth, tileHeight);
+    }
+
+    Tilemap::~Tilemap() {
+        Destroy();
+    }
+
+    bool Tilemap::Create(int width, int height, float tileWidth, float tileHeight) {
+        Destroy();
+
+        if (width <= 0 || height <= 0 || tileWidth <= 0.0f || tileHeight <= 0.0f) {
+            std::cerr << "Tilemap: invalid size " << width << "x" << height << " with tiles of "
+                << tileWidth << "x" << tileHeight << std::endl;
+            return false;
+        }
+
+        m_Width = width;
+        m_Height = height;
+        m_TileWidth = tileWidth;
+        m_TileHeight = tileHeight;
+        m_ChunksX = (width + ChunkSize - 1) / ChunkSize;
+        m_ChunksY = (height + ChunkSize - 1) / ChunkSize;
+        m_Tiles.assign((size_t)width * height, EmptyTile);
+        m_Chunks.resize((size_t)m_ChunksX * m_ChunksY);
+        return true;
+    }
+
+    void Tilemap::Destroy() {
+        DestroyChunks();
+        m_Chunks.clear();
+        m_Tiles.clear();
+        m_Width = m_Height = 0;
+        m_ChunksX = m_ChunksY = 0;
+        m_DrawnChunks = 0;
+    }
+
+    void Tilemap::DestroyChunks() {
+        for (Chunk& chunk : m_Chunks) {
+            if (chunk.vbo) glDeleteBuffers(1, &chunk.vbo);
+            if (chunk.vao) glDeleteVertexArrays(1, &chunk.vao);
+            chunk = Chunk();
+        }
+    }
+
+    bool Tilemap::SetTileset(unsigned int texture, int tileWidth, int tileHeight, int margin, int spacing) {
+        if (texture == 0 || tileWidth <= 0 || tileHeight <= 0 || margin < 0 || spacing < 0) {
+            std::cerr << "Tilemap: invalid tileset" << std::endl;
+            return false;
+        }
+
+        GLint prevTexture = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTexture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        ECH_STATS_TEXTURE_BIND(texture);
+        GLint texWidth = 0, texHeight = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texWidth);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texHeight);
+        glBindTexture(GL_TEXTURE_2D, (GLuint)prevTexture);
+        ECH_STATS_TEXTURE_BIND((unsigned int)prevTexture);
+
+        const int columns = (texWidth - 2 * margin + spacing) / (tileWidth + spacing);
+        const int rows = (texHeight - 2 * margin + spacing) / (tileHeight + spacing);
+        if (columns <= 0 || rows <= 0) {
+            std::cerr << "Tilemap: tileset texture (" << texWidth << "x" << texHeight
+                << ") holds no " << tileWidth << "x" << tileHeight << " tiles" << std::endl;
+            return false;
+        }
+
+        m_Texture = texture;
+        m_TextureWidth = texWidth;
+        m_TextureHeight = texHeight;
+        m_SourceWidth = tileWidth;
+        m_SourceHeight = tileHeight;
+        m_Margin = margin;
+        m_Spacing = spacing;
+        m_Columns = columns;
+        m_TileCount = columns * rows;
+
+        // UVs are baked into the chunks
+        for (Chunk& chunk : m_Chunks) chunk.dirty = true;
+        return true;
+    }
+
+    void Tilemap::MarkDirty(int x, int y) {
+        m_Chunks[(size_t)(y / ChunkSize) * m_ChunksX + x / ChunkSize].dirty = true;
+    }
+
+    void Tilemap::SetTile(int x, int y, int tile) {
+        if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) return;
+        int& slot = m_Tiles[(size_t)y * m_Width + x];
+        if (slot == tile) return;
+        slot = tile;
+        MarkDirty(x, y);
+    }
+
+    int Tilemap::GetTile(int x, int y) const {
+        if (x < 0 || y < 0 || x >= m_Width || y >= m_Height) return EmptyTile;
+        return m_Tiles[(size_t)y * m_Width + x];
+    }
+
+    void Tilemap::SetTiles(int x, int y, int width, int height, const int* tiles) {
+        if (!tiles) return;
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                SetTile(x + col, y + row, tiles[(size_t)row * width + col]);
+            }
+        }
+    }
+
+    void Tilemap::Fill(int tile) {
+        std::fill(m_Tiles.begin(), m_Tiles.end(), tile);
+        for (Chunk& chunk : m_Chunks) chunk.dirty = true;
+    }
+
+    void Tilemap::SetPosition(float x, float y) {
+        // Chunks are built relative to the map, so moving it (e.g. parallax) rebuilds nothing
+        m_X = x;
+        m_Y = y;
+    }
+
+    void Tilemap::BuildChunk(int cx, int cy) {
+        Chunk& chunk = m_Chunks[(size_t)cy * m_ChunksX + cx];
+        chunk.dirty = false;
+
+        const int x0 = cx * ChunkSize, y0 = cy * ChunkSize;
+        const int x1 = std::min(x0 + ChunkSize, m_Width), y1 = std::min(y0 + ChunkSize, m_Height);
+
+        // Inset by half a texel so linear filtering never samples the neighbouring tile
+        const float invW = 1.0f / m_TextureWidth, invH = 1.0f / m_TextureHeight;
+
+        m_Scratch.clear();
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                const int tile = m_Tiles[(size_t)y * m_Width + x];
+                if (tile < 0 || tile >= m_TileCount) continue;
+
+                const int sx = m_Margin + (tile % m_Columns) * (m_SourceWidth + m_Spacing);
+                const int sy = m_Margin + (tile / m_Columns) * (m_SourceHeight + m_Spacing);
+                const float u0 = (sx + 0.5f) * invW, u1 = (sx + m_SourceWidth - 0.5f) * invW;
+                const float v0 = (sy + 0.5f) * invH, v1 = (sy + m_SourceHeight - 0.5f) * invH;
+
+                const float px = x * m_TileWidth, py = y * m_TileHeight;
+                const float qx = px + m_TileWidth, qy = py + m_TileHeight;
+                m_Scratch.insert(m_Scratch.end(), {
+                    px, py, u0, v0,
+                    qx, py, u1, v0,
+                    qx, qy, u1, v1,
+                    px, qy, u0, v1
+                    });
+            }
+        }
+        chunk.quadCount = (int)(m_Scratch.size() / 16);
+        if (chunk.quadCount == 0) return;
+
+        if (!chunk.vao) {
+            glGenVertexArrays(1, &chunk.vao);
+            glGenBuffers(1, &chunk.vbo);
+
+            glBindVertexArray(chunk.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetQuadIndexBuffer());
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+            glBindVertexArray(0);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferData(GL_ARRAY_BUFFER, m_Scratch.size() * sizeof(float), m_Scratch.data(), GL_STATIC_DRAW);
+        ECH_STATS_UPLOAD(m_Scratch.size() * sizeof(float));
+    }
+
+    void Tilemap::Draw() {
+        // World rectangle seen through the current matrices: unproject the NDC corners
+        const glm::mat4 inverse = glm::inverse(projection * view);
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        for (int i = 0; i < 4; ++i) {
+            const glm::vec4 p = inverse * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, 0.0f, 1.0f);
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        Draw(minX, minY, maxX - minX, maxY - minY);
+    }
+
+    void Tilemap::Draw(float viewX, float viewY, float viewW, float viewH) {
+        ECH_PROFILE_SCOPE("Tilemap::Draw");
+        m_DrawnChunks = 0;
+        if (m_Width == 0 || m_Texture == 0) return;
+
+        // Visible chunk range, in map space
+        const float chunkW = m_TileWidth * ChunkSize, chunkH = m_TileHeight * ChunkSize;
+        const int cx0 = std::max(0, (int)std::floor((viewX - m_X) / chunkW));
+        const int cy0 = std::max(0, (int)std::floor((viewY - m_Y) / chunkH));
+        const int cx1 = std::min(m_ChunksX - 1, (int)std::floor((viewX + viewW - m_X) / chunkW));
+        const int cy1 = std::min(m_ChunksY - 1, (int)std::floor((viewY + viewH - m_Y) / chunkH));
+        if (cx0 > cx1 || cy0 > cy1) return;
+
+        glUseProgram(shaderProgramTexture);
+        ECH_STATS_SHADER(shaderProgramTexture);
+
+        // The map offset rides on the view matrix; put the plain one back afterwards
+        const glm::mat4 mapView = glm::translate(view, glm::vec3(m_X, m_Y, 0.0f));
+        const GLint viewLocation = glGetUniformLocation(shaderProgramTexture, "uView");
+        glUniformMatrix4fv(glGetUniformLocation(shaderProgramTexture, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(mapView));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_Texture);
+        ECH_STATS_TEXTURE_BIND(m_Texture);
+        glUniform1i(glGetUniformLocation(shaderProgramTexture, "texture1"), 0);
+
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                Chunk& chunk = m_Chunks[(size_t)cy * m_ChunksX + cx];
+                if (chunk.dirty) BuildChunk(cx, cy);
+                if (chunk.quadCount == 0) continue;
+
+                glBindVertexArray(chunk.vao);
+                glDrawElements(GL_TRIANGLES, chunk.quadCount * 6, GL_UNSIGNED_SHORT, 0);
+                ECH_STATS_DRAW(chunk.quadCount * 6);
+                ++m_DrawnChunks;
+            }
+        }
+        glBindVertexArray(0);
+
+        glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+    }
+
+}
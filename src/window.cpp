@@ -6,15 +6,47 @@
 
 #include "internal.hpp"
 #include "graphics_internal.hpp"
+#include "render_target.hpp"
 
 static bool s_GLFWInitialized = false;
 
 namespace ech {
 
-    Window::Window(int width, int height, const char* title)
-        : m_Width(width), m_Height(height)
+    // Try the context backends that work without a display, best first.
+    // EGL/OSMesa on the null platform need GLFW 3.4; older GLFW falls back to an invisible window.
+    static GLFWwindow* CreateHeadlessNativeWindow(int width, int height, const char* title) {
+        const int contextApis[] = {
+#ifdef GLFW_EGL_CONTEXT_API
+            GLFW_EGL_CONTEXT_API,
+#endif
+#ifdef GLFW_OSMESA_CONTEXT_API
+            GLFW_OSMESA_CONTEXT_API,
+#endif
+            GLFW_NATIVE_CONTEXT_API
+        };
+
+        for (int api : contextApis) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+            GLFWwindow* window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+            if (window) return window;
+        }
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+        return nullptr;
+    }
+
+    Window::Window(int width, int height, const char* title, bool headless)
+        : m_Width(width), m_Height(height), m_Headless(headless)
     {
-        if (!glfwInit()) {
+#ifdef GLFW_PLATFORM_NULL
+        // No display on CI boxes: don't even try to connect to X11/Wayland
+        if (headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+        const int initialized = glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+        // Init hints outlive glfwTerminate(): don't force the next init headless as well
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+        if (!initialized) {
             std::cerr << "Failed to initialize GLFW\n";
             return;
         }
@@ -23,9 +55,16 @@ namespace ech {
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-        m_Window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+        if (headless) {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            m_Window = CreateHeadlessNativeWindow(width, height, title);
+            glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        }
+        else {
+            m_Window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+        }
         if (!m_Window) {
-            std::cerr << "Failed to create GLFW window\n";
+            std::cerr << (headless ? "Failed to create headless GL context\n" : "Failed to create GLFW window\n");
             glfwTerminate();
             return;
         }
@@ -46,8 +85,20 @@ namespace ech {
         auto*& def = ech::GetDefaultWindow();
         if (!def) def = this;
 
+        // Input queries read the events of every window, whichever has focus
+        ech::InstallInputCallbacks(m_Window);
+
         // ? Graphics init must happen AFTER context exists
         ech::InitGraphics(m_Window);
+
+        if (headless) {
+            // The default framebuffer of a hidden/surfaceless window is undefined, so render offscreen
+            m_Offscreen = std::make_unique<RenderTarget>(width, height);
+            if (!m_Offscreen->IsValid()) {
+                std::cerr << "Failed to create headless framebuffer\n";
+            }
+            BindDefaultFramebuffer();
+        }
 		glfwSwapInterval(0); // Disable vsync by default
         if (!s_GLFWInitialized)
         {
@@ -60,7 +111,10 @@ namespace ech {
     }
 
     Window::~Window() {
+        m_Offscreen.reset(); // GL objects go before the context does
+
         if (m_Window) {
+            ech::RemoveInputCallbacks(m_Window);
             glfwDestroyWindow(m_Window);
             m_Window = nullptr;
         }
@@ -73,4 +127,29 @@ namespace ech {
         return m_Window ? glfwWindowShouldClose(m_Window) : true;
     }
 
+    void Window::GetFramebufferSize(int& width, int& height) const {
+        if (m_Offscreen) {
+            width = m_Offscreen->Width();
+            height = m_Offscreen->Height();
+        }
+        else if (m_Window) {
+            glfwGetFramebufferSize(m_Window, &width, &height);
+        }
+        else {
+            width = 0;
+            height = 0;
+        }
+    }
+
+    unsigned int Window::GetFramebuffer() const {
+        return m_Offscreen ? m_Offscreen->GetFramebuffer() : 0;
+    }
+
+    void Window::BindDefaultFramebuffer() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer());
+        int w, h;
+        GetFramebufferSize(w, h);
+        glViewport(0, 0, w, h);
+    }
+
 }